@@ -1,6 +1,9 @@
 #ifndef SERIAL_H_
 #define SERIAL_H_
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
 #define SERIAL_BUF_SIZE 16
 #define CHUNK_SIZE 1024
 
@@ -11,7 +14,7 @@ int16_t SERIAL_rx(uint8_t *, uint16_t, uint16_t);
 void SERIAL_clear_buffer(void);
 esp_err_t SERIAL_set_baud(int baud);
 
-esp_err_t SERIAL_init_BAP(void);
+esp_err_t SERIAL_init_BAP(QueueHandle_t *event_queue);
 int SERIAL_send_BAP(uint8_t *, int, bool);
 //int16_t SERIAL_rx_BAP(uint8_t *, uint16_t, uint16_t);
 void SERIAL_clear_buffer_BAP(void);
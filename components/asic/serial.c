@@ -21,6 +21,7 @@
 #define UARTBAP_TXD (40)
 #define UARTBAP_RXD (41)
 #define BAP_BUF_SIZE (1024)
+#define BAP_EVENT_QUEUE_SIZE (20)
 
 static const char *TAG = "serial";
 
@@ -110,7 +111,7 @@ void SERIAL_clear_buffer(void)
 }
 
 
-esp_err_t SERIAL_init_BAP(void)
+esp_err_t SERIAL_init_BAP(QueueHandle_t *event_queue)
 {
     ESP_LOGI(TAG, "Initializing serial");
     // Configure UART1 parameters
@@ -127,18 +128,17 @@ esp_err_t SERIAL_init_BAP(void)
     // Set UART1 pins(TX: IO17, RX: I018)
     uart_set_pin(UART_NUM_2, UARTBAP_TXD, UARTBAP_RXD, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
 
-    // Install UART driver (we don't need an event queue here)
-    // tx buffer 0 so the tx time doesn't overlap with the job wait time
-    //  by returning before the job is written
-    uart_driver_install(UART_NUM_2, BUF_SIZE * 2, BUF_SIZE * 2, 0, NULL, 0);
-    return ESP_OK;
+    // Install UART driver with an event queue, the receiver waits on it instead of polling
+    return uart_driver_install(UART_NUM_2, BUF_SIZE * 2, BUF_SIZE * 2, BAP_EVENT_QUEUE_SIZE, event_queue, 0);
 }
 
 int SERIAL_send_BAP(uint8_t *data, int len, bool debug)
 {
-    ESP_LOGI("Serial BAP", "tx: ");
-    prettyHex((unsigned char *)data, len);
-    ESP_LOGI("Serial BAP", "\n");
+    if (debug) {
+        ESP_LOGI("Serial BAP", "tx: ");
+        prettyHex((unsigned char *)data, len);
+        ESP_LOGI("Serial BAP", "\n");
+    }
 
     return uart_write_bytes(UART_NUM_2, (const char *)data, len);
 }
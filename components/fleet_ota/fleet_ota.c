@@ -0,0 +1,253 @@
+#include "fleet_ota.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mbedtls/sha256.h"
+
+static void put_u32(uint8_t *p, uint32_t value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void sha256(const uint8_t *data, size_t len, uint8_t out[32])
+{
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+    mbedtls_sha256_update(&ctx, data, len);
+    mbedtls_sha256_finish(&ctx, out);
+    mbedtls_sha256_free(&ctx);
+}
+
+size_t fleet_ota_chunk_offset(const fleet_ota_manifest_t *manifest, uint32_t index)
+{
+    return (size_t)index * manifest->chunk_size;
+}
+
+size_t fleet_ota_chunk_len(const fleet_ota_manifest_t *manifest, uint32_t index)
+{
+    size_t offset = fleet_ota_chunk_offset(manifest, index);
+    if (index >= manifest->chunk_count || offset >= manifest->size) {
+        return 0;
+    }
+    size_t remaining = manifest->size - offset;
+    return remaining < manifest->chunk_size ? remaining : manifest->chunk_size;
+}
+
+esp_err_t fleet_ota_manifest_build(fleet_ota_manifest_t *manifest, fleet_ota_image_t image, const char *version,
+                                   size_t size, size_t chunk_size, fleet_ota_read_fn read, void *ctx,
+                                   uint8_t *scratch)
+{
+    memset(manifest, 0, sizeof(*manifest));
+    if (size == 0 || chunk_size == 0 || chunk_size > FLEET_OTA_CHUNK_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if ((size + chunk_size - 1) / chunk_size > FLEET_OTA_MAX_CHUNKS) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    manifest->image = image;
+    manifest->size = size;
+    manifest->chunk_size = chunk_size;
+    manifest->chunk_count = (size + chunk_size - 1) / chunk_size;
+    strncpy(manifest->version, version, sizeof(manifest->version) - 1);
+    manifest->chunk_sha = calloc(manifest->chunk_count, sizeof(manifest->chunk_sha[0]));
+    if (manifest->chunk_sha == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    mbedtls_sha256_context image_ctx;
+    mbedtls_sha256_init(&image_ctx);
+    mbedtls_sha256_starts(&image_ctx, 0);
+
+    esp_err_t err = ESP_OK;
+    for (uint32_t i = 0; i < manifest->chunk_count; i++) {
+        size_t len = fleet_ota_chunk_len(manifest, i);
+        err = read(ctx, fleet_ota_chunk_offset(manifest, i), scratch, len);
+        if (err != ESP_OK) {
+            break;
+        }
+        sha256(scratch, len, manifest->chunk_sha[i]);
+        mbedtls_sha256_update(&image_ctx, scratch, len);
+    }
+    mbedtls_sha256_finish(&image_ctx, manifest->image_sha);
+    mbedtls_sha256_free(&image_ctx);
+
+    if (err != ESP_OK) {
+        fleet_ota_manifest_free(manifest);
+    }
+    return err;
+}
+
+void fleet_ota_manifest_free(fleet_ota_manifest_t *manifest)
+{
+    free(manifest->chunk_sha);
+    manifest->chunk_sha = NULL;
+    manifest->chunk_count = 0;
+}
+
+size_t fleet_ota_manifest_encoded_size(const fleet_ota_manifest_t *manifest)
+{
+    return FLEET_OTA_MANIFEST_HEADER_SIZE + manifest->chunk_count * 32;
+}
+
+size_t fleet_ota_manifest_encode(const fleet_ota_manifest_t *manifest, uint8_t *buf, size_t size)
+{
+    size_t len = fleet_ota_manifest_encoded_size(manifest);
+    if (size < len) {
+        return 0;
+    }
+
+    uint8_t *p = buf;
+    put_u32(p, FLEET_OTA_MANIFEST_MAGIC);
+    put_u32(p + 4, manifest->image);
+    put_u32(p + 8, manifest->size);
+    put_u32(p + 12, manifest->chunk_size);
+    put_u32(p + 16, manifest->chunk_count);
+    p += 20;
+    memcpy(p, manifest->version, FLEET_OTA_VERSION_LEN);
+    p += FLEET_OTA_VERSION_LEN;
+    memcpy(p, manifest->image_sha, 32);
+    p += 32;
+    memcpy(p, manifest->chunk_sha, manifest->chunk_count * 32);
+    return len;
+}
+
+esp_err_t fleet_ota_manifest_decode(fleet_ota_manifest_t *manifest, const uint8_t *buf, size_t len)
+{
+    memset(manifest, 0, sizeof(*manifest));
+    if (len < FLEET_OTA_MANIFEST_HEADER_SIZE || get_u32(buf) != FLEET_OTA_MANIFEST_MAGIC) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    uint32_t image = get_u32(buf + 4);
+    uint32_t size = get_u32(buf + 8);
+    uint32_t chunk_size = get_u32(buf + 12);
+    uint32_t chunk_count = get_u32(buf + 16);
+    if (image > FLEET_OTA_IMAGE_WWW || size == 0 || chunk_size == 0 || chunk_size > FLEET_OTA_CHUNK_SIZE ||
+        chunk_count > FLEET_OTA_MAX_CHUNKS || chunk_count != (size + chunk_size - 1) / chunk_size ||
+        len != FLEET_OTA_MANIFEST_HEADER_SIZE + chunk_count * 32) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    manifest->chunk_sha = malloc(chunk_count * 32);
+    if (manifest->chunk_sha == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    manifest->image = image;
+    manifest->size = size;
+    manifest->chunk_size = chunk_size;
+    manifest->chunk_count = chunk_count;
+
+    const uint8_t *p = buf + 20;
+    memcpy(manifest->version, p, FLEET_OTA_VERSION_LEN);
+    manifest->version[FLEET_OTA_VERSION_LEN - 1] = '\0';
+    p += FLEET_OTA_VERSION_LEN;
+    memcpy(manifest->image_sha, p, 32);
+    p += 32;
+    memcpy(manifest->chunk_sha, p, chunk_count * 32);
+    return ESP_OK;
+}
+
+esp_err_t fleet_ota_pull(const fleet_ota_manifest_t *manifest, const fleet_ota_pull_io_t *io, uint8_t *buf)
+{
+    mbedtls_sha256_context image_ctx;
+    mbedtls_sha256_init(&image_ctx);
+    mbedtls_sha256_starts(&image_ctx, 0);
+
+    esp_err_t err = ESP_OK;
+    for (uint32_t i = 0; i < manifest->chunk_count && err == ESP_OK; i++) {
+        size_t len = fleet_ota_chunk_len(manifest, i);
+
+        for (int attempt = 0; attempt < FLEET_OTA_CHUNK_RETRIES; attempt++) {
+            err = io->fetch(io->ctx, i, buf, len);
+            if (err != ESP_OK) {
+                continue;
+            }
+            uint8_t sha[32];
+            sha256(buf, len, sha);
+            if (memcmp(sha, manifest->chunk_sha[i], sizeof(sha)) == 0) {
+                break;
+            }
+            err = ESP_ERR_INVALID_CRC;
+        }
+
+        if (err == ESP_OK) {
+            err = io->write(io->ctx, fleet_ota_chunk_offset(manifest, i), buf, len);
+            mbedtls_sha256_update(&image_ctx, buf, len);
+        }
+    }
+
+    if (err == ESP_OK) {
+        // The chunk hashes all matched, this catches a manifest that does not add up
+        uint8_t sha[32];
+        mbedtls_sha256_finish(&image_ctx, sha);
+        if (memcmp(sha, manifest->image_sha, sizeof(sha)) != 0) {
+            err = ESP_ERR_INVALID_CRC;
+        }
+    }
+    mbedtls_sha256_free(&image_ctx);
+    return err;
+}
+
+typedef struct {
+    uint32_t part[4];
+    uint32_t commits;
+} version_t;
+
+static bool parse_version(const char *s, version_t *version)
+{
+    memset(version, 0, sizeof(*version));
+    if (*s == 'v' || *s == 'V') {
+        s++;
+    }
+
+    char *end;
+    for (int i = 0; i < 4; i++) {
+        if (!isdigit((unsigned char)*s)) {
+            return false;
+        }
+        version->part[i] = strtoul(s, &end, 10);
+        s = end;
+        if (*s != '.') {
+            break;
+        }
+        s++;
+    }
+
+    // git describe appends -<commits>-g<hash>
+    if (*s == '-' && isdigit((unsigned char)s[1])) {
+        uint32_t commits = strtoul(s + 1, &end, 10);
+        if (*end == '-' || *end == '\0') {
+            version->commits = commits;
+        }
+    }
+    return true;
+}
+
+int fleet_ota_version_compare(const char *a, const char *b)
+{
+    version_t va, vb;
+    if (!parse_version(a, &va) || !parse_version(b, &vb)) {
+        return 0;
+    }
+    for (int i = 0; i < 4; i++) {
+        if (va.part[i] != vb.part[i]) {
+            return va.part[i] < vb.part[i] ? -1 : 1;
+        }
+    }
+    if (va.commits != vb.commits) {
+        return va.commits < vb.commits ? -1 : 1;
+    }
+    return 0;
+}
@@ -0,0 +1,108 @@
+#ifndef FLEET_OTA_H_
+#define FLEET_OTA_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/*
+ * Transfer of a flash image from one miner to another. The serving side describes the
+ * image with a manifest: its size, a SHA-256 of every chunk and of the whole image. The
+ * pulling side fetches the manifest, then the chunks one by one, and only writes a chunk
+ * once its hash matches. Transport and storage are callbacks, so the same code runs on
+ * the device over HTTP and on a host between two instances in memory.
+ *
+ * The hashes protect against corruption in transit, not against a malicious peer. A
+ * firmware image is still validated by esp_ota_end before it can boot.
+ */
+
+#define FLEET_OTA_CHUNK_SIZE 16384
+#define FLEET_OTA_MAX_CHUNKS 512
+#define FLEET_OTA_CHUNK_RETRIES 3
+#define FLEET_OTA_VERSION_LEN 32
+
+#define FLEET_OTA_MANIFEST_MAGIC 0x41544F46 /* "FOTA" */
+#define FLEET_OTA_MANIFEST_HEADER_SIZE (4 + 4 + 4 + 4 + 4 + FLEET_OTA_VERSION_LEN + 32)
+#define FLEET_OTA_MANIFEST_MAX_SIZE (FLEET_OTA_MANIFEST_HEADER_SIZE + FLEET_OTA_MAX_CHUNKS * 32)
+
+typedef enum {
+    FLEET_OTA_IMAGE_FIRMWARE = 0,
+    FLEET_OTA_IMAGE_WWW = 1,
+} fleet_ota_image_t;
+
+typedef struct {
+    fleet_ota_image_t image;
+    uint32_t size;
+    uint32_t chunk_size;
+    uint32_t chunk_count;
+    char version[FLEET_OTA_VERSION_LEN];    // Firmware version of the serving miner
+    uint8_t image_sha[32];
+    uint8_t (*chunk_sha)[32];               // chunk_count entries, owned by the manifest
+} fleet_ota_manifest_t;
+
+/**
+ * @brief Read len bytes of the image at offset
+ */
+typedef esp_err_t (*fleet_ota_read_fn)(void *ctx, size_t offset, void *buf, size_t len);
+
+typedef struct {
+    /* Fetch chunk index from the peer into buf, exactly len bytes are expected */
+    esp_err_t (*fetch)(void *ctx, uint32_t index, uint8_t *buf, size_t len);
+    /* Store a verified chunk, offsets only ever increase */
+    esp_err_t (*write)(void *ctx, size_t offset, const uint8_t *data, size_t len);
+    void *ctx;
+} fleet_ota_pull_io_t;
+
+/**
+ * @brief Hash an image of size bytes into a manifest
+ * @param scratch At least chunk_size bytes
+ * @return ESP_ERR_INVALID_SIZE if the image needs more than FLEET_OTA_MAX_CHUNKS chunks
+ */
+esp_err_t fleet_ota_manifest_build(fleet_ota_manifest_t *manifest, fleet_ota_image_t image, const char *version,
+                                   size_t size, size_t chunk_size, fleet_ota_read_fn read, void *ctx,
+                                   uint8_t *scratch);
+
+void fleet_ota_manifest_free(fleet_ota_manifest_t *manifest);
+
+size_t fleet_ota_manifest_encoded_size(const fleet_ota_manifest_t *manifest);
+
+/**
+ * @brief Serialize the manifest, little endian
+ * @return The number of bytes written, 0 if size is too small
+ */
+size_t fleet_ota_manifest_encode(const fleet_ota_manifest_t *manifest, uint8_t *buf, size_t size);
+
+/**
+ * @brief Parse a manifest received from a peer, free it with fleet_ota_manifest_free
+ * @return ESP_ERR_INVALID_RESPONSE if it is malformed or its chunks are larger than
+ *         FLEET_OTA_CHUNK_SIZE
+ */
+esp_err_t fleet_ota_manifest_decode(fleet_ota_manifest_t *manifest, const uint8_t *buf, size_t len);
+
+/* Offset and length of a chunk, the last one may be short */
+size_t fleet_ota_chunk_offset(const fleet_ota_manifest_t *manifest, uint32_t index);
+size_t fleet_ota_chunk_len(const fleet_ota_manifest_t *manifest, uint32_t index);
+
+/**
+ * @brief Pull the image described by manifest through io
+ *
+ * A chunk that fails its hash or its fetch is fetched again up to FLEET_OTA_CHUNK_RETRIES
+ * times. Nothing unverified is ever written.
+ *
+ * @param buf At least manifest->chunk_size bytes
+ * @return ESP_OK when every chunk and the whole image matched
+ *         ESP_ERR_INVALID_CRC when a chunk kept failing its hash
+ *         the error of fetch or write otherwise
+ */
+esp_err_t fleet_ota_pull(const fleet_ota_manifest_t *manifest, const fleet_ota_pull_io_t *io, uint8_t *buf);
+
+/**
+ * @brief Order two firmware versions such as "v2.4.1" or "2.4.1-3-gabc1234"
+ *
+ * The dotted numbers are compared first, then the count of commits after the tag.
+ * @return < 0 if a is older, > 0 if a is newer, 0 if equal or either one is not a version
+ */
+int fleet_ota_version_compare(const char *a, const char *b);
+
+#endif /* FLEET_OTA_H_ */
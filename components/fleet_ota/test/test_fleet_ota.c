@@ -0,0 +1,176 @@
+#include "unity.h"
+#include "fleet_ota.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_IMAGE_SIZE (3 * FLEET_OTA_CHUNK_SIZE + 1234)
+
+/* One miner serving an image from memory */
+typedef struct {
+    uint8_t *image;
+    size_t size;
+    fleet_ota_manifest_t manifest;
+    int corrupt_fetches;            // The next fetches of chunk 1 return a flipped bit
+} test_server_t;
+
+/* One miner pulling into memory */
+typedef struct {
+    test_server_t *server;
+    uint8_t *image;
+    size_t written;
+    int fetches;
+} test_client_t;
+
+static esp_err_t server_read(void *ctx, size_t offset, void *buf, size_t len)
+{
+    test_server_t *server = ctx;
+    memcpy(buf, server->image + offset, len);
+    return ESP_OK;
+}
+
+static void server_init(test_server_t *server)
+{
+    server->size = TEST_IMAGE_SIZE;
+    server->image = malloc(server->size);
+    for (size_t i = 0; i < server->size; i++) {
+        server->image[i] = (i * 31 + (i >> 8)) & 0xFF;
+    }
+    server->corrupt_fetches = 0;
+
+    uint8_t *scratch = malloc(FLEET_OTA_CHUNK_SIZE);
+    TEST_ASSERT_EQUAL(ESP_OK, fleet_ota_manifest_build(&server->manifest, FLEET_OTA_IMAGE_WWW, "v2.4.1", server->size,
+                                                       FLEET_OTA_CHUNK_SIZE, server_read, server, scratch));
+    free(scratch);
+}
+
+static void server_free(test_server_t *server)
+{
+    fleet_ota_manifest_free(&server->manifest);
+    free(server->image);
+}
+
+static esp_err_t client_fetch(void *ctx, uint32_t index, uint8_t *buf, size_t len)
+{
+    test_client_t *client = ctx;
+    test_server_t *server = client->server;
+    client->fetches++;
+    memcpy(buf, server->image + fleet_ota_chunk_offset(&server->manifest, index), len);
+    if (index == 1 && server->corrupt_fetches > 0) {
+        server->corrupt_fetches--;
+        buf[17] ^= 0x01;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t client_write(void *ctx, size_t offset, const uint8_t *data, size_t len)
+{
+    test_client_t *client = ctx;
+    TEST_ASSERT_EQUAL(client->written, offset);
+    memcpy(client->image + offset, data, len);
+    client->written += len;
+    return ESP_OK;
+}
+
+/* The client only ever sees the manifest the way it goes over the wire */
+static esp_err_t client_pull(test_client_t *client, test_server_t *server)
+{
+    uint8_t *wire = malloc(FLEET_OTA_MANIFEST_MAX_SIZE);
+    size_t wire_len = fleet_ota_manifest_encode(&server->manifest, wire, FLEET_OTA_MANIFEST_MAX_SIZE);
+    TEST_ASSERT_EQUAL(fleet_ota_manifest_encoded_size(&server->manifest), wire_len);
+
+    fleet_ota_manifest_t manifest;
+    TEST_ASSERT_EQUAL(ESP_OK, fleet_ota_manifest_decode(&manifest, wire, wire_len));
+    free(wire);
+    TEST_ASSERT_EQUAL_STRING("v2.4.1", manifest.version);
+    TEST_ASSERT_EQUAL(server->size, manifest.size);
+
+    memset(client, 0, sizeof(*client));
+    client->server = server;
+    client->image = calloc(1, manifest.size);
+
+    fleet_ota_pull_io_t io = {
+        .fetch = client_fetch,
+        .write = client_write,
+        .ctx = client,
+    };
+    uint8_t *buf = malloc(manifest.chunk_size);
+    esp_err_t err = fleet_ota_pull(&manifest, &io, buf);
+    free(buf);
+    fleet_ota_manifest_free(&manifest);
+    return err;
+}
+
+TEST_CASE("Pull an image from a peer", "[fleet_ota]")
+{
+    test_server_t server;
+    test_client_t client;
+    server_init(&server);
+
+    TEST_ASSERT_EQUAL(4, server.manifest.chunk_count);
+    TEST_ASSERT_EQUAL(1234, fleet_ota_chunk_len(&server.manifest, 3));
+
+    TEST_ASSERT_EQUAL(ESP_OK, client_pull(&client, &server));
+    TEST_ASSERT_EQUAL(server.size, client.written);
+    TEST_ASSERT_EQUAL_MEMORY(server.image, client.image, server.size);
+    TEST_ASSERT_EQUAL(4, client.fetches);
+
+    free(client.image);
+    server_free(&server);
+}
+
+TEST_CASE("Refetch a chunk that fails its hash", "[fleet_ota]")
+{
+    test_server_t server;
+    test_client_t client;
+    server_init(&server);
+
+    server.corrupt_fetches = FLEET_OTA_CHUNK_RETRIES - 1;
+    TEST_ASSERT_EQUAL(ESP_OK, client_pull(&client, &server));
+    TEST_ASSERT_EQUAL_MEMORY(server.image, client.image, server.size);
+    TEST_ASSERT_EQUAL(4 + FLEET_OTA_CHUNK_RETRIES - 1, client.fetches);
+    free(client.image);
+
+    // Nothing past the last good chunk is written
+    server.corrupt_fetches = FLEET_OTA_CHUNK_RETRIES;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_CRC, client_pull(&client, &server));
+    TEST_ASSERT_EQUAL(FLEET_OTA_CHUNK_SIZE, client.written);
+    free(client.image);
+
+    server_free(&server);
+}
+
+TEST_CASE("Reject malformed manifests", "[fleet_ota]")
+{
+    test_server_t server;
+    server_init(&server);
+
+    uint8_t *wire = malloc(FLEET_OTA_MANIFEST_MAX_SIZE);
+    size_t wire_len = fleet_ota_manifest_encode(&server.manifest, wire, FLEET_OTA_MANIFEST_MAX_SIZE);
+    TEST_ASSERT_EQUAL(0, fleet_ota_manifest_encode(&server.manifest, wire, wire_len - 1));
+
+    fleet_ota_manifest_t manifest;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE, fleet_ota_manifest_decode(&manifest, wire, wire_len - 32));
+
+    // Chunk count that does not match the size
+    wire[16] = 5;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE, fleet_ota_manifest_decode(&manifest, wire, wire_len));
+    wire[16] = 4;
+
+    wire[0] ^= 0xFF;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE, fleet_ota_manifest_decode(&manifest, wire, wire_len));
+
+    free(wire);
+    server_free(&server);
+}
+
+TEST_CASE("Compare firmware versions", "[fleet_ota]")
+{
+    TEST_ASSERT_TRUE(fleet_ota_version_compare("v2.4.1", "v2.4.0") > 0);
+    TEST_ASSERT_TRUE(fleet_ota_version_compare("v2.4.0", "v2.10.0") < 0);
+    TEST_ASSERT_TRUE(fleet_ota_version_compare("2.4.1", "v2.4.1") == 0);
+    TEST_ASSERT_TRUE(fleet_ota_version_compare("v2.4.1-3-gabc1234", "v2.4.1") > 0);
+    TEST_ASSERT_TRUE(fleet_ota_version_compare("v2.4.1-3-gabc1234-dirty", "v2.4.1-12-gdef5678") < 0);
+    TEST_ASSERT_TRUE(fleet_ota_version_compare("v2.5", "v2.4.9") > 0);
+    TEST_ASSERT_TRUE(fleet_ota_version_compare("custom", "v2.4.1") == 0);
+}
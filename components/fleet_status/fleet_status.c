@@ -0,0 +1,272 @@
+#include "fleet_status.h"
+
+#include <math.h>
+#include <string.h>
+
+#define FLEET_STATUS_ANNOUNCE_FIXED_SIZE (6 + 4 + 4 + 2 + 2 + 4 + 4 + 4 + 2 + 1)
+
+/* Writes to a packet, every put is dropped once it does not fit */
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+    bool overflow;
+} writer_t;
+
+/* Reads from a packet, every get returns zeros once it ran past the end */
+typedef struct {
+    const uint8_t *buf;
+    size_t len;
+    size_t pos;
+    bool truncated;
+} reader_t;
+
+static void put_bytes(writer_t *w, const void *data, size_t len)
+{
+    if (w->overflow || w->size - w->len < len) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, data, len);
+    w->len += len;
+}
+
+static void put_u8(writer_t *w, uint8_t value)
+{
+    put_bytes(w, &value, 1);
+}
+
+static void put_u16(writer_t *w, uint16_t value)
+{
+    uint8_t p[2] = {value, value >> 8};
+    put_bytes(w, p, sizeof(p));
+}
+
+static void put_u32(writer_t *w, uint32_t value)
+{
+    uint8_t p[4] = {value, value >> 8, value >> 16, value >> 24};
+    put_bytes(w, p, sizeof(p));
+}
+
+static void put_string(writer_t *w, const char *value, size_t max_len)
+{
+    size_t len = strnlen(value, max_len - 1);
+    put_u8(w, len);
+    put_bytes(w, value, len);
+}
+
+static const uint8_t *get_bytes(reader_t *r, size_t len)
+{
+    static const uint8_t zeros[8];
+    if (r->truncated || r->len - r->pos < len) {
+        r->truncated = true;
+        return zeros;
+    }
+    const uint8_t *p = r->buf + r->pos;
+    r->pos += len;
+    return p;
+}
+
+static uint8_t get_u8(reader_t *r)
+{
+    return get_bytes(r, 1)[0];
+}
+
+static uint16_t get_u16(reader_t *r)
+{
+    const uint8_t *p = get_bytes(r, 2);
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_u32(reader_t *r)
+{
+    const uint8_t *p = get_bytes(r, 4);
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Strings longer than the field are cut, a newer peer may send longer ones */
+static void get_string(reader_t *r, char *out, size_t size)
+{
+    size_t len = get_u8(r);
+    if (r->truncated || r->len - r->pos < len) {
+        r->truncated = true;
+        out[0] = '\0';
+        return;
+    }
+    size_t copy = len < size - 1 ? len : size - 1;
+    memcpy(out, r->buf + r->pos, copy);
+    out[copy] = '\0';
+    r->pos += len;
+}
+
+/* Scaled to an integer, clamped to what the field holds */
+static int64_t fixed(float value, float scale, int64_t min, int64_t max)
+{
+    if (!isfinite(value)) {
+        return 0;
+    }
+    double scaled = round((double)value * scale);
+    if (scaled < min) {
+        return min;
+    }
+    if (scaled > max) {
+        return max;
+    }
+    return (int64_t)scaled;
+}
+
+static void put_header(writer_t *w, fleet_status_type_t type, uint32_t seq)
+{
+    put_u32(w, FLEET_STATUS_MAGIC);
+    put_u8(w, FLEET_STATUS_PROTOCOL_VERSION);
+    put_u8(w, type);
+    put_u16(w, 0);
+    put_u32(w, seq);
+}
+
+size_t fleet_status_encode_announce(const fleet_status_digest_t *digest, uint32_t seq, uint8_t *buf, size_t size)
+{
+    writer_t w = {.buf = buf, .size = size};
+
+    put_header(&w, FLEET_STATUS_ANNOUNCE, seq);
+    put_bytes(&w, digest->mac, sizeof(digest->mac));
+    put_bytes(&w, digest->ip, sizeof(digest->ip));
+    put_u32(&w, fixed(digest->hashrate, 100, 0, UINT32_MAX));
+    put_u16(&w, (uint16_t)fixed(digest->chip_temp, 10, INT16_MIN, INT16_MAX));
+    put_u16(&w, fixed(digest->power, 10, 0, UINT16_MAX));
+    put_u32(&w, digest->uptime_s);
+    put_u32(&w, digest->shares_accepted);
+    put_u32(&w, digest->shares_rejected);
+    put_u16(&w, digest->pool_port);
+    put_u8(&w, digest->flags);
+    put_string(&w, digest->hostname, sizeof(digest->hostname));
+    put_string(&w, digest->model, sizeof(digest->model));
+    put_string(&w, digest->version, sizeof(digest->version));
+    put_string(&w, digest->pool, sizeof(digest->pool));
+
+    return w.overflow ? 0 : w.len;
+}
+
+size_t fleet_status_encode_query(uint32_t seq, uint8_t *buf, size_t size)
+{
+    writer_t w = {.buf = buf, .size = size};
+    put_header(&w, FLEET_STATUS_QUERY, seq);
+    return w.overflow ? 0 : w.len;
+}
+
+esp_err_t fleet_status_decode(fleet_status_message_t *msg, const uint8_t *buf, size_t len)
+{
+    reader_t r = {.buf = buf, .len = len};
+
+    memset(msg, 0, sizeof(*msg));
+    if (len < FLEET_STATUS_HEADER_SIZE || get_u32(&r) != FLEET_STATUS_MAGIC) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    // Any version from 1 on starts with the fields of version 1
+    if (get_u8(&r) < 1) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    msg->type = get_u8(&r);
+    get_u16(&r);
+    msg->seq = get_u32(&r);
+
+    if (msg->type == FLEET_STATUS_QUERY) {
+        return ESP_OK;
+    }
+    if (msg->type != FLEET_STATUS_ANNOUNCE || len - r.pos < FLEET_STATUS_ANNOUNCE_FIXED_SIZE) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    fleet_status_digest_t *digest = &msg->digest;
+    memcpy(digest->mac, get_bytes(&r, sizeof(digest->mac)), sizeof(digest->mac));
+    memcpy(digest->ip, get_bytes(&r, sizeof(digest->ip)), sizeof(digest->ip));
+    digest->hashrate = get_u32(&r) / 100.0f;
+    digest->chip_temp = (int16_t)get_u16(&r) / 10.0f;
+    digest->power = get_u16(&r) / 10.0f;
+    digest->uptime_s = get_u32(&r);
+    digest->shares_accepted = get_u32(&r);
+    digest->shares_rejected = get_u32(&r);
+    digest->pool_port = get_u16(&r);
+    digest->flags = get_u8(&r);
+    get_string(&r, digest->hostname, sizeof(digest->hostname));
+    get_string(&r, digest->model, sizeof(digest->model));
+    get_string(&r, digest->version, sizeof(digest->version));
+    get_string(&r, digest->pool, sizeof(digest->pool));
+
+    return r.truncated ? ESP_ERR_INVALID_RESPONSE : ESP_OK;
+}
+
+void fleet_status_table_init(fleet_status_table_t *table, fleet_status_peer_t *peers, size_t capacity)
+{
+    table->peers = peers;
+    table->capacity = capacity;
+    table->count = 0;
+}
+
+void fleet_status_table_update(fleet_status_table_t *table, const fleet_status_digest_t *digest, int64_t now_ms)
+{
+    fleet_status_peer_t *peer = NULL;
+    fleet_status_peer_t *stalest = NULL;
+
+    for (size_t i = 0; i < table->count; i++) {
+        if (memcmp(table->peers[i].digest.mac, digest->mac, sizeof(digest->mac)) == 0) {
+            peer = &table->peers[i];
+            break;
+        }
+        if (stalest == NULL || table->peers[i].last_seen_ms < stalest->last_seen_ms) {
+            stalest = &table->peers[i];
+        }
+    }
+
+    if (peer == NULL) {
+        if (table->count < table->capacity) {
+            peer = &table->peers[table->count++];
+        } else if (stalest != NULL) {
+            peer = stalest;
+        } else {
+            return;
+        }
+    }
+    peer->digest = *digest;
+    peer->last_seen_ms = now_ms;
+}
+
+size_t fleet_status_table_expire(fleet_status_table_t *table, int64_t now_ms)
+{
+    size_t dropped = 0;
+    size_t i = 0;
+
+    while (i < table->count) {
+        if (now_ms - table->peers[i].last_seen_ms > FLEET_STATUS_PEER_TIMEOUT_MS) {
+            table->peers[i] = table->peers[--table->count];
+            dropped++;
+        } else {
+            i++;
+        }
+    }
+    return dropped;
+}
+
+void fleet_status_table_summarize(const fleet_status_table_t *table, fleet_status_summary_t *summary)
+{
+    memset(summary, 0, sizeof(*summary));
+    summary->max_chip_temp = NAN;
+
+    for (size_t i = 0; i < table->count; i++) {
+        const fleet_status_digest_t *digest = &table->peers[i].digest;
+        summary->miners++;
+        summary->hashrate += digest->hashrate;
+        summary->power += digest->power;
+        if (isnan(summary->max_chip_temp) || digest->chip_temp > summary->max_chip_temp) {
+            summary->max_chip_temp = digest->chip_temp;
+        }
+        summary->shares_accepted += digest->shares_accepted;
+        summary->shares_rejected += digest->shares_rejected;
+        if (digest->flags & FLEET_STATUS_FLAG_FALLBACK) {
+            summary->on_fallback++;
+        }
+        if (digest->flags & FLEET_STATUS_FLAG_OVERHEAT) {
+            summary->overheated++;
+        }
+    }
+}
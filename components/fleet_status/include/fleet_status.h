@@ -0,0 +1,132 @@
+#ifndef FLEET_STATUS_H_
+#define FLEET_STATUS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/*
+ * Status of a fleet over UDP multicast. Every miner sends a compact digest of its state
+ * to the group every FLEET_STATUS_ANNOUNCE_INTERVAL_MS. A listener, another miner or a
+ * desktop tool, joins the group and builds a table of the fleet from the digests. To
+ * get a full snapshot at once it sends a query to the group, and every miner answers
+ * it with its digest, sent straight to the address the query came from.
+ *
+ * Packets are little endian:
+ *   header   magic "ACSS", protocol version (u8), type (u8), reserved (u16), seq (u32)
+ *   announce mac[6], ipv4[4], hashrate in GH/s * 100 (u32), chip temp in C * 10 (i16),
+ *            power in W * 10 (u16), uptime s (u32), shares accepted (u32), shares
+ *            rejected (u32), pool port (u16), flags (u8), then hostname, model, firmware
+ *            version and pool url, each as a length (u8) and that many bytes
+ *   query    the header only
+ * An answer to a query carries the seq of the query, periodic announces carry 0. Later
+ * protocol versions only append fields, so decoders ignore anything past what they know.
+ *
+ * Nothing is authenticated, the digests are as trustworthy as the LAN they came from.
+ */
+
+#define FLEET_STATUS_GROUP "239.255.77.77"
+#define FLEET_STATUS_PORT 47777
+#define FLEET_STATUS_PROTOCOL_VERSION 1
+#define FLEET_STATUS_ANNOUNCE_INTERVAL_MS 10000
+// A peer not heard of for three announces is gone
+#define FLEET_STATUS_PEER_TIMEOUT_MS (3 * FLEET_STATUS_ANNOUNCE_INTERVAL_MS + 5000)
+
+#define FLEET_STATUS_MAGIC 0x53534341 /* "ACSS" */
+#define FLEET_STATUS_HEADER_SIZE 12
+#define FLEET_STATUS_MAX_PACKET_SIZE 256
+
+#define FLEET_STATUS_HOSTNAME_LEN 33
+#define FLEET_STATUS_MODEL_LEN 16
+#define FLEET_STATUS_VERSION_LEN 32
+#define FLEET_STATUS_POOL_LEN 64
+
+#define FLEET_STATUS_FLAG_FALLBACK 0x01  // Mining on the fallback pool
+#define FLEET_STATUS_FLAG_OVERHEAT 0x02  // In overheat mode
+
+typedef enum {
+    FLEET_STATUS_ANNOUNCE = 1,
+    FLEET_STATUS_QUERY = 2,
+} fleet_status_type_t;
+
+typedef struct {
+    uint8_t mac[6];                 // Identifies the miner
+    uint8_t ip[4];
+    float hashrate;                 // GH/s
+    float chip_temp;                // C
+    float power;                    // W
+    uint32_t uptime_s;
+    uint32_t shares_accepted;
+    uint32_t shares_rejected;
+    uint16_t pool_port;
+    uint8_t flags;
+    char hostname[FLEET_STATUS_HOSTNAME_LEN];
+    char model[FLEET_STATUS_MODEL_LEN];
+    char version[FLEET_STATUS_VERSION_LEN];
+    char pool[FLEET_STATUS_POOL_LEN];
+} fleet_status_digest_t;
+
+typedef struct {
+    fleet_status_type_t type;
+    uint32_t seq;
+    fleet_status_digest_t digest;   // Announces only
+} fleet_status_message_t;
+
+typedef struct {
+    fleet_status_digest_t digest;
+    int64_t last_seen_ms;
+} fleet_status_peer_t;
+
+/* The miners heard from, in no particular order */
+typedef struct {
+    fleet_status_peer_t *peers;
+    size_t capacity;
+    size_t count;
+} fleet_status_table_t;
+
+typedef struct {
+    size_t miners;
+    double hashrate;                // Sums
+    double power;
+    float max_chip_temp;            // NAN without miners
+    uint64_t shares_accepted;
+    uint64_t shares_rejected;
+    size_t on_fallback;             // Miners with FLEET_STATUS_FLAG_FALLBACK
+    size_t overheated;              // Miners with FLEET_STATUS_FLAG_OVERHEAT
+} fleet_status_summary_t;
+
+/**
+ * @brief Serialize an announce, strings longer than a packet allows are cut
+ * @return The number of bytes written, 0 if size is too small
+ */
+size_t fleet_status_encode_announce(const fleet_status_digest_t *digest, uint32_t seq, uint8_t *buf, size_t size);
+
+/**
+ * @return The number of bytes written, 0 if size is too small
+ */
+size_t fleet_status_encode_query(uint32_t seq, uint8_t *buf, size_t size);
+
+/**
+ * @brief Parse a packet received on the group
+ * @return ESP_ERR_INVALID_RESPONSE if it is not a fleet status packet or it is truncated
+ */
+esp_err_t fleet_status_decode(fleet_status_message_t *msg, const uint8_t *buf, size_t len);
+
+void fleet_status_table_init(fleet_status_table_t *table, fleet_status_peer_t *peers, size_t capacity);
+
+/**
+ * @brief Add a miner or refresh the one with the same mac. A full table gives up the
+ *        miner heard from least recently.
+ */
+void fleet_status_table_update(fleet_status_table_t *table, const fleet_status_digest_t *digest, int64_t now_ms);
+
+/**
+ * @brief Drop the miners not heard from in FLEET_STATUS_PEER_TIMEOUT_MS
+ * @return The number of miners dropped
+ */
+size_t fleet_status_table_expire(fleet_status_table_t *table, int64_t now_ms);
+
+void fleet_status_table_summarize(const fleet_status_table_t *table, fleet_status_summary_t *summary);
+
+#endif /* FLEET_STATUS_H_ */
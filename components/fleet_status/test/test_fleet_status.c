@@ -0,0 +1,156 @@
+#include "unity.h"
+#include "fleet_status.h"
+
+#include <math.h>
+#include <string.h>
+
+static void test_digest(fleet_status_digest_t *digest, uint8_t id)
+{
+    memset(digest, 0, sizeof(*digest));
+    uint8_t mac[6] = {0x24, 0x6f, 0x28, 0x00, 0x00, id};
+    memcpy(digest->mac, mac, sizeof(mac));
+    uint8_t ip[4] = {192, 168, 1, id};
+    memcpy(digest->ip, ip, sizeof(ip));
+    digest->hashrate = 1234.56f;
+    digest->chip_temp = 58.3f;
+    digest->power = 21.7f;
+    digest->uptime_s = 86400;
+    digest->shares_accepted = 1500;
+    digest->shares_rejected = 3;
+    digest->pool_port = 21496;
+    digest->flags = FLEET_STATUS_FLAG_FALLBACK;
+    strcpy(digest->hostname, "acs-miner");
+    strcpy(digest->model, "supra");
+    strcpy(digest->version, "v2.4.1-3-gabc1234");
+    strcpy(digest->pool, "public-pool.io");
+}
+
+TEST_CASE("Announce a digest", "[fleet_status]")
+{
+    fleet_status_digest_t digest;
+    test_digest(&digest, 7);
+
+    uint8_t buf[FLEET_STATUS_MAX_PACKET_SIZE];
+    size_t len = fleet_status_encode_announce(&digest, 42, buf, sizeof(buf));
+    TEST_ASSERT_GREATER_THAN(FLEET_STATUS_HEADER_SIZE, len);
+    TEST_ASSERT_EQUAL(0, fleet_status_encode_announce(&digest, 42, buf, len - 1));
+
+    fleet_status_message_t msg;
+    TEST_ASSERT_EQUAL(ESP_OK, fleet_status_decode(&msg, buf, len));
+    TEST_ASSERT_EQUAL(FLEET_STATUS_ANNOUNCE, msg.type);
+    TEST_ASSERT_EQUAL(42, msg.seq);
+    TEST_ASSERT_EQUAL_MEMORY(digest.mac, msg.digest.mac, sizeof(digest.mac));
+    TEST_ASSERT_EQUAL_MEMORY(digest.ip, msg.digest.ip, sizeof(digest.ip));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 1234.56f, msg.digest.hashrate);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 58.3f, msg.digest.chip_temp);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 21.7f, msg.digest.power);
+    TEST_ASSERT_EQUAL(86400, msg.digest.uptime_s);
+    TEST_ASSERT_EQUAL(1500, msg.digest.shares_accepted);
+    TEST_ASSERT_EQUAL(3, msg.digest.shares_rejected);
+    TEST_ASSERT_EQUAL(21496, msg.digest.pool_port);
+    TEST_ASSERT_EQUAL(FLEET_STATUS_FLAG_FALLBACK, msg.digest.flags);
+    TEST_ASSERT_EQUAL_STRING("acs-miner", msg.digest.hostname);
+    TEST_ASSERT_EQUAL_STRING("supra", msg.digest.model);
+    TEST_ASSERT_EQUAL_STRING("v2.4.1-3-gabc1234", msg.digest.version);
+    TEST_ASSERT_EQUAL_STRING("public-pool.io", msg.digest.pool);
+
+    // Values out of the range of a field are clamped
+    digest.chip_temp = -5000.0f;
+    digest.power = NAN;
+    len = fleet_status_encode_announce(&digest, 0, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL(ESP_OK, fleet_status_decode(&msg, buf, len));
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, -3276.8f, msg.digest.chip_temp);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, msg.digest.power);
+}
+
+TEST_CASE("Query the fleet", "[fleet_status]")
+{
+    uint8_t buf[FLEET_STATUS_MAX_PACKET_SIZE];
+    size_t len = fleet_status_encode_query(0xdeadbeef, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL(FLEET_STATUS_HEADER_SIZE, len);
+
+    fleet_status_message_t msg;
+    TEST_ASSERT_EQUAL(ESP_OK, fleet_status_decode(&msg, buf, len));
+    TEST_ASSERT_EQUAL(FLEET_STATUS_QUERY, msg.type);
+    TEST_ASSERT_EQUAL_HEX32(0xdeadbeef, msg.seq);
+}
+
+TEST_CASE("Reject packets that are not fleet status", "[fleet_status]")
+{
+    fleet_status_digest_t digest;
+    test_digest(&digest, 1);
+    uint8_t buf[FLEET_STATUS_MAX_PACKET_SIZE];
+    size_t len = fleet_status_encode_announce(&digest, 0, buf, sizeof(buf));
+    fleet_status_message_t msg;
+
+    // Cut anywhere, including inside the strings
+    for (size_t cut = 0; cut < len; cut++) {
+        TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE, fleet_status_decode(&msg, buf, cut));
+    }
+
+    buf[0] ^= 0xFF;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE, fleet_status_decode(&msg, buf, len));
+    buf[0] ^= 0xFF;
+
+    buf[5] = 9;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE, fleet_status_decode(&msg, buf, len));
+    buf[5] = FLEET_STATUS_ANNOUNCE;
+
+    // A later protocol version with more fields is read as far as this one knows
+    buf[4] = FLEET_STATUS_PROTOCOL_VERSION + 1;
+    buf[len] = 0x55;
+    TEST_ASSERT_EQUAL(ESP_OK, fleet_status_decode(&msg, buf, len + 1));
+    TEST_ASSERT_EQUAL_STRING("public-pool.io", msg.digest.pool);
+}
+
+TEST_CASE("Track and summarize the fleet", "[fleet_status]")
+{
+    fleet_status_peer_t peers[3];
+    fleet_status_table_t table;
+    fleet_status_table_init(&table, peers, 3);
+    fleet_status_digest_t digest;
+    fleet_status_summary_t summary;
+
+    fleet_status_table_summarize(&table, &summary);
+    TEST_ASSERT_EQUAL(0, summary.miners);
+    TEST_ASSERT_TRUE(isnan(summary.max_chip_temp));
+
+    for (uint8_t id = 1; id <= 3; id++) {
+        test_digest(&digest, id);
+        digest.chip_temp = 50 + id;
+        digest.flags = id == 2 ? FLEET_STATUS_FLAG_OVERHEAT : 0;
+        fleet_status_table_update(&table, &digest, id * 1000);
+    }
+    TEST_ASSERT_EQUAL(3, table.count);
+
+    // Heard again, refreshed in place
+    test_digest(&digest, 1);
+    digest.hashrate = 1000.0f;
+    digest.chip_temp = 51;
+    digest.flags = 0;
+    fleet_status_table_update(&table, &digest, 5000);
+    TEST_ASSERT_EQUAL(3, table.count);
+
+    fleet_status_table_summarize(&table, &summary);
+    TEST_ASSERT_EQUAL(3, summary.miners);
+    TEST_ASSERT_FLOAT_WITHIN(0.1, 1000.0 + 2 * 1234.56, summary.hashrate);
+    TEST_ASSERT_FLOAT_WITHIN(0.1, 3 * 21.7, summary.power);
+    TEST_ASSERT_EQUAL_FLOAT(53.0f, summary.max_chip_temp);
+    TEST_ASSERT_EQUAL(4500, summary.shares_accepted);
+    TEST_ASSERT_EQUAL(1, summary.overheated);
+    TEST_ASSERT_EQUAL(0, summary.on_fallback);
+
+    // A full table gives up the miner heard from least recently, miner 2
+    test_digest(&digest, 4);
+    fleet_status_table_update(&table, &digest, 6000);
+    TEST_ASSERT_EQUAL(3, table.count);
+    for (size_t i = 0; i < table.count; i++) {
+        TEST_ASSERT_NOT_EQUAL(2, table.peers[i].digest.mac[5]);
+    }
+
+    // Miner 3 was last heard at 3 s
+    TEST_ASSERT_EQUAL(1, fleet_status_table_expire(&table, 3000 + FLEET_STATUS_PEER_TIMEOUT_MS + 1));
+    TEST_ASSERT_EQUAL(2, table.count);
+    TEST_ASSERT_EQUAL(2, fleet_status_table_expire(&table, 6000 + FLEET_STATUS_PEER_TIMEOUT_MS + 1));
+    TEST_ASSERT_EQUAL(0, table.count);
+}
@@ -0,0 +1,122 @@
+#ifndef PMBUS_H_
+#define PMBUS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "pmbus_commands.h"
+
+#define PMBUS_MAX_BLOCK_LEN 32
+
+/* STATUS_WORD bits, low byte is STATUS_BYTE */
+#define PMBUS_STATUS_WORD_NONE_OF_THE_ABOVE (1 << 0)
+#define PMBUS_STATUS_WORD_CML               (1 << 1)
+#define PMBUS_STATUS_WORD_TEMPERATURE       (1 << 2)
+#define PMBUS_STATUS_WORD_VIN_UV            (1 << 3)
+#define PMBUS_STATUS_WORD_IOUT_OC           (1 << 4)
+#define PMBUS_STATUS_WORD_VOUT_OV           (1 << 5)
+#define PMBUS_STATUS_WORD_OFF               (1 << 6)
+#define PMBUS_STATUS_WORD_BUSY              (1 << 7)
+#define PMBUS_STATUS_WORD_UNKNOWN           (1 << 8)
+#define PMBUS_STATUS_WORD_OTHER             (1 << 9)
+#define PMBUS_STATUS_WORD_FANS              (1 << 10)
+#define PMBUS_STATUS_WORD_POWER_GOOD_N      (1 << 11)
+#define PMBUS_STATUS_WORD_MFR               (1 << 12)
+#define PMBUS_STATUS_WORD_INPUT             (1 << 13)
+#define PMBUS_STATUS_WORD_IOUT_POUT         (1 << 14)
+#define PMBUS_STATUS_WORD_VOUT              (1 << 15)
+
+/* Bits that report a condition rather than a state such as the output being off */
+#define PMBUS_STATUS_WORD_FAULT_MASK (0xFFFF & ~(PMBUS_STATUS_WORD_NONE_OF_THE_ABOVE | PMBUS_STATUS_WORD_BUSY | \
+                                                  PMBUS_STATUS_WORD_OFF | PMBUS_STATUS_WORD_POWER_GOOD_N))
+
+/**
+ * @brief Raw register read, the transport behind a PMBus device
+ * @param ctx The device context passed to PMBUS_init
+ * @param command The PMBus command code
+ * @param data Buffer for the response, exactly len bytes are expected
+ * @param len Number of bytes to read
+ */
+typedef esp_err_t (*pmbus_read_fn)(void *ctx, uint8_t command, uint8_t *data, size_t len);
+
+/* Byte offsets of each telemetry word inside a manufacturer READ_ALL style block */
+typedef struct {
+    uint8_t command;
+    uint8_t length;
+    uint8_t status_word;
+    uint8_t vin;
+    uint8_t iout;
+    uint8_t vout;
+    uint8_t temperature;
+} PMBUS_BlockLayout;
+
+typedef struct {
+    pmbus_read_fn read;
+    void *ctx;
+    int8_t vout_exponent;           // Cached from VOUT_MODE
+    bool vout_mode_valid;
+    const PMBUS_BlockLayout *block; // Non-NULL once the block read has been verified
+    uint16_t last_status;           // STATUS_WORD from the previous poll
+} PMBUS_Device;
+
+/* Telemetry in integer milli-units */
+typedef struct {
+    int32_t vin;         // mV
+    int32_t iout;        // mA
+    int32_t vout;        // mV
+    int32_t temperature; // m°C
+    uint16_t status_word;
+} PMBUS_Telemetry;
+
+void PMBUS_init(PMBUS_Device *dev, pmbus_read_fn read, void *ctx);
+
+/* Fixed-point conversions, results are rounded to the nearest unit and saturate at the int32 range */
+int32_t PMBUS_linear11_to_milli(uint16_t value);
+uint16_t PMBUS_milli_to_linear11(int32_t milli);
+int8_t PMBUS_vout_mode_exponent(uint8_t vout_mode);
+int32_t PMBUS_ulinear16_to_milli(uint16_t value, int8_t exponent);
+uint16_t PMBUS_milli_to_ulinear16(int32_t milli, int8_t exponent);
+
+esp_err_t PMBUS_read_word(PMBUS_Device *dev, uint8_t command, uint16_t *result);
+
+/**
+ * @brief Read an SMBus block, checking the leading byte count
+ * @param len Number of data bytes expected, the device must report at least this many
+ */
+esp_err_t PMBUS_read_block(PMBUS_Device *dev, uint8_t command, uint8_t *data, uint8_t len);
+
+/**
+ * @brief Read VOUT_MODE and cache its exponent for the ULINEAR16 registers
+ * Call again after anything that writes VOUT_MODE.
+ */
+esp_err_t PMBUS_refresh_vout_mode(PMBUS_Device *dev);
+
+/**
+ * @brief Use a single block transaction for telemetry reads
+ * The block is read once and every telemetry word in it is compared with the individual
+ * register, it is only used from then on if the layout agrees with what the device reports.
+ * @return ESP_ERR_INVALID_RESPONSE if the block doesn't match the layout
+ */
+esp_err_t PMBUS_enable_block_telemetry(PMBUS_Device *dev, const PMBUS_BlockLayout *layout);
+
+/**
+ * @brief Read STATUS_WORD, VIN, IOUT, VOUT and TEMPERATURE_1
+ * Uses the verified block read when available, otherwise one word read per register,
+ * stopping at the first failure.
+ */
+esp_err_t PMBUS_read_telemetry(PMBUS_Device *dev, PMBUS_Telemetry *telemetry);
+
+/**
+ * @brief Track STATUS_WORD between polls
+ * @param status The STATUS_WORD just read
+ * @return Fault bits (PMBUS_STATUS_WORD_FAULT_MASK) that are set now but were clear on the previous poll
+ */
+uint16_t PMBUS_update_status(PMBUS_Device *dev, uint16_t status);
+
+/**
+ * @brief Name of a single STATUS_WORD bit, for logging
+ */
+const char *PMBUS_status_bit_name(int bit);
+
+#endif /* PMBUS_H_ */
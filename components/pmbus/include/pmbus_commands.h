@@ -1,3 +1,6 @@
+#ifndef PMBUS_COMMANDS_H_
+#define PMBUS_COMMANDS_H_
+
 
 /* Standard Core PMBus commands */
 #define PMBUS_OPERATION 0x01
@@ -81,3 +84,5 @@
 #define PMBUS_SIMULATE_FAULTS 0xF1
 #define PMBUS_FUSION_ID0 0xFC
 #define PMBUS_FUSION_ID1 0xFD
+
+#endif /* PMBUS_COMMANDS_H_ */
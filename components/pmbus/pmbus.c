@@ -0,0 +1,279 @@
+#include <stdlib.h>
+#include <string.h>
+#include "pmbus.h"
+
+// Worst-case disagreement between the block and the single register reads
+// taken a few milliseconds apart, the readings are live and move a little
+#define BLOCK_VERIFY_VIN_TOLERANCE 250   // mV
+#define BLOCK_VERIFY_VOUT_TOLERANCE 50   // mV
+#define BLOCK_VERIFY_IOUT_TOLERANCE 2000 // mA
+#define BLOCK_VERIFY_TEMP_TOLERANCE 5000 // m°C
+
+static const char *status_bit_names[16] = {
+    "NONE_OF_THE_ABOVE", "CML", "TEMPERATURE", "VIN_UV",
+    "IOUT_OC", "VOUT_OV", "OFF", "BUSY",
+    "UNKNOWN", "OTHER", "FANS", "POWER_GOOD#",
+    "MFR", "INPUT", "IOUT/POUT", "VOUT",
+};
+
+static int64_t div_round(int64_t num, int64_t den)
+{
+    // den is always positive here, round half away from zero
+    if (num >= 0) {
+        return (num + den / 2) / den;
+    }
+    return -((-num + den / 2) / den);
+}
+
+static int32_t saturate_i32(int64_t value)
+{
+    if (value > INT32_MAX) {
+        return INT32_MAX;
+    }
+    if (value < INT32_MIN) {
+        return INT32_MIN;
+    }
+    return (int32_t)value;
+}
+
+// value * 2^exponent
+static int64_t scale_pow2(int64_t value, int exponent)
+{
+    if (exponent >= 0) {
+        return value << exponent;
+    }
+    return div_round(value, 1LL << -exponent);
+}
+
+static uint16_t get_le16(const uint8_t *data)
+{
+    return (data[1] << 8) | data[0];
+}
+
+void PMBUS_init(PMBUS_Device *dev, pmbus_read_fn read, void *ctx)
+{
+    memset(dev, 0, sizeof(*dev));
+    dev->read = read;
+    dev->ctx = ctx;
+}
+
+/**
+ * @brief LINEAR11: 5-bit two's complement exponent in bits [15..11],
+ * 11-bit two's complement mantissa in bits [10..0]
+ */
+int32_t PMBUS_linear11_to_milli(uint16_t value)
+{
+    int exponent = (int16_t)value >> 11;
+    int mantissa = (int16_t)(value << 5) >> 5;
+
+    return saturate_i32(scale_pow2((int64_t)mantissa * 1000, exponent));
+}
+
+uint16_t PMBUS_milli_to_linear11(int32_t milli)
+{
+    if (milli == 0) {
+        return 0;
+    }
+
+    // Smallest exponent whose mantissa still fits keeps the most resolution
+    for (int exponent = -16; exponent <= 15; exponent++) {
+        int64_t mantissa;
+        if (exponent < 0) {
+            mantissa = div_round((int64_t)milli << -exponent, 1000);
+        } else {
+            mantissa = div_round(milli, 1000LL << exponent);
+        }
+        if (mantissa >= -1024 && mantissa <= 1023) {
+            return ((exponent & 0x1F) << 11) | (mantissa & 0x7FF);
+        }
+    }
+    // Out of range for LINEAR11, can't happen for an int32 input
+    return milli < 0 ? 0x7C00 : 0x7BFF;
+}
+
+/**
+ * @brief The ULINEAR16 exponent is VOUT_MODE bits [4..0] in two's complement
+ */
+int8_t PMBUS_vout_mode_exponent(uint8_t vout_mode)
+{
+    return (int8_t)((vout_mode & 0x1F) << 3) >> 3;
+}
+
+int32_t PMBUS_ulinear16_to_milli(uint16_t value, int8_t exponent)
+{
+    return saturate_i32(scale_pow2((int64_t)value * 1000, exponent));
+}
+
+uint16_t PMBUS_milli_to_ulinear16(int32_t milli, int8_t exponent)
+{
+    if (milli <= 0) {
+        return 0;
+    }
+
+    int64_t mantissa;
+    if (exponent < 0) {
+        mantissa = div_round((int64_t)milli << -exponent, 1000);
+    } else {
+        mantissa = div_round(milli, 1000LL << exponent);
+    }
+    return mantissa > UINT16_MAX ? UINT16_MAX : (uint16_t)mantissa;
+}
+
+esp_err_t PMBUS_read_word(PMBUS_Device *dev, uint8_t command, uint16_t *result)
+{
+    uint8_t data[2];
+    esp_err_t err = dev->read(dev->ctx, command, data, 2);
+    if (err != ESP_OK) {
+        return err;
+    }
+    *result = get_le16(data);
+    return ESP_OK;
+}
+
+esp_err_t PMBUS_read_block(PMBUS_Device *dev, uint8_t command, uint8_t *data, uint8_t len)
+{
+    // First byte on the wire is the byte count
+    uint8_t buf[PMBUS_MAX_BLOCK_LEN + 1];
+
+    if (len > PMBUS_MAX_BLOCK_LEN) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    esp_err_t err = dev->read(dev->ctx, command, buf, len + 1);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (buf[0] < len) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    memcpy(data, buf + 1, len);
+    return ESP_OK;
+}
+
+esp_err_t PMBUS_refresh_vout_mode(PMBUS_Device *dev)
+{
+    uint8_t vout_mode;
+    esp_err_t err = dev->read(dev->ctx, PMBUS_VOUT_MODE, &vout_mode, 1);
+    if (err != ESP_OK) {
+        dev->vout_mode_valid = false;
+        return err;
+    }
+    dev->vout_exponent = PMBUS_vout_mode_exponent(vout_mode);
+    dev->vout_mode_valid = true;
+    return ESP_OK;
+}
+
+static void decode_telemetry(const PMBUS_Device *dev, uint16_t status, uint16_t vin, uint16_t iout,
+                             uint16_t vout, uint16_t temperature, PMBUS_Telemetry *telemetry)
+{
+    telemetry->status_word = status;
+    telemetry->vin = PMBUS_linear11_to_milli(vin);
+    telemetry->iout = PMBUS_linear11_to_milli(iout);
+    telemetry->vout = PMBUS_ulinear16_to_milli(vout, dev->vout_exponent);
+    telemetry->temperature = PMBUS_linear11_to_milli(temperature);
+}
+
+static esp_err_t read_telemetry_block(PMBUS_Device *dev, const PMBUS_BlockLayout *layout, PMBUS_Telemetry *telemetry)
+{
+    uint8_t data[PMBUS_MAX_BLOCK_LEN];
+    esp_err_t err = PMBUS_read_block(dev, layout->command, data, layout->length);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    decode_telemetry(dev, get_le16(data + layout->status_word), get_le16(data + layout->vin),
+                     get_le16(data + layout->iout), get_le16(data + layout->vout),
+                     get_le16(data + layout->temperature), telemetry);
+    return ESP_OK;
+}
+
+static esp_err_t read_telemetry_words(PMBUS_Device *dev, PMBUS_Telemetry *telemetry)
+{
+    uint16_t status, vin, iout, vout, temperature;
+    esp_err_t err;
+
+    if ((err = PMBUS_read_word(dev, PMBUS_STATUS_WORD, &status)) != ESP_OK ||
+        (err = PMBUS_read_word(dev, PMBUS_READ_VIN, &vin)) != ESP_OK ||
+        (err = PMBUS_read_word(dev, PMBUS_READ_IOUT, &iout)) != ESP_OK ||
+        (err = PMBUS_read_word(dev, PMBUS_READ_VOUT, &vout)) != ESP_OK ||
+        (err = PMBUS_read_word(dev, PMBUS_READ_TEMPERATURE_1, &temperature)) != ESP_OK) {
+        return err;
+    }
+
+    decode_telemetry(dev, status, vin, iout, vout, temperature, telemetry);
+    return ESP_OK;
+}
+
+esp_err_t PMBUS_enable_block_telemetry(PMBUS_Device *dev, const PMBUS_BlockLayout *layout)
+{
+    dev->block = NULL;
+
+    if (layout->length > PMBUS_MAX_BLOCK_LEN ||
+        layout->status_word + 2 > layout->length || layout->vin + 2 > layout->length ||
+        layout->iout + 2 > layout->length || layout->vout + 2 > layout->length ||
+        layout->temperature + 2 > layout->length) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!dev->vout_mode_valid) {
+        esp_err_t err = PMBUS_refresh_vout_mode(dev);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    PMBUS_Telemetry from_block, from_words;
+    esp_err_t err = read_telemetry_block(dev, layout, &from_block);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = read_telemetry_words(dev, &from_words);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // VIN and temperature are never zero on a running device and can't be mistaken for
+    // each other. VOUT and IOUT may both be zero while the output is off, but a LINEAR11
+    // word carries its exponent in the top bits, so read through each other's format they
+    // still land far apart unless the device reports both as a plain 0.
+    if (labs(from_block.vin - from_words.vin) > BLOCK_VERIFY_VIN_TOLERANCE ||
+        labs(from_block.vout - from_words.vout) > BLOCK_VERIFY_VOUT_TOLERANCE ||
+        labs(from_block.iout - from_words.iout) > BLOCK_VERIFY_IOUT_TOLERANCE ||
+        labs(from_block.temperature - from_words.temperature) > BLOCK_VERIFY_TEMP_TOLERANCE ||
+        from_words.vin <= 0) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    dev->block = layout;
+    return ESP_OK;
+}
+
+esp_err_t PMBUS_read_telemetry(PMBUS_Device *dev, PMBUS_Telemetry *telemetry)
+{
+    if (!dev->vout_mode_valid) {
+        esp_err_t err = PMBUS_refresh_vout_mode(dev);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    if (dev->block) {
+        return read_telemetry_block(dev, dev->block, telemetry);
+    }
+    return read_telemetry_words(dev, telemetry);
+}
+
+uint16_t PMBUS_update_status(PMBUS_Device *dev, uint16_t status)
+{
+    uint16_t raised = status & ~dev->last_status & PMBUS_STATUS_WORD_FAULT_MASK;
+    dev->last_status = status;
+    return raised;
+}
+
+const char *PMBUS_status_bit_name(int bit)
+{
+    if (bit < 0 || bit > 15) {
+        return "?";
+    }
+    return status_bit_names[bit];
+}
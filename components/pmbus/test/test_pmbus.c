@@ -0,0 +1,250 @@
+#include "unity.h"
+#include "pmbus.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_READ_ALL 0xDA
+
+// Simulated register map standing in for the regulator on the bus
+static uint16_t sim_words[256];
+static uint8_t sim_vout_mode;
+static uint8_t sim_block[PMBUS_MAX_BLOCK_LEN + 1]; // Byte count followed by the data
+static bool sim_fail;
+static int sim_transactions;
+
+static esp_err_t sim_read(void *ctx, uint8_t command, uint8_t *data, size_t len)
+{
+    sim_transactions++;
+    if (sim_fail) {
+        return ESP_ERR_TIMEOUT;
+    }
+    if (command == PMBUS_VOUT_MODE && len == 1) {
+        data[0] = sim_vout_mode;
+    } else if (command == SIM_READ_ALL) {
+        memcpy(data, sim_block, len);
+    } else if (len == 2) {
+        data[0] = sim_words[command] & 0xFF;
+        data[1] = sim_words[command] >> 8;
+    } else {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static void sim_put_block_word(uint8_t offset, uint16_t value)
+{
+    sim_block[1 + offset] = value & 0xFF;
+    sim_block[2 + offset] = value >> 8;
+}
+
+static void sim_reset(void)
+{
+    memset(sim_words, 0, sizeof(sim_words));
+    memset(sim_block, 0, sizeof(sim_block));
+    sim_fail = false;
+    sim_transactions = 0;
+
+    sim_vout_mode = 0x17;                           // exponent -9
+    sim_words[PMBUS_STATUS_WORD] = 0x0000;
+    sim_words[PMBUS_READ_VIN] = 0xCA80;             // 5.0 V
+    sim_words[PMBUS_READ_IOUT] = 0xD2C0;            // 11.0 A
+    sim_words[PMBUS_READ_VOUT] = 0x0266;            // 614 / 512 V
+    sim_words[PMBUS_READ_TEMPERATURE_1] = 0x0019;   // 25 °C
+}
+
+static const PMBUS_BlockLayout sim_layout = {
+    .command = SIM_READ_ALL,
+    .length = 10,
+    .status_word = 0,
+    .vin = 2,
+    .iout = 4,
+    .vout = 6,
+    .temperature = 8,
+};
+
+static void sim_fill_block(void)
+{
+    sim_block[0] = sim_layout.length;
+    sim_put_block_word(sim_layout.status_word, sim_words[PMBUS_STATUS_WORD]);
+    sim_put_block_word(sim_layout.vin, sim_words[PMBUS_READ_VIN]);
+    sim_put_block_word(sim_layout.iout, sim_words[PMBUS_READ_IOUT]);
+    sim_put_block_word(sim_layout.vout, sim_words[PMBUS_READ_VOUT]);
+    sim_put_block_word(sim_layout.temperature, sim_words[PMBUS_READ_TEMPERATURE_1]);
+}
+
+TEST_CASE("LINEAR11 decodes to milli-units", "[pmbus]")
+{
+    TEST_ASSERT_EQUAL_INT32(5000, PMBUS_linear11_to_milli(0xCA80));
+    TEST_ASSERT_EQUAL_INT32(11000, PMBUS_linear11_to_milli(0xD2C0));
+    TEST_ASSERT_EQUAL_INT32(25000, PMBUS_linear11_to_milli(0x0019));
+    // Negative mantissa
+    TEST_ASSERT_EQUAL_INT32(-1000, PMBUS_linear11_to_milli(0x07FF));
+    // 1/1024 rounds to the nearest milli-unit
+    TEST_ASSERT_EQUAL_INT32(1, PMBUS_linear11_to_milli(0xB001));
+}
+
+TEST_CASE("LINEAR11 encodes with the finest exponent that fits", "[pmbus]")
+{
+    TEST_ASSERT_EQUAL_HEX16(0xCA66, PMBUS_milli_to_linear11(4800));
+    TEST_ASSERT_EQUAL_HEX16(0x028A, PMBUS_milli_to_linear11(650000));
+    TEST_ASSERT_EQUAL_HEX16(0x0000, PMBUS_milli_to_linear11(0));
+
+    int32_t values[] = {1000, 4500, 5800, 6000, 25000, 30000, 105000, 145000, -1500};
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        int32_t round_trip = PMBUS_linear11_to_milli(PMBUS_milli_to_linear11(values[i]));
+        // Within half an LSB of the chosen exponent, 10 bits of mantissa
+        TEST_ASSERT_INT32_WITHIN(abs(values[i]) / 1000 + 1, values[i], round_trip);
+    }
+}
+
+TEST_CASE("VOUT_MODE exponent and ULINEAR16", "[pmbus]")
+{
+    TEST_ASSERT_EQUAL_INT8(-9, PMBUS_vout_mode_exponent(0x17));
+    TEST_ASSERT_EQUAL_INT8(-12, PMBUS_vout_mode_exponent(0x14));
+    TEST_ASSERT_EQUAL_INT8(3, PMBUS_vout_mode_exponent(0x03));
+    // Mode bits above the exponent are ignored
+    TEST_ASSERT_EQUAL_INT8(-9, PMBUS_vout_mode_exponent(0x97));
+
+    TEST_ASSERT_EQUAL_HEX16(614, PMBUS_milli_to_ulinear16(1200, -9));
+    TEST_ASSERT_EQUAL_INT32(1199, PMBUS_ulinear16_to_milli(614, -9));
+    TEST_ASSERT_EQUAL_HEX16(0, PMBUS_milli_to_ulinear16(-5, -9));
+    TEST_ASSERT_EQUAL_HEX16(UINT16_MAX, PMBUS_milli_to_ulinear16(1000000, -9));
+}
+
+TEST_CASE("VOUT_MODE is read once and cached", "[pmbus]")
+{
+    PMBUS_Device dev;
+    PMBUS_Telemetry telemetry;
+
+    sim_reset();
+    PMBUS_init(&dev, sim_read, NULL);
+
+    TEST_ASSERT_EQUAL(ESP_OK, PMBUS_read_telemetry(&dev, &telemetry));
+    TEST_ASSERT_TRUE(dev.vout_mode_valid);
+    TEST_ASSERT_EQUAL_INT8(-9, dev.vout_exponent);
+    // VOUT_MODE plus one word per register
+    TEST_ASSERT_EQUAL_INT(6, sim_transactions);
+
+    sim_transactions = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, PMBUS_read_telemetry(&dev, &telemetry));
+    TEST_ASSERT_EQUAL_INT(5, sim_transactions);
+
+    TEST_ASSERT_EQUAL_INT32(5000, telemetry.vin);
+    TEST_ASSERT_EQUAL_INT32(11000, telemetry.iout);
+    TEST_ASSERT_EQUAL_INT32(1199, telemetry.vout);
+    TEST_ASSERT_EQUAL_INT32(25000, telemetry.temperature);
+}
+
+TEST_CASE("Telemetry read stops at the first bus error", "[pmbus]")
+{
+    PMBUS_Device dev;
+    PMBUS_Telemetry telemetry;
+
+    sim_reset();
+    PMBUS_init(&dev, sim_read, NULL);
+    TEST_ASSERT_EQUAL(ESP_OK, PMBUS_refresh_vout_mode(&dev));
+
+    sim_fail = true;
+    sim_transactions = 0;
+    TEST_ASSERT_EQUAL(ESP_ERR_TIMEOUT, PMBUS_read_telemetry(&dev, &telemetry));
+    TEST_ASSERT_EQUAL_INT(1, sim_transactions);
+}
+
+TEST_CASE("Block telemetry is one transaction once verified", "[pmbus]")
+{
+    PMBUS_Device dev;
+    PMBUS_Telemetry telemetry;
+
+    sim_reset();
+    sim_words[PMBUS_STATUS_WORD] = PMBUS_STATUS_WORD_OFF;
+    sim_fill_block();
+    PMBUS_init(&dev, sim_read, NULL);
+
+    TEST_ASSERT_EQUAL(ESP_OK, PMBUS_enable_block_telemetry(&dev, &sim_layout));
+    TEST_ASSERT_EQUAL_PTR(&sim_layout, dev.block);
+
+    sim_transactions = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, PMBUS_read_telemetry(&dev, &telemetry));
+    TEST_ASSERT_EQUAL_INT(1, sim_transactions);
+    TEST_ASSERT_EQUAL_HEX16(PMBUS_STATUS_WORD_OFF, telemetry.status_word);
+    TEST_ASSERT_EQUAL_INT32(5000, telemetry.vin);
+    TEST_ASSERT_EQUAL_INT32(11000, telemetry.iout);
+    TEST_ASSERT_EQUAL_INT32(1199, telemetry.vout);
+    TEST_ASSERT_EQUAL_INT32(25000, telemetry.temperature);
+}
+
+TEST_CASE("Block telemetry with the wrong layout is rejected", "[pmbus]")
+{
+    PMBUS_Device dev;
+    PMBUS_Telemetry telemetry;
+
+    sim_reset();
+    sim_fill_block();
+    // Swap VIN and temperature in the device's block
+    sim_put_block_word(sim_layout.vin, sim_words[PMBUS_READ_TEMPERATURE_1]);
+    sim_put_block_word(sim_layout.temperature, sim_words[PMBUS_READ_VIN]);
+    PMBUS_init(&dev, sim_read, NULL);
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE, PMBUS_enable_block_telemetry(&dev, &sim_layout));
+    TEST_ASSERT_NULL(dev.block);
+
+    // Falls back to word reads
+    sim_transactions = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, PMBUS_read_telemetry(&dev, &telemetry));
+    TEST_ASSERT_EQUAL_INT(5, sim_transactions);
+    TEST_ASSERT_EQUAL_INT32(5000, telemetry.vin);
+
+    // Swapped VOUT and IOUT are caught as well, with the output on and off
+    sim_fill_block();
+    sim_put_block_word(sim_layout.iout, sim_words[PMBUS_READ_VOUT]);
+    sim_put_block_word(sim_layout.vout, sim_words[PMBUS_READ_IOUT]);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE, PMBUS_enable_block_telemetry(&dev, &sim_layout));
+
+    sim_words[PMBUS_READ_IOUT] = 0xE000;            // 0 A, exponent -4
+    sim_words[PMBUS_READ_VOUT] = 0x0000;
+    sim_fill_block();
+    sim_put_block_word(sim_layout.iout, sim_words[PMBUS_READ_VOUT]);
+    sim_put_block_word(sim_layout.vout, sim_words[PMBUS_READ_IOUT]);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE, PMBUS_enable_block_telemetry(&dev, &sim_layout));
+    TEST_ASSERT_NULL(dev.block);
+}
+
+TEST_CASE("Short block byte count is an error", "[pmbus]")
+{
+    PMBUS_Device dev;
+    uint8_t data[10];
+
+    sim_reset();
+    sim_fill_block();
+    sim_block[0] = 6;
+    PMBUS_init(&dev, sim_read, NULL);
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE, PMBUS_read_block(&dev, SIM_READ_ALL, data, 10));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, PMBUS_read_block(&dev, SIM_READ_ALL, data, PMBUS_MAX_BLOCK_LEN + 1));
+}
+
+TEST_CASE("Status polling reports newly raised faults only", "[pmbus]")
+{
+    PMBUS_Device dev;
+
+    sim_reset();
+    PMBUS_init(&dev, sim_read, NULL);
+
+    // Output off and power not good are states, not faults
+    TEST_ASSERT_EQUAL_HEX16(0, PMBUS_update_status(&dev, PMBUS_STATUS_WORD_OFF | PMBUS_STATUS_WORD_POWER_GOOD_N));
+
+    uint16_t status = PMBUS_STATUS_WORD_VOUT | PMBUS_STATUS_WORD_VOUT_OV | PMBUS_STATUS_WORD_OFF;
+    TEST_ASSERT_EQUAL_HEX16(PMBUS_STATUS_WORD_VOUT | PMBUS_STATUS_WORD_VOUT_OV, PMBUS_update_status(&dev, status));
+    // Still latched, nothing new
+    TEST_ASSERT_EQUAL_HEX16(0, PMBUS_update_status(&dev, status));
+
+    status |= PMBUS_STATUS_WORD_TEMPERATURE;
+    TEST_ASSERT_EQUAL_HEX16(PMBUS_STATUS_WORD_TEMPERATURE, PMBUS_update_status(&dev, status));
+
+    // Cleared and raised again counts as new
+    TEST_ASSERT_EQUAL_HEX16(0, PMBUS_update_status(&dev, 0));
+    TEST_ASSERT_EQUAL_HEX16(PMBUS_STATUS_WORD_TEMPERATURE, PMBUS_update_status(&dev, PMBUS_STATUS_WORD_TEMPERATURE));
+
+    TEST_ASSERT_EQUAL_STRING("VOUT", PMBUS_status_bit_name(15));
+    TEST_ASSERT_EQUAL_STRING("TEMPERATURE", PMBUS_status_bit_name(2));
+}
@@ -40,4 +40,11 @@ char *extranonce_2_generate(uint32_t extranonce_2, uint32_t length);
 
 uint32_t increment_bitmask(const uint32_t value, const uint32_t mask);
 
+double calculate_network_difficulty(uint32_t nbits);
+
+// Block height from the BIP34 push at the start of the coinbase scriptSig, 0 if there is none.
+// The push is trusted to be a height, a pre-BIP34 scriptSig starting with a short push gives a
+// wrong one. Pools only send work above height 227931, where BIP34 requires the height.
+uint32_t coinbase_block_height(const char *coinbase_1);
+
 #endif /* MINING_H_ */
\ No newline at end of file
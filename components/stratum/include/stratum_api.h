@@ -39,6 +39,7 @@ typedef struct
     uint32_t target;
     uint32_t ntime;
     uint32_t difficulty;
+    int64_t received_us;    // esp_timer time the notify arrived, set by the receiver
 } mining_notify;
 
 typedef struct
@@ -66,6 +67,9 @@ void STRATUM_V1_reset_uid();
 
 void STRATUM_V1_initialize_buffer();
 
+// A complete line was already received, the next receive does not read the socket
+bool STRATUM_V1_line_buffered();
+
 char *STRATUM_V1_receive_jsonrpc_line(int sockfd);
 
 int STRATUM_V1_subscribe(int socket, char * model);
@@ -1,6 +1,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <limits.h>
+#include <math.h>
 #include "mining.h"
 #include "utils.h"
 #include "mbedtls/sha256.h"
@@ -181,3 +182,39 @@ uint32_t increment_bitmask(const uint32_t value, const uint32_t mask)
 
     return new_value;
 }
+
+double calculate_network_difficulty(uint32_t nbits)
+{
+    uint32_t mantissa = nbits & 0x007fffff;  // Extract the mantissa from nBits
+    uint8_t exponent = (nbits >> 24) & 0xff; // Extract the exponent from nBits
+
+    double target = (double) mantissa * pow(256, (exponent - 3)); // Calculate the target value
+
+    double difficulty = (pow(2, 208) * 65535) / target; // Calculate the difficulty
+
+    return difficulty;
+}
+
+uint32_t coinbase_block_height(const char *coinbase_1)
+{
+    // version (4) + input count (1) + null prevout (36) + scriptSig length (1), then
+    // BIP34 puts the height first in the scriptSig as a little endian push of 1-4 bytes
+    const size_t script_offset = (4 + 1 + 36 + 1) * 2;
+    uint8_t push[5];
+
+    if (coinbase_1 == NULL || strlen(coinbase_1) < script_offset + 2) {
+        return 0;
+    }
+    hex2bin(coinbase_1 + script_offset, push, 1);
+    uint8_t push_len = push[0];
+    if (push_len < 1 || push_len > 4 || strlen(coinbase_1) < script_offset + 2 + push_len * 2) {
+        return 0;
+    }
+    hex2bin(coinbase_1 + script_offset + 2, push + 1, push_len);
+
+    uint32_t height = 0;
+    for (int i = push_len; i > 0; i--) {
+        height = (height << 8) | push[i];
+    }
+    return height;
+}
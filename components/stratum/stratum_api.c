@@ -75,6 +75,11 @@ static void realloc_json_buffer(size_t len)
     json_rpc_buffer_size = new;
 }
 
+bool STRATUM_V1_line_buffered()
+{
+    return json_rpc_buffer != NULL && strchr(json_rpc_buffer, '\n') != NULL;
+}
+
 char * STRATUM_V1_receive_jsonrpc_line(int sockfd)
 {
     if (json_rpc_buffer == NULL) {
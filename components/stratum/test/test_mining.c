@@ -188,3 +188,19 @@ TEST_CASE("Test nonce diff checking 2", "[mining test_nonce]")
     double diff = test_nonce_value(&job, nonce, 0);
     TEST_ASSERT_EQUAL_INT(683, (int)diff);
 }
+
+TEST_CASE("Network difficulty from nbits", "[mining]")
+{
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, calculate_network_difficulty(0x1d00ffff));
+    TEST_ASSERT_DOUBLE_WITHIN(1.0, 53911173001054.586, calculate_network_difficulty(0x17053894));
+}
+
+TEST_CASE("Block height from coinbase", "[mining]")
+{
+    // Height 791433 pushed as 03 89130c
+    const char *coinbase_1 = "01000000010000000000000000000000000000000000000000000000000000000000000000ffffffff4b0389130cfabe6d6d5cbab26a2599e92916edec5657a94a0708ddb970f5c45b5d12905085617eff8e0100000000000000";
+    TEST_ASSERT_EQUAL_UINT32(791433, coinbase_block_height(coinbase_1));
+
+    TEST_ASSERT_EQUAL_UINT32(0, coinbase_block_height("0100000001"));
+    TEST_ASSERT_EQUAL_UINT32(0, coinbase_block_height(NULL));
+}
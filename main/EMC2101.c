@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include "esp_log.h"
+#include "esp_check.h"
 
 #include "i2c_bitaxe.h"
 #include "EMC2101.h"
@@ -52,43 +53,57 @@ void EMC2101_set_beta_compensation(uint8_t beta){
 }
 
 // takes a fan speed percent
-void EMC2101_set_fan_speed(float percent)
+// A failed write is logged by i2c_bitaxe and returned, it must not take down the caller (overheat handling sets the fan too)
+esp_err_t EMC2101_set_fan_speed(float percent)
 {
     uint8_t speed;
 
     speed = (uint8_t) (63.0 * percent);
-    ESP_ERROR_CHECK(i2c_bitaxe_register_write_byte(emc2101_dev_handle, EMC2101_REG_FAN_SETTING, speed));
+    return i2c_bitaxe_register_write_byte(emc2101_dev_handle, EMC2101_REG_FAN_SETTING, speed);
 }
 
 // RPM = 5400000/reading
-uint16_t EMC2101_get_fan_speed(void)
+static esp_err_t read_fan_speed(uint16_t * rpm, int timeout_ms)
 {
     uint8_t tach_lsb, tach_msb;
     uint16_t reading;
     uint16_t RPM;
 
-    ESP_ERROR_CHECK(i2c_bitaxe_register_read(emc2101_dev_handle, EMC2101_TACH_LSB, &tach_lsb, 1));
-    ESP_ERROR_CHECK(i2c_bitaxe_register_read(emc2101_dev_handle, EMC2101_TACH_MSB, &tach_msb, 1));
+    ESP_RETURN_ON_ERROR(i2c_bitaxe_register_read_timeout(emc2101_dev_handle, EMC2101_TACH_LSB, &tach_lsb, 1, timeout_ms), TAG, "tach lsb");
+    ESP_RETURN_ON_ERROR(i2c_bitaxe_register_read_timeout(emc2101_dev_handle, EMC2101_TACH_MSB, &tach_msb, 1, timeout_ms), TAG, "tach msb");
 
     // ESP_LOGI(TAG, "Raw Fan Speed = %02X %02X", tach_msb, tach_lsb);
 
     reading = tach_lsb | (tach_msb << 8);
-    RPM = 5400000 / reading;
+    RPM = reading ? 5400000 / reading : 0;
 
     // ESP_LOGI(TAG, "Fan Speed = %d RPM", RPM);
     if (RPM == 82) {
-        return 0;
+        RPM = 0;
     }
-    return RPM;
+    *rpm = RPM;
+    return ESP_OK;
 }
 
-float EMC2101_get_external_temp(void)
+esp_err_t EMC2101_read_fan_speed(uint16_t * rpm)
+{
+    return read_fan_speed(rpm, I2C_TELEMETRY_TIMEOUT_MS);
+}
+
+uint16_t EMC2101_get_fan_speed(void)
+{
+    uint16_t rpm = 0;
+    ESP_ERROR_CHECK(read_fan_speed(&rpm, I2C_DEFAULT_TIMEOUT));
+    return rpm;
+}
+
+static esp_err_t read_external_temp(float * temp, int timeout_ms)
 {
     uint8_t temp_msb, temp_lsb;
     uint16_t reading;
 
-    ESP_ERROR_CHECK(i2c_bitaxe_register_read(emc2101_dev_handle, EMC2101_EXTERNAL_TEMP_MSB, &temp_msb, 1));
-    ESP_ERROR_CHECK(i2c_bitaxe_register_read(emc2101_dev_handle, EMC2101_EXTERNAL_TEMP_LSB, &temp_lsb, 1));
+    ESP_RETURN_ON_ERROR(i2c_bitaxe_register_read_timeout(emc2101_dev_handle, EMC2101_EXTERNAL_TEMP_MSB, &temp_msb, 1, timeout_ms), TAG, "temp msb");
+    ESP_RETURN_ON_ERROR(i2c_bitaxe_register_read_timeout(emc2101_dev_handle, EMC2101_EXTERNAL_TEMP_LSB, &temp_lsb, 1, timeout_ms), TAG, "temp lsb");
     
     // Combine MSB and LSB, and then right shift to get 11 bits
     reading = (temp_msb << 8) | temp_lsb;
@@ -110,9 +125,26 @@ float EMC2101_get_external_temp(void)
     }
 
     // Convert the signed reading to temperature in Celsius
-    float result = (float)signed_reading / 8.0;
+    *temp = (float)signed_reading / 8.0;
+
+    return ESP_OK;
+}
+
+esp_err_t EMC2101_read_external_temp(float * temp)
+{
+    return read_external_temp(temp, I2C_TELEMETRY_TIMEOUT_MS);
+}
 
-    return result;
+float EMC2101_get_external_temp(void)
+{
+    float temp = 0;
+    ESP_ERROR_CHECK(read_external_temp(&temp, I2C_DEFAULT_TIMEOUT));
+    return temp;
+}
+
+esp_err_t EMC2101_read_internal_temp(uint8_t * temp)
+{
+    return i2c_bitaxe_register_read_timeout(emc2101_dev_handle, EMC2101_INTERNAL_TEMP, temp, 1, I2C_TELEMETRY_TIMEOUT_MS);
 }
 
 uint8_t EMC2101_get_internal_temp(void)
@@ -160,12 +160,16 @@ typedef enum
     EMC2101_RATE_32_HZ,   ///< 32_HZ
 } emc2101_rate_t;
 
-void EMC2101_set_fan_speed(float);
+esp_err_t EMC2101_set_fan_speed(float);
 // void EMC2101_read(void);
 uint16_t EMC2101_get_fan_speed(void);
 esp_err_t EMC2101_init(bool);
 float EMC2101_get_external_temp(void);
 uint8_t EMC2101_get_internal_temp(void);
+// Non-aborting variants for the sensor task, return the I2C error instead and give up after I2C_TELEMETRY_TIMEOUT_MS
+esp_err_t EMC2101_read_fan_speed(uint16_t *);
+esp_err_t EMC2101_read_external_temp(float *);
+esp_err_t EMC2101_read_internal_temp(uint8_t *);
 void EMC2101_set_ideality_factor(uint8_t);
 void EMC2101_set_beta_compensation(uint8_t);
 #endif /* EMC2101_H_ */
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include "esp_log.h"
+#include "esp_check.h"
 
 #include "i2c_bitaxe.h"
 #include "INA260.h"
@@ -53,3 +54,20 @@ float INA260_read_power(void)
 
     return (data[1] | (data[0] << 8)) * 10;
 }
+
+// Current, voltage and power in one pass, without aborting on a bus error or waiting out a stuck bus
+esp_err_t INA260_read_all(float * current, float * voltage, float * power)
+{
+    uint8_t data[2];
+
+    ESP_RETURN_ON_ERROR(i2c_bitaxe_register_read_timeout(ina260_dev_handle, INA260_REG_CURRENT, data, 2, I2C_TELEMETRY_TIMEOUT_MS), TAG, "current");
+    *current = (uint16_t)(data[1] | (data[0] << 8)) * 1.25;
+
+    ESP_RETURN_ON_ERROR(i2c_bitaxe_register_read_timeout(ina260_dev_handle, INA260_REG_BUSVOLTAGE, data, 2, I2C_TELEMETRY_TIMEOUT_MS), TAG, "voltage");
+    *voltage = (uint16_t)(data[1] | (data[0] << 8)) * 1.25;
+
+    ESP_RETURN_ON_ERROR(i2c_bitaxe_register_read_timeout(ina260_dev_handle, INA260_REG_POWER, data, 2, I2C_TELEMETRY_TIMEOUT_MS), TAG, "power");
+    *power = (data[1] | (data[0] << 8)) * 10;
+
+    return ESP_OK;
+}
@@ -110,5 +110,6 @@ bool INA260_installed(void);
 float INA260_read_current(void);
 float INA260_read_voltage(void);
 float INA260_read_power(void);
+esp_err_t INA260_read_all(float * current, float * voltage, float * power);
 
 #endif /* INA260_H_ */
@@ -6,6 +6,7 @@
 #include "pmbus_commands.h"
 
 #include "i2c_bitaxe.h"
+#include "pmbus.h"
 #include "TPS546.h"
 
 //#define _DEBUG_LOG_ 1
@@ -33,7 +34,20 @@ static uint8_t MFR_REVISION[] = {0x00, 0x00, 0x01};
 
 //static uint8_t COMPENSATION_CONFIG[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
 
+// READ_ALL returns the telemetry registers in one block, it is checked against
+// the single registers at init and only used if the layout matches
+static const PMBUS_BlockLayout READ_ALL_LAYOUT = {
+    .command = PMBUS_READ_ALL,
+    .length = 10,
+    .status_word = 0,
+    .vin = 2,
+    .vout = 4,
+    .iout = 6,
+    .temperature = 8,
+};
+
 static i2c_master_dev_handle_t tps546_dev_handle;
+static PMBUS_Device tps546_pmbus;
 
 /**
  * @brief SMBus read byte
@@ -127,102 +141,67 @@ static esp_err_t smb_write_block(uint8_t command, uint8_t *data, uint8_t len)
     }
 }
 
+/**
+ * @brief PMBus transport for the shared driver layer
+ * The layer serves the sensor task's telemetry poll and reports errors to its callers, so it
+ * gets the bounded telemetry timeout instead of waiting out a stuck bus
+ */
+static esp_err_t pmbus_read(void *ctx, uint8_t command, uint8_t *data, size_t len)
+{
+    return i2c_bitaxe_register_read_timeout(tps546_dev_handle, command, data, len, I2C_TELEMETRY_TIMEOUT_MS);
+}
+
+/**
+ * @brief The cached VOUT_MODE exponent, read from the device on first use
+ */
+static int8_t vout_exponent(void)
+{
+    if (!tps546_pmbus.vout_mode_valid && PMBUS_refresh_vout_mode(&tps546_pmbus) != ESP_OK) {
+        ESP_LOGE(TAG, "Could not read VOUT_MODE");
+    }
+    return tps546_pmbus.vout_exponent;
+}
+
 /**
  * @brief Convert an SLINEAR11 value into an int
  * @param value The SLINEAR11 value to convert
  */
 static int slinear11_2_int(uint16_t value)
 {
-    int exponent, mantissa;
-    float result;
-
-    // First 5 bits is exponent in twos-complement
-    // check the first bit of the exponent to see if its negative
-    if (value & 0x8000) {
-        // exponent is negative
-        exponent = -1 * (((~value >> 11) & 0x001F) + 1);
-    } else {
-        exponent = (value >> 11);
-    }
-    // last 11 bits is the mantissa in twos-complement
-    // check the first bit of the mantissa to see if its negative
-    if (value & 0x400) {
-        // mantissa is negative
-        mantissa = -1 * ((~value & 0x03FF) + 1);
-    } else {
-        mantissa = (value & 0x03FF);
-    }
-
-    // calculate result (mantissa * 2^exponent)
-    result = mantissa * powf(2.0, exponent);
-    return (int)result;
+    return PMBUS_linear11_to_milli(value) / 1000;
 }
 
 /**
- * @brief Convert an SLINEAR11 value into an int
+ * @brief Convert an SLINEAR11 value into a float
  * @param value The SLINEAR11 value to convert
  */
 static float slinear11_2_float(uint16_t value)
 {
-    int exponent, mantissa;
-    float result;
-
-    // First 5 bits is exponent in twos-complement
-    // check the first bit of the exponent to see if its negative
-    if (value & 0x8000) {
-        // exponent is negative
-        exponent = -1 * (((~value >> 11) & 0x001F) + 1);
-    } else {
-        exponent = (value >> 11);
-    }
-    // last 11 bits is the mantissa in twos-complement
-    // check the first bit of the mantissa to see if its negative
-    if (value & 0x400) {
-        // mantissa is negative
-        mantissa = -1 * ((~value & 0x03FF) + 1);
-    } else {
-        mantissa = (value & 0x03FF);
-    }
-
-    // calculate result (mantissa * 2^exponent)
-    result = mantissa * powf(2.0, exponent);
-    return result;
+    return PMBUS_linear11_to_milli(value) / 1000.0f;
 }
 
 /**
  * @brief Convert an int value into an SLINEAR11
+ * Integer settings keep a non-negative exponent, as the regulator has always been written
  * @param value The int value to convert
  */
 static uint16_t int_2_slinear11(int value)
 {
-    int mantissa;
-    int exponent = 0;
-    uint16_t result = 0;
-    int i;
-
-    // First see if the exponent is positive or negative
-    if (value >= 0) {
-        // exponent is positive
-        for (i=0; i<=15; i++) {
-            mantissa = value / powf(2.0, i);
-            if (mantissa < 1024) {
-                exponent = i;
-                break;
-            }
-        }
-        if (i == 16) {
-            ESP_LOGI(TAG, "Could not find a solution");
-            return 0;
-        }
-    } else {
-        // value is negative
+    int exponent;
+
+    if (value < 0) {
         ESP_LOGI(TAG, "No negative numbers at this time");
         return 0;
     }
 
-    result = ((exponent << 11) & 0xF800) + mantissa;
+    for (exponent = 0; exponent <= 15; exponent++) {
+        if ((value >> exponent) < 1024) {
+            return ((exponent << 11) & 0xF800) + (value >> exponent);
+        }
+    }
 
-    return result;
+    ESP_LOGI(TAG, "Could not find a solution");
+    return 0;
 }
 
 /**
@@ -231,86 +210,33 @@ static uint16_t int_2_slinear11(int value)
  */
 static uint16_t float_2_slinear11(float value)
 {
-    int mantissa;
-    int exponent = 0;
-    uint16_t result = 0;
-    int i;
-
-    // First see if the exponent is positive or negative
-    if (value > 0) {
-        // exponent is negative
-        for (i=0; i<=15; i++) {
-            mantissa = value * powf(2.0, i);
-            if (mantissa >= 1024) {
-                exponent = i-1;
-                mantissa = value * powf(2.0, exponent);
-                break;
-            }
-        }
-        if (i == 16) {
-            ESP_LOGI(TAG, "Could not find a solution");
-            return 0;
-        }
-    } else {
-        // value is negative
+    if (value <= 0) {
         ESP_LOGI(TAG, "No negative numbers at this time");
         return 0;
     }
-
-    result = (( (~exponent + 1) << 11) & 0xF800) + mantissa;
-
-    return result;
+    return PMBUS_milli_to_linear11(lroundf(value * 1000));
 }
 
 /**
  * @brief Convert a ULINEAR16 value into a float
- * the exponent comes from the VOUT_MODE bits[4..0]
- * stored in twos-complement
+ * the exponent is the cached VOUT_MODE bits[4..0]
  * The mantissa occupies the full 16-bits of the value
  * @param value The ULINEAR16 value to convert
  */
 static float ulinear16_2_float(uint16_t value)
 {
-    uint8_t voutmode;
-    int exponent;
-    float result;
-
-    smb_read_byte(PMBUS_VOUT_MODE, &voutmode);
-
-    if (voutmode & 0x10) {
-        // exponent is negative
-        exponent = -1 * ((~voutmode & 0x1F) + 1);
-    } else {
-        exponent = (voutmode & 0x1F);
-    }
-    result = (value * powf(2.0, exponent));
-    return result;
+    return PMBUS_ulinear16_to_milli(value, vout_exponent()) / 1000.0f;
 }
 
 /**
  * @brief Convert a float value into a ULINEAR16
- * the exponent comes from the VOUT_MODE bits[4..0]
- * stored in twos-complement
+ * the exponent is the cached VOUT_MODE bits[4..0]
  * The mantissa occupies the full 16-bits of the result
  * @param value The float value to convert
 */
 static uint16_t float_2_ulinear16(float value)
 {
-    uint8_t voutmode;
-    float exponent;
-    uint16_t result;
-
-    smb_read_byte(PMBUS_VOUT_MODE, &voutmode);
-    if (voutmode & 0x10) {
-        // exponent is negative
-        exponent = -1 * ((~voutmode & 0x1F) + 1);
-    } else {
-        exponent = (voutmode & 0x1F);
-    }
-
-    result = (value / powf(2.0, exponent));
-
-    return result;
+    return PMBUS_milli_to_ulinear16(lroundf(value * 1000), vout_exponent());
 }
 
 /*--- Public TPS546 functions ---*/
@@ -334,6 +260,7 @@ int TPS546_init(void)
         ESP_LOGE(TAG, "Failed to add I2C device");
         return -1;
     }
+    PMBUS_init(&tps546_pmbus, pmbus_read, NULL);
 
     /* Establish communication with regulator */
     smb_read_block(PMBUS_IC_DEVICE_ID, data, 6); //the DEVICE_ID block first byte is the length.
@@ -361,7 +288,14 @@ int TPS546_init(void)
     ESP_LOGI(TAG, "Writing new config values");
     smb_read_byte(PMBUS_VOUT_MODE, &voutmode);
     ESP_LOGI(TAG, "VOUT_MODE: %02x", voutmode);
+    PMBUS_refresh_vout_mode(&tps546_pmbus);
     TPS546_write_entire_config();
+
+    if (PMBUS_enable_block_telemetry(&tps546_pmbus, &READ_ALL_LAYOUT) == ESP_OK) {
+        ESP_LOGI(TAG, "Using READ_ALL for telemetry");
+    } else {
+        ESP_LOGW(TAG, "READ_ALL doesn't match the telemetry registers, using word reads");
+    }
     //}
 
     // /* Show temperature */
@@ -659,6 +593,40 @@ float TPS546_get_vout(void)
     }
 }
 
+/**
+ * @brief Read input voltage, output current, output voltage, temperature and status in one pass
+ * A single READ_ALL block when the device supports it, otherwise word reads that
+ * stop at the first failed transaction so a wedged regulator costs one timeout
+ * Newly raised faults in STATUS_WORD are logged along with the detailed status registers
+ * @param telemetry Filled with the converted values on success
+ */
+esp_err_t TPS546_read_telemetry(TPS546_Telemetry *telemetry)
+{
+    PMBUS_Telemetry raw;
+    esp_err_t err = PMBUS_read_telemetry(&tps546_pmbus, &raw);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    telemetry->vin = raw.vin / 1000.0f;
+    telemetry->iout = raw.iout / 1000.0f;
+    telemetry->vout = raw.vout / 1000.0f;
+    telemetry->temperature = raw.temperature / 1000;
+    telemetry->status_word = raw.status_word;
+
+    uint16_t raised = PMBUS_update_status(&tps546_pmbus, raw.status_word);
+    if (raised) {
+        for (int bit = 0; bit < 16; bit++) {
+            if (raised & (1 << bit)) {
+                ESP_LOGW(TAG, "Fault raised: %s", PMBUS_status_bit_name(bit));
+            }
+        }
+        TPS546_print_status();
+    }
+
+    return ESP_OK;
+}
+
 void TPS546_print_status(void) {
     uint16_t u16_value;
     uint8_t u8_value;
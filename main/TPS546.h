@@ -1,6 +1,8 @@
 #ifndef TPS546_H_
 #define TPS546_H_
 
+#include "esp_err.h"
+
 #define TPS546_I2CADDR         0x24  //< TPS546 i2c address
 #define TPS546_MANUFACTURER_ID 0xFE  //< Manufacturer ID
 #define TPS546_REVISION        0xFF  //< Chip revision
@@ -68,6 +70,14 @@
 #define ON_OFF_CONFIG_DELAY 0x00 // turn off DELAY bit
 
 
+typedef struct {
+    float vin;          // V
+    float iout;         // A
+    float vout;         // V
+    float temperature;  // °C
+    uint16_t status_word;
+} TPS546_Telemetry;
+
 /* public functions */
 int TPS546_init(void);
 void TPS546_read_mfr_info(uint8_t *);
@@ -82,5 +92,6 @@ float TPS546_get_vout(void);
 void TPS546_set_vout(float volts);
 void TPS546_show_voltage_settings(void);
 void TPS546_print_status(void);
+esp_err_t TPS546_read_telemetry(TPS546_Telemetry *telemetry);
 
 #endif /* TPS546_H_ */
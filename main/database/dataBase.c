@@ -1,4 +1,6 @@
 #include "dataBase.h"
+#include "eventLog.h"
+#include "logWriter.h"
 #include "esp_log.h"
 #include "esp_spiffs.h"
 #include "esp_partition.h"
@@ -6,6 +8,7 @@
 #include "esp_vfs.h"
 #include "theme_api.h"
 #include "nvs_config.h"
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <time.h>
@@ -28,10 +31,14 @@ static partition_layout_t current_layout;
 
 #define ACTIVE_THEMES_FILE "activeThemes.json"
 #define AVAILABLE_THEMES_FILE "availableThemes.json"
+// Pre-eventLog JSON logs, only read once for migration
 #define RECENT_LOGS_FILE "recentLogs.json"
 #define ERROR_LOGS_FILE "errorLogs.json"
 #define CRITICAL_LOGS_FILE "criticalLogs.json"
 
+// Events copied out of the log per read, a query visits them after the log is unlocked
+#define LOG_BATCH_SIZE 4096
+
 static char themes_dir[32];
 static char logs_dir[32];
 
@@ -40,6 +47,15 @@ static void get_file_path(const char* base_dir, const char* filename, char* full
     snprintf(full_path, max_len, "%s/%s", base_dir, filename);
 }
 
+// Resolve a file in the logs directory for modules that keep their own files there
+esp_err_t dataBase_get_logs_path(const char* filename, char* full_path, size_t max_len) {
+    if (logs_dir[0] == '\0') {
+        return ESP_ERR_INVALID_STATE;
+    }
+    get_file_path(logs_dir, filename, full_path, max_len);
+    return ESP_OK;
+}
+
 // Detect partition layout
 esp_err_t dataBase_check_partition_layout(void) {
     // Check if the "data" partition exists
@@ -315,267 +331,355 @@ esp_err_t dataBase_get_available_themes(cJSON** themes_json) {
     return dataBase_read_json_file(available_themes_path, themes_json);
 }
 
+// Legacy JSON logs larger than this are dropped instead of being loaded for migration
+#define LEGACY_LOGS_MAX_SIZE (64 * 1024)
+
+// Move the events of a pre-eventLog JSON file into its ring once, then remove the file
+static void migrate_legacy_logs(EventLogId log, const char* filename, const char* array_name) {
+    char path[128];
+    get_file_path(logs_dir, filename, path, sizeof(path));
+
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return;
+    }
+
+    // A ring that already has events was migrated before the file could be removed
+    if (st.st_size > LEGACY_LOGS_MAX_SIZE || eventLog_next_seq(log) != 1) {
+        ESP_LOGW(TAG, "Dropping legacy %s (%ld bytes)", filename, (long)st.st_size);
+        remove(path);
+        return;
+    }
+
+    cJSON* root;
+    if (dataBase_read_json_file(path, &root) == ESP_OK) {
+        int migrated = 0;
+        cJSON* event;
+        cJSON_ArrayForEach(event, cJSON_GetObjectItem(root, array_name)) {
+            cJSON* timestamp = cJSON_GetObjectItem(event, "timestamp");
+            cJSON* data = cJSON_GetObjectItem(event, "data");
+            char* data_str = NULL;
+            if (data && !cJSON_IsString(data)) {
+                data_str = cJSON_PrintUnformatted(data);
+            }
+
+            eventLog_append(log, cJSON_IsNumber(timestamp) ? (uint32_t)timestamp->valuedouble : 0,
+                            cJSON_GetStringValue(cJSON_GetObjectItem(event, "type")),
+                            cJSON_GetStringValue(cJSON_GetObjectItem(event, "level")),
+                            cJSON_GetStringValue(cJSON_GetObjectItem(event, "message")),
+                            data_str ? data_str : cJSON_GetStringValue(data));
+            free(data_str);
+            migrated++;
+        }
+        cJSON_Delete(root);
+        eventLog_flush();
+        ESP_LOGI(TAG, "Migrated %d events from %s", migrated, filename);
+    }
+
+    remove(path);
+}
+
 // Initialize logs database
 esp_err_t dataBase_init_logs(void) {
     // Create logs directory if it doesn't exist
     if (mkdir(logs_dir, 0755) != 0) {
         // Directory might already exist, which is fine
     }
-    
-    char recent_logs_path[128];
-    get_file_path(logs_dir, RECENT_LOGS_FILE, recent_logs_path, sizeof(recent_logs_path));
-    
-    // Check if recentLogs.json exists
-    FILE* file = fopen(recent_logs_path, "r");
-    if (!file) {
-        ESP_LOGI(TAG, "Creating recentLogs.json");
-        
-        // Create empty logs file
-        cJSON* root = cJSON_CreateObject();
-        cJSON_AddNumberToObject(root, "maxEvents", 100);
-        cJSON_AddNumberToObject(root, "currentCount", 0);
-        cJSON_AddNumberToObject(root, "lastArchived", 0);
-        
-        cJSON* events_array = cJSON_CreateArray();
-        cJSON_AddItemToObject(root, "events", events_array);
-        
-        esp_err_t ret = dataBase_write_json_file(recent_logs_path, root);
-        cJSON_Delete(root);
-        
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to create recentLogs.json");
-            return ret;
-        }
-    } else {
-        fclose(file);
+
+    esp_err_t ret = eventLog_init(logs_dir);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize event log");
+        return ret;
     }
-    
+
+    migrate_legacy_logs(EVENTLOG_RECENT, RECENT_LOGS_FILE, "events");
+
     ESP_LOGI(TAG, "Logs database initialized successfully");
     return ESP_OK;
 }
 
 // Log an event
 esp_err_t dataBase_log_event(const char* event_type, const char* level, const char* message, const char* data) {
-    char recent_logs_path[128];
-    get_file_path(logs_dir, RECENT_LOGS_FILE, recent_logs_path, sizeof(recent_logs_path));
-    
-    cJSON* root;
-    esp_err_t ret = dataBase_read_json_file(recent_logs_path, &root);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to read recent logs file");
-        return ret;
-    }
-    
-    cJSON* events_array = cJSON_GetObjectItem(root, "events");
-    if (!cJSON_IsArray(events_array)) {
-        ESP_LOGE(TAG, "Events array not found in logs file");
-        cJSON_Delete(root);
-        return ESP_FAIL;
-    }
-    
-    // Create new event
-    cJSON* new_event = cJSON_CreateObject();
     time_t now;
     time(&now);
-    cJSON_AddNumberToObject(new_event, "timestamp", now);
-    cJSON_AddStringToObject(new_event, "type", event_type);
-    cJSON_AddStringToObject(new_event, "level", level);
-    cJSON_AddStringToObject(new_event, "message", message);
+
+    // Error and critical events also go to their own logs
+    uint8_t targets = LOGWRITER_TARGET(EVENTLOG_RECENT);
+    if (strcmp(level, "error") == 0 || strcmp(level, "critical") == 0) {
+        targets |= LOGWRITER_TARGET(EVENTLOG_ERRORS);
+    }
+    if (strcmp(level, "critical") == 0) {
+        targets |= LOGWRITER_TARGET(EVENTLOG_CRITICAL);
+    }
+
+    // Queued for the writer task, this never touches the filesystem
+    esp_err_t ret = logWriter_submit(targets, now, event_type, level, message, data);
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "Event logged: %s - %s", event_type, message);
+    } else {
+        ESP_LOGE(TAG, "Failed to queue event log");
+    }
     
-    if (data && strlen(data) > 0) {
-        cJSON* data_json = cJSON_Parse(data);
+    return ret;
+}
+
+// Write out every event logged so far
+esp_err_t dataBase_flush_logs(uint32_t timeout_ms) {
+    esp_err_t ret = logWriter_flush(timeout_ms);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to flush logs: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+// Turn a stored event back into the JSON the API has always returned
+static bool add_event_to_array(const EventLogEntry* entry, void* ctx) {
+    cJSON* events_array = ctx;
+
+    cJSON* event = cJSON_CreateObject();
+    cJSON_AddNumberToObject(event, "timestamp", entry->timestamp);
+    cJSON_AddStringToObject(event, "type", entry->type);
+    cJSON_AddStringToObject(event, "level", entry->level);
+    cJSON_AddStringToObject(event, "message", entry->message);
+
+    if (entry->data[0] != '\0') {
+        cJSON* data_json = cJSON_Parse(entry->data);
         if (data_json) {
-            cJSON_AddItemToObject(new_event, "data", data_json);
+            cJSON_AddItemToObject(event, "data", data_json);
         } else {
-            cJSON_AddStringToObject(new_event, "data", data);
+            cJSON_AddStringToObject(event, "data", entry->data);
         }
     }
-    
-    // Add to events array
-    cJSON_AddItemToArray(events_array, new_event);
-    
-    // Update current count
-    cJSON* current_count = cJSON_GetObjectItem(root, "currentCount");
-    if (cJSON_IsNumber(current_count)) {
-        current_count->valueint++;
+
+    cJSON_AddItemToArray(events_array, event);
+    return true;
+}
+
+// Read the newest max_count events of a ring (0 = all) into a JSON array, oldest first
+static esp_err_t read_events(EventLogId log, int max_count, cJSON** events_array) {
+    uint32_t next_seq = eventLog_next_seq(log);
+    uint32_t from_seq = eventLog_oldest_seq(log);
+    if (max_count > 0 && next_seq - from_seq > (uint32_t)max_count) {
+        from_seq = next_seq - max_count;
     }
-    
-    // Check if we need to trim (keep max 100 events)
-    int array_size = cJSON_GetArraySize(events_array);
-    if (array_size > 100) {
-        // Remove oldest event
-        cJSON_DeleteItemFromArray(events_array, 0);
-        if (cJSON_IsNumber(current_count)) {
-            current_count->valueint--;
+
+    cJSON* array = cJSON_CreateArray();
+    esp_err_t ret = eventLog_read(log, from_seq, add_event_to_array, array);
+    if (ret != ESP_OK) {
+        cJSON_Delete(array);
+        return ret;
+    }
+
+    *events_array = array;
+    return ESP_OK;
+}
+
+static bool list_contains(const char* list, const char* value) {
+    size_t len = strlen(value);
+    const char* p = list;
+    while (p) {
+        if (strncmp(p, value, len) == 0 && (p[len] == ',' || p[len] == '\0')) {
+            return true;
+        }
+        p = strchr(p, ',');
+        if (p) {
+            p++;
         }
     }
-    
-    // Write back to file
-    ret = dataBase_write_json_file(recent_logs_path, root);
-    cJSON_Delete(root);
-    
-    if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "Event logged: %s - %s", event_type, message);
-    } else {
-        ESP_LOGE(TAG, "Failed to write event log");
+    return false;
+}
+
+static bool query_matches(const log_query_t* query, const EventLogEntry* entry) {
+    return (!query->since || entry->timestamp >= query->since) &&
+           (!query->until || entry->timestamp <= query->until) &&
+           (!query->levels || list_contains(query->levels, entry->level)) &&
+           (!query->types || list_contains(query->types, entry->type));
+}
+
+typedef struct {
+    log_query_t* query;
+    int skip;        // Matches to pass over before the page starts
+    int matched;
+    int returned;
+    eventlog_visit_fn visit;
+    void* ctx;
+} query_state_t;
+
+static bool count_matches(const EventLogEntry* entry, void* ctx) {
+    query_state_t* state = ctx;
+    if (query_matches(state->query, entry)) {
+        state->matched++;
     }
-    
-    // Also log to error logs if level is error or critical
-    if (strcmp(level, "error") == 0 || strcmp(level, "critical") == 0) {
-        esp_err_t error_ret = dataBase_log_error(event_type, level, message, data);
-        if (error_ret != ESP_OK) {
-            ESP_LOGW(TAG, "Failed to log to error logs");
+    return true;
+}
+
+static bool visit_page(const EventLogEntry* entry, void* ctx) {
+    query_state_t* state = ctx;
+    log_query_t* query = state->query;
+
+    query->next_cursor = entry->seq + 1;
+    if (!query_matches(query, entry)) {
+        return true;
+    }
+    if (state->skip > 0) {
+        state->skip--;
+        return true;
+    }
+
+    state->returned++;
+    if (!state->visit(entry, state->ctx)) {
+        return false;
+    }
+    return !query->limit || state->returned < query->limit;
+}
+
+// Events packed as seq, timestamp and the four NUL-terminated fields
+typedef struct {
+    uint8_t* buf;
+    size_t len;
+    uint32_t last_seq;
+    bool full;
+} log_batch_t;
+
+static bool copy_to_batch(const EventLogEntry* entry, void* ctx) {
+    log_batch_t* batch = ctx;
+    const char* fields[4] = {entry->type, entry->level, entry->message, entry->data};
+    size_t lens[4];
+    size_t need = 2 * sizeof(uint32_t);
+    for (int i = 0; i < 4; i++) {
+        lens[i] = strlen(fields[i]) + 1;
+        need += lens[i];
+    }
+    // An empty batch always fits one event, a payload is at most EVENTLOG_MAX_PAYLOAD
+    if (batch->len + need > LOG_BATCH_SIZE) {
+        batch->full = true;
+        return false;
+    }
+
+    uint8_t* p = batch->buf + batch->len;
+    memcpy(p, &entry->seq, sizeof(uint32_t));
+    memcpy(p + sizeof(uint32_t), &entry->timestamp, sizeof(uint32_t));
+    p += 2 * sizeof(uint32_t);
+    for (int i = 0; i < 4; i++) {
+        memcpy(p, fields[i], lens[i]);
+        p += lens[i];
+    }
+    batch->len += need;
+    batch->last_seq = entry->seq;
+    return true;
+}
+
+// Visit the events of a batch in order, false once visit stopped
+static bool replay_batch(const log_batch_t* batch, eventlog_visit_fn visit, void* ctx) {
+    const uint8_t* p = batch->buf;
+    const uint8_t* end = batch->buf + batch->len;
+    while (p < end) {
+        EventLogEntry entry;
+        memcpy(&entry.seq, p, sizeof(uint32_t));
+        memcpy(&entry.timestamp, p + sizeof(uint32_t), sizeof(uint32_t));
+        p += 2 * sizeof(uint32_t);
+        const char** fields[4] = {&entry.type, &entry.level, &entry.message, &entry.data};
+        for (int i = 0; i < 4; i++) {
+            *fields[i] = (const char*)p;
+            p += strlen((const char*)p) + 1;
+        }
+        if (!visit(&entry, ctx)) {
+            return false;
         }
     }
-    
-    // Also log to critical logs if level is critical
-    if (strcmp(level, "critical") == 0) {
-        esp_err_t critical_ret = dataBase_log_critical(event_type, level, message, data);
-        if (critical_ret != ESP_OK) {
-            ESP_LOGW(TAG, "Failed to log to critical logs");
+    return true;
+}
+
+// Page through a log, calling visit for each matching event oldest first. Without a
+// cursor the page is the newest limit matches, so it takes a counting pass first.
+// Events are copied out LOG_BATCH_SIZE bytes at a time and visited with the log
+// unlocked, so a slow client never holds up the log writer or a flush.
+esp_err_t dataBase_query_logs(EventLogId log, log_query_t* query, eventlog_visit_fn visit, void* ctx) {
+    query_state_t state = {
+        .query = query,
+        .visit = visit,
+        .ctx = ctx,
+    };
+    uint32_t from_seq = query->cursor;
+
+    if (from_seq == 0) {
+        from_seq = eventLog_oldest_seq(log);
+        bool filtered = query->since || query->until || query->levels || query->types;
+        if (query->limit > 0 && !filtered) {
+            // Every event matches, the page start follows from the sequence numbers
+            uint32_t next_seq = eventLog_next_seq(log);
+            if (next_seq - from_seq > (uint32_t)query->limit) {
+                from_seq = next_seq - query->limit;
+            }
+        } else if (query->limit > 0) {
+            esp_err_t ret = eventLog_read(log, from_seq, count_matches, &state);
+            if (ret != ESP_OK) {
+                return ret;
+            }
+            state.skip = state.matched > query->limit ? state.matched - query->limit : 0;
         }
     }
-    
+
+    query->next_cursor = from_seq;
+
+    log_batch_t batch = {
+        .buf = malloc(LOG_BATCH_SIZE),
+    };
+    if (!batch.buf) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t ret = ESP_OK;
+    do {
+        batch.len = 0;
+        batch.full = false;
+        ret = eventLog_read(log, from_seq, copy_to_batch, &batch);
+        if (ret != ESP_OK || !replay_batch(&batch, visit_page, &state)) {
+            break;
+        }
+        // Events dropped by the ring in between are skipped, the next read starts at the oldest left
+        from_seq = batch.last_seq + 1;
+    } while (batch.full);
+
+    free(batch.buf);
     return ret;
 }
 
 // Get recent logs
 esp_err_t dataBase_get_recent_logs(int max_count, cJSON** logs_json) {
-    char recent_logs_path[128];
-    get_file_path(logs_dir, RECENT_LOGS_FILE, recent_logs_path, sizeof(recent_logs_path));
-    
-    cJSON* root;
-    esp_err_t ret = dataBase_read_json_file(recent_logs_path, &root);
+    cJSON* events_array;
+    esp_err_t ret = read_events(EVENTLOG_RECENT, max_count, &events_array);
     if (ret != ESP_OK) {
         return ret;
     }
     
-    cJSON* events_array = cJSON_GetObjectItem(root, "events");
-    if (!cJSON_IsArray(events_array)) {
-        cJSON_Delete(root);
-        return ESP_FAIL;
-    }
-    
-    // Create response with limited events
     cJSON* response = cJSON_CreateObject();
-    cJSON* limited_events = cJSON_CreateArray();
+    cJSON_AddNumberToObject(response, "count", cJSON_GetArraySize(events_array));
+    cJSON_AddItemToObject(response, "events", events_array);
     
-    int array_size = cJSON_GetArraySize(events_array);
-    int count = (max_count < array_size) ? max_count : array_size;
-    
-    // Get the most recent events
-    for (int i = array_size - count; i < array_size; i++) {
-        cJSON* event = cJSON_GetArrayItem(events_array, i);
-        cJSON_AddItemToArray(limited_events, cJSON_Duplicate(event, 1));
-    }
-    
-    cJSON_AddItemToObject(response, "events", limited_events);
-    cJSON_AddNumberToObject(response, "count", count);
-    
-    cJSON_Delete(root);
     *logs_json = response;
-    
     return ESP_OK;
 }
 
 // Initialize error logs database
 esp_err_t dataBase_init_error_logs(void) {
-    // Create logs directory if it doesn't exist (should already exist from regular logs init)
-    if (mkdir(logs_dir, 0755) != 0) {
-        // Directory might already exist, which is fine
-    }
-    
-    char error_logs_path[128];
-    get_file_path(logs_dir, ERROR_LOGS_FILE, error_logs_path, sizeof(error_logs_path));
-    
-    // Check if errorLogs.json exists
-    FILE* file = fopen(error_logs_path, "r");
-    if (!file) {
-        ESP_LOGI(TAG, "Creating errorLogs.json");
-        
-        // Create empty error logs file
-        cJSON* root = cJSON_CreateObject();
-        cJSON_AddNumberToObject(root, "totalErrors", 0);
-        cJSON_AddNumberToObject(root, "lastError", 0);
-        cJSON_AddStringToObject(root, "description", "Persistent error logs - no automatic rotation");
-        
-        cJSON* errors_array = cJSON_CreateArray();
-        cJSON_AddItemToObject(root, "errors", errors_array);
-        
-        esp_err_t ret = dataBase_write_json_file(error_logs_path, root);
-        cJSON_Delete(root);
-        
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to create errorLogs.json");
-            return ret;
-        }
-    } else {
-        fclose(file);
-    }
-    
+    // The event log itself is set up with the regular logs
+    migrate_legacy_logs(EVENTLOG_ERRORS, ERROR_LOGS_FILE, "errors");
+
     ESP_LOGI(TAG, "Error logs database initialized successfully");
     return ESP_OK;
 }
 
 // Log an error event (persistent)
 esp_err_t dataBase_log_error(const char* event_type, const char* level, const char* message, const char* data) {
-    char error_logs_path[128];
-    get_file_path(logs_dir, ERROR_LOGS_FILE, error_logs_path, sizeof(error_logs_path));
-    
-    cJSON* root;
-    esp_err_t ret = dataBase_read_json_file(error_logs_path, &root);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to read error logs file");
-        return ret;
-    }
-    
-    cJSON* errors_array = cJSON_GetObjectItem(root, "errors");
-    if (!cJSON_IsArray(errors_array)) {
-        ESP_LOGE(TAG, "Errors array not found in error logs file");
-        cJSON_Delete(root);
-        return ESP_FAIL;
-    }
-    
-    // Create new error event
-    cJSON* new_error = cJSON_CreateObject();
     time_t now;
     time(&now);
-    cJSON_AddNumberToObject(new_error, "timestamp", now);
-    cJSON_AddStringToObject(new_error, "type", event_type);
-    cJSON_AddStringToObject(new_error, "level", level);
-    cJSON_AddStringToObject(new_error, "message", message);
-    
-    if (data && strlen(data) > 0) {
-        cJSON* data_json = cJSON_Parse(data);
-        if (data_json) {
-            cJSON_AddItemToObject(new_error, "data", data_json);
-        } else {
-            cJSON_AddStringToObject(new_error, "data", data);
-        }
-    }
-    
-    // Add to errors array
-    cJSON_AddItemToArray(errors_array, new_error);
-    
-    // Update total count and last error timestamp
-    cJSON* total_errors = cJSON_GetObjectItem(root, "totalErrors");
-    if (cJSON_IsNumber(total_errors)) {
-        total_errors->valueint++;
-    }
-    
-    cJSON* last_error = cJSON_GetObjectItem(root, "lastError");
-    if (cJSON_IsNumber(last_error)) {
-        last_error->valueint = now;
-    }
-    
-    // Write back to file (no size limit - persistent storage)
-    ret = dataBase_write_json_file(error_logs_path, root);
-    cJSON_Delete(root);
-    
+
+    esp_err_t ret = logWriter_submit(LOGWRITER_TARGET(EVENTLOG_ERRORS), now, event_type, level, message, data);
     if (ret == ESP_OK) {
         ESP_LOGI(TAG, "Error logged: %s - %s", event_type, message);
     } else {
-        ESP_LOGE(TAG, "Failed to write error log");
+        ESP_LOGE(TAG, "Failed to queue error log");
     }
     
     return ret;
@@ -583,62 +687,26 @@ esp_err_t dataBase_log_error(const char* event_type, const char* level, const ch
 
 // Get error logs
 esp_err_t dataBase_get_error_logs(int max_count, cJSON** logs_json) {
-    char error_logs_path[128];
-    get_file_path(logs_dir, ERROR_LOGS_FILE, error_logs_path, sizeof(error_logs_path));
-    
-    cJSON* root;
-    esp_err_t ret = dataBase_read_json_file(error_logs_path, &root);
+    cJSON* errors_array;
+    esp_err_t ret = read_events(EVENTLOG_ERRORS, max_count, &errors_array);
     if (ret != ESP_OK) {
         return ret;
     }
     
-    cJSON* errors_array = cJSON_GetObjectItem(root, "errors");
-    if (!cJSON_IsArray(errors_array)) {
-        cJSON_Delete(root);
-        return ESP_FAIL;
-    }
-    
-    // Create response with limited errors
     cJSON* response = cJSON_CreateObject();
-    cJSON* limited_errors = cJSON_CreateArray();
-    
-    int array_size = cJSON_GetArraySize(errors_array);
-    int count = (max_count > 0 && max_count < array_size) ? max_count : array_size;
-    
-    // Get the most recent errors
-    for (int i = array_size - count; i < array_size; i++) {
-        cJSON* error = cJSON_GetArrayItem(errors_array, i);
-        cJSON_AddItemToArray(limited_errors, cJSON_Duplicate(error, 1));
-    }
-    
-    cJSON_AddItemToObject(response, "errors", limited_errors);
-    cJSON_AddNumberToObject(response, "count", count);
-    cJSON_AddNumberToObject(response, "totalErrors", cJSON_GetObjectItem(root, "totalErrors")->valueint);
-    cJSON_AddNumberToObject(response, "lastError", cJSON_GetObjectItem(root, "lastError")->valueint);
+    cJSON_AddNumberToObject(response, "count", cJSON_GetArraySize(errors_array));
+    cJSON_AddItemToObject(response, "errors", errors_array);
+    // Counted since the last clear, including errors the ring has already wrapped over
+    cJSON_AddNumberToObject(response, "totalErrors", eventLog_next_seq(EVENTLOG_ERRORS) - 1);
+    cJSON_AddNumberToObject(response, "lastError", eventLog_last_timestamp(EVENTLOG_ERRORS));
     
-    cJSON_Delete(root);
     *logs_json = response;
-    
     return ESP_OK;
 }
 
 // Clear all error logs
 esp_err_t dataBase_clear_error_logs(void) {
-    char error_logs_path[128];
-    get_file_path(logs_dir, ERROR_LOGS_FILE, error_logs_path, sizeof(error_logs_path));
-    
-    // Create empty error logs file
-    cJSON* root = cJSON_CreateObject();
-    cJSON_AddNumberToObject(root, "totalErrors", 0);
-    cJSON_AddNumberToObject(root, "lastError", 0);
-    cJSON_AddStringToObject(root, "description", "Persistent error logs - no automatic rotation");
-    
-    cJSON* errors_array = cJSON_CreateArray();
-    cJSON_AddItemToObject(root, "errors", errors_array);
-    
-    esp_err_t ret = dataBase_write_json_file(error_logs_path, root);
-    cJSON_Delete(root);
-    
+    esp_err_t ret = eventLog_clear(EVENTLOG_ERRORS);
     if (ret == ESP_OK) {
         ESP_LOGI(TAG, "Error logs cleared successfully");
     } else {
@@ -650,102 +718,23 @@ esp_err_t dataBase_clear_error_logs(void) {
 
 // Initialize critical logs database
 esp_err_t dataBase_init_critical_logs(void) {
-    // Create logs directory if it doesn't exist (should already exist from regular logs init)
-    if (mkdir(logs_dir, 0755) != 0) {
-        // Directory might already exist, which is fine
-    }
-    
-    char critical_logs_path[128];
-    get_file_path(logs_dir, CRITICAL_LOGS_FILE, critical_logs_path, sizeof(critical_logs_path));
-    
-    // Check if criticalLogs.json exists
-    FILE* file = fopen(critical_logs_path, "r");
-    if (!file) {
-        ESP_LOGI(TAG, "Creating criticalLogs.json");
-        
-        // Create empty critical logs file
-        cJSON* root = cJSON_CreateObject();
-        cJSON_AddNumberToObject(root, "totalCritical", 0);
-        cJSON_AddNumberToObject(root, "lastCritical", 0);
-        cJSON_AddStringToObject(root, "description", "Persistent critical logs - no automatic rotation");
-        
-        cJSON* critical_array = cJSON_CreateArray();
-        cJSON_AddItemToObject(root, "critical", critical_array);
-        
-        esp_err_t ret = dataBase_write_json_file(critical_logs_path, root);
-        cJSON_Delete(root);
-        
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to create criticalLogs.json");
-            return ret;
-        }
-    } else {
-        fclose(file);
-    }
-    
+    // The event log itself is set up with the regular logs
+    migrate_legacy_logs(EVENTLOG_CRITICAL, CRITICAL_LOGS_FILE, "critical");
+
     ESP_LOGI(TAG, "Critical logs database initialized successfully");
     return ESP_OK;
 }
 
 // Log a critical event (persistent)
 esp_err_t dataBase_log_critical(const char* event_type, const char* level, const char* message, const char* data) {
-    char critical_logs_path[128];
-    get_file_path(logs_dir, CRITICAL_LOGS_FILE, critical_logs_path, sizeof(critical_logs_path));
-    
-    cJSON* root;
-    esp_err_t ret = dataBase_read_json_file(critical_logs_path, &root);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to read critical logs file");
-        return ret;
-    }
-    
-    cJSON* critical_array = cJSON_GetObjectItem(root, "critical");
-    if (!cJSON_IsArray(critical_array)) {
-        ESP_LOGE(TAG, "Critical array not found in critical logs file");
-        cJSON_Delete(root);
-        return ESP_FAIL;
-    }
-    
-    // Create new critical event
-    cJSON* new_critical = cJSON_CreateObject();
     time_t now;
     time(&now);
-    cJSON_AddNumberToObject(new_critical, "timestamp", now);
-    cJSON_AddStringToObject(new_critical, "type", event_type);
-    cJSON_AddStringToObject(new_critical, "level", level);
-    cJSON_AddStringToObject(new_critical, "message", message);
-    
-    if (data && strlen(data) > 0) {
-        cJSON* data_json = cJSON_Parse(data);
-        if (data_json) {
-            cJSON_AddItemToObject(new_critical, "data", data_json);
-        } else {
-            cJSON_AddStringToObject(new_critical, "data", data);
-        }
-    }
-    
-    // Add to critical array
-    cJSON_AddItemToArray(critical_array, new_critical);
-    
-    // Update total count and last critical timestamp
-    cJSON* total_critical = cJSON_GetObjectItem(root, "totalCritical");
-    if (cJSON_IsNumber(total_critical)) {
-        total_critical->valueint++;
-    }
-    
-    cJSON* last_critical = cJSON_GetObjectItem(root, "lastCritical");
-    if (cJSON_IsNumber(last_critical)) {
-        last_critical->valueint = now;
-    }
-    
-    // Write back to file (no size limit - persistent storage)
-    ret = dataBase_write_json_file(critical_logs_path, root);
-    cJSON_Delete(root);
-    
+
+    esp_err_t ret = logWriter_submit(LOGWRITER_TARGET(EVENTLOG_CRITICAL), now, event_type, level, message, data);
     if (ret == ESP_OK) {
         ESP_LOGI(TAG, "Critical event logged: %s - %s", event_type, message);
     } else {
-        ESP_LOGE(TAG, "Failed to write critical log");
+        ESP_LOGE(TAG, "Failed to queue critical log");
     }
     
     return ret;
@@ -753,62 +742,25 @@ esp_err_t dataBase_log_critical(const char* event_type, const char* level, const
 
 // Get critical logs
 esp_err_t dataBase_get_critical_logs(int max_count, cJSON** logs_json) {
-    char critical_logs_path[128];
-    get_file_path(logs_dir, CRITICAL_LOGS_FILE, critical_logs_path, sizeof(critical_logs_path));
-    
-    cJSON* root;
-    esp_err_t ret = dataBase_read_json_file(critical_logs_path, &root);
+    cJSON* critical_array;
+    esp_err_t ret = read_events(EVENTLOG_CRITICAL, max_count, &critical_array);
     if (ret != ESP_OK) {
         return ret;
     }
     
-    cJSON* critical_array = cJSON_GetObjectItem(root, "critical");
-    if (!cJSON_IsArray(critical_array)) {
-        cJSON_Delete(root);
-        return ESP_FAIL;
-    }
-    
-    // Create response with limited critical events
     cJSON* response = cJSON_CreateObject();
-    cJSON* limited_critical = cJSON_CreateArray();
-    
-    int array_size = cJSON_GetArraySize(critical_array);
-    int count = (max_count > 0 && max_count < array_size) ? max_count : array_size;
-    
-    // Get the most recent critical events
-    for (int i = array_size - count; i < array_size; i++) {
-        cJSON* critical = cJSON_GetArrayItem(critical_array, i);
-        cJSON_AddItemToArray(limited_critical, cJSON_Duplicate(critical, 1));
-    }
-    
-    cJSON_AddItemToObject(response, "critical", limited_critical);
-    cJSON_AddNumberToObject(response, "count", count);
-    cJSON_AddNumberToObject(response, "totalCritical", cJSON_GetObjectItem(root, "totalCritical")->valueint);
-    cJSON_AddNumberToObject(response, "lastCritical", cJSON_GetObjectItem(root, "lastCritical")->valueint);
+    cJSON_AddNumberToObject(response, "count", cJSON_GetArraySize(critical_array));
+    cJSON_AddItemToObject(response, "critical", critical_array);
+    cJSON_AddNumberToObject(response, "totalCritical", eventLog_next_seq(EVENTLOG_CRITICAL) - 1);
+    cJSON_AddNumberToObject(response, "lastCritical", eventLog_last_timestamp(EVENTLOG_CRITICAL));
     
-    cJSON_Delete(root);
     *logs_json = response;
-    
     return ESP_OK;
 }
 
 // Clear all critical logs
 esp_err_t dataBase_clear_critical_logs(void) {
-    char critical_logs_path[128];
-    get_file_path(logs_dir, CRITICAL_LOGS_FILE, critical_logs_path, sizeof(critical_logs_path));
-    
-    // Create empty critical logs file
-    cJSON* root = cJSON_CreateObject();
-    cJSON_AddNumberToObject(root, "totalCritical", 0);
-    cJSON_AddNumberToObject(root, "lastCritical", 0);
-    cJSON_AddStringToObject(root, "description", "Persistent critical logs - no automatic rotation");
-    
-    cJSON* critical_array = cJSON_CreateArray();
-    cJSON_AddItemToObject(root, "critical", critical_array);
-    
-    esp_err_t ret = dataBase_write_json_file(critical_logs_path, root);
-    cJSON_Delete(root);
-    
+    esp_err_t ret = eventLog_clear(EVENTLOG_CRITICAL);
     if (ret == ESP_OK) {
         ESP_LOGI(TAG, "Critical logs cleared successfully");
     } else {
@@ -863,6 +815,11 @@ esp_err_t dataBase_init(void) {
         ESP_LOGE(TAG, "Failed to initialize critical logs database");
         return ret;
     }
+
+    // Move log writes off the calling tasks, logging still works synchronously without it
+    if (logWriter_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to start log writer task");
+    }
     
     ESP_LOGI(TAG, "Database system initialized successfully (data partition only)");
     return ESP_OK;
@@ -4,6 +4,18 @@
 #include "esp_err.h"
 #include "esp_http_server.h"
 #include "cJSON.h"
+#include "eventLog.h"
+
+// Filters and position for dataBase_query_logs
+typedef struct {
+    uint32_t cursor;      // First sequence number to return, 0 for the newest page
+    uint32_t since;       // Only events at or after this Unix time, 0 = unbounded
+    uint32_t until;       // Only events at or before this Unix time, 0 = unbounded
+    const char* levels;   // Comma separated levels to match, NULL for any
+    const char* types;    // Comma separated event types to match, NULL for any
+    int limit;            // Most events to return, 0 = no limit
+    uint32_t next_cursor; // Set to the cursor of the following page
+} log_query_t;
 
 // Database initialization
 esp_err_t dataBase_init(void);
@@ -24,6 +36,8 @@ esp_err_t dataBase_init_logs(void);
 esp_err_t dataBase_log_event(const char* event_type, const char* level, const char* message, const char* data);
 esp_err_t dataBase_get_recent_logs(int max_count, cJSON** logs_json);
 esp_err_t dataBase_archive_old_logs(void);
+esp_err_t dataBase_flush_logs(uint32_t timeout_ms);
+esp_err_t dataBase_query_logs(EventLogId log, log_query_t* query, eventlog_visit_fn visit, void* ctx);
 
 // Error logging functions (persistent)
 esp_err_t dataBase_init_error_logs(void);
@@ -43,5 +57,6 @@ esp_err_t dataBase_register_api_endpoints(httpd_handle_t server, void* ctx);
 // Utility functions
 esp_err_t dataBase_read_json_file(const char* path, cJSON** json);
 esp_err_t dataBase_write_json_file(const char* path, cJSON* json);
+esp_err_t dataBase_get_logs_path(const char* filename, char* full_path, size_t max_len);
 
 #endif // DATABASE_H_ 
\ No newline at end of file
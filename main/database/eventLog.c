@@ -0,0 +1,425 @@
+#include "eventLog.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "eventLog";
+
+#define SEGMENT_SIZE (16 * 1024)
+#define MAX_SEGMENTS 4
+#define FRAME_MAGIC 0xE7A1
+#define PENDING_SIZE 2048  // Per ring, fits at least one frame of the largest payload
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint16_t length;     // Payload bytes, the CRC32 follows the payload
+    uint32_t seq;
+    uint32_t timestamp;
+} FrameHeader;
+
+typedef struct {
+    const char* name;
+    uint8_t segments;
+} RingConfig;
+
+// 160KB in total on the 1MB data partition
+static const RingConfig ring_config[EVENTLOG_COUNT] = {
+    [EVENTLOG_RECENT] = {"events", 4},
+    [EVENTLOG_ERRORS] = {"errors", 4},
+    [EVENTLOG_CRITICAL] = {"critical", 2},
+};
+
+typedef struct {
+    uint32_t first_seq[MAX_SEGMENTS]; // 0 for an empty segment
+    uint8_t current;                  // Segment being appended to
+    uint32_t offset;                  // Bytes written to the current segment
+    uint16_t pending_len;             // Bytes buffered for the current segment
+    uint32_t next_seq;
+    uint32_t last_timestamp;
+} Ring;
+
+static Ring rings[EVENTLOG_COUNT];
+static char log_dir[32];
+static SemaphoreHandle_t log_mutex = NULL;
+
+// Shared by appends and reads, both run under log_mutex
+static uint8_t frame_buf[sizeof(FrameHeader) + EVENTLOG_MAX_PAYLOAD + sizeof(uint32_t)];
+// Frames appended since the last flush, written out together
+static uint8_t pending[EVENTLOG_COUNT][PENDING_SIZE];
+
+static void segment_path(EventLogId log, int segment, char* path, size_t max_len) {
+    snprintf(path, max_len, "%s/%s.%d", log_dir, ring_config[log].name, segment);
+}
+
+// Reads the frame at the current file position into frame_buf. Without verify only
+// the header is read and the payload is skipped.
+static bool read_frame(FILE* file, FrameHeader* header, bool verify) {
+    if (fread(header, sizeof(FrameHeader), 1, file) != 1) {
+        return false;
+    }
+    if (header->magic != FRAME_MAGIC || header->length > EVENTLOG_MAX_PAYLOAD) {
+        return false;
+    }
+
+    if (!verify) {
+        return fseek(file, header->length + sizeof(uint32_t), SEEK_CUR) == 0;
+    }
+
+    memcpy(frame_buf, header, sizeof(FrameHeader));
+    size_t body_len = header->length + sizeof(uint32_t);
+    if (fread(frame_buf + sizeof(FrameHeader), 1, body_len, file) != body_len) {
+        return false;
+    }
+
+    uint32_t crc;
+    memcpy(&crc, frame_buf + sizeof(FrameHeader) + header->length, sizeof(crc));
+    return esp_rom_crc32_le(0, frame_buf, sizeof(FrameHeader) + header->length) == crc;
+}
+
+// Payload is type, level, message and data as consecutive NUL-terminated strings
+static bool decode_payload(const FrameHeader* header, EventLogEntry* entry) {
+    const char* fields[4];
+    const char* p = (const char*)frame_buf + sizeof(FrameHeader);
+    const char* end = p + header->length;
+
+    for (int i = 0; i < 4; i++) {
+        const char* nul = memchr(p, '\0', end - p);
+        if (!nul) {
+            return false;
+        }
+        fields[i] = p;
+        p = nul + 1;
+    }
+
+    entry->seq = header->seq;
+    entry->timestamp = header->timestamp;
+    entry->type = fields[0];
+    entry->level = fields[1];
+    entry->message = fields[2];
+    entry->data = fields[3];
+    return true;
+}
+
+static size_t put_field(uint8_t* dest, size_t space, const char* value) {
+    size_t len = value ? strlen(value) : 0;
+    if (len >= space) {
+        len = space - 1;
+    }
+    if (len) {
+        memcpy(dest, value, len);
+    }
+    dest[len] = '\0';
+    return len + 1;
+}
+
+// Start appending to the next segment, dropping the events it held
+static void rotate(EventLogId log) {
+    Ring* ring = &rings[log];
+    ring->current = (ring->current + 1) % ring_config[log].segments;
+    ring->first_seq[ring->current] = 0;
+    ring->offset = 0;
+}
+
+// Write the frames buffered for a ring with a single append
+static esp_err_t flush_ring(EventLogId log) {
+    Ring* ring = &rings[log];
+    if (ring->pending_len == 0) {
+        return ESP_OK;
+    }
+
+    char path[64];
+    segment_path(log, ring->current, path, sizeof(path));
+    // A reused segment is truncated by its first write
+    FILE* file = fopen(path, ring->offset == 0 ? "wb" : "ab");
+    size_t written = 0;
+    if (file) {
+        written = fwrite(pending[log], 1, ring->pending_len, file);
+        fclose(file);
+    }
+
+    if (written != ring->pending_len) {
+        ESP_LOGE(TAG, "Failed to write %u bytes to %s", ring->pending_len, path);
+        ring->pending_len = 0;
+        // Frames behind a partial write can't be read back, continue in a fresh segment
+        if (written) {
+            rotate(log);
+        }
+        return ESP_FAIL;
+    }
+
+    ring->offset += written;
+    ring->pending_len = 0;
+    return ESP_OK;
+}
+
+static void scan_ring(EventLogId log) {
+    Ring* ring = &rings[log];
+    char path[64];
+    FrameHeader header;
+
+    memset(ring, 0, sizeof(*ring));
+    ring->next_seq = 1;
+
+    for (int i = 0; i < ring_config[log].segments; i++) {
+        segment_path(log, i, path, sizeof(path));
+        FILE* file = fopen(path, "rb");
+        if (!file) {
+            continue;
+        }
+        if (read_frame(file, &header, true)) {
+            ring->first_seq[i] = header.seq;
+            if (header.seq > ring->first_seq[ring->current]) {
+                ring->current = i;
+            }
+        }
+        fclose(file);
+    }
+
+    if (ring->first_seq[ring->current] == 0) {
+        return;
+    }
+
+    // Walk the newest segment to find where the last complete frame ends
+    segment_path(log, ring->current, path, sizeof(path));
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return;
+    }
+    while (read_frame(file, &header, true)) {
+        ring->offset = ftell(file);
+        ring->next_seq = header.seq + 1;
+        ring->last_timestamp = header.timestamp;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+
+    // A torn write at the tail would sit between the old and the new frames
+    if (size > (long)ring->offset) {
+        ESP_LOGW(TAG, "%s: %ld bytes of damaged frames after seq %lu, starting a new segment",
+                 ring_config[log].name, size - (long)ring->offset, (unsigned long)(ring->next_seq - 1));
+        rotate(log);
+    }
+}
+
+// Caller holds log_mutex
+static uint32_t oldest_seq(EventLogId log) {
+    uint32_t oldest = rings[log].next_seq;
+    for (int i = 0; i < ring_config[log].segments; i++) {
+        if (rings[log].first_seq[i] && rings[log].first_seq[i] < oldest) {
+            oldest = rings[log].first_seq[i];
+        }
+    }
+    return oldest;
+}
+
+esp_err_t eventLog_init(const char* dir) {
+    if (!log_mutex) {
+        log_mutex = xSemaphoreCreateMutex();
+        if (!log_mutex) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    strncpy(log_dir, dir, sizeof(log_dir) - 1);
+    for (int log = 0; log < EVENTLOG_COUNT; log++) {
+        scan_ring(log);
+        ESP_LOGI(TAG, "%s: %lu events stored, next seq %lu", ring_config[log].name,
+                 (unsigned long)(rings[log].next_seq - oldest_seq(log)),
+                 (unsigned long)rings[log].next_seq);
+    }
+    xSemaphoreGive(log_mutex);
+
+    return ESP_OK;
+}
+
+esp_err_t eventLog_append(EventLogId log, uint32_t timestamp, const char* type, const char* level,
+                          const char* message, const char* data) {
+    if (!log_mutex || log >= EVENTLOG_COUNT) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    Ring* ring = &rings[log];
+
+    // Keep room for the three NULs after the first field and the data's own
+    uint8_t* payload = frame_buf + sizeof(FrameHeader);
+    size_t len = 0;
+    len += put_field(payload + len, EVENTLOG_MAX_PAYLOAD - 3 - len, type);
+    len += put_field(payload + len, EVENTLOG_MAX_PAYLOAD - 2 - len, level);
+    len += put_field(payload + len, EVENTLOG_MAX_PAYLOAD - 1 - len, message);
+    len += put_field(payload + len, EVENTLOG_MAX_PAYLOAD - len, data);
+
+    FrameHeader header = {
+        .magic = FRAME_MAGIC,
+        .length = len,
+        .seq = ring->next_seq,
+        .timestamp = timestamp,
+    };
+    memcpy(frame_buf, &header, sizeof(header));
+    uint32_t crc = esp_rom_crc32_le(0, frame_buf, sizeof(header) + len);
+    memcpy(payload + len, &crc, sizeof(crc));
+    size_t frame_len = sizeof(header) + len + sizeof(crc);
+
+    // A batch never spans two segments
+    if (ring->offset + ring->pending_len + frame_len > SEGMENT_SIZE) {
+        flush_ring(log);
+        rotate(log);
+    }
+    if (ring->pending_len + frame_len > PENDING_SIZE) {
+        flush_ring(log);
+    }
+
+    if (ring->offset == 0 && ring->pending_len == 0) {
+        ring->first_seq[ring->current] = header.seq;
+    }
+    memcpy(pending[log] + ring->pending_len, frame_buf, frame_len);
+    ring->pending_len += frame_len;
+    ring->next_seq++;
+    ring->last_timestamp = timestamp;
+
+    xSemaphoreGive(log_mutex);
+    return ESP_OK;
+}
+
+esp_err_t eventLog_flush(void) {
+    if (!log_mutex) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    for (int log = 0; log < EVENTLOG_COUNT; log++) {
+        if (flush_ring(log) != ESP_OK) {
+            ret = ESP_FAIL;
+        }
+    }
+    xSemaphoreGive(log_mutex);
+
+    return ret;
+}
+
+esp_err_t eventLog_read(EventLogId log, uint32_t from_seq, eventlog_visit_fn visit, void* ctx) {
+    if (!log_mutex || log >= EVENTLOG_COUNT) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    flush_ring(log);
+    Ring* ring = &rings[log];
+    int segments = ring_config[log].segments;
+    bool keep_going = true;
+
+    // Oldest segment is the one after the current
+    for (int n = 1; n <= segments && keep_going; n++) {
+        int segment = (ring->current + n) % segments;
+        if (ring->first_seq[segment] == 0) {
+            continue;
+        }
+
+        // Skip the whole segment when the following one starts at or before from_seq
+        uint32_t end_seq = ring->next_seq;
+        for (int m = n + 1; m <= segments; m++) {
+            int following = (ring->current + m) % segments;
+            if (ring->first_seq[following]) {
+                end_seq = ring->first_seq[following];
+                break;
+            }
+        }
+        if (end_seq <= from_seq) {
+            continue;
+        }
+
+        char path[64];
+        segment_path(log, segment, path, sizeof(path));
+        FILE* file = fopen(path, "rb");
+        if (!file) {
+            continue;
+        }
+
+        FrameHeader header;
+        long limit = segment == ring->current ? (long)ring->offset : SEGMENT_SIZE;
+        while (keep_going && ftell(file) < limit) {
+            long start = ftell(file);
+            if (fread(&header, sizeof(header), 1, file) != 1) {
+                break;
+            }
+            // Anything else after the last frame is the tail of a torn write
+            if (header.magic != FRAME_MAGIC) {
+                break;
+            }
+            fseek(file, start, SEEK_SET);
+
+            EventLogEntry entry;
+            if (header.seq < from_seq) {
+                if (!read_frame(file, &header, false)) {
+                    break;
+                }
+            } else if (!read_frame(file, &header, true) || !decode_payload(&header, &entry)) {
+                ESP_LOGW(TAG, "%s.%d: damaged frame at %ld", ring_config[log].name, segment, start);
+                break;
+            } else {
+                keep_going = visit(&entry, ctx);
+            }
+        }
+        fclose(file);
+    }
+
+    xSemaphoreGive(log_mutex);
+    return ESP_OK;
+}
+
+esp_err_t eventLog_clear(EventLogId log) {
+    if (!log_mutex || log >= EVENTLOG_COUNT) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    char path[64];
+    for (int i = 0; i < ring_config[log].segments; i++) {
+        segment_path(log, i, path, sizeof(path));
+        remove(path);
+    }
+    memset(&rings[log], 0, sizeof(Ring));
+    rings[log].next_seq = 1;
+    xSemaphoreGive(log_mutex);
+
+    return ESP_OK;
+}
+
+uint32_t eventLog_next_seq(EventLogId log) {
+    if (!log_mutex || log >= EVENTLOG_COUNT) {
+        return 1;
+    }
+
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    uint32_t next = rings[log].next_seq;
+    xSemaphoreGive(log_mutex);
+    return next;
+}
+
+uint32_t eventLog_oldest_seq(EventLogId log) {
+    if (!log_mutex || log >= EVENTLOG_COUNT) {
+        return 1;
+    }
+
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    uint32_t oldest = oldest_seq(log);
+    xSemaphoreGive(log_mutex);
+    return oldest;
+}
+
+uint32_t eventLog_last_timestamp(EventLogId log) {
+    if (!log_mutex || log >= EVENTLOG_COUNT) {
+        return 0;
+    }
+
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    uint32_t timestamp = rings[log].last_timestamp;
+    xSemaphoreGive(log_mutex);
+    return timestamp;
+}
@@ -0,0 +1,71 @@
+#ifndef EVENTLOG_H_
+#define EVENTLOG_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Append-only event rings on the data partition. Each ring is a fixed number of
+// fixed-size segment files written in turn, the oldest segment is truncated and
+// reused once the newest is full. Events are stored as CRC32-framed binary records
+// and only turned into JSON when something reads them.
+
+typedef enum {
+    EVENTLOG_RECENT,    // Every event
+    EVENTLOG_ERRORS,    // error and critical level
+    EVENTLOG_CRITICAL,  // critical level only
+    EVENTLOG_COUNT
+} EventLogId;
+
+// Largest stored type + level + message + data, longer fields are truncated
+#define EVENTLOG_MAX_PAYLOAD 1024
+
+typedef struct {
+    uint32_t seq;         // Increasing per ring, 1 is the first event after a clear
+    uint32_t timestamp;   // Unix time
+    const char* type;
+    const char* level;
+    const char* message;
+    const char* data;     // Empty string when there is no data
+} EventLogEntry;
+
+/**
+ * @brief Called for each event in sequence order, the entry is only valid during the call
+ * @return false to stop reading
+ */
+typedef bool (*eventlog_visit_fn)(const EventLogEntry* entry, void* ctx);
+
+/**
+ * @brief Scan the segments in dir and resume each ring after its last valid frame
+ */
+esp_err_t eventLog_init(const char* dir);
+
+/**
+ * @brief Add an event to a ring
+ * The frame is buffered in RAM until eventLog_flush, or until the buffer or the
+ * segment is full, so a batch of events costs one write.
+ */
+esp_err_t eventLog_append(EventLogId log, uint32_t timestamp, const char* type, const char* level,
+                          const char* message, const char* data);
+
+/**
+ * @brief Write the buffered frames of every ring
+ */
+esp_err_t eventLog_flush(void);
+
+/**
+ * @brief Visit the stored events of a ring, oldest first, buffered ones included
+ * @param from_seq First sequence number to visit, older events are skipped without decoding
+ */
+esp_err_t eventLog_read(EventLogId log, uint32_t from_seq, eventlog_visit_fn visit, void* ctx);
+
+esp_err_t eventLog_clear(EventLogId log);
+
+// Sequence number the next event will get, so next_seq - 1 events were logged since the last clear
+uint32_t eventLog_next_seq(EventLogId log);
+// Oldest event still stored, equal to next_seq when the ring is empty
+uint32_t eventLog_oldest_seq(EventLogId log);
+// Timestamp of the newest event, 0 when the ring is empty
+uint32_t eventLog_last_timestamp(EventLogId log);
+
+#endif // EVENTLOG_H_
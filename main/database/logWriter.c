@@ -0,0 +1,187 @@
+#include "logWriter.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/ringbuf.h"
+#include <string.h>
+
+static const char *TAG = "logWriter";
+
+#define RECORD_BUFFER_SIZE (8 * 1024)
+#define COALESCE_MS 2000        // Longest an event waits for others to share its write
+#define RECORD_URGENT 0x01      // Write without waiting for more events
+#define RECORD_FLUSH 0x02       // Flush request, carries no event
+
+// Followed by type, level, message and data as NUL-terminated strings
+typedef struct {
+    uint32_t timestamp;
+    uint8_t targets;
+    uint8_t flags;
+} LogRecord;
+
+static RingbufHandle_t record_buffer = NULL;
+static SemaphoreHandle_t flush_done = NULL;
+static uint32_t dropped_events = 0;
+static portMUX_TYPE dropped_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static esp_err_t write_now(uint8_t targets, uint32_t timestamp, const char* type, const char* level,
+                           const char* message, const char* data) {
+    for (int log = 0; log < EVENTLOG_COUNT; log++) {
+        if (targets & LOGWRITER_TARGET(log)) {
+            eventLog_append(log, timestamp, type, level, message, data);
+        }
+    }
+    return eventLog_flush();
+}
+
+static void write_record(const LogRecord* record) {
+    const char* fields[4];
+    const char* p = (const char*)(record + 1);
+    for (int i = 0; i < 4; i++) {
+        fields[i] = p;
+        p += strlen(p) + 1;
+    }
+
+    for (int log = 0; log < EVENTLOG_COUNT; log++) {
+        if (record->targets & LOGWRITER_TARGET(log)) {
+            eventLog_append(log, record->timestamp, fields[0], fields[1], fields[2], fields[3]);
+        }
+    }
+}
+
+static void log_writer_task(void* pvParameters) {
+    while (1) {
+        size_t size;
+        LogRecord* record = xRingbufferReceive(record_buffer, &size, portMAX_DELAY);
+        TickType_t batch_start = xTaskGetTickCount();
+        bool urgent = false;
+        bool flush_requested = false;
+        int batched = 0;
+
+        // Collect everything that arrives within the coalescing window into one write,
+        // after an urgent record only what is already queued
+        while (record) {
+            if (record->flags & RECORD_FLUSH) {
+                flush_requested = true;
+            } else {
+                write_record(record);
+                batched++;
+            }
+            urgent |= (record->flags & (RECORD_URGENT | RECORD_FLUSH)) != 0;
+            vRingbufferReturnItem(record_buffer, record);
+
+            TickType_t waited = xTaskGetTickCount() - batch_start;
+            TickType_t wait = 0;
+            if (!urgent && waited < pdMS_TO_TICKS(COALESCE_MS)) {
+                wait = pdMS_TO_TICKS(COALESCE_MS) - waited;
+            }
+            record = xRingbufferReceive(record_buffer, &size, wait);
+        }
+
+        if (eventLog_flush() != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to write %d events", batched);
+        }
+
+        taskENTER_CRITICAL(&dropped_lock);
+        uint32_t dropped = dropped_events;
+        dropped_events = 0;
+        taskEXIT_CRITICAL(&dropped_lock);
+        if (dropped) {
+            ESP_LOGW(TAG, "Dropped %lu events, log buffer was full", (unsigned long)dropped);
+        }
+
+        if (flush_requested) {
+            xSemaphoreGive(flush_done);
+        }
+    }
+}
+
+esp_err_t logWriter_init(void) {
+    if (record_buffer) {
+        return ESP_OK;
+    }
+
+    flush_done = xSemaphoreCreateBinary();
+    record_buffer = xRingbufferCreate(RECORD_BUFFER_SIZE, RINGBUF_TYPE_NOSPLIT);
+    // Below everything that does real work, nothing waits on the writes
+    if (!flush_done || !record_buffer ||
+        xTaskCreate(log_writer_task, "log writer", 4096, NULL, 1, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start log writer, logging synchronously");
+        if (record_buffer) {
+            vRingbufferDelete(record_buffer);
+            record_buffer = NULL;
+        }
+        if (flush_done) {
+            vSemaphoreDelete(flush_done);
+            flush_done = NULL;
+        }
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t logWriter_submit(uint8_t targets, uint32_t timestamp, const char* type, const char* level,
+                           const char* message, const char* data) {
+    if (!record_buffer) {
+        return write_now(targets, timestamp, type, level, message, data);
+    }
+
+    // Truncate the same way eventLog would, leaving room for each field's NUL
+    const char* fields[4] = {type, level, message, data};
+    size_t lengths[4];
+    size_t space = EVENTLOG_MAX_PAYLOAD;
+    size_t total = 0;
+    for (int i = 0; i < 4; i++) {
+        size_t len = fields[i] ? strlen(fields[i]) : 0;
+        size_t max_len = space - (4 - i);
+        lengths[i] = len < max_len ? len : max_len;
+        space -= lengths[i] + 1;
+        total += lengths[i] + 1;
+    }
+
+    LogRecord* record;
+    if (xRingbufferSendAcquire(record_buffer, (void**)&record, sizeof(LogRecord) + total, 0) != pdTRUE) {
+        taskENTER_CRITICAL(&dropped_lock);
+        dropped_events++;
+        taskEXIT_CRITICAL(&dropped_lock);
+        return ESP_ERR_NO_MEM;
+    }
+
+    record->timestamp = timestamp;
+    record->targets = targets;
+    record->flags = (targets & LOGWRITER_TARGET(EVENTLOG_CRITICAL)) ? RECORD_URGENT : 0;
+    char* p = (char*)(record + 1);
+    for (int i = 0; i < 4; i++) {
+        if (lengths[i]) {
+            memcpy(p, fields[i], lengths[i]);
+        }
+        p[lengths[i]] = '\0';
+        p += lengths[i] + 1;
+    }
+    xRingbufferSendComplete(record_buffer, record);
+
+    return ESP_OK;
+}
+
+esp_err_t logWriter_flush(uint32_t timeout_ms) {
+    if (!record_buffer) {
+        return eventLog_flush();
+    }
+
+    // Drop a completion left over from an earlier flush that timed out
+    xSemaphoreTake(flush_done, 0);
+
+    LogRecord* record;
+    if (xRingbufferSendAcquire(record_buffer, (void**)&record, sizeof(LogRecord),
+                               pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    record->timestamp = 0;
+    record->targets = 0;
+    record->flags = RECORD_FLUSH;
+    xRingbufferSendComplete(record_buffer, record);
+
+    return xSemaphoreTake(flush_done, pdMS_TO_TICKS(timeout_ms)) == pdTRUE ? ESP_OK : ESP_ERR_TIMEOUT;
+}
@@ -0,0 +1,33 @@
+#ifndef LOGWRITER_H_
+#define LOGWRITER_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "eventLog.h"
+
+// Write-behind front end for eventLog. Events are copied into a bounded RAM
+// buffer and written by a low priority task, so logging never waits on flash.
+
+#define LOGWRITER_TARGET(log) (1 << (log))
+
+/**
+ * @brief Start the writer task, eventLog must already be initialized
+ * Until this is called events are written synchronously.
+ */
+esp_err_t logWriter_init(void);
+
+/**
+ * @brief Queue an event for the rings in targets (LOGWRITER_TARGET bits)
+ * Never blocks. Critical events are written as soon as the writer task runs,
+ * other events are held for a short while and written in one batch.
+ * @return ESP_ERR_NO_MEM if the buffer is full and the event was dropped
+ */
+esp_err_t logWriter_submit(uint8_t targets, uint32_t timestamp, const char* type, const char* level,
+                           const char* message, const char* data);
+
+/**
+ * @brief Wait until everything queued so far is on flash, e.g. before a restart
+ */
+esp_err_t logWriter_flush(uint32_t timeout_ms);
+
+#endif // LOGWRITER_H_
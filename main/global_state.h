@@ -19,6 +19,10 @@
 
 #define HISTORY_LENGTH 100
 #define DIFF_STRING_SIZE 10
+#define REJECT_REASON_COUNT 8
+#define REJECT_REASON_SIZE 32
+#define NOTIFY_LATENCY_BUCKETS 8
+#define POOL_URL_SIZE 128
 
 typedef enum
 {
@@ -48,6 +52,23 @@ typedef struct
     void (*set_version_mask)(uint32_t);
 } AsicFunctions;
 
+typedef struct
+{
+    char reason[REJECT_REASON_SIZE];   // As reported by the pool, empty while the slot is unused
+    uint64_t count;
+} RejectedShares;
+
+// What the pool's mining.notify says about the chain, kept per pool
+typedef struct
+{
+    uint32_t block_height;          // From the BIP34 coinbase push, 0 until the pool sent one
+    double network_difficulty;      // From nBits
+    char prev_block_hash[65];
+    uint32_t block_ntime;           // ntime of the first notify for the current block
+    int64_t block_change_us;        // esp_timer time the current block was first seen, 0 before any notify
+    uint32_t block_changes;         // Block changes seen, not counting the first notify from the pool
+} ChainState;
+
 typedef struct
 {
     double duration_start;
@@ -59,6 +80,12 @@ typedef struct
     int64_t start_time;
     uint64_t shares_accepted;
     uint64_t shares_rejected;
+    RejectedShares shares_rejected_by_reason[REJECT_REASON_COUNT]; // The last slot takes every reason without one of its own
+    uint64_t nonces_found;
+    uint64_t invalid_job_nonces;
+    uint32_t notify_latency_buckets[NOTIFY_LATENCY_BUCKETS]; // mining.notify to first job, see SYSTEM_notify_latency_bounds_us
+    uint64_t notify_latency_sum_us;
+    uint32_t notify_latency_count;
     int screen_page;
     uint64_t best_nonce_diff;
     char best_diff_string[DIFF_STRING_SIZE];
@@ -71,11 +98,14 @@ typedef struct
     char ip_addr_str[16]; // IP4ADDR_STRLEN_MAX
     char ap_ssid[32];
     bool ap_enabled;
-    char * pool_url;
-    char * fallback_pool_url;
+    // Written by the stratum task under pool_lock, other tasks read them with SYSTEM_copy_pool_url
+    char pool_url[POOL_URL_SIZE];
+    char fallback_pool_url[POOL_URL_SIZE];
+    pthread_mutex_t pool_lock;
     uint16_t pool_port;
     uint16_t fallback_pool_port;
     bool is_using_fallback;
+    ChainState chain_state[2];     // Primary pool, fallback pool, written by the stratum task, read with SYSTEM_copy_chain_state
     uint16_t overheat_mode;
     uint32_t lastClockSync;
     bool is_screen_active;
@@ -276,7 +276,7 @@ export function PoolsPage() {
         : formData.fallbackPool.user;
 
       // First save the settings
-      await updatePoolInfo(
+      const result = await updatePoolInfo(
         primaryURL,
         formData.stratumOption === "Other"
           ? parseInt(formData.primaryPool.port, 10)
@@ -298,6 +298,11 @@ export function PoolsPage() {
       );
       showToast("Pool settings updated successfully", "success");
 
+      // Pool settings are applied live, the miner reconnects without a restart
+      if (result?.restartRequired === false) {
+        return;
+      }
+
       // Then restart the system
       await restartSystem();
       showToast("System is restarting...", "info");
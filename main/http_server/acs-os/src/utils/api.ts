@@ -1,6 +1,7 @@
 import { SystemInfo } from "./types/systemInfo";
 import { formatRelativeTime } from "./formatters";
 import { logger } from "./logger";
+import { sha256Hex } from "./sha256";
 
 // Re-export SystemInfo type for convenience
 export type { SystemInfo };
@@ -322,11 +323,12 @@ export async function restartSystem(): Promise<string> {
  */
 export async function uploadWebApp(file: File): Promise<{ success: boolean; message: string }> {
   try {
-    // Send the web app blob directly
+    // Send the web app blob directly, the device only accepts it with its digest
     const response = await fetch("/api/system/OTAWWW", {
       method: "POST",
       headers: {
         "Content-Type": "application/octet-stream",
+        "X-OTA-SHA256": await sha256Hex(file),
       },
       body: file,
     });
@@ -0,0 +1,47 @@
+#include "chunk_writer.h"
+#include <string.h>
+
+static void chunk_writer_flush(chunk_writer_t * writer)
+{
+    if (writer->err == ESP_OK && writer->len > 0) {
+        writer->err = httpd_resp_send_chunk(writer->req, writer->buf, writer->len);
+    }
+    writer->len = 0;
+}
+
+void chunk_writer_init(chunk_writer_t * writer, httpd_req_t * req, char * buf, size_t size)
+{
+    writer->req = req;
+    writer->buf = buf;
+    writer->size = size;
+    writer->len = 0;
+    writer->err = ESP_OK;
+}
+
+void chunk_writer_write(chunk_writer_t * writer, const char * data, size_t len)
+{
+    while (len > 0 && writer->err == ESP_OK) {
+        if (writer->len == writer->size) {
+            chunk_writer_flush(writer);
+        }
+        size_t n = len < writer->size - writer->len ? len : writer->size - writer->len;
+        memcpy(writer->buf + writer->len, data, n);
+        writer->len += n;
+        data += n;
+        len -= n;
+    }
+}
+
+void chunk_writer_write_str(chunk_writer_t * writer, const char * str)
+{
+    chunk_writer_write(writer, str, strlen(str));
+}
+
+esp_err_t chunk_writer_finish(chunk_writer_t * writer)
+{
+    chunk_writer_flush(writer);
+    if (writer->err != ESP_OK) {
+        return writer->err;
+    }
+    return httpd_resp_send_chunk(writer->req, NULL, 0);
+}
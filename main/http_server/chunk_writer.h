@@ -0,0 +1,28 @@
+#ifndef CHUNK_WRITER_H
+#define CHUNK_WRITER_H
+
+#include <stddef.h>
+#include "esp_http_server.h"
+
+// Buffers writes into a fixed buffer and sends it as a chunk of a chunked HTTP response
+// whenever it fills up. After the first failed send everything else is dropped and
+// chunk_writer_finish reports the error.
+typedef struct {
+    httpd_req_t * req;
+    char * buf;
+    size_t size;
+    size_t len;
+    esp_err_t err;
+} chunk_writer_t;
+
+void chunk_writer_init(chunk_writer_t * writer, httpd_req_t * req, char * buf, size_t size);
+
+void chunk_writer_write(chunk_writer_t * writer, const char * data, size_t len);
+void chunk_writer_write_str(chunk_writer_t * writer, const char * str);
+
+/**
+ * @brief Send what is buffered and end the chunked response
+ */
+esp_err_t chunk_writer_finish(chunk_writer_t * writer);
+
+#endif // CHUNK_WRITER_H
@@ -2,12 +2,21 @@
 #include "http_server.h"
 #include "recovery_page.h"
 #include "theme_api.h"  // Add theme API include
+#include "ws_api.h"
 #include "dataBase.h"  // Add database API include
+#include "json_stream.h"
+#include "msgpack.h"
+#include "openmetrics.h"
+#include "static_assets.h"
+#include "ota_stream.h"
+#include "http_workers.h"
 #include "cJSON.h"
 #include "esp_chip_info.h"
+#include "esp_heap_caps.h"
 #include "esp_http_server.h"
 #include "esp_log.h"
 #include "esp_random.h"
+#include "esp_rom_crc.h"
 #include "esp_spiffs.h"
 #include "esp_timer.h"
 #include "esp_wifi.h"
@@ -19,9 +28,15 @@
 #include "nvs_config.h"
 #include "vcore.h"
 #include "power_management_task.h"  // Add this for preset support
+#include "telemetry_task.h"
+#include "fleet_ota_task.h"
+#include "fleet_status_task.h"
+#include "system.h"
+#include <ctype.h>
 #include <fcntl.h>
 #include <string.h>
 #include <sys/param.h>
+#include <unistd.h>
 
 #include "dns_server.h"
 #include "esp_mac.h"
@@ -46,9 +61,6 @@ static const char * CORS_TAG = "CORS";
 
 static GlobalState * GLOBAL_STATE;
 static httpd_handle_t server = NULL;
-QueueHandle_t log_queue = NULL;
-
-static int fd = -1;
 
 #define REST_CHECK(a, str, goto_tag, ...)                                                                                          \
     do {                                                                                                                           \
@@ -60,18 +72,26 @@ static int fd = -1;
 
 #define FILE_PATH_MAX (ESP_VFS_PATH_MAX + 128)
 #define SCRATCH_BUFSIZE (10240)
-#define MESSAGE_QUEUE_SIZE (128)
 
 #define MAX_HTTP_REQUEST_SIZE 4096  // Maximum HTTP request body size
 #define MAX_JSON_RESPONSE_SIZE 4096  // Maximum JSON response size
 #define MAX_NVS_STRING_SIZE 128      // Maximum NVS string length
-#define MAX_OTA_BUFFER_SIZE 1000     // Maximum OTA buffer size
 
 // Pre-allocated buffers for HTTP request handling
 static char http_request_buffer[MAX_HTTP_REQUEST_SIZE];
 static char json_response_buffer[MAX_JSON_RESPONSE_SIZE];
-static char nvs_string_buffer[MAX_NVS_STRING_SIZE];
-static char ota_buffer[MAX_OTA_BUFFER_SIZE];  // Dedicated buffer for OTA operations
+
+// Handlers that may run on an HTTP worker take its buffer, the shared ones are only
+// used from the httpd task. size holds the size of shared and is updated.
+static char * handler_buffer(char * shared, size_t * size)
+{
+    char * buffer = http_workers_buffer();
+    if (buffer == NULL) {
+        return shared;
+    }
+    *size = HTTP_WORKER_BUFSIZE;
+    return buffer;
+}
 
 static esp_err_t GET_wifi_scan(httpd_req_t *req)
 {
@@ -180,7 +200,7 @@ static uint32_t extract_origin_ip_addr(httpd_req_t *req)
     return origin_ip_addr;
 }
 
-static esp_err_t is_network_allowed(httpd_req_t * req)
+esp_err_t is_network_allowed(httpd_req_t * req)
 {
     if (GLOBAL_STATE->SYSTEM_MODULE.ap_enabled == true) {
         ESP_LOGI(CORS_TAG, "Device in AP mode. Allowing CORS.");
@@ -288,7 +308,7 @@ static esp_err_t set_cors_headers(httpd_req_t * req)
         return ESP_FAIL;
     }
 
-    err = httpd_resp_set_hdr(req, "Access-Control-Allow-Headers", "Content-Type");
+    err = httpd_resp_set_hdr(req, "Access-Control-Allow-Headers", "Content-Type, Content-Range, X-OTA-SHA256");
     if (err != ESP_OK) {
         return ESP_FAIL;
     }
@@ -310,20 +330,24 @@ static esp_err_t rest_recovery_handler(httpd_req_t * req)
 /* Send HTTP response with the contents of the requested file */
 static esp_err_t rest_common_get_handler(httpd_req_t * req)
 {
+    if (http_workers_defer(req, rest_common_get_handler)) {
+        return ESP_OK;
+    }
+
     char filepath[FILE_PATH_MAX];
     uint8_t filePathLength = sizeof(filepath);
 
     rest_server_context_t * rest_context = (rest_server_context_t *) req->user_ctx;
-    strlcpy(filepath, rest_context->base_path, filePathLength);
     if (req->uri[strlen(req->uri) - 1] == '/') {
-        strlcat(filepath, "/index.html", filePathLength);
+        strlcpy(filepath, "/index.html", filePathLength);
     } else {
-        strlcat(filepath, req->uri, filePathLength);
+        strlcpy(filepath, req->uri, filePathLength);
     }
     set_content_type_from_file(req, filepath);
-    strcat(filepath, ".gz");
-    int fd = open(filepath, O_RDONLY, 0);
-    if (fd == -1) {
+
+    size_t scratch_size = SCRATCH_BUFSIZE;
+    char * scratch = handler_buffer(rest_context->scratch, &scratch_size);
+    if (static_assets_send(req, filepath, scratch, scratch_size) == ESP_ERR_NOT_FOUND) {
         // Set status
         httpd_resp_set_status(req, "302 Temporary Redirect");
         // Redirect to the "/" root directory
@@ -332,40 +356,7 @@ static esp_err_t rest_common_get_handler(httpd_req_t * req)
         httpd_resp_send(req, "Redirect to the captive portal", HTTPD_RESP_USE_STRLEN);
 
         ESP_LOGI(TAG, "Redirecting to root");
-        return ESP_OK;
     }
-
-    if (req->uri[strlen(req->uri) - 1] != '/') {
-        httpd_resp_set_hdr(req, "Cache-Control", "max-age=2592000");
-    }
-
-    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
-
-    char * chunk = rest_context->scratch;
-    ssize_t read_bytes;
-    do {
-        /* Read file in chunks into the scratch buffer */
-        read_bytes = read(fd, chunk, SCRATCH_BUFSIZE);
-        if (read_bytes == -1) {
-            ESP_LOGE(TAG, "Failed to read file : %s", filepath);
-        } else if (read_bytes > 0) {
-            /* Send the buffer contents as HTTP response chunk */
-            if (httpd_resp_send_chunk(req, chunk, read_bytes) != ESP_OK) {
-                close(fd);
-                ESP_LOGE(TAG, "File sending failed!");
-                /* Abort sending file */
-                httpd_resp_sendstr_chunk(req, NULL);
-                /* Respond with 500 Internal Server Error */
-                httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to send file");
-                return ESP_OK;
-            }
-        }
-    } while (read_bytes > 0);
-    /* Close file after sending complete */
-    close(fd);
-    ESP_LOGI(TAG, "File sending complete");
-    /* Respond with an empty chunk to signal HTTP response completion */
-    httpd_resp_send_chunk(req, NULL, 0);
     return ESP_OK;
 }
 
@@ -387,6 +378,104 @@ static esp_err_t handle_options_request(httpd_req_t * req)
     return ESP_OK;
 }
 
+typedef enum {
+    SETTING_STRING,
+    SETTING_NUMBER,
+} setting_type_t;
+
+// A field PATCH /api/system accepts. Strings are min..max characters long, numbers are
+// integers from min to max and booleans count as 0 and 1. Live settings are picked up by
+// the task using them as soon as they are written, the others are read at boot.
+// A zero_keeps field given as 0 is ignored and keeps its current value, as older UIs send 0 for unset.
+typedef struct {
+    const char * name;
+    const char * key;
+    setting_type_t type;
+    uint16_t min;
+    uint16_t max;
+    bool secret;
+    bool live;
+    bool zero_keeps;
+} setting_t;
+
+static const setting_t settings_schema[] = {
+    {"stratumURL", NVS_CONFIG_STRATUM_URL, SETTING_STRING, 1, MAX_NVS_STRING_SIZE - 1, false, true},
+    {"fallbackStratumURL", NVS_CONFIG_FALLBACK_STRATUM_URL, SETTING_STRING, 0, MAX_NVS_STRING_SIZE - 1, false, true},
+    {"stratumUser", NVS_CONFIG_STRATUM_USER, SETTING_STRING, 0, MAX_NVS_STRING_SIZE - 1, false, true},
+    {"stratumPassword", NVS_CONFIG_STRATUM_PASS, SETTING_STRING, 0, MAX_NVS_STRING_SIZE - 1, true, true},
+    {"fallbackStratumUser", NVS_CONFIG_FALLBACK_STRATUM_USER, SETTING_STRING, 0, MAX_NVS_STRING_SIZE - 1, false, true},
+    {"fallbackStratumPassword", NVS_CONFIG_FALLBACK_STRATUM_PASS, SETTING_STRING, 0, MAX_NVS_STRING_SIZE - 1, true, true},
+    {"stratumPort", NVS_CONFIG_STRATUM_PORT, SETTING_NUMBER, 1, UINT16_MAX, false, true},
+    {"fallbackStratumPort", NVS_CONFIG_FALLBACK_STRATUM_PORT, SETTING_NUMBER, 0, UINT16_MAX, false, true},
+    {"ssid", NVS_CONFIG_WIFI_SSID, SETTING_STRING, 1, 32, false, false},
+    {"wifiPass", NVS_CONFIG_WIFI_PASS, SETTING_STRING, 0, 63, true, false},
+    {"hostname", NVS_CONFIG_HOSTNAME, SETTING_STRING, 1, 32, false, false},
+    {"coreVoltage", NVS_CONFIG_ASIC_VOLTAGE, SETTING_NUMBER, 800, 1500, false, true, true},
+    {"frequency", NVS_CONFIG_ASIC_FREQ, SETTING_NUMBER, 200, 1000, false, true, true},
+    {"flipscreen", NVS_CONFIG_FLIP_SCREEN, SETTING_NUMBER, 0, 1, false, false},
+    {"overheat_mode", NVS_CONFIG_OVERHEAT_MODE, SETTING_NUMBER, 0, 1, false, true},
+    {"invertscreen", NVS_CONFIG_INVERT_SCREEN, SETTING_NUMBER, 0, 1, false, false},
+    {"invertfanpolarity", NVS_CONFIG_INVERT_FAN_POLARITY, SETTING_NUMBER, 0, 1, false, false},
+    {"autofanspeed", NVS_CONFIG_AUTO_FAN_SPEED, SETTING_NUMBER, 0, 1, false, true},
+    {"fanspeed", NVS_CONFIG_FAN_SPEED, SETTING_NUMBER, 0, 100, false, true},
+    {"autotune", NVS_CONFIG_AUTOTUNE_FLAG, SETTING_NUMBER, 0, 1, false, true},
+    {"powerCap", NVS_CONFIG_POWER_CAP, SETTING_NUMBER, 0, UINT16_MAX, false, true},
+    {"fleetOta", NVS_CONFIG_FLEET_OTA, SETTING_NUMBER, 0, 1, false, false},
+    {"fleetStatus", NVS_CONFIG_FLEET_STATUS, SETTING_NUMBER, 0, 1, false, false},
+};
+
+_Static_assert(sizeof(settings_schema) / sizeof(settings_schema[0]) <= 32, "settings are tracked in a 32 bit mask");
+
+static const setting_t * find_setting(const char * name)
+{
+    for (size_t i = 0; i < sizeof(settings_schema) / sizeof(settings_schema[0]); i++) {
+        if (strcmp(settings_schema[i].name, name) == 0) {
+            return &settings_schema[i];
+        }
+    }
+    return NULL;
+}
+
+// Fill value from item, NULL when it is valid, otherwise why not
+static const char * validate_setting(const setting_t * setting, const cJSON * item, nvs_config_value_t * value)
+{
+    value->key = setting->key;
+
+    if (setting->type == SETTING_STRING) {
+        if (!cJSON_IsString(item)) {
+            return "must be a string";
+        }
+        size_t len = strlen(item->valuestring);
+        if (len < setting->min) {
+            return "must not be empty";
+        }
+        if (len > setting->max) {
+            return "too long";
+        }
+        value->type = NVS_TYPE_STR;
+        value->str = item->valuestring;
+        return NULL;
+    }
+
+    double number;
+    if (cJSON_IsBool(item)) {
+        number = cJSON_IsTrue(item) ? 1 : 0;
+    } else if (cJSON_IsNumber(item)) {
+        number = item->valuedouble;
+    } else {
+        return "must be a number";
+    }
+    if (number < setting->min || number > setting->max) {
+        return "out of range";
+    }
+    if (number != (double) (uint16_t) number) {
+        return "must be an integer";
+    }
+    value->type = NVS_TYPE_U16;
+    value->u64 = (uint16_t) number;
+    return NULL;
+}
+
 static esp_err_t PATCH_update_settings(httpd_req_t * req)
 {
 
@@ -426,177 +515,136 @@ static esp_err_t PATCH_update_settings(httpd_req_t * req)
     http_request_buffer[total_len] = '\0';
 
     cJSON * root = cJSON_Parse(http_request_buffer);
-    cJSON * item;
-    if (root == NULL) {
+    if (root == NULL || !cJSON_IsObject(root)) {
+        cJSON_Delete(root);
         httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
         return ESP_OK;
     }
 
-    if ((item = cJSON_GetObjectItem(root, "stratumURL")) != NULL) {
-        nvs_config_set_string(NVS_CONFIG_STRATUM_URL, item->valuestring);
-    }
-    if ((item = cJSON_GetObjectItem(root, "fallbackStratumURL")) != NULL) {
-        nvs_config_set_string(NVS_CONFIG_FALLBACK_STRATUM_URL, item->valuestring);
-    }
-    if ((item = cJSON_GetObjectItem(root, "stratumUser")) != NULL) {
-        nvs_config_set_string(NVS_CONFIG_STRATUM_USER, item->valuestring);
-    }
-    if ((item = cJSON_GetObjectItem(root, "stratumPassword")) != NULL) {
-        nvs_config_set_string(NVS_CONFIG_STRATUM_PASS, item->valuestring);
-    }
-    if ((item = cJSON_GetObjectItem(root, "fallbackStratumUser")) != NULL) {
-        nvs_config_set_string(NVS_CONFIG_FALLBACK_STRATUM_USER, item->valuestring);
-    }
-    if ((item = cJSON_GetObjectItem(root, "fallbackStratumPassword")) != NULL) {
-        nvs_config_set_string(NVS_CONFIG_FALLBACK_STRATUM_PASS, item->valuestring);
-    }
-    if ((item = cJSON_GetObjectItem(root, "stratumPort")) != NULL) {
-        nvs_config_set_u16(NVS_CONFIG_STRATUM_PORT, item->valueint);
-    }
-    if ((item = cJSON_GetObjectItem(root, "fallbackStratumPort")) != NULL) {
-        nvs_config_set_u16(NVS_CONFIG_FALLBACK_STRATUM_PORT, item->valueint);
-    }
-    if ((item = cJSON_GetObjectItem(root, "ssid")) != NULL) {
-        nvs_config_set_string(NVS_CONFIG_WIFI_SSID, item->valuestring);
-    }
-    if ((item = cJSON_GetObjectItem(root, "wifiPass")) != NULL) {
-        nvs_config_set_string(NVS_CONFIG_WIFI_PASS, item->valuestring);
-    }
-    if ((item = cJSON_GetObjectItem(root, "hostname")) != NULL) {
-        nvs_config_set_string(NVS_CONFIG_HOSTNAME, item->valuestring);
-    }
-    if ((item = cJSON_GetObjectItem(root, "coreVoltage")) != NULL && item->valueint > 0) {
-        nvs_config_set_u16(NVS_CONFIG_ASIC_VOLTAGE, item->valueint);
-    }
-    if ((item = cJSON_GetObjectItem(root, "frequency")) != NULL && item->valueint > 0) {
-        nvs_config_set_u16(NVS_CONFIG_ASIC_FREQ, item->valueint);
-    }
-    if ((item = cJSON_GetObjectItem(root, "flipscreen")) != NULL) {
-        nvs_config_set_u16(NVS_CONFIG_FLIP_SCREEN, item->valueint);
-    }
-    if ((item = cJSON_GetObjectItem(root, "overheat_mode")) != NULL) {
-        nvs_config_set_u16(NVS_CONFIG_OVERHEAT_MODE, item->valueint);
-    }
-    if ((item = cJSON_GetObjectItem(root, "invertscreen")) != NULL) {
-        nvs_config_set_u16(NVS_CONFIG_INVERT_SCREEN, item->valueint);
-    }
-    if ((item = cJSON_GetObjectItem(root, "invertfanpolarity")) != NULL) {
-        nvs_config_set_u16(NVS_CONFIG_INVERT_FAN_POLARITY, item->valueint);
-    }
-    if ((item = cJSON_GetObjectItem(root, "autofanspeed")) != NULL) {
-        nvs_config_set_u16(NVS_CONFIG_AUTO_FAN_SPEED, item->valueint);
-    }
-    if ((item = cJSON_GetObjectItem(root, "fanspeed")) != NULL) {
-        nvs_config_set_u16(NVS_CONFIG_FAN_SPEED, item->valueint);
-    }
-    if ((item = cJSON_GetObjectItem(root, "autotune")) != NULL) {
-        nvs_config_set_u16(NVS_CONFIG_AUTOTUNE_FLAG, item->valueint);
-    }
-    // Apply preset immediately if "presetName" field is present
-    if ((item = cJSON_GetObjectItem(root, "presetName")) != NULL && item->valuestring != NULL) {
-        if (apply_preset(GLOBAL_STATE->device_model, item->valuestring)) {
-            ESP_LOGI(TAG, "Preset '%s' applied successfully", item->valuestring);
-            lvglSendPresetBAP();
+    // Check the whole payload first, nothing is written unless every field is valid
+    nvs_config_value_t values[sizeof(settings_schema) / sizeof(settings_schema[0])];
+    size_t value_count = 0;
+    uint32_t seen = 0;
+    bool restart_required = false;
+    cJSON * errors = cJSON_CreateObject();
+    cJSON * ignored = cJSON_CreateArray();
+    cJSON * applied_live = cJSON_CreateArray();
+    cJSON * updated_settings = cJSON_CreateObject();
+    cJSON * item;
+
+    cJSON_ArrayForEach(item, root) {
+        if (strcmp(item->string, "presetName") == 0) {
+            if (!cJSON_IsString(item)) {
+                cJSON_AddStringToObject(errors, item->string, "must be a string");
+            }
+            continue;
+        }
+
+        const setting_t * setting = find_setting(item->string);
+        if (setting == NULL) {
+            cJSON_AddItemToArray(ignored, cJSON_CreateString(item->string));
+            continue;
+        }
+
+        uint32_t bit = 1u << (setting - settings_schema);
+        if (seen & bit) {
+            cJSON_AddStringToObject(errors, item->string, "given more than once");
+            continue;
+        }
+        seen |= bit;
+
+        if (setting->zero_keeps && cJSON_IsNumber(item) && item->valuedouble == 0) {
+            cJSON_AddItemToArray(ignored, cJSON_CreateString(item->string));
+            continue;
+        }
+
+        nvs_config_value_t * value = &values[value_count];
+        const char * error = validate_setting(setting, item, value);
+        if (error) {
+            cJSON_AddStringToObject(errors, item->string, error);
+            continue;
+        }
+        value_count++;
+
+        if (setting->type == SETTING_STRING) {
+            cJSON_AddStringToObject(updated_settings, setting->name, setting->secret ? "***" : value->str); // Don't expose passwords
+        } else {
+            cJSON_AddNumberToObject(updated_settings, setting->name, value->u64);
+        }
+        if (setting->live) {
+            cJSON_AddItemToArray(applied_live, cJSON_CreateString(setting->name));
         } else {
-            ESP_LOGE(TAG, "Failed to apply preset '%s'", item->valuestring);
+            restart_required = true;
         }
     }
 
-    // Create response JSON with updated settings
     httpd_resp_set_type(req, "application/json");
-    
-    cJSON *response = cJSON_CreateObject();
-    cJSON *updated_settings = cJSON_CreateObject();
-    
-    // Add each setting that was updated to the response
-    if ((item = cJSON_GetObjectItem(root, "stratumURL")) != NULL) {
-        cJSON_AddStringToObject(updated_settings, "stratumURL", item->valuestring);
-    }
-    if ((item = cJSON_GetObjectItem(root, "fallbackStratumURL")) != NULL) {
-        cJSON_AddStringToObject(updated_settings, "fallbackStratumURL", item->valuestring);
-    }
-    if ((item = cJSON_GetObjectItem(root, "stratumUser")) != NULL) {
-        cJSON_AddStringToObject(updated_settings, "stratumUser", item->valuestring);
-    }
-    if ((item = cJSON_GetObjectItem(root, "stratumPassword")) != NULL) {
-        cJSON_AddStringToObject(updated_settings, "stratumPassword", "***"); // Don't expose password
-    }
-    if ((item = cJSON_GetObjectItem(root, "fallbackStratumUser")) != NULL) {
-        cJSON_AddStringToObject(updated_settings, "fallbackStratumUser", item->valuestring);
-    }
-    if ((item = cJSON_GetObjectItem(root, "fallbackStratumPassword")) != NULL) {
-        cJSON_AddStringToObject(updated_settings, "fallbackStratumPassword", "***"); // Don't expose password
-    }
-    if ((item = cJSON_GetObjectItem(root, "stratumPort")) != NULL) {
-        cJSON_AddNumberToObject(updated_settings, "stratumPort", item->valueint);
-    }
-    if ((item = cJSON_GetObjectItem(root, "fallbackStratumPort")) != NULL) {
-        cJSON_AddNumberToObject(updated_settings, "fallbackStratumPort", item->valueint);
-    }
-    if ((item = cJSON_GetObjectItem(root, "ssid")) != NULL) {
-        cJSON_AddStringToObject(updated_settings, "ssid", item->valuestring);
-    }
-    if ((item = cJSON_GetObjectItem(root, "wifiPass")) != NULL) {
-        cJSON_AddStringToObject(updated_settings, "wifiPass", "***"); // Don't expose password
-    }
-    if ((item = cJSON_GetObjectItem(root, "hostname")) != NULL) {
-        cJSON_AddStringToObject(updated_settings, "hostname", item->valuestring);
-    }
-    if ((item = cJSON_GetObjectItem(root, "coreVoltage")) != NULL && item->valueint > 0) {
-        cJSON_AddNumberToObject(updated_settings, "coreVoltage", item->valueint);
-    }
-    if ((item = cJSON_GetObjectItem(root, "frequency")) != NULL && item->valueint > 0) {
-        cJSON_AddNumberToObject(updated_settings, "frequency", item->valueint);
-    }
-    if ((item = cJSON_GetObjectItem(root, "flipscreen")) != NULL) {
-        cJSON_AddNumberToObject(updated_settings, "flipscreen", item->valueint);
-    }
-    if ((item = cJSON_GetObjectItem(root, "overheat_mode")) != NULL) {
-        cJSON_AddNumberToObject(updated_settings, "overheat_mode", item->valueint);
-    }
-    if ((item = cJSON_GetObjectItem(root, "invertscreen")) != NULL) {
-        cJSON_AddNumberToObject(updated_settings, "invertscreen", item->valueint);
-    }
-    if ((item = cJSON_GetObjectItem(root, "invertfanpolarity")) != NULL) {
-        cJSON_AddNumberToObject(updated_settings, "invertfanpolarity", item->valueint);
-    }
-    if ((item = cJSON_GetObjectItem(root, "autofanspeed")) != NULL) {
-        cJSON_AddNumberToObject(updated_settings, "autofanspeed", item->valueint);
-    }
-    if ((item = cJSON_GetObjectItem(root, "fanspeed")) != NULL) {
-        cJSON_AddNumberToObject(updated_settings, "fanspeed", item->valueint);
-    }
-    if ((item = cJSON_GetObjectItem(root, "autotune")) != NULL) {
-        cJSON_AddNumberToObject(updated_settings, "autotune", item->valueint);
-    }
-    if ((item = cJSON_GetObjectItem(root, "autotunePreset")) != NULL) {
-        cJSON_AddStringToObject(updated_settings, "autotunePreset", item->valuestring);
-    }
-    if ((item = cJSON_GetObjectItem(root, "presetName")) != NULL && item->valuestring != NULL) {
-        cJSON_AddStringToObject(updated_settings, "presetName", item->valuestring);
-        cJSON_AddBoolToObject(updated_settings, "presetApplied", apply_preset(GLOBAL_STATE->device_model, item->valuestring));
+    cJSON * response = cJSON_CreateObject();
+    bool updated = cJSON_GetArraySize(errors) == 0;
+
+    if (!updated) {
+        cJSON_AddStringToObject(response, "status", "error");
+        cJSON_AddStringToObject(response, "message", "Invalid settings, nothing was changed");
+        cJSON_AddItemToObject(response, "errors", errors);
+        cJSON_Delete(ignored);
+        cJSON_Delete(applied_live);
+        cJSON_Delete(updated_settings);
+        httpd_resp_set_status(req, "400 Bad Request");
+    } else {
+        cJSON_Delete(errors);
+        // Subscribers see the new values once the batch is committed, the power task
+        // retunes the ASIC and the fan and the stratum task reconnects to the new pool
+        esp_err_t err = nvs_config_set_batch(values, value_count);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Could not save settings: %s", esp_err_to_name(err));
+            cJSON_Delete(ignored);
+            cJSON_Delete(applied_live);
+            cJSON_Delete(updated_settings);
+            cJSON_Delete(response);
+            cJSON_Delete(root);
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could not save settings, nothing was changed");
+            return ESP_OK;
+        }
+
+        // Apply preset once the settings it may override are saved
+        if ((item = cJSON_GetObjectItem(root, "presetName")) != NULL) {
+            bool applied = apply_preset(GLOBAL_STATE->device_model, item->valuestring);
+            if (applied) {
+                ESP_LOGI(TAG, "Preset '%s' applied successfully", item->valuestring);
+                lvglSendPresetBAP();
+            } else {
+                ESP_LOGE(TAG, "Failed to apply preset '%s'", item->valuestring);
+            }
+            cJSON_AddStringToObject(updated_settings, "presetName", item->valuestring);
+            cJSON_AddBoolToObject(updated_settings, "presetApplied", applied);
+        }
+
+        cJSON_AddStringToObject(response, "status", "success");
+        cJSON_AddStringToObject(response, "message", "Settings updated successfully");
+        cJSON_AddItemToObject(response, "updatedSettings", updated_settings);
+        cJSON_AddItemToObject(response, "appliedLive", applied_live);
+        cJSON_AddBoolToObject(response, "restartRequired", restart_required);
+        cJSON_AddItemToObject(response, "ignored", ignored);
     }
-    
-    // Add metadata to response
-    cJSON_AddStringToObject(response, "status", "success");
-    cJSON_AddStringToObject(response, "message", "Settings updated successfully");
-    cJSON_AddItemToObject(response, "updatedSettings", updated_settings);
+
     time_t now;
     time(&now);
     cJSON_AddNumberToObject(response, "timestamp", now);
-    
+
     // Send response
     const char *response_str = cJSON_Print(response);
     httpd_resp_sendstr(req, response_str);
 
     // Log the event
-    dataBase_log_event("settings", "info", "Settings updated via WebUI", response_str);
-    
+    if (updated) {
+        dataBase_log_event("settings", "info", "Settings updated via WebUI", response_str);
+    }
+
     // Cleanup
     free((char *)response_str);
     cJSON_Delete(response);
     cJSON_Delete(root);
-    
+
     return ESP_OK;
 }
 
@@ -641,6 +689,9 @@ static esp_err_t POST_restart(httpd_req_t * req)
     // Delay to ensure the response is sent
     vTaskDelay(1000 / portTICK_PERIOD_MS);
 
+    // Make sure the restart event is written before the queued logs are lost
+    dataBase_flush_logs(2000);
+
     // Restart the system
     esp_restart();
 
@@ -648,16 +699,80 @@ static esp_err_t POST_restart(httpd_req_t * req)
     return ESP_OK;
 }
 
-/* Simple handler for getting system handler */
-// Pre-allocated buffers for NVS strings to avoid dynamic allocation
-static char ssid_buffer[MAX_NVS_STRING_SIZE];
-static char hostname_buffer[MAX_NVS_STRING_SIZE];
-static char stratum_url_buffer[MAX_NVS_STRING_SIZE];
-static char fallback_stratum_url_buffer[MAX_NVS_STRING_SIZE];
-static char stratum_user_buffer[MAX_NVS_STRING_SIZE];
-static char fallback_stratum_user_buffer[MAX_NVS_STRING_SIZE];
-static char board_version_buffer[MAX_NVS_STRING_SIZE];
+/* Settings reported by /api/system/info. They only change through nvs_config_set_*,
+ * so they are re-read from NVS when the config generation moves, not on every poll */
+typedef struct {
+    uint32_t generation;
+    char ssid[MAX_NVS_STRING_SIZE];
+    char hostname[MAX_NVS_STRING_SIZE];
+    char stratum_url[MAX_NVS_STRING_SIZE];
+    char fallback_stratum_url[MAX_NVS_STRING_SIZE];
+    char stratum_user[MAX_NVS_STRING_SIZE];
+    char fallback_stratum_user[MAX_NVS_STRING_SIZE];
+    char board_version[MAX_NVS_STRING_SIZE];
+    char autotune_preset[MAX_NVS_STRING_SIZE];
+    char serial_number[MAX_NVS_STRING_SIZE];
+    uint16_t core_voltage;
+    uint16_t frequency;
+    uint16_t stratum_port;
+    uint16_t fallback_stratum_port;
+    uint16_t flip_screen;
+    uint16_t overheat_mode;
+    uint16_t invert_screen;
+    uint16_t invert_fan_polarity;
+    uint16_t auto_fan_speed;
+    uint16_t autotune;
+    uint16_t power_cap;
+    uint16_t fleet_ota;
+    uint16_t fleet_status;
+} system_info_config_t;
+
+static system_info_config_t info_config;
+
+static void copy_nvs_string(const char * key, const char * default_value, char * dest)
+{
+    char * value = nvs_config_get_string(key, default_value);
+    strncpy(dest, value, MAX_NVS_STRING_SIZE - 1);
+    dest[MAX_NVS_STRING_SIZE - 1] = '\0';
+    free(value);
+}
+
+static const system_info_config_t * get_info_config(void)
+{
+    uint32_t generation = nvs_config_get_generation();
+    if (info_config.generation == generation) {
+        return &info_config;
+    }
+
+    copy_nvs_string(NVS_CONFIG_WIFI_SSID, CONFIG_ESP_WIFI_SSID, info_config.ssid);
+    copy_nvs_string(NVS_CONFIG_HOSTNAME, CONFIG_LWIP_LOCAL_HOSTNAME, info_config.hostname);
+    copy_nvs_string(NVS_CONFIG_STRATUM_URL, CONFIG_STRATUM_URL, info_config.stratum_url);
+    copy_nvs_string(NVS_CONFIG_FALLBACK_STRATUM_URL, CONFIG_FALLBACK_STRATUM_URL, info_config.fallback_stratum_url);
+    copy_nvs_string(NVS_CONFIG_STRATUM_USER, CONFIG_STRATUM_USER, info_config.stratum_user);
+    copy_nvs_string(NVS_CONFIG_FALLBACK_STRATUM_USER, CONFIG_FALLBACK_STRATUM_USER, info_config.fallback_stratum_user);
+    copy_nvs_string(NVS_CONFIG_BOARD_VERSION, "unknown", info_config.board_version);
+    copy_nvs_string(NVS_CONFIG_AUTOTUNE_PRESET, "", info_config.autotune_preset);
+    copy_nvs_string(NVS_CONFIG_SERIAL_NUMBER, "", info_config.serial_number);
+    info_config.core_voltage = nvs_config_get_u16(NVS_CONFIG_ASIC_VOLTAGE, CONFIG_ASIC_VOLTAGE);
+    info_config.frequency = nvs_config_get_u16(NVS_CONFIG_ASIC_FREQ, CONFIG_ASIC_FREQUENCY);
+    info_config.stratum_port = nvs_config_get_u16(NVS_CONFIG_STRATUM_PORT, CONFIG_STRATUM_PORT);
+    info_config.fallback_stratum_port = nvs_config_get_u16(NVS_CONFIG_FALLBACK_STRATUM_PORT, CONFIG_FALLBACK_STRATUM_PORT);
+    info_config.flip_screen = nvs_config_get_u16(NVS_CONFIG_FLIP_SCREEN, 1);
+    info_config.overheat_mode = nvs_config_get_u16(NVS_CONFIG_OVERHEAT_MODE, 0);
+    info_config.invert_screen = nvs_config_get_u16(NVS_CONFIG_INVERT_SCREEN, 0);
+    info_config.invert_fan_polarity = nvs_config_get_u16(NVS_CONFIG_INVERT_FAN_POLARITY, 1);
+    info_config.auto_fan_speed = nvs_config_get_u16(NVS_CONFIG_AUTO_FAN_SPEED, 1);
+    info_config.autotune = nvs_config_get_u16(NVS_CONFIG_AUTOTUNE_FLAG, 1);
+    info_config.power_cap = nvs_config_get_u16(NVS_CONFIG_POWER_CAP, 0);
+    info_config.fleet_ota = nvs_config_get_u16(NVS_CONFIG_FLEET_OTA, 0);
+    info_config.fleet_status = nvs_config_get_u16(NVS_CONFIG_FLEET_STATUS, 0);
+
+    // A write that landed while reading leaves the old generation, so the next poll reads again
+    info_config.generation = generation;
+    return &info_config;
+}
 
+/* Simple handler for getting system handler */
 static esp_err_t GET_system_info(httpd_req_t * req)
 {
     if (is_network_allowed(req) != ESP_OK) {
@@ -672,77 +787,52 @@ static esp_err_t GET_system_info(httpd_req_t * req)
         return ESP_OK;
     }
 
-    // Use safe string copying to pre-allocated buffers
-    const char* ssid_temp = nvs_config_get_string(NVS_CONFIG_WIFI_SSID, CONFIG_ESP_WIFI_SSID);
-    strncpy(ssid_buffer, ssid_temp, MAX_NVS_STRING_SIZE - 1);
-    ssid_buffer[MAX_NVS_STRING_SIZE - 1] = '\0';
-    free((char*)ssid_temp);
-
-    const char* hostname_temp = nvs_config_get_string(NVS_CONFIG_HOSTNAME, CONFIG_LWIP_LOCAL_HOSTNAME);
-    strncpy(hostname_buffer, hostname_temp, MAX_NVS_STRING_SIZE - 1);
-    hostname_buffer[MAX_NVS_STRING_SIZE - 1] = '\0';
-    free((char*)hostname_temp);
-
-    const char* stratum_url_temp = nvs_config_get_string(NVS_CONFIG_STRATUM_URL, CONFIG_STRATUM_URL);
-    strncpy(stratum_url_buffer, stratum_url_temp, MAX_NVS_STRING_SIZE - 1);
-    stratum_url_buffer[MAX_NVS_STRING_SIZE - 1] = '\0';
-    free((char*)stratum_url_temp);
-
-    const char* fallback_stratum_url_temp = nvs_config_get_string(NVS_CONFIG_FALLBACK_STRATUM_URL, CONFIG_FALLBACK_STRATUM_URL);
-    strncpy(fallback_stratum_url_buffer, fallback_stratum_url_temp, MAX_NVS_STRING_SIZE - 1);
-    fallback_stratum_url_buffer[MAX_NVS_STRING_SIZE - 1] = '\0';
-    free((char*)fallback_stratum_url_temp);
-
-    const char* stratum_user_temp = nvs_config_get_string(NVS_CONFIG_STRATUM_USER, CONFIG_STRATUM_USER);
-    strncpy(stratum_user_buffer, stratum_user_temp, MAX_NVS_STRING_SIZE - 1);
-    stratum_user_buffer[MAX_NVS_STRING_SIZE - 1] = '\0';
-    free((char*)stratum_user_temp);
-
-    const char* fallback_stratum_user_temp = nvs_config_get_string(NVS_CONFIG_FALLBACK_STRATUM_USER, CONFIG_FALLBACK_STRATUM_USER);
-    strncpy(fallback_stratum_user_buffer, fallback_stratum_user_temp, MAX_NVS_STRING_SIZE - 1);
-    fallback_stratum_user_buffer[MAX_NVS_STRING_SIZE - 1] = '\0';
-    free((char*)fallback_stratum_user_temp);
-
-    const char* board_version_temp = nvs_config_get_string(NVS_CONFIG_BOARD_VERSION, "unknown");
-    strncpy(board_version_buffer, board_version_temp, MAX_NVS_STRING_SIZE - 1);
-    board_version_buffer[MAX_NVS_STRING_SIZE - 1] = '\0';
-    free((char*)board_version_temp);
+    const system_info_config_t * config = get_info_config();
 
     uint8_t mac[6];
     char formattedMac[18];
     esp_wifi_get_mac(WIFI_IF_STA, mac);
     snprintf(formattedMac, 18, "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
 
-        cJSON * root = cJSON_CreateObject();
-    cJSON_AddNumberToObject(root, "power", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.power);
-    cJSON_AddNumberToObject(root, "voltage", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.voltage);
-    cJSON_AddNumberToObject(root, "current", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.current);
-    cJSON_AddNumberToObject(root, "temp", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.chip_temp_avg);
-    cJSON_AddNumberToObject(root, "vrTemp", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.vr_temp);
-    cJSON_AddNumberToObject(root, "hashRate", GLOBAL_STATE->SYSTEM_MODULE.current_hashrate);
+    json_stream_t json;
+    json_stream_init(&json, req, json_response_buffer, sizeof(json_response_buffer));
+    json_stream_begin_object(&json, NULL);
+    json_stream_add_number(&json, "power", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.power);
+    json_stream_add_number(&json, "voltage", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.voltage);
+    json_stream_add_number(&json, "current", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.current);
+    json_stream_add_number(&json, "temp", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.chip_temp_avg);
+    json_stream_add_number(&json, "vrTemp", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.vr_temp);
+    json_stream_add_number(&json, "hashRate", GLOBAL_STATE->SYSTEM_MODULE.current_hashrate);
     
     // Calculate expected hashrate based on current frequency, small core count, and ASIC count
-    float expectedHashrate = nvs_config_get_u16(NVS_CONFIG_ASIC_FREQ, CONFIG_ASIC_FREQUENCY) * ((GLOBAL_STATE->small_core_count * GLOBAL_STATE->asic_count) / 1000.0);
-    cJSON_AddNumberToObject(root, "expectedHashrate", expectedHashrate);
+    float expectedHashrate = config->frequency * ((GLOBAL_STATE->small_core_count * GLOBAL_STATE->asic_count) / 1000.0);
+    json_stream_add_number(&json, "expectedHashrate", expectedHashrate);
     
-    cJSON_AddStringToObject(root, "bestDiff", GLOBAL_STATE->SYSTEM_MODULE.best_diff_string);
-    cJSON_AddStringToObject(root, "bestSessionDiff", GLOBAL_STATE->SYSTEM_MODULE.best_session_diff_string);
-    cJSON_AddNumberToObject(root, "stratumDiff", GLOBAL_STATE->stratum_difficulty);
-
-    cJSON_AddNumberToObject(root, "isUsingFallbackStratum", GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback);
-
-    cJSON_AddNumberToObject(root, "freeHeap", esp_get_free_heap_size());
-    cJSON_AddNumberToObject(root, "coreVoltage", nvs_config_get_u16(NVS_CONFIG_ASIC_VOLTAGE, CONFIG_ASIC_VOLTAGE));
-    cJSON_AddNumberToObject(root, "coreVoltageActual", VCORE_get_voltage_mv(GLOBAL_STATE));
-    cJSON_AddNumberToObject(root, "frequency", nvs_config_get_u16(NVS_CONFIG_ASIC_FREQ, CONFIG_ASIC_FREQUENCY));
-    cJSON_AddStringToObject(root, "ssid", ssid_buffer);
-    cJSON_AddStringToObject(root, "macAddr", formattedMac);
-    cJSON_AddStringToObject(root, "hostname", hostname_buffer);
-    cJSON_AddStringToObject(root, "wifiStatus", GLOBAL_STATE->SYSTEM_MODULE.wifi_status);
-    cJSON_AddNumberToObject(root, "sharesAccepted", GLOBAL_STATE->SYSTEM_MODULE.shares_accepted);
-    cJSON_AddNumberToObject(root, "sharesRejected", GLOBAL_STATE->SYSTEM_MODULE.shares_rejected);
-    cJSON_AddNumberToObject(root, "uptimeSeconds", (esp_timer_get_time() - GLOBAL_STATE->SYSTEM_MODULE.start_time) / 1000000);
-    cJSON_AddNumberToObject(root, "asicCount", GLOBAL_STATE->asic_count);
+    json_stream_add_string(&json, "bestDiff", GLOBAL_STATE->SYSTEM_MODULE.best_diff_string);
+    json_stream_add_string(&json, "bestSessionDiff", GLOBAL_STATE->SYSTEM_MODULE.best_session_diff_string);
+    json_stream_add_number(&json, "stratumDiff", GLOBAL_STATE->stratum_difficulty);
+
+    json_stream_add_int(&json, "isUsingFallbackStratum", GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback);
+
+    ChainState chain;
+    SYSTEM_copy_chain_state(GLOBAL_STATE, GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback, &chain);
+    json_stream_add_int(&json, "blockHeight", chain.block_height);
+    json_stream_add_number(&json, "networkDifficulty", chain.network_difficulty);
+    json_stream_add_int(&json, "blockAgeSeconds",
+                        chain.block_change_us ? (esp_timer_get_time() - chain.block_change_us) / 1000000 : -1);
+
+    json_stream_add_int(&json, "freeHeap", esp_get_free_heap_size());
+    json_stream_add_int(&json, "coreVoltage", config->core_voltage);
+    json_stream_add_int(&json, "coreVoltageActual", VCORE_get_voltage_mv(GLOBAL_STATE));
+    json_stream_add_int(&json, "frequency", config->frequency);
+    json_stream_add_string(&json, "ssid", config->ssid);
+    json_stream_add_string(&json, "macAddr", formattedMac);
+    json_stream_add_string(&json, "hostname", config->hostname);
+    json_stream_add_string(&json, "wifiStatus", GLOBAL_STATE->SYSTEM_MODULE.wifi_status);
+    json_stream_add_int(&json, "sharesAccepted", GLOBAL_STATE->SYSTEM_MODULE.shares_accepted);
+    json_stream_add_int(&json, "sharesRejected", GLOBAL_STATE->SYSTEM_MODULE.shares_rejected);
+    json_stream_add_int(&json, "uptimeSeconds", (esp_timer_get_time() - GLOBAL_STATE->SYSTEM_MODULE.start_time) / 1000000);
+    json_stream_add_int(&json, "asicCount", GLOBAL_STATE->asic_count);
     uint16_t small_core_count = 0;
     switch (GLOBAL_STATE->asic_model){
         case ASIC_BM1397:
@@ -762,65 +852,97 @@ static esp_err_t GET_system_info(httpd_req_t * req)
             small_core_count = -1;
             break;
     }
-    cJSON_AddNumberToObject(root, "smallCoreCount", small_core_count);
-    cJSON_AddStringToObject(root, "ASICModel", GLOBAL_STATE->asic_model_str);
-    cJSON_AddStringToObject(root, "stratumURL", stratum_url_buffer);
-    cJSON_AddStringToObject(root, "fallbackStratumURL", fallback_stratum_url_buffer);
-    cJSON_AddNumberToObject(root, "stratumPort", nvs_config_get_u16(NVS_CONFIG_STRATUM_PORT, CONFIG_STRATUM_PORT));
-    cJSON_AddNumberToObject(root, "fallbackStratumPort", nvs_config_get_u16(NVS_CONFIG_FALLBACK_STRATUM_PORT, CONFIG_FALLBACK_STRATUM_PORT));
-    cJSON_AddStringToObject(root, "stratumUser", stratum_user_buffer);
-    cJSON_AddStringToObject(root, "fallbackStratumUser", fallback_stratum_user_buffer);
-
-    cJSON_AddStringToObject(root, "version", esp_app_get_description()->version);
-    cJSON_AddStringToObject(root, "idfVersion", esp_get_idf_version());
-    cJSON_AddStringToObject(root, "boardVersion", board_version_buffer);
-    cJSON_AddStringToObject(root, "runningPartition", esp_ota_get_running_partition()->label);
-
-    cJSON_AddNumberToObject(root, "flipscreen", nvs_config_get_u16(NVS_CONFIG_FLIP_SCREEN, 1));
-    cJSON_AddNumberToObject(root, "overheat_mode", nvs_config_get_u16(NVS_CONFIG_OVERHEAT_MODE, 0));
-    cJSON_AddNumberToObject(root, "invertscreen", nvs_config_get_u16(NVS_CONFIG_INVERT_SCREEN, 0));
-
-    cJSON_AddNumberToObject(root, "invertfanpolarity", nvs_config_get_u16(NVS_CONFIG_INVERT_FAN_POLARITY, 1));
-    cJSON_AddNumberToObject(root, "autofanspeed", nvs_config_get_u16(NVS_CONFIG_AUTO_FAN_SPEED, 1));
-
-    cJSON_AddNumberToObject(root, "fanspeed", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.fan_perc);
-    cJSON_AddNumberToObject(root, "fanrpm", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.fan_rpm);
-    cJSON_AddNumberToObject(root, "autotune", nvs_config_get_u16(NVS_CONFIG_AUTOTUNE_FLAG, 1));
-    const char* autotune_preset_temp = nvs_config_get_string(NVS_CONFIG_AUTOTUNE_PRESET, "");
-    strncpy(nvs_string_buffer, autotune_preset_temp, MAX_NVS_STRING_SIZE - 1);
-    nvs_string_buffer[MAX_NVS_STRING_SIZE - 1] = '\0';
-    free((char*)autotune_preset_temp);
-    cJSON_AddStringToObject(root, "autotunePreset", nvs_string_buffer);
-    
-    const char* serial_temp = nvs_config_get_string(NVS_CONFIG_SERIAL_NUMBER, "");
-    strncpy(nvs_string_buffer, serial_temp, MAX_NVS_STRING_SIZE - 1);
-    nvs_string_buffer[MAX_NVS_STRING_SIZE - 1] = '\0';
-    free((char*)serial_temp);
-    cJSON_AddStringToObject(root, "serialnumber", nvs_string_buffer);
-
-    // Use pre-allocated buffer for JSON response
-    char* sys_info = cJSON_PrintUnformatted(root);
-    if (sys_info != NULL) {
-        size_t sys_info_len = strlen(sys_info);
-        if (sys_info_len < MAX_JSON_RESPONSE_SIZE) {
-            strncpy(json_response_buffer, sys_info, MAX_JSON_RESPONSE_SIZE - 1);
-            json_response_buffer[MAX_JSON_RESPONSE_SIZE - 1] = '\0';
-            httpd_resp_sendstr(req, json_response_buffer);
-        } else {
-            ESP_LOGE(TAG, "JSON response too large: %d bytes", sys_info_len);
-            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Response too large");
-        }
-        free(sys_info);  // Free the cJSON allocated string
-    } else {
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "JSON creation failed");
+    json_stream_add_int(&json, "smallCoreCount", small_core_count);
+    json_stream_add_string(&json, "ASICModel", GLOBAL_STATE->asic_model_str);
+    json_stream_add_string(&json, "stratumURL", config->stratum_url);
+    json_stream_add_string(&json, "fallbackStratumURL", config->fallback_stratum_url);
+    json_stream_add_int(&json, "stratumPort", config->stratum_port);
+    json_stream_add_int(&json, "fallbackStratumPort", config->fallback_stratum_port);
+    json_stream_add_string(&json, "stratumUser", config->stratum_user);
+    json_stream_add_string(&json, "fallbackStratumUser", config->fallback_stratum_user);
+
+    json_stream_add_string(&json, "version", esp_app_get_description()->version);
+    json_stream_add_string(&json, "idfVersion", esp_get_idf_version());
+    json_stream_add_string(&json, "boardVersion", config->board_version);
+    json_stream_add_string(&json, "runningPartition", esp_ota_get_running_partition()->label);
+
+    json_stream_add_int(&json, "flipscreen", config->flip_screen);
+    json_stream_add_int(&json, "overheat_mode", config->overheat_mode);
+    json_stream_add_int(&json, "invertscreen", config->invert_screen);
+
+    json_stream_add_int(&json, "invertfanpolarity", config->invert_fan_polarity);
+    json_stream_add_int(&json, "autofanspeed", config->auto_fan_speed);
+
+    json_stream_add_number(&json, "fanspeed", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.fan_perc);
+    json_stream_add_int(&json, "fanrpm", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.fan_rpm);
+    json_stream_add_int(&json, "autotune", config->autotune);
+    json_stream_add_string(&json, "autotunePreset", config->autotune_preset);
+    json_stream_add_int(&json, "powerCap", config->power_cap);
+    json_stream_add_bool(&json, "powerCapActive", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.power_capped);
+    json_stream_add_int(&json, "fleetOta", config->fleet_ota);
+    json_stream_add_int(&json, "fleetStatus", config->fleet_status);
+    json_stream_add_string(&json, "serialnumber", config->serial_number);
+    json_stream_end_object(&json);
+
+    return json_stream_finish(&json) == ESP_OK ? ESP_OK : ESP_FAIL;
+}
+
+// Where an interrupted upload has to continue, as {"target": ..., "offset": ..., "total": ...}
+static esp_err_t send_ota_progress(httpd_req_t * req, const char * status)
+{
+    ota_stream_status_t progress = ota_stream_status();
+    size_t size = sizeof(json_response_buffer);
+    char * buffer = handler_buffer(json_response_buffer, &size);
+    httpd_resp_set_status(req, status);
+    httpd_resp_set_type(req, "application/json");
+    snprintf(buffer, size, "{\"target\":\"%s\",\"offset\":%u,\"total\":%u}",
+             !progress.active ? "none" : progress.target == OTA_TARGET_FIRMWARE ? "firmware" : "www",
+             (unsigned) progress.offset, (unsigned) progress.total);
+    return httpd_resp_sendstr(req, buffer);
+}
+
+static esp_err_t send_ota_error(httpd_req_t * req, esp_err_t err, const char * what)
+{
+    char message[96];
+
+    switch (err) {
+        case ESP_ERR_NOT_FINISHED:
+            ESP_LOGW(TAG, "%s incomplete, waiting for the rest", what);
+            return send_ota_progress(req, "202 Accepted");
+        case ESP_ERR_INVALID_STATE:
+            return send_ota_progress(req, "409 Conflict");
+        case ESP_ERR_INVALID_ARG:
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Content-Range does not match the body");
+        case ESP_ERR_INVALID_SIZE:
+            snprintf(message, sizeof(message), "%s failed: File too large for partition", what);
+            dataBase_log_event("system", "error", message, NULL);
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "File provided is too large for device");
+        case ESP_ERR_INVALID_CRC:
+            snprintf(message, sizeof(message), "%s failed: SHA-256 mismatch", what);
+            dataBase_log_event("system", "error", message, NULL);
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "SHA-256 mismatch");
+        default:
+            ESP_LOGE(TAG, "%s error: %s", what, esp_err_to_name(err));
+            snprintf(message, sizeof(message), "%s failed: %s", what, esp_err_to_name(err));
+            dataBase_log_event("system", "error", message, NULL);
+            return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Flash or Validation Error");
     }
-    
-    cJSON_Delete(root);
-    return ESP_OK;
+}
+
+static esp_err_t GET_OTA_status(httpd_req_t * req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+    return send_ota_progress(req, "200 OK");
 }
 
 esp_err_t POST_WWW_update(httpd_req_t * req)
 {
+    if (http_workers_defer(req, POST_WWW_update)) {
+        return ESP_OK;
+    }
+
     if (is_network_allowed(req) != ESP_OK) {
         ESP_LOGW(TAG, "Unauthorized WWW update attempt from client");
         dataBase_log_event("system", "warning", "Unauthorized WWW update attempt", NULL);
@@ -837,50 +959,16 @@ esp_err_t POST_WWW_update(httpd_req_t * req)
         return ESP_OK;
     }
 
-    int remaining = req->content_len;
-    char* buf = ota_buffer;  // Use dedicated OTA buffer
-    const int buf_size = MAX_OTA_BUFFER_SIZE;
-
-    const esp_partition_t * www_partition =
-        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, "www");
-    if (www_partition == NULL) {
-        ESP_LOGE(TAG, "WWW partition not found during update");
-        dataBase_log_event("system", "error", "WWW update failed: WWW partition not found", NULL);
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "WWW partition not found");
-        return ESP_OK;
-    }
-
-    // Don't attempt to write more than what can be stored in the partition
-    if (remaining > www_partition->size) {
-        ESP_LOGE(TAG, "WWW update file too large: %d bytes, partition size: %lu bytes", remaining, www_partition->size);
-        dataBase_log_event("system", "error", "WWW update failed: File too large for partition", NULL);
-        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "File provided is too large for device");
-        return ESP_OK;
+    esp_err_t err = ota_stream_receive(req, OTA_TARGET_WWW);
+    if (err != ESP_OK) {
+        return send_ota_error(req, err, "WWW update");
     }
 
-    // Erase the entire www partition before writing
-    ESP_ERROR_CHECK(esp_partition_erase_range(www_partition, 0, www_partition->size));
-
-    while (remaining > 0) {
-        int recv_len = httpd_req_recv(req, buf, MIN(remaining, buf_size));
-
-        if (recv_len == HTTPD_SOCK_ERR_TIMEOUT) {
-            continue;
-        } else if (recv_len <= 0) {
-            ESP_LOGE(TAG, "WWW update protocol error: recv_len=%d", recv_len);
-            dataBase_log_event("system", "error", "WWW update failed: Protocol error during file receive", NULL);
-            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Protocol Error");
-            return ESP_OK;
-        }
-
-        if (esp_partition_write(www_partition, www_partition->size - remaining, (const void *) buf, recv_len) != ESP_OK) {
-            ESP_LOGE(TAG, "WWW update write error: offset=%lu, length=%d", www_partition->size - remaining, recv_len);
-            dataBase_log_event("system", "error", "WWW update failed: Write error to partition", NULL);
-            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Write Error");
-            return ESP_OK;
-        }
-
-        remaining -= recv_len;
+    // The old manifests describe the image that was just replaced
+    static_assets_clear();
+    FLEET_OTA_stop_serving(FLEET_OTA_IMAGE_WWW);
+    if (static_assets_reload() != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to rebuild the web app manifest, serving straight from the filesystem");
     }
 
     // Set content type to JSON
@@ -890,6 +978,7 @@ esp_err_t POST_WWW_update(httpd_req_t * req)
     cJSON *response = cJSON_CreateObject();
     cJSON_AddStringToObject(response, "status", "success");
     cJSON_AddStringToObject(response, "message", "WWW update completed successfully");
+    cJSON_AddStringToObject(response, "sha256", ota_stream_status().sha256);
     time_t now;
     time(&now);
     cJSON_AddNumberToObject(response, "timestamp", now);
@@ -904,6 +993,9 @@ esp_err_t POST_WWW_update(httpd_req_t * req)
     // Cleanup
     free((char *)response_str);
     cJSON_Delete(response);
+
+    // Hashes the whole partition, after the response so the client is not kept waiting
+    FLEET_OTA_start_serving(FLEET_OTA_IMAGE_WWW);
     
     return ESP_OK;
 }
@@ -913,6 +1005,10 @@ esp_err_t POST_WWW_update(httpd_req_t * req)
  */
 esp_err_t POST_OTA_update(httpd_req_t * req)
 {
+    if (http_workers_defer(req, POST_OTA_update)) {
+        return ESP_OK;
+    }
+
     if (is_network_allowed(req) != ESP_OK) {
         ESP_LOGW(TAG, "Unauthorized OTA firmware update attempt from client");
         dataBase_log_event("system", "warning", "Unauthorized OTA firmware update attempt", NULL);
@@ -929,47 +1025,9 @@ esp_err_t POST_OTA_update(httpd_req_t * req)
         return ESP_OK;
     }
     
-    esp_ota_handle_t ota_handle;
-    int remaining = req->content_len;
-    char* buf = ota_buffer;  // Use dedicated OTA buffer
-    const int buf_size = MAX_OTA_BUFFER_SIZE;
-
-    const esp_partition_t * ota_partition = esp_ota_get_next_update_partition(NULL);
-    ESP_ERROR_CHECK(esp_ota_begin(ota_partition, OTA_SIZE_UNKNOWN, &ota_handle));
-
-    while (remaining > 0) {
-        int recv_len = httpd_req_recv(req, buf, MIN(remaining, buf_size));
-
-        // Timeout Error: Just retry
-        if (recv_len == HTTPD_SOCK_ERR_TIMEOUT) {
-            continue;
-
-            // Serious Error: Abort OTA
-        } else if (recv_len <= 0) {
-            ESP_LOGE(TAG, "OTA firmware update protocol error: recv_len=%d", recv_len);
-            dataBase_log_event("system", "error", "OTA firmware update failed: Protocol error during file receive", NULL);
-            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Protocol Error");
-            return ESP_OK;
-        }
-
-        // Successful Upload: Flash firmware chunk
-        if (esp_ota_write(ota_handle, (const void *) buf, recv_len) != ESP_OK) {
-            ESP_LOGE(TAG, "OTA firmware update flash error: length=%d", recv_len);
-            dataBase_log_event("system", "error", "OTA firmware update failed: Flash write error", NULL);
-            esp_ota_abort(ota_handle);
-            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Flash Error");
-            return ESP_OK;
-        }
-
-        remaining -= recv_len;
-    }
-
-    // Validate and switch to new OTA image and reboot
-    if (esp_ota_end(ota_handle) != ESP_OK || esp_ota_set_boot_partition(ota_partition) != ESP_OK) {
-        ESP_LOGE(TAG, "OTA firmware update validation/activation error");
-        dataBase_log_event("system", "error", "OTA firmware update failed: Validation or activation error", NULL);
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Validation / Activation Error");
-        return ESP_OK;
+    esp_err_t err = ota_stream_receive(req, OTA_TARGET_FIRMWARE);
+    if (err != ESP_OK) {
+        return send_ota_error(req, err, "OTA firmware update");
     }
 
     // Set content type to JSON
@@ -979,6 +1037,7 @@ esp_err_t POST_OTA_update(httpd_req_t * req)
     cJSON *response = cJSON_CreateObject();
     cJSON_AddStringToObject(response, "status", "success");
     cJSON_AddStringToObject(response, "message", "Firmware update completed successfully, rebooting now");
+    cJSON_AddStringToObject(response, "sha256", ota_stream_status().sha256);
     time_t now;
     time(&now);
     cJSON_AddNumberToObject(response, "timestamp", now);
@@ -996,109 +1055,181 @@ esp_err_t POST_OTA_update(httpd_req_t * req)
     
     ESP_LOGI(TAG, "Restarting System because of Firmware update complete");
     vTaskDelay(1000 / portTICK_PERIOD_MS);
+    dataBase_flush_logs(2000);
     esp_restart();
 
     return ESP_OK;
 }
 
-#define MAX_LOG_BUFFER_SIZE 1024  // Define maximum log message size
-static char log_buffer[MAX_LOG_BUFFER_SIZE];  // Pre-allocated buffer for log messages
-
-int log_to_queue(const char * format, va_list args)
+// The image named by ?image=firmware|www, if this miner serves it to its fleet. Hand it back
+// with FLEET_OTA_release(*image).
+static const FleetOtaServed * get_fleet_image(httpd_req_t * req, char * query_buf, size_t query_size,
+                                              fleet_ota_image_t * image)
 {
-    va_list args_copy;
-    va_copy(args_copy, args);
-
-    // Format the string into the pre-allocated buffer
-    int written = vsnprintf(log_buffer, MAX_LOG_BUFFER_SIZE - 1, format, args_copy);
-    va_end(args_copy);
-
-    if (written < 0) {
-        return 0;  // Formatting error
-    }
-
-    // Ensure the log message ends with a newline
-    size_t len = strlen(log_buffer);
-    if (len > 0 && log_buffer[len - 1] != '\n') {
-        if (len < MAX_LOG_BUFFER_SIZE - 2) {  // Check if we have space for \n\0
-            log_buffer[len] = '\n';
-            log_buffer[len + 1] = '\0';
-            len++;
-        }
+    char value[16];
+    if (httpd_req_get_url_query_str(req, query_buf, query_size) != ESP_OK ||
+        httpd_query_key_value(query_buf, "image", value, sizeof(value)) != ESP_OK) {
+        return NULL;
+    }
+    if (strcmp(value, "firmware") == 0) {
+        *image = FLEET_OTA_IMAGE_FIRMWARE;
+    } else if (strcmp(value, "www") == 0) {
+        *image = FLEET_OTA_IMAGE_WWW;
+    } else {
+        return NULL;
     }
+    return FLEET_OTA_acquire(*image);
+}
 
-    // Print to standard output
-    printf("%s", log_buffer);
-
-    // Create a copy of the message for the queue
-    char *queue_message = pvPortMalloc(len + 1);
-    if (queue_message == NULL) {
-        return 0;  // Memory allocation failed
+static esp_err_t GET_fleet_manifest(httpd_req_t * req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
     }
-    strncpy(queue_message, log_buffer, len);
-    queue_message[len] = '\0';
 
-    if (xQueueSendToBack(log_queue, (void*)&queue_message, (TickType_t) 0) != pdPASS) {
-        vPortFree(queue_message);
+    char query_buf[64];
+    fleet_ota_image_t image;
+    const FleetOtaServed * served = get_fleet_image(req, query_buf, sizeof(query_buf), &image);
+    if (served == NULL) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Image not served");
     }
 
-    return 0;
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    esp_err_t err = httpd_resp_send(req, (const char *) served->encoded, served->encoded_len);
+    FLEET_OTA_release(image);
+    return err;
 }
 
-#define MAX_WS_FRAME_SIZE 1024  // Define maximum WebSocket frame size
-static uint8_t ws_frame_buffer[MAX_WS_FRAME_SIZE];  // Pre-allocated buffer for WebSocket frames
-
-void send_log_to_websocket(char *message)
+static esp_err_t GET_fleet_chunk(httpd_req_t * req)
 {
-    if (message == NULL) {
-        return;
+    if (http_workers_defer(req, GET_fleet_chunk)) {
+        return ESP_OK;
     }
 
-    // Prepare the WebSocket frame
-    httpd_ws_frame_t ws_pkt;
-    memset(&ws_pkt, 0, sizeof(httpd_ws_frame_t));
-    
-    // Copy message to pre-allocated buffer
-    size_t msg_len = strlen(message);
-    if (msg_len >= MAX_WS_FRAME_SIZE) {
-        msg_len = MAX_WS_FRAME_SIZE - 1;  // Leave room for null terminator
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
     }
-    memcpy(ws_frame_buffer, message, msg_len);
-    ws_frame_buffer[msg_len] = '\0';
-    
-    ws_pkt.payload = ws_frame_buffer;
-    ws_pkt.len = msg_len;
-    ws_pkt.type = HTTPD_WS_TYPE_TEXT;
-
-    // Ensure server and fd are valid
-    if (server != NULL && fd >= 0) {
-        // Send the WebSocket frame asynchronously
-        if (httpd_ws_send_frame_async(server, fd, &ws_pkt) != ESP_OK) {
-            esp_log_set_vprintf(vprintf);
+
+    char query_buf[64];
+    char value[12];
+    fleet_ota_image_t image;
+    const FleetOtaServed * served = get_fleet_image(req, query_buf, sizeof(query_buf), &image);
+    if (served == NULL) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Image not served");
+    }
+    if (httpd_query_key_value(query_buf, "index", value, sizeof(value)) != ESP_OK) {
+        FLEET_OTA_release(image);
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing index");
+    }
+    // The peer checks every chunk against its hash, the manifest is only needed to locate it
+    uint32_t index = strtoul(value, NULL, 10);
+    size_t len = fleet_ota_chunk_len(&served->manifest, index);
+    size_t offset = fleet_ota_chunk_offset(&served->manifest, index);
+    const esp_partition_t * partition = served->partition;
+    FLEET_OTA_release(image);
+    if (len == 0) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid index");
+    }
+
+    rest_server_context_t * rest_context = (rest_server_context_t *) req->user_ctx;
+    size_t scratch_size = SCRATCH_BUFSIZE;
+    char * scratch = handler_buffer(rest_context->scratch, &scratch_size);
+    httpd_resp_set_type(req, "application/octet-stream");
+    while (len > 0) {
+        size_t part = MIN(len, scratch_size);
+        if (esp_partition_read(partition, offset, scratch, part) != ESP_OK) {
+            // Too late for an error status, the peer sees a short chunk and asks again
+            ESP_LOGE(TAG, "Failed to read fleet chunk %" PRIu32, index);
+            httpd_resp_send_chunk(req, NULL, 0);
+            return ESP_FAIL;
+        }
+        if (httpd_resp_send_chunk(req, scratch, part) != ESP_OK) {
+            return ESP_FAIL;
         }
+        offset += part;
+        len -= part;
     }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
 
-    // Free the message buffer
-    vPortFree(message);
+static bool fleet_status_stream_peer(const fleet_status_peer_t * peer, void * ctx)
+{
+    json_stream_t * json = ctx;
+    const fleet_status_digest_t * digest = &peer->digest;
+    char mac[18];
+    char ip[16];
+
+    snprintf(mac, sizeof(mac), "%02X:%02X:%02X:%02X:%02X:%02X", digest->mac[0], digest->mac[1], digest->mac[2],
+             digest->mac[3], digest->mac[4], digest->mac[5]);
+    snprintf(ip, sizeof(ip), "%u.%u.%u.%u", digest->ip[0], digest->ip[1], digest->ip[2], digest->ip[3]);
+
+    json_stream_begin_object(json, NULL);
+    json_stream_add_string(json, "macAddr", mac);
+    json_stream_add_string(json, "ip", ip);
+    json_stream_add_string(json, "hostname", digest->hostname);
+    json_stream_add_string(json, "deviceModel", digest->model);
+    json_stream_add_string(json, "version", digest->version);
+    json_stream_add_number(json, "hashRate", digest->hashrate);
+    json_stream_add_number(json, "temp", digest->chip_temp);
+    json_stream_add_number(json, "power", digest->power);
+    json_stream_add_int(json, "uptimeSeconds", digest->uptime_s);
+    json_stream_add_int(json, "sharesAccepted", digest->shares_accepted);
+    json_stream_add_int(json, "sharesRejected", digest->shares_rejected);
+    json_stream_add_string(json, "stratumURL", digest->pool);
+    json_stream_add_int(json, "stratumPort", digest->pool_port);
+    json_stream_add_bool(json, "isUsingFallbackStratum", digest->flags & FLEET_STATUS_FLAG_FALLBACK);
+    json_stream_add_bool(json, "overheatMode", digest->flags & FLEET_STATUS_FLAG_OVERHEAT);
+    json_stream_add_int(json, "lastSeenSeconds", (esp_timer_get_time() / 1000 - peer->last_seen_ms) / 1000);
+    json_stream_end_object(json);
+
+    return json->out.err == ESP_OK;
 }
 
-/*
- * This handler echos back the received ws data
- * and triggers an async send if certain message received
- */
-esp_err_t echo_handler(httpd_req_t * req)
+/* Handler for the fleet snapshot: every miner heard on the fleet status group and their totals */
+static esp_err_t GET_fleet_status(httpd_req_t * req)
 {
+    if (http_workers_defer(req, GET_fleet_status)) {
+        return ESP_OK;
+    }
+
     if (is_network_allowed(req) != ESP_OK) {
         return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
     }
 
-    if (req->method == HTTP_GET) {
-        ESP_LOGI(TAG, "Handshake done, the new connection was opened");
-        fd = httpd_req_to_sockfd(req);
-        esp_log_set_vprintf(log_to_queue);
+    // Set CORS headers
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
         return ESP_OK;
     }
-    return ESP_OK;
+
+    fleet_status_summary_t summary;
+    if (!FLEET_STATUS_summarize(&summary)) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Fleet status is disabled");
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    json_stream_t json;
+    size_t size = sizeof(json_response_buffer);
+    char * buffer = handler_buffer(json_response_buffer, &size);
+    json_stream_init(&json, req, buffer, size);
+    json_stream_begin_object(&json, NULL);
+    json_stream_begin_object(&json, "summary");
+    json_stream_add_int(&json, "miners", summary.miners);
+    json_stream_add_number(&json, "hashRate", summary.hashrate);
+    json_stream_add_number(&json, "power", summary.power);
+    json_stream_add_number(&json, "maxTemp", summary.max_chip_temp);
+    json_stream_add_int(&json, "sharesAccepted", summary.shares_accepted);
+    json_stream_add_int(&json, "sharesRejected", summary.shares_rejected);
+    json_stream_add_int(&json, "onFallbackStratum", summary.on_fallback);
+    json_stream_add_int(&json, "overheated", summary.overheated);
+    json_stream_end_object(&json);
+    json_stream_begin_array(&json, "miners");
+    FLEET_STATUS_for_each(fleet_status_stream_peer, &json);
+    json_stream_end_array(&json);
+    json_stream_end_object(&json);
+
+    return json_stream_finish(&json) == ESP_OK ? ESP_OK : ESP_FAIL;
 }
 
 // HTTP Error (404) Handler - Redirects all requests to the root page
@@ -1115,35 +1246,97 @@ esp_err_t http_404_error_handler(httpd_req_t * req, httpd_err_code_t err)
     return ESP_OK;
 }
 
-void websocket_log_handler()
+/* Log responses are copied out of the event log a few KB at a time into a chunked
+ * response, so no event list is ever held in memory */
+typedef struct {
+    json_stream_t json;
+    int count;
+} log_stream_t;
+
+// Event data is logged as a JSON object or array. Checks that the brackets open with
+// the first character and close with the last, which also catches a payload cut short
+// by the size limit, without building a cJSON tree for every event.
+static bool looks_like_json(const char * data)
 {
-    char *message;
-    const TickType_t queue_timeout = pdMS_TO_TICKS(100);  // 100ms timeout
-
-    while (true)
-    {
-        if (xQueueReceive(log_queue, &message, queue_timeout) != pdPASS) {
-            vTaskDelay(10 / portTICK_PERIOD_MS);
-            continue;
+    int depth = 0;
+    bool in_string = false;
+    bool escape = false;
+
+    while (isspace((unsigned char) *data)) {
+        data++;
+    }
+    if (*data != '{' && *data != '[') {
+        return false;
+    }
+    for (; *data; data++) {
+        char c = *data;
+        if (in_string) {
+            if (escape) {
+                escape = false;
+            } else if (c == '\\') {
+                escape = true;
+            } else if (c == '"') {
+                in_string = false;
+            }
+        } else if (c == '"') {
+            in_string = true;
+        } else if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            if (--depth == 0) {
+                break;
+            }
         }
-
-        if (message == NULL) {
-            vTaskDelay(10 / portTICK_PERIOD_MS);
-            continue;
+    }
+    if (depth != 0) {
+        return false;
+    }
+    for (data++; *data; data++) {
+        if (!isspace((unsigned char) *data)) {
+            return false;
         }
+    }
+    return true;
+}
 
-        if (fd == -1) {
-            vPortFree(message);
-            vTaskDelay(100 / portTICK_PERIOD_MS);
-            continue;
+static bool log_stream_event(const EventLogEntry * entry, void * ctx)
+{
+    log_stream_t * stream = ctx;
+
+    json_stream_begin_object(&stream->json, NULL);
+    json_stream_add_int(&stream->json, "seq", entry->seq);
+    json_stream_add_int(&stream->json, "timestamp", entry->timestamp);
+    json_stream_add_string(&stream->json, "type", entry->type);
+    json_stream_add_string(&stream->json, "level", entry->level);
+    json_stream_add_string(&stream->json, "message", entry->message);
+
+    // Data that was logged as JSON goes out as JSON, anything else as a string
+    if (entry->data[0] != '\0') {
+        if (looks_like_json(entry->data)) {
+            json_stream_add_raw(&stream->json, "data", entry->data);
+        } else {
+            json_stream_add_string(&stream->json, "data", entry->data);
         }
+    }
+    json_stream_end_object(&stream->json);
+
+    stream->count++;
+    return stream->json.out.err == ESP_OK;
+}
 
-        send_log_to_websocket(message);
+static uint32_t query_u32(const char * query_buf, const char * key)
+{
+    char value[16];
+    if (httpd_query_key_value(query_buf, key, value, sizeof(value)) != ESP_OK) {
+        return 0;
     }
+    return strtoul(value, NULL, 10);
 }
 
-/* Handler for getting recent logs from database */
-static esp_err_t GET_recent_logs(httpd_req_t * req)
+/* Shared by the log handlers: parse the query, then stream the matching events as
+ * {"<array_name>":[...],"count":n,"nextCursor":c,"oldestCursor":o} */
+static esp_err_t send_log_query(httpd_req_t * req, EventLogId log, const char * array_name,
+                                int default_limit, int max_limit)
 {
     if (is_network_allowed(req) != ESP_OK) {
         return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
@@ -1157,111 +1350,313 @@ static esp_err_t GET_recent_logs(httpd_req_t * req)
         return ESP_OK;
     }
 
-    // Parse query parameters for limit
-    int limit = 50; // Default limit
-    char query_buf[128];
+    log_query_t query = {
+        .limit = default_limit,
+    };
+    char query_buf[256];
+    char levels[64];
+    char types[64];
     if (httpd_req_get_url_query_str(req, query_buf, sizeof(query_buf)) == ESP_OK) {
-        char limit_str[16];
-        if (httpd_query_key_value(query_buf, "limit", limit_str, sizeof(limit_str)) == ESP_OK) {
-            int parsed_limit = atoi(limit_str);
-            if (parsed_limit > 0 && parsed_limit <= 100) {
-                limit = parsed_limit;
-            }
+        int parsed_limit = query_u32(query_buf, "limit");
+        if (parsed_limit > 0 && (max_limit == 0 || parsed_limit <= max_limit)) {
+            query.limit = parsed_limit;
+        }
+        query.cursor = query_u32(query_buf, "cursor");
+        query.since = query_u32(query_buf, "since");
+        query.until = query_u32(query_buf, "until");
+        if (httpd_query_key_value(query_buf, "level", levels, sizeof(levels)) == ESP_OK) {
+            query.levels = levels;
+        }
+        if (httpd_query_key_value(query_buf, "type", types, sizeof(types)) == ESP_OK) {
+            query.types = types;
         }
     }
 
-    // Get logs from database
-    cJSON* logs_json = NULL;
-    esp_err_t ret = dataBase_get_recent_logs(limit, &logs_json);
-    
-    if (ret != ESP_OK || logs_json == NULL) {
-        ESP_LOGW(TAG, "Failed to get logs from database, returning empty response");
-        // Return empty logs response
-        cJSON* empty_response = cJSON_CreateObject();
-        cJSON_AddArrayToObject(empty_response, "events");
-        cJSON_AddNumberToObject(empty_response, "count", 0);
-        
-        const char* response_str = cJSON_Print(empty_response);
-        httpd_resp_sendstr(req, response_str);
-        free((char*)response_str);
-        cJSON_Delete(empty_response);
+    log_stream_t stream = {
+        .count = 0,
+    };
+    size_t size = sizeof(json_response_buffer);
+    char * buffer = handler_buffer(json_response_buffer, &size);
+    json_stream_init(&stream.json, req, buffer, size);
+    json_stream_begin_object(&stream.json, NULL);
+    json_stream_begin_array(&stream.json, array_name);
+    if (dataBase_query_logs(log, &query, log_stream_event, &stream) != ESP_OK && stream.json.out.err == ESP_OK) {
+        ESP_LOGW(TAG, "Failed to read logs from database, returning what was found");
+    }
+    json_stream_end_array(&stream.json);
+    json_stream_add_int(&stream.json, "count", stream.count);
+    json_stream_add_int(&stream.json, "nextCursor", query.next_cursor);
+    json_stream_add_int(&stream.json, "oldestCursor", eventLog_oldest_seq(log));
+    if (log == EVENTLOG_ERRORS) {
+        json_stream_add_int(&stream.json, "totalErrors", eventLog_next_seq(log) - 1);
+        json_stream_add_int(&stream.json, "lastError", eventLog_last_timestamp(log));
+    } else if (log == EVENTLOG_CRITICAL) {
+        json_stream_add_int(&stream.json, "totalCritical", eventLog_next_seq(log) - 1);
+        json_stream_add_int(&stream.json, "lastCritical", eventLog_last_timestamp(log));
+    }
+    json_stream_end_object(&stream.json);
+
+    return json_stream_finish(&stream.json) == ESP_OK ? ESP_OK : ESP_FAIL;
+}
+
+/* Handler for getting recent logs from database */
+static esp_err_t GET_recent_logs(httpd_req_t * req)
+{
+    if (http_workers_defer(req, GET_recent_logs)) {
         return ESP_OK;
     }
-
-    // Send the logs response
-    const char* logs_str = cJSON_Print(logs_json);
-    httpd_resp_sendstr(req, logs_str);
-    free((char*)logs_str);
-    cJSON_Delete(logs_json);
-    
-    return ESP_OK;
+    return send_log_query(req, EVENTLOG_RECENT, "events", 50, 100);
 }
 
 /* Handler for getting error logs from database */
 static esp_err_t GET_error_logs(httpd_req_t * req)
 {
+    if (http_workers_defer(req, GET_error_logs)) {
+        return ESP_OK;
+    }
+    // Default: return all errors
+    return send_log_query(req, EVENTLOG_ERRORS, "errors", 0, 0);
+}
+
+/* Handler for getting critical logs from database */
+static esp_err_t GET_critical_logs(httpd_req_t * req)
+{
+    if (http_workers_defer(req, GET_critical_logs)) {
+        return ESP_OK;
+    }
+    // Default: return all critical events
+    return send_log_query(req, EVENTLOG_CRITICAL, "critical", 0, 0);
+}
+
+#define TELEMETRY_CHUNK_SAMPLES 32
+
+/* Handler for downloading the telemetry time series as CSV or binary */
+static esp_err_t GET_telemetry(httpd_req_t * req)
+{
+    if (http_workers_defer(req, GET_telemetry)) {
+        return ESP_OK;
+    }
+
     if (is_network_allowed(req) != ESP_OK) {
         return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
     }
 
-    httpd_resp_set_type(req, "application/json");
-
     // Set CORS headers
     if (set_cors_headers(req) != ESP_OK) {
         httpd_resp_send_500(req);
         return ESP_OK;
     }
 
-    // Parse query parameters for limit
-    int limit = 0; // Default: return all errors
+    // Parse query parameters: resolution=1s|1m|1h, format=csv|bin
+    TelemetryResolution res = TELEMETRY_RES_1M;
+    bool binary = false;
     char query_buf[128];
     if (httpd_req_get_url_query_str(req, query_buf, sizeof(query_buf)) == ESP_OK) {
-        char limit_str[16];
-        if (httpd_query_key_value(query_buf, "limit", limit_str, sizeof(limit_str)) == ESP_OK) {
-            int parsed_limit = atoi(limit_str);
-            if (parsed_limit > 0) {
-                limit = parsed_limit;
+        char value[8];
+        if (httpd_query_key_value(query_buf, "resolution", value, sizeof(value)) == ESP_OK) {
+            if (strcmp(value, "1s") == 0) {
+                res = TELEMETRY_RES_1S;
+            } else if (strcmp(value, "1m") == 0) {
+                res = TELEMETRY_RES_1M;
+            } else if (strcmp(value, "1h") == 0) {
+                res = TELEMETRY_RES_1H;
+            } else {
+                return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid resolution");
             }
         }
+        if (httpd_query_key_value(query_buf, "format", value, sizeof(value)) == ESP_OK) {
+            binary = strcmp(value, "bin") == 0;
+        }
     }
 
-    // Get error logs from database
-    cJSON* logs_json = NULL;
-    esp_err_t ret = dataBase_get_error_logs(limit, &logs_json);
-    
-    if (ret != ESP_OK || logs_json == NULL) {
-        ESP_LOGW(TAG, "Failed to get error logs from database, returning empty response");
-        // Return empty error logs response
-        cJSON* empty_response = cJSON_CreateObject();
-        cJSON_AddArrayToObject(empty_response, "errors");
-        cJSON_AddNumberToObject(empty_response, "count", 0);
-        cJSON_AddNumberToObject(empty_response, "totalErrors", 0);
-        cJSON_AddNumberToObject(empty_response, "lastError", 0);
-        
-        const char* response_str = cJSON_Print(empty_response);
-        httpd_resp_sendstr(req, response_str);
-        free((char*)response_str);
-        cJSON_Delete(empty_response);
-        return ESP_OK;
+    TelemetrySample samples[TELEMETRY_CHUNK_SAMPLES];
+    uint32_t seq;
+    uint32_t count;
+    size_t n;
+    TELEMETRY_window(res, &seq, &count);
+
+    if (binary) {
+        httpd_resp_set_type(req, "application/octet-stream");
+        httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"telemetry.bin\"");
+
+        // One copy of the ring, the header count holds even if it wraps during the download.
+        // Rings never shrink, so no copy of a ring that held samples means no memory.
+        uint32_t held = count;
+        TelemetrySample * snapshot = TELEMETRY_snapshot(res, &count);
+        if (snapshot == NULL && held > 0) {
+            httpd_resp_send_500(req);
+            return ESP_OK;
+        }
+        TelemetryHeader header = {
+            .magic = TELEMETRY_MAGIC,
+            .version = TELEMETRY_VERSION,
+            .sample_size = sizeof(TelemetrySample),
+            .interval_s = TELEMETRY_interval_s(res),
+            .count = count,
+        };
+        esp_err_t err = httpd_resp_send_chunk(req, (const char *) &header, sizeof(header));
+        for (uint32_t sent = 0; err == ESP_OK && sent < count; sent += n) {
+            n = MIN(count - sent, TELEMETRY_CHUNK_SAMPLES);
+            err = httpd_resp_send_chunk(req, (const char *) &snapshot[sent], n * sizeof(TelemetrySample));
+        }
+        free(snapshot);
+        if (err != ESP_OK) {
+            return ESP_FAIL;
+        }
+    } else {
+        httpd_resp_set_type(req, "text/csv");
+        httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"telemetry.csv\"");
+
+        size_t size = sizeof(json_response_buffer);
+        char * buffer = handler_buffer(json_response_buffer, &size);
+        const char * csv_header = "timestamp,voltage_mv,current_ma,power_w,chip_temp_c,vr_temp_c,fan_rpm,hashrate_ghs\n";
+        if (httpd_resp_send_chunk(req, csv_header, HTTPD_RESP_USE_STRLEN) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        while ((n = TELEMETRY_read(res, &seq, samples, TELEMETRY_CHUNK_SAMPLES)) > 0) {
+            size_t len = 0;
+            for (size_t i = 0; i < n; i++) {
+                const TelemetrySample * s = &samples[i];
+                len += snprintf(buffer + len, size - len,
+                                "%lu,%u,%u,%u.%02u,%d.%d,%d.%d,%u,%lu.%02lu\n",
+                                s->timestamp, s->voltage, s->current, s->power / 100, s->power % 100,
+                                s->chip_temp / 10, abs(s->chip_temp % 10), s->vr_temp / 10, abs(s->vr_temp % 10),
+                                s->fan_rpm, s->hashrate / 100, s->hashrate % 100);
+            }
+            if (httpd_resp_send_chunk(req, buffer, len) != ESP_OK) {
+                return ESP_FAIL;
+            }
+        }
     }
 
-    // Send the error logs response
-    const char* logs_str = cJSON_Print(logs_json);
-    httpd_resp_sendstr(req, logs_str);
-    free((char*)logs_str);
-    cJSON_Delete(logs_json);
-    
+    httpd_resp_send_chunk(req, NULL, 0);
     return ESP_OK;
 }
 
-/* Handler for getting critical logs from database */
-static esp_err_t GET_critical_logs(httpd_req_t * req)
+#define METRICS_SCHEMA_VERSION 1
+#define METRICS_FIELD_COUNT 20
+
+// Hashrate of the newest sample of a telemetry resolution in GH/s, 0 before the first one
+static float newest_telemetry_hashrate(TelemetryResolution res)
+{
+    uint32_t seq;
+    uint32_t count;
+    TELEMETRY_window(res, &seq, &count);
+    if (count == 0) {
+        return 0;
+    }
+    seq += count - 1;
+    TelemetrySample sample;
+    if (TELEMETRY_read(res, &seq, &sample, 1) != 1) {
+        return 0;
+    }
+    return sample.hashrate / 100.0f;
+}
+
+/* Handler for the compact MessagePack metrics used by fleet collectors. The payload has
+ * a fixed layout and carries no settings, and an unchanged payload is answered with 304 */
+static esp_err_t GET_metrics(httpd_req_t * req)
 {
     if (is_network_allowed(req) != ESP_OK) {
         return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
     }
 
-    httpd_resp_set_type(req, "application/json");
+    // Set CORS headers
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_OK;
+    }
+
+    PowerManagementModule * power = &GLOBAL_STATE->POWER_MANAGEMENT_MODULE;
+    SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
+
+    msgpack_writer_t writer;
+    msgpack_init(&writer, (uint8_t *) json_response_buffer, sizeof(json_response_buffer));
+    msgpack_map(&writer, METRICS_FIELD_COUNT);
+    msgpack_str(&writer, "v");
+    msgpack_uint32(&writer, METRICS_SCHEMA_VERSION);
+    msgpack_str(&writer, "hashRate");
+    msgpack_float(&writer, module->current_hashrate);
+    msgpack_str(&writer, "hashRate1m");
+    msgpack_float(&writer, newest_telemetry_hashrate(TELEMETRY_RES_1M));
+    msgpack_str(&writer, "hashRate1h");
+    msgpack_float(&writer, newest_telemetry_hashrate(TELEMETRY_RES_1H));
+    msgpack_str(&writer, "temp");
+    msgpack_float(&writer, power->chip_temp_avg);
+    msgpack_str(&writer, "vrTemp");
+    msgpack_float(&writer, power->vr_temp);
+    msgpack_str(&writer, "power");
+    msgpack_float(&writer, power->power);
+    msgpack_str(&writer, "voltage");
+    msgpack_float(&writer, power->voltage);
+    msgpack_str(&writer, "current");
+    msgpack_float(&writer, power->current);
+    msgpack_str(&writer, "fanrpm");
+    msgpack_uint32(&writer, power->fan_rpm);
+    msgpack_str(&writer, "fanspeed");
+    msgpack_uint32(&writer, power->fan_perc);
+    msgpack_str(&writer, "frequency");
+    msgpack_uint32(&writer, (uint32_t) power->frequency_value);
+    msgpack_str(&writer, "coreVoltageActual");
+    msgpack_uint32(&writer, VCORE_get_voltage_mv(GLOBAL_STATE));
+    msgpack_str(&writer, "asicCount");
+    msgpack_uint32(&writer, GLOBAL_STATE->asic_count);
+    msgpack_str(&writer, "sharesAccepted");
+    msgpack_uint64(&writer, module->shares_accepted);
+    msgpack_str(&writer, "sharesRejected");
+    msgpack_uint64(&writer, module->shares_rejected);
+    msgpack_str(&writer, "bestSessionDiff");
+    msgpack_uint64(&writer, module->best_session_nonce_diff);
+    msgpack_str(&writer, "stratumDiff");
+    msgpack_uint32(&writer, GLOBAL_STATE->stratum_difficulty);
+    msgpack_str(&writer, "isUsingFallbackStratum");
+    msgpack_bool(&writer, module->is_using_fallback);
+    msgpack_str(&writer, "powerCapActive");
+    msgpack_bool(&writer, power->power_capped);
+
+    if (writer.overflow) {
+        ESP_LOGE(TAG, "Metrics payload does not fit the response buffer");
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Response too large");
+    }
+
+    char etag[12];
+    snprintf(etag, sizeof(etag), "\"%08lx\"", (unsigned long) esp_rom_crc32_le(0, writer.buf, writer.len));
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    char if_none_match[64];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+        (strstr(if_none_match, etag) || strcmp(if_none_match, "*") == 0)) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    httpd_resp_set_type(req, "application/msgpack");
+    return httpd_resp_send(req, (const char *) writer.buf, writer.len);
+}
+
+// Tasks whose stack high-water mark is exported, a task that is not running is skipped
+static const char * const metrics_tasks[] = {
+    "SYSTEM_task", "sensors", "power management", "telemetry", "stratum admin", "stratum miner",
+    "asic", "asic result", "websocket_publish", "httpd", "nvs flush", "log writer",
+};
+
+static void openmetrics_heap(openmetrics_stream_t * om, const char * name, const char * help,
+                             size_t (*read)(uint32_t caps))
+{
+    openmetrics_family(om, name, "gauge", help);
+    openmetrics_sample_uint(om, name, "pool", "internal", read(MALLOC_CAP_INTERNAL));
+    openmetrics_sample_uint(om, name, "pool", "psram", read(MALLOC_CAP_SPIRAM));
+}
+
+/* Handler for Prometheus scrapes in the OpenMetrics text format, streamed as it is written */
+static esp_err_t GET_openmetrics(httpd_req_t * req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    httpd_resp_set_type(req, OPENMETRICS_CONTENT_TYPE);
 
     // Set CORS headers
     if (set_cors_headers(req) != ESP_OK) {
@@ -1269,46 +1664,115 @@ static esp_err_t GET_critical_logs(httpd_req_t * req)
         return ESP_OK;
     }
 
-    // Parse query parameters for limit
-    int limit = 0; // Default: return all critical events
-    char query_buf[128];
-    if (httpd_req_get_url_query_str(req, query_buf, sizeof(query_buf)) == ESP_OK) {
-        char limit_str[16];
-        if (httpd_query_key_value(query_buf, "limit", limit_str, sizeof(limit_str)) == ESP_OK) {
-            int parsed_limit = atoi(limit_str);
-            if (parsed_limit > 0) {
-                limit = parsed_limit;
-            }
+    PowerManagementModule * power = &GLOBAL_STATE->POWER_MANAGEMENT_MODULE;
+    SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
+    openmetrics_stream_t om;
+    openmetrics_init(&om, req, json_response_buffer, sizeof(json_response_buffer));
+
+    openmetrics_family(&om, "espminer_hashrate_ghs", "gauge", "Hashrate in GH/s over the given window");
+    openmetrics_sample(&om, "espminer_hashrate_ghs", "window", "current", module->current_hashrate);
+    openmetrics_sample(&om, "espminer_hashrate_ghs", "window", "1m", newest_telemetry_hashrate(TELEMETRY_RES_1M));
+    openmetrics_sample(&om, "espminer_hashrate_ghs", "window", "1h", newest_telemetry_hashrate(TELEMETRY_RES_1H));
+
+    openmetrics_family(&om, "espminer_shares_accepted", "counter", "Shares accepted by the pool");
+    openmetrics_sample_uint(&om, "espminer_shares_accepted_total", NULL, NULL, module->shares_accepted);
+    openmetrics_family(&om, "espminer_shares_rejected", "counter", "Shares rejected by the pool, by the reason it gave");
+    for (int i = 0; i < REJECT_REASON_COUNT; i++) {
+        const RejectedShares * rejected = &module->shares_rejected_by_reason[i];
+        if (rejected->reason[0] != '\0') {
+            openmetrics_sample_uint(&om, "espminer_shares_rejected_total", "reason", rejected->reason, rejected->count);
         }
     }
 
-    // Get critical logs from database
-    cJSON* logs_json = NULL;
-    esp_err_t ret = dataBase_get_critical_logs(limit, &logs_json);
-    
-    if (ret != ESP_OK || logs_json == NULL) {
-        ESP_LOGW(TAG, "Failed to get critical logs from database, returning empty response");
-        // Return empty critical logs response
-        cJSON* empty_response = cJSON_CreateObject();
-        cJSON_AddArrayToObject(empty_response, "critical");
-        cJSON_AddNumberToObject(empty_response, "count", 0);
-        cJSON_AddNumberToObject(empty_response, "totalCritical", 0);
-        cJSON_AddNumberToObject(empty_response, "lastCritical", 0);
-        
-        const char* response_str = cJSON_Print(empty_response);
-        httpd_resp_sendstr(req, response_str);
-        free((char*)response_str);
-        cJSON_Delete(empty_response);
-        return ESP_OK;
+    openmetrics_family(&om, "espminer_nonces", "counter", "Nonces returned by the ASIC chain");
+    openmetrics_sample_uint(&om, "espminer_nonces_total", NULL, NULL, module->nonces_found);
+    openmetrics_family(&om, "espminer_invalid_job_nonces", "counter", "Nonces returned for a job that is no longer valid");
+    openmetrics_sample_uint(&om, "espminer_invalid_job_nonces_total", NULL, NULL, module->invalid_job_nonces);
+    openmetrics_family(&om, "espminer_asic_count", "gauge", "ASICs on the chain");
+    openmetrics_sample_uint(&om, "espminer_asic_count", NULL, NULL, GLOBAL_STATE->asic_count);
+
+    static const char * const chain_pools[] = {"primary", "fallback"};
+    ChainState chains[2];
+    for (int i = 0; i < 2; i++) {
+        SYSTEM_copy_chain_state(GLOBAL_STATE, i, &chains[i]);
+    }
+    openmetrics_family(&om, "espminer_block_height", "gauge", "Block height from the pool's coinbase, 0 until known");
+    for (int i = 0; i < 2; i++) {
+        openmetrics_sample_uint(&om, "espminer_block_height", "pool", chain_pools[i], chains[i].block_height);
+    }
+    openmetrics_family(&om, "espminer_network_difficulty", "gauge", "Network difficulty from the pool's nBits");
+    for (int i = 0; i < 2; i++) {
+        openmetrics_sample(&om, "espminer_network_difficulty", "pool", chain_pools[i], chains[i].network_difficulty);
+    }
+    openmetrics_family(&om, "espminer_block_changes", "counter", "New blocks announced by the pool");
+    for (int i = 0; i < 2; i++) {
+        openmetrics_sample_uint(&om, "espminer_block_changes_total", "pool", chain_pools[i], chains[i].block_changes);
     }
 
-    // Send the critical logs response
-    const char* logs_str = cJSON_Print(logs_json);
-    httpd_resp_sendstr(req, logs_str);
-    free((char*)logs_str);
-    cJSON_Delete(logs_json);
-    
-    return ESP_OK;
+    openmetrics_family(&om, "espminer_queue_depth", "gauge", "Entries waiting in a job queue");
+    openmetrics_sample_uint(&om, "espminer_queue_depth", "queue", "stratum", GLOBAL_STATE->stratum_queue.count);
+    openmetrics_sample_uint(&om, "espminer_queue_depth", "queue", "asic_jobs", GLOBAL_STATE->ASIC_jobs_queue.count);
+
+    openmetrics_family(&om, "espminer_notify_to_job_seconds", "histogram",
+                       "Time from receiving mining.notify to building the first job for it");
+    uint64_t cumulative = 0;
+    for (int i = 0; i < NOTIFY_LATENCY_BUCKETS; i++) {
+        char le[16] = "+Inf";
+        if (i < NOTIFY_LATENCY_BUCKETS - 1) {
+            snprintf(le, sizeof(le), "%g", SYSTEM_notify_latency_bounds_us[i] / 1e6);
+        }
+        cumulative += module->notify_latency_buckets[i];
+        openmetrics_sample_uint(&om, "espminer_notify_to_job_seconds_bucket", "le", le, cumulative);
+    }
+    openmetrics_sample(&om, "espminer_notify_to_job_seconds_sum", NULL, NULL, module->notify_latency_sum_us / 1e6);
+    openmetrics_sample_uint(&om, "espminer_notify_to_job_seconds_count", NULL, NULL, module->notify_latency_count);
+
+    openmetrics_heap(&om, "espminer_heap_free_bytes", "Free heap by memory pool", heap_caps_get_free_size);
+    openmetrics_heap(&om, "espminer_heap_min_free_bytes", "Lowest free heap since boot by memory pool",
+                     heap_caps_get_minimum_free_size);
+    openmetrics_heap(&om, "espminer_heap_size_bytes", "Total heap by memory pool", heap_caps_get_total_size);
+
+    openmetrics_family(&om, "espminer_task_stack_free_bytes", "gauge", "Lowest free stack a task has had");
+    for (size_t i = 0; i < sizeof(metrics_tasks) / sizeof(metrics_tasks[0]); i++) {
+        TaskHandle_t task = xTaskGetHandle(metrics_tasks[i]);
+        if (task) {
+            openmetrics_sample_uint(&om, "espminer_task_stack_free_bytes", "task", metrics_tasks[i],
+                                    uxTaskGetStackHighWaterMark(task));
+        }
+    }
+
+    wifi_ap_record_t ap_info;
+    if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
+        openmetrics_family(&om, "espminer_wifi_rssi_dbm", "gauge", "Signal strength of the connected access point");
+        openmetrics_sample(&om, "espminer_wifi_rssi_dbm", NULL, NULL, ap_info.rssi);
+    }
+
+    openmetrics_family(&om, "espminer_temperature_celsius", "gauge", "Temperature by sensor");
+    openmetrics_sample(&om, "espminer_temperature_celsius", "sensor", "asic", power->chip_temp_avg);
+    openmetrics_sample(&om, "espminer_temperature_celsius", "sensor", "vr", power->vr_temp);
+    openmetrics_family(&om, "espminer_power_watts", "gauge", "Input power");
+    openmetrics_sample(&om, "espminer_power_watts", NULL, NULL, power->power);
+    openmetrics_family(&om, "espminer_voltage_volts", "gauge", "Voltage by rail");
+    openmetrics_sample(&om, "espminer_voltage_volts", "rail", "input", power->voltage / 1000.0);
+    openmetrics_sample(&om, "espminer_voltage_volts", "rail", "core", VCORE_get_voltage_mv(GLOBAL_STATE) / 1000.0);
+    openmetrics_family(&om, "espminer_current_amperes", "gauge", "Input current");
+    openmetrics_sample(&om, "espminer_current_amperes", NULL, NULL, power->current / 1000.0);
+    openmetrics_family(&om, "espminer_frequency_mhz", "gauge", "ASIC frequency in MHz");
+    openmetrics_sample(&om, "espminer_frequency_mhz", NULL, NULL, power->frequency_value);
+    openmetrics_family(&om, "espminer_fan_rpm", "gauge", "Fan speed");
+    openmetrics_sample_uint(&om, "espminer_fan_rpm", NULL, NULL, power->fan_rpm);
+
+    openmetrics_family(&om, "espminer_uptime_seconds", "gauge", "Time since boot");
+    openmetrics_sample(&om, "espminer_uptime_seconds", NULL, NULL, (esp_timer_get_time() - module->start_time) / 1e6);
+
+    return openmetrics_finish(&om);
+}
+
+// Setting close_fn leaves closing the socket to us
+static void close_session(httpd_handle_t hd, int sockfd)
+{
+    ws_api_session_closed(sockfd);
+    close(sockfd);
 }
 
 esp_err_t start_rest_server(void * pvParameters)
@@ -1321,6 +1785,8 @@ esp_err_t start_rest_server(void * pvParameters)
         // Unable to initialize the web app filesystem.
         // Enter recovery mode
         enter_recovery = true;
+    } else if (static_assets_init(base_path) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to build the web app manifest, serving straight from the filesystem");
     }
     
     // Initialize data partition database (independent of www partition)
@@ -1334,16 +1800,25 @@ esp_err_t start_rest_server(void * pvParameters)
     REST_CHECK(rest_context, "No memory for rest context", err);
     strlcpy(rest_context->base_path, base_path, sizeof(rest_context->base_path));
 
-    log_queue = xQueueCreate(MESSAGE_QUEUE_SIZE, sizeof(char*));
-
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.uri_match_fn = httpd_uri_match_wildcard;
     config.max_open_sockets = 10;
-    config.max_uri_handlers = 20;
+    config.max_uri_handlers = 32;
+    // Requests held by the workers keep their sockets, close idle ones so polls still get through
+    config.lru_purge_enable = true;
+    config.close_fn = close_session;
+
+    if (ota_stream_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start the OTA writer, updates are refused");
+    }
 
     ESP_LOGI(TAG, "Starting HTTP Server");
     REST_CHECK(httpd_start(&server, &config) == ESP_OK, "Start server failed", err_start);
 
+    if (http_workers_start() != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to start the HTTP workers, long requests run on the server task");
+    }
+
     httpd_uri_t recovery_explicit_get_uri = {
         .uri = "/recovery", 
         .method = HTTP_GET, 
@@ -1412,6 +1887,14 @@ esp_err_t start_rest_server(void * pvParameters)
     };
     httpd_register_uri_handler(server, &update_post_ota_firmware);
 
+    httpd_uri_t update_get_ota_status = {
+        .uri = "/api/system/OTA/status",
+        .method = HTTP_GET,
+        .handler = GET_OTA_status,
+        .user_ctx = NULL
+    };
+    httpd_register_uri_handler(server, &update_get_ota_status);
+
     httpd_uri_t update_post_ota_www = {
         .uri = "/api/system/OTAWWW", 
         .method = HTTP_POST, 
@@ -1429,6 +1912,30 @@ esp_err_t start_rest_server(void * pvParameters)
     };
     httpd_register_uri_handler(server, &update_post_ota_www_alt);
 
+    httpd_uri_t fleet_manifest_get_uri = {
+        .uri = "/api/fleet/manifest",
+        .method = HTTP_GET,
+        .handler = GET_fleet_manifest,
+        .user_ctx = rest_context
+    };
+    httpd_register_uri_handler(server, &fleet_manifest_get_uri);
+
+    httpd_uri_t fleet_chunk_get_uri = {
+        .uri = "/api/fleet/chunk",
+        .method = HTTP_GET,
+        .handler = GET_fleet_chunk,
+        .user_ctx = rest_context
+    };
+    httpd_register_uri_handler(server, &fleet_chunk_get_uri);
+
+    httpd_uri_t fleet_status_get_uri = {
+        .uri = "/api/fleet/status",
+        .method = HTTP_GET,
+        .handler = GET_fleet_status,
+        .user_ctx = rest_context
+    };
+    httpd_register_uri_handler(server, &fleet_status_get_uri);
+
     /* URI handler for fetching recent logs */
     httpd_uri_t logs_recent_get_uri = {
         .uri = "/api/logs/recent", 
@@ -1456,14 +1963,32 @@ esp_err_t start_rest_server(void * pvParameters)
     };
     httpd_register_uri_handler(server, &logs_critical_get_uri);
 
-    httpd_uri_t ws = {
-        .uri = "/api/ws", 
+    /* URI handler for downloading telemetry history */
+    httpd_uri_t telemetry_get_uri = {
+        .uri = "/api/system/telemetry", 
+        .method = HTTP_GET, 
+        .handler = GET_telemetry, 
+        .user_ctx = rest_context
+    };
+    httpd_register_uri_handler(server, &telemetry_get_uri);
+
+    httpd_uri_t metrics_get_uri = {
+        .uri = "/api/system/metrics", 
+        .method = HTTP_GET, 
+        .handler = GET_metrics, 
+        .user_ctx = rest_context
+    };
+    httpd_register_uri_handler(server, &metrics_get_uri);
+
+    httpd_uri_t openmetrics_get_uri = {
+        .uri = "/metrics", 
         .method = HTTP_GET, 
-        .handler = echo_handler, 
-        .user_ctx = NULL, 
-        .is_websocket = true
+        .handler = GET_openmetrics, 
+        .user_ctx = rest_context
     };
-    httpd_register_uri_handler(server, &ws);
+    httpd_register_uri_handler(server, &openmetrics_get_uri);
+
+    ESP_ERROR_CHECK(register_ws_api_endpoints(server, GLOBAL_STATE));
 
 
     if (enter_recovery) {
@@ -1488,9 +2013,6 @@ esp_err_t start_rest_server(void * pvParameters)
 
     httpd_register_err_handler(server, HTTPD_404_NOT_FOUND, http_404_error_handler);
 
-    // Start websocket log handler thread
-    xTaskCreate(&websocket_log_handler, "websocket_log_handler", 4096, NULL, 2, NULL);
-
     // Start the DNS server that will redirect all queries to the softAP IP
     dns_server_config_t dns_config = DNS_SERVER_CONFIG_SINGLE("*" /* all A queries */, "WIFI_AP_DEF" /* softAP netif ID */);
     start_dns_server(&dns_config);
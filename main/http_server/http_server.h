@@ -4,4 +4,7 @@
 
 esp_err_t start_rest_server(void *pvParameters);
 
+// ESP_OK when the request comes from a private network or the device is in AP mode
+esp_err_t is_network_allowed(httpd_req_t * req);
+
 #endif
\ No newline at end of file
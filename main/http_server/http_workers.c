@@ -0,0 +1,99 @@
+#include "http_workers.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char * TAG = "http_workers";
+
+#define HTTP_WORK_QUEUE_LEN 8
+#define HTTP_WORKER_STACK 6144
+#define HTTP_WORKER_PRIORITY 4      // Below the httpd task, which runs at tskIDLE_PRIORITY + 5
+
+typedef struct {
+    httpd_req_t * req;              // Async copy, owned by the worker until completed
+    http_worker_handler_t handler;
+} http_work_t;
+
+typedef struct {
+    TaskHandle_t task;
+    char * buffer;
+} http_worker_t;
+
+static http_worker_t workers[HTTP_WORKER_COUNT];
+static QueueHandle_t work_queue = NULL;
+
+static void worker_task(void * pvParameters)
+{
+    while (1) {
+        http_work_t work;
+        xQueueReceive(work_queue, &work, portMAX_DELAY);
+        work.handler(work.req);
+        httpd_req_async_handler_complete(work.req);
+    }
+}
+
+esp_err_t http_workers_start(void)
+{
+    QueueHandle_t queue = xQueueCreate(HTTP_WORK_QUEUE_LEN, sizeof(http_work_t));
+    if (queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    work_queue = queue;
+
+    for (int i = 0; i < HTTP_WORKER_COUNT; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "http worker %d", i);
+        workers[i].buffer = malloc(HTTP_WORKER_BUFSIZE);
+        if (workers[i].buffer == NULL ||
+            xTaskCreate(worker_task, name, HTTP_WORKER_STACK, NULL, HTTP_WORKER_PRIORITY, &workers[i].task) != pdPASS) {
+            // Requests queued so far still have a worker, the rest run on the httpd task
+            ESP_LOGE(TAG, "Failed to start %s", name);
+            free(workers[i].buffer);
+            workers[i].buffer = NULL;
+            if (i == 0) {
+                work_queue = NULL;
+                vQueueDelete(queue);
+            }
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    return ESP_OK;
+}
+
+char * http_workers_buffer(void)
+{
+    TaskHandle_t current = xTaskGetCurrentTaskHandle();
+    for (int i = 0; i < HTTP_WORKER_COUNT; i++) {
+        if (workers[i].task == current) {
+            return workers[i].buffer;
+        }
+    }
+    return NULL;
+}
+
+bool http_workers_defer(httpd_req_t * req, http_worker_handler_t handler)
+{
+    if (work_queue == NULL || http_workers_buffer() != NULL) {
+        return false;
+    }
+    // Only the httpd task queues work, so the space seen here is still there when sending
+    if (uxQueueSpacesAvailable(work_queue) == 0) {
+        ESP_LOGW(TAG, "All workers busy, handling %s on the httpd task", req->uri);
+        return false;
+    }
+
+    http_work_t work = {
+        .handler = handler,
+    };
+    if (httpd_req_async_handler_begin(req, &work.req) != ESP_OK) {
+        return false;
+    }
+    if (xQueueSend(work_queue, &work, 0) != pdTRUE) {
+        httpd_req_async_handler_complete(work.req);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,33 @@
+#ifndef HTTP_WORKERS_H
+#define HTTP_WORKERS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_http_server.h"
+
+// Handlers for long transfers, such as web app files, log queries and OTA uploads, hand
+// their request to a small pool of worker tasks with httpd_req_async_handler_begin. The
+// httpd task then only runs the short API handlers, and the workers run below its
+// priority, so monitoring polls are answered while the UI loads or an image uploads.
+
+#define HTTP_WORKER_COUNT 2
+#define HTTP_WORKER_BUFSIZE 10240
+
+typedef esp_err_t (*http_worker_handler_t)(httpd_req_t * req);
+
+esp_err_t http_workers_start(void);
+
+/**
+ * @brief Queue req for handler on a worker, call first thing in the handler
+ *
+ * @return true when the request was queued, the handler returns ESP_OK right away.
+ *         false on a worker, before http_workers_start, or when the queue is full,
+ *         the handler goes on in the current task.
+ */
+bool http_workers_defer(httpd_req_t * req, http_worker_handler_t handler);
+
+// The calling worker's buffer of HTTP_WORKER_BUFSIZE bytes, NULL outside a worker.
+// The shared buffers of the HTTP server belong to the httpd task.
+char * http_workers_buffer(void);
+
+#endif // HTTP_WORKERS_H
@@ -0,0 +1,122 @@
+#include "json_stream.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+
+static void stream_write_quoted(json_stream_t * stream, const char * value)
+{
+    chunk_writer_write(&stream->out, "\"", 1);
+    const char * run = value;
+    for (const char * p = value; *p; p++) {
+        unsigned char c = *p;
+        if (c != '"' && c != '\\' && c >= 0x20) {
+            continue;
+        }
+        chunk_writer_write(&stream->out, run, p - run);
+        run = p + 1;
+        switch (c) {
+            case '"': chunk_writer_write(&stream->out, "\\\"", 2); break;
+            case '\\': chunk_writer_write(&stream->out, "\\\\", 2); break;
+            case '\n': chunk_writer_write(&stream->out, "\\n", 2); break;
+            case '\r': chunk_writer_write(&stream->out, "\\r", 2); break;
+            case '\t': chunk_writer_write(&stream->out, "\\t", 2); break;
+            default: {
+                char escape[7];
+                snprintf(escape, sizeof(escape), "\\u%04x", c);
+                chunk_writer_write(&stream->out, escape, 6);
+                break;
+            }
+        }
+    }
+    chunk_writer_write_str(&stream->out, run);
+    chunk_writer_write(&stream->out, "\"", 1);
+}
+
+// Separator and key in front of every value
+static void stream_write_prefix(json_stream_t * stream, const char * key)
+{
+    if (stream->need_comma) {
+        chunk_writer_write(&stream->out, ",", 1);
+    }
+    if (key) {
+        stream_write_quoted(stream, key);
+        chunk_writer_write(&stream->out, ":", 1);
+    }
+    stream->need_comma = true;
+}
+
+void json_stream_init(json_stream_t * stream, httpd_req_t * req, char * buf, size_t size)
+{
+    chunk_writer_init(&stream->out, req, buf, size);
+    stream->need_comma = false;
+}
+
+void json_stream_begin_object(json_stream_t * stream, const char * key)
+{
+    stream_write_prefix(stream, key);
+    chunk_writer_write(&stream->out, "{", 1);
+    stream->need_comma = false;
+}
+
+void json_stream_end_object(json_stream_t * stream)
+{
+    chunk_writer_write(&stream->out, "}", 1);
+    stream->need_comma = true;
+}
+
+void json_stream_begin_array(json_stream_t * stream, const char * key)
+{
+    stream_write_prefix(stream, key);
+    chunk_writer_write(&stream->out, "[", 1);
+    stream->need_comma = false;
+}
+
+void json_stream_end_array(json_stream_t * stream)
+{
+    chunk_writer_write(&stream->out, "]", 1);
+    stream->need_comma = true;
+}
+
+void json_stream_add_string(json_stream_t * stream, const char * key, const char * value)
+{
+    stream_write_prefix(stream, key);
+    stream_write_quoted(stream, value ? value : "");
+}
+
+void json_stream_add_int(json_stream_t * stream, const char * key, int64_t value)
+{
+    char num[24];
+    stream_write_prefix(stream, key);
+    snprintf(num, sizeof(num), "%" PRId64, value);
+    chunk_writer_write_str(&stream->out, num);
+}
+
+void json_stream_add_number(json_stream_t * stream, const char * key, double value)
+{
+    char num[32];
+    stream_write_prefix(stream, key);
+    if (!isfinite(value)) {
+        chunk_writer_write_str(&stream->out, "null");
+        return;
+    }
+    // Same precision cJSON prints with
+    snprintf(num, sizeof(num), "%1.15g", value);
+    chunk_writer_write_str(&stream->out, num);
+}
+
+void json_stream_add_bool(json_stream_t * stream, const char * key, bool value)
+{
+    stream_write_prefix(stream, key);
+    chunk_writer_write_str(&stream->out, value ? "true" : "false");
+}
+
+void json_stream_add_raw(json_stream_t * stream, const char * key, const char * value)
+{
+    stream_write_prefix(stream, key);
+    chunk_writer_write_str(&stream->out, value);
+}
+
+esp_err_t json_stream_finish(json_stream_t * stream)
+{
+    return chunk_writer_finish(&stream->out);
+}
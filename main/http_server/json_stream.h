@@ -0,0 +1,36 @@
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "chunk_writer.h"
+
+// Writes JSON straight into a chunked HTTP response through a fixed buffer, no
+// document is built in memory. Keys are NULL for array elements. After the first
+// failed send everything else is dropped and json_stream_finish reports the error.
+typedef struct {
+    chunk_writer_t out;
+    bool need_comma;    // A value was written since the last { or [
+} json_stream_t;
+
+void json_stream_init(json_stream_t * stream, httpd_req_t * req, char * buf, size_t size);
+
+void json_stream_begin_object(json_stream_t * stream, const char * key);
+void json_stream_end_object(json_stream_t * stream);
+void json_stream_begin_array(json_stream_t * stream, const char * key);
+void json_stream_end_array(json_stream_t * stream);
+
+void json_stream_add_string(json_stream_t * stream, const char * key, const char * value);
+void json_stream_add_int(json_stream_t * stream, const char * key, int64_t value);
+// Non-finite values are written as null
+void json_stream_add_number(json_stream_t * stream, const char * key, double value);
+void json_stream_add_bool(json_stream_t * stream, const char * key, bool value);
+// value must already be valid JSON
+void json_stream_add_raw(json_stream_t * stream, const char * key, const char * value);
+
+/**
+ * @brief Send what is buffered and end the chunked response
+ */
+esp_err_t json_stream_finish(json_stream_t * stream);
+
+#endif // JSON_STREAM_H
@@ -0,0 +1,94 @@
+#include "msgpack.h"
+#include <string.h>
+
+static void put(msgpack_writer_t * writer, const void * data, size_t len)
+{
+    if (writer->overflow || writer->size - writer->len < len) {
+        writer->overflow = true;
+        return;
+    }
+    memcpy(writer->buf + writer->len, data, len);
+    writer->len += len;
+}
+
+// Type byte followed by a big-endian value of size bytes
+static void put_be(msgpack_writer_t * writer, uint8_t type, uint64_t value, int size)
+{
+    uint8_t out[9];
+    out[0] = type;
+    for (int i = 0; i < size; i++) {
+        out[size - i] = (uint8_t) (value >> (8 * i));
+    }
+    put(writer, out, size + 1);
+}
+
+void msgpack_init(msgpack_writer_t * writer, uint8_t * buf, size_t size)
+{
+    writer->buf = buf;
+    writer->size = size;
+    writer->len = 0;
+    writer->overflow = false;
+}
+
+void msgpack_map(msgpack_writer_t * writer, uint32_t count)
+{
+    if (count < 16) {
+        uint8_t type = 0x80 | count;
+        put(writer, &type, 1);
+    } else if (count <= UINT16_MAX) {
+        put_be(writer, 0xde, count, 2);
+    } else {
+        put_be(writer, 0xdf, count, 4);
+    }
+}
+
+void msgpack_array(msgpack_writer_t * writer, uint32_t count)
+{
+    if (count < 16) {
+        uint8_t type = 0x90 | count;
+        put(writer, &type, 1);
+    } else if (count <= UINT16_MAX) {
+        put_be(writer, 0xdc, count, 2);
+    } else {
+        put_be(writer, 0xdd, count, 4);
+    }
+}
+
+void msgpack_str(msgpack_writer_t * writer, const char * value)
+{
+    size_t len = strlen(value);
+    if (len < 32) {
+        uint8_t type = 0xa0 | len;
+        put(writer, &type, 1);
+    } else if (len <= UINT8_MAX) {
+        put_be(writer, 0xd9, len, 1);
+    } else if (len <= UINT16_MAX) {
+        put_be(writer, 0xda, len, 2);
+    } else {
+        put_be(writer, 0xdb, len, 4);
+    }
+    put(writer, value, len);
+}
+
+void msgpack_uint32(msgpack_writer_t * writer, uint32_t value)
+{
+    put_be(writer, 0xce, value, 4);
+}
+
+void msgpack_uint64(msgpack_writer_t * writer, uint64_t value)
+{
+    put_be(writer, 0xcf, value, 8);
+}
+
+void msgpack_float(msgpack_writer_t * writer, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    put_be(writer, 0xca, bits, 4);
+}
+
+void msgpack_bool(msgpack_writer_t * writer, bool value)
+{
+    uint8_t type = value ? 0xc3 : 0xc2;
+    put(writer, &type, 1);
+}
@@ -0,0 +1,28 @@
+#ifndef MSGPACK_H
+#define MSGPACK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Minimal MessagePack encoder into a caller buffer. Numbers are always written with
+// their full-width type, so a fixed sequence of calls gives a fixed payload layout.
+// Writes past the end of the buffer are dropped and flagged in overflow.
+typedef struct {
+    uint8_t * buf;
+    size_t size;
+    size_t len;
+    bool overflow;
+} msgpack_writer_t;
+
+void msgpack_init(msgpack_writer_t * writer, uint8_t * buf, size_t size);
+
+void msgpack_map(msgpack_writer_t * writer, uint32_t count);
+void msgpack_array(msgpack_writer_t * writer, uint32_t count);
+void msgpack_str(msgpack_writer_t * writer, const char * value);
+void msgpack_uint32(msgpack_writer_t * writer, uint32_t value);
+void msgpack_uint64(msgpack_writer_t * writer, uint64_t value);
+void msgpack_float(msgpack_writer_t * writer, float value);
+void msgpack_bool(msgpack_writer_t * writer, bool value);
+
+#endif // MSGPACK_H
@@ -0,0 +1,87 @@
+#include "openmetrics.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+static void stream_write_escaped(openmetrics_stream_t * stream, const char * value, bool quotes)
+{
+    const char * run = value;
+    for (const char * p = value; *p; p++) {
+        if (*p != '\\' && *p != '\n' && (*p != '"' || !quotes)) {
+            continue;
+        }
+        chunk_writer_write(&stream->out, run, p - run);
+        run = p + 1;
+        switch (*p) {
+            case '\\': chunk_writer_write(&stream->out, "\\\\", 2); break;
+            case '\n': chunk_writer_write(&stream->out, "\\n", 2); break;
+            default: chunk_writer_write(&stream->out, "\\\"", 2); break;
+        }
+    }
+    chunk_writer_write_str(&stream->out, run);
+}
+
+static void stream_write_name(openmetrics_stream_t * stream, const char * name, const char * label_name,
+                              const char * label_value)
+{
+    chunk_writer_write_str(&stream->out, name);
+    if (label_name) {
+        chunk_writer_write(&stream->out, "{", 1);
+        chunk_writer_write_str(&stream->out, label_name);
+        chunk_writer_write(&stream->out, "=\"", 2);
+        stream_write_escaped(stream, label_value ? label_value : "", true);
+        chunk_writer_write(&stream->out, "\"}", 2);
+    }
+    chunk_writer_write(&stream->out, " ", 1);
+}
+
+void openmetrics_init(openmetrics_stream_t * stream, httpd_req_t * req, char * buf, size_t size)
+{
+    chunk_writer_init(&stream->out, req, buf, size);
+}
+
+void openmetrics_family(openmetrics_stream_t * stream, const char * name, const char * type, const char * help)
+{
+    chunk_writer_write_str(&stream->out, "# TYPE ");
+    chunk_writer_write_str(&stream->out, name);
+    chunk_writer_write(&stream->out, " ", 1);
+    chunk_writer_write_str(&stream->out, type);
+    chunk_writer_write_str(&stream->out, "\n# HELP ");
+    chunk_writer_write_str(&stream->out, name);
+    chunk_writer_write(&stream->out, " ", 1);
+    stream_write_escaped(stream, help, false);
+    chunk_writer_write(&stream->out, "\n", 1);
+}
+
+void openmetrics_sample(openmetrics_stream_t * stream, const char * name, const char * label_name,
+                        const char * label_value, double value)
+{
+    char num[32];
+    stream_write_name(stream, name, label_name, label_value);
+    if (isnan(value)) {
+        strcpy(num, "NaN");
+    } else if (isinf(value)) {
+        strcpy(num, value > 0 ? "+Inf" : "-Inf");
+    } else {
+        snprintf(num, sizeof(num), "%.10g", value);
+    }
+    chunk_writer_write_str(&stream->out, num);
+    chunk_writer_write(&stream->out, "\n", 1);
+}
+
+void openmetrics_sample_uint(openmetrics_stream_t * stream, const char * name, const char * label_name,
+                             const char * label_value, uint64_t value)
+{
+    char num[24];
+    stream_write_name(stream, name, label_name, label_value);
+    snprintf(num, sizeof(num), "%" PRIu64 "\n", value);
+    chunk_writer_write_str(&stream->out, num);
+}
+
+esp_err_t openmetrics_finish(openmetrics_stream_t * stream)
+{
+    chunk_writer_write_str(&stream->out, "# EOF\n");
+    return chunk_writer_finish(&stream->out);
+}
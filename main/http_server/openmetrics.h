@@ -0,0 +1,32 @@
+#ifndef OPENMETRICS_H
+#define OPENMETRICS_H
+
+#include <stdint.h>
+#include "chunk_writer.h"
+
+#define OPENMETRICS_CONTENT_TYPE "application/openmetrics-text; version=1.0.0; charset=utf-8"
+
+// Writes the OpenMetrics text format straight into a chunked HTTP response through a
+// fixed buffer, the same way json_stream does for JSON. Samples take at most one label,
+// label_name is NULL for none. After the first failed send everything else is dropped
+// and openmetrics_finish reports the error.
+typedef struct {
+    chunk_writer_t out;
+} openmetrics_stream_t;
+
+void openmetrics_init(openmetrics_stream_t * stream, httpd_req_t * req, char * buf, size_t size);
+
+// TYPE and HELP lines, name is the family name without the _total, _bucket, ... suffix
+void openmetrics_family(openmetrics_stream_t * stream, const char * name, const char * type, const char * help);
+
+void openmetrics_sample(openmetrics_stream_t * stream, const char * name, const char * label_name,
+                        const char * label_value, double value);
+void openmetrics_sample_uint(openmetrics_stream_t * stream, const char * name, const char * label_name,
+                             const char * label_value, uint64_t value);
+
+/**
+ * @brief Write the # EOF marker, send what is buffered and end the chunked response
+ */
+esp_err_t openmetrics_finish(openmetrics_stream_t * stream);
+
+#endif // OPENMETRICS_H
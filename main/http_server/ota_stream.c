@@ -0,0 +1,364 @@
+#include "ota_stream.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "mbedtls/sha256.h"
+#include "utils.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+static const char * TAG = "ota_stream";
+
+#define OTA_BLOCK_SIZE 4096
+#define OTA_BLOCK_COUNT 2
+#define OTA_SECTOR_SIZE 4096
+#define OTA_RECV_TIMEOUTS 10                        // Consecutive receive timeouts before a connection counts as dropped
+#define OTA_SESSION_TIMEOUT_US (10 * 60 * 1000000LL) // An update that is not resumed within this is discarded
+
+typedef struct {
+    uint8_t * data;
+    size_t len;
+} ota_block_t;
+
+typedef struct {
+    bool active;
+    ota_target_t target;
+    const esp_partition_t * partition;
+    esp_ota_handle_t ota_handle;        // Firmware only
+    size_t total;
+    size_t offset;                      // Written by the writer task, read after a sync
+    size_t erased_to;                   // www only, everything below is erased
+    bool has_sha;
+    uint8_t expected_sha[32];
+    mbedtls_sha256_context sha;
+    int64_t last_activity_us;
+    esp_err_t write_err;                // First error of the writer task, ends the update
+} ota_session_t;
+
+static ota_session_t session;
+static char last_sha_hex[65];               // Of the last image received in full
+static ota_block_t blocks[OTA_BLOCK_COUNT];
+static QueueHandle_t free_blocks = NULL;
+static QueueHandle_t full_blocks = NULL;   // A NULL entry asks the writer to report when it got there
+static SemaphoreHandle_t writer_synced = NULL;
+static SemaphoreHandle_t receive_lock = NULL;     // Uploads can arrive on several HTTP workers
+
+static esp_err_t write_block(const uint8_t * data, size_t len)
+{
+    if (session.target == OTA_TARGET_FIRMWARE) {
+        return esp_ota_write(session.ota_handle, data, len);
+    }
+
+    // Erase only the sectors the image reaches instead of the whole partition up front
+    size_t end = session.offset + len;
+    while (session.erased_to < end) {
+        esp_err_t err = esp_partition_erase_range(session.partition, session.erased_to, OTA_SECTOR_SIZE);
+        if (err != ESP_OK) {
+            return err;
+        }
+        session.erased_to += OTA_SECTOR_SIZE;
+    }
+    return esp_partition_write(session.partition, session.offset, data, len);
+}
+
+static void writer_task(void * pvParameters)
+{
+    while (1) {
+        ota_block_t * block;
+        xQueueReceive(full_blocks, &block, portMAX_DELAY);
+        if (block == NULL) {
+            xSemaphoreGive(writer_synced);
+            continue;
+        }
+
+        if (session.write_err == ESP_OK) {
+            session.write_err = write_block(block->data, block->len);
+            if (session.write_err == ESP_OK) {
+                mbedtls_sha256_update(&session.sha, block->data, block->len);
+                session.offset += block->len;
+            } else {
+                ESP_LOGE(TAG, "Flash write at %u failed: %s", (unsigned) session.offset, esp_err_to_name(session.write_err));
+            }
+        }
+        block->len = 0;
+        xQueueSend(free_blocks, &block, portMAX_DELAY);
+    }
+}
+
+static void ota_stream_free(void)
+{
+    for (int i = 0; i < OTA_BLOCK_COUNT; i++) {
+        free(blocks[i].data);
+        blocks[i].data = NULL;
+    }
+    if (free_blocks != NULL) {
+        vQueueDelete(free_blocks);
+        free_blocks = NULL;
+    }
+    if (full_blocks != NULL) {
+        vQueueDelete(full_blocks);
+        full_blocks = NULL;
+    }
+    if (receive_lock != NULL) {
+        vSemaphoreDelete(receive_lock);
+        receive_lock = NULL;
+    }
+    if (writer_synced != NULL) {
+        vSemaphoreDelete(writer_synced);
+        writer_synced = NULL;
+    }
+}
+
+esp_err_t ota_stream_init(void)
+{
+    if (receive_lock != NULL) {
+        return ESP_OK;
+    }
+
+    free_blocks = xQueueCreate(OTA_BLOCK_COUNT, sizeof(ota_block_t *));
+    full_blocks = xQueueCreate(OTA_BLOCK_COUNT + 1, sizeof(ota_block_t *));
+    writer_synced = xSemaphoreCreateBinary();
+    SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+    if (free_blocks == NULL || full_blocks == NULL || writer_synced == NULL || lock == NULL) {
+        if (lock != NULL) {
+            vSemaphoreDelete(lock);
+        }
+        ota_stream_free();
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < OTA_BLOCK_COUNT; i++) {
+        blocks[i].data = malloc(OTA_BLOCK_SIZE);
+        if (blocks[i].data == NULL) {
+            vSemaphoreDelete(lock);
+            ota_stream_free();
+            return ESP_ERR_NO_MEM;
+        }
+        ota_block_t * block = &blocks[i];
+        xQueueSend(free_blocks, &block, 0);
+    }
+    if (xTaskCreate(writer_task, "ota writer", 4096, NULL, 5, NULL) != pdPASS) {
+        vSemaphoreDelete(lock);
+        ota_stream_free();
+        return ESP_ERR_NO_MEM;
+    }
+    // Set last, receiving checks it to tell whether the writer runs
+    receive_lock = lock;
+    return ESP_OK;
+}
+
+// Wait until the writer has flashed every block handed to it
+static void sync_writer(void)
+{
+    ota_block_t * marker = NULL;
+    xQueueSend(full_blocks, &marker, portMAX_DELAY);
+    xSemaphoreTake(writer_synced, portMAX_DELAY);
+}
+
+static void session_abort(void)
+{
+    if (!session.active) {
+        return;
+    }
+    if (session.target == OTA_TARGET_FIRMWARE) {
+        esp_ota_abort(session.ota_handle);
+    }
+    mbedtls_sha256_free(&session.sha);
+    session.active = false;
+}
+
+static esp_err_t session_begin(httpd_req_t * req, ota_target_t target, size_t total)
+{
+    memset(&session, 0, sizeof(session));
+    session.target = target;
+
+    if (target == OTA_TARGET_FIRMWARE) {
+        session.partition = esp_ota_get_next_update_partition(NULL);
+    } else {
+        session.partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, "www");
+    }
+    if (session.partition == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (total == 0 || total > session.partition->size) {
+        ESP_LOGE(TAG, "Image of %u bytes does not fit the %" PRIu32 " byte partition", (unsigned) total,
+                 session.partition->size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    char sha_hex[65];
+    if (httpd_req_get_hdr_value_len(req, "X-OTA-SHA256") == 64 &&
+        httpd_req_get_hdr_value_str(req, "X-OTA-SHA256", sha_hex, sizeof(sha_hex)) == ESP_OK) {
+        hex2bin(sha_hex, session.expected_sha, sizeof(session.expected_sha));
+        session.has_sha = true;
+    }
+    // A SPIFFS image has no header or signature of its own, older clients and the recovery
+    // page send none either, so without a digest the image is written unchecked
+    if (target == OTA_TARGET_WWW && !session.has_sha) {
+        ESP_LOGW(TAG, "www image without X-OTA-SHA256, it is not verified");
+    }
+
+    if (target == OTA_TARGET_FIRMWARE) {
+        esp_err_t err = esp_ota_begin(session.partition, OTA_WITH_SEQUENTIAL_WRITES, &session.ota_handle);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    mbedtls_sha256_init(&session.sha);
+    mbedtls_sha256_starts(&session.sha, 0);
+    session.total = total;
+    session.active = true;
+    ESP_LOGI(TAG, "Receiving %s image, %u bytes%s", target == OTA_TARGET_FIRMWARE ? "firmware" : "www",
+             (unsigned) total, session.has_sha ? ", SHA-256 given" : "");
+    return ESP_OK;
+}
+
+static esp_err_t session_finish(void)
+{
+    uint8_t sha[32];
+    mbedtls_sha256_finish(&session.sha, sha);
+    if (session.has_sha && memcmp(sha, session.expected_sha, sizeof(sha)) != 0) {
+        // A www image is already in place by now, only a new upload or /recovery repairs it
+        ESP_LOGE(TAG, "SHA-256 mismatch, discarding the update");
+        session_abort();
+        return ESP_ERR_INVALID_CRC;
+    }
+    bin2hex(sha, sizeof(sha), last_sha_hex, sizeof(last_sha_hex));
+    mbedtls_sha256_free(&session.sha);
+    session.active = false;
+
+    if (session.target == OTA_TARGET_FIRMWARE) {
+        // Checks the image, and its signature when signed app images are enabled
+        esp_err_t err = esp_ota_end(session.ota_handle);
+        if (err == ESP_OK) {
+            err = esp_ota_set_boot_partition(session.partition);
+        }
+        return err;
+    }
+    return ESP_OK;
+}
+
+// "bytes first-last/total", false when the header is missing or malformed
+static bool parse_content_range(httpd_req_t * req, size_t * first, size_t * last, size_t * total)
+{
+    char value[64];
+    unsigned long f, l, t;
+    if (httpd_req_get_hdr_value_str(req, "Content-Range", value, sizeof(value)) != ESP_OK ||
+        sscanf(value, "bytes %lu-%lu/%lu", &f, &l, &t) != 3 || f > l || l >= t) {
+        return false;
+    }
+    *first = f;
+    *last = l;
+    *total = t;
+    return true;
+}
+
+static esp_err_t receive(httpd_req_t * req, ota_target_t target)
+{
+    esp_err_t err;
+    size_t first = 0, last = 0, total = req->content_len;
+    bool ranged = parse_content_range(req, &first, &last, &total);
+    if (ranged && req->content_len != last - first + 1) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (session.active && esp_timer_get_time() - session.last_activity_us > OTA_SESSION_TIMEOUT_US) {
+        ESP_LOGW(TAG, "Discarding an update that was not resumed in time");
+        session_abort();
+    }
+
+    if (ranged && first > 0) {
+        if (!session.active || session.target != target || session.total != total || session.offset != first) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        ESP_LOGI(TAG, "Resuming at %u of %u bytes", (unsigned) first, (unsigned) total);
+    } else {
+        session_abort();
+        err = session_begin(req, target, total);
+        if (err != ESP_OK) {
+            session.active = false;
+            return err;
+        }
+    }
+
+    size_t remaining = req->content_len;
+    int timeouts = 0;
+    while (remaining > 0 && session.write_err == ESP_OK) {
+        ota_block_t * block;
+        xQueueReceive(free_blocks, &block, portMAX_DELAY);
+
+        bool dropped = false;
+        while (block->len < OTA_BLOCK_SIZE && remaining > 0) {
+            int recv_len = httpd_req_recv(req, (char *) block->data + block->len, MIN(remaining, OTA_BLOCK_SIZE - block->len));
+            if (recv_len == HTTPD_SOCK_ERR_TIMEOUT && ++timeouts < OTA_RECV_TIMEOUTS) {
+                continue;
+            }
+            if (recv_len <= 0) {
+                dropped = true;
+                break;
+            }
+            timeouts = 0;
+            block->len += recv_len;
+            remaining -= recv_len;
+        }
+
+        if (block->len > 0) {
+            xQueueSend(full_blocks, &block, portMAX_DELAY);
+        } else {
+            xQueueSend(free_blocks, &block, portMAX_DELAY);
+        }
+        if (dropped) {
+            ESP_LOGW(TAG, "Connection dropped with %u bytes of the request left", (unsigned) remaining);
+            break;
+        }
+    }
+
+    // Everything received is kept, the next request resumes right after it
+    sync_writer();
+    session.last_activity_us = esp_timer_get_time();
+
+    if (session.write_err != ESP_OK) {
+        err = session.write_err;
+        session_abort();
+        return err;
+    }
+    if (session.offset < session.total) {
+        return ESP_ERR_NOT_FINISHED;
+    }
+    return session_finish();
+}
+
+esp_err_t ota_stream_receive(httpd_req_t * req, ota_target_t target)
+{
+    if (receive_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xSemaphoreTake(receive_lock, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Another upload is being received");
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = receive(req, target);
+    xSemaphoreGive(receive_lock);
+    return err;
+}
+
+ota_stream_status_t ota_stream_status(void)
+{
+    ota_stream_status_t status = {
+        .active = session.active,
+        .target = session.target,
+        .offset = session.active ? session.offset : 0,
+        .total = session.active ? session.total : 0,
+    };
+    strlcpy(status.sha256, last_sha_hex, sizeof(status.sha256));
+    return status;
+}
@@ -0,0 +1,59 @@
+#ifndef OTA_STREAM_H
+#define OTA_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_http_server.h"
+
+// Receives a firmware or www image over one or more requests. The body is handed from the
+// HTTP task to a writer task through two blocks, so the network and the flash work in
+// parallel, flash sectors are erased as they are reached and a SHA-256 is taken over the
+// stream. A request can carry part of the image with Content-Range: bytes first-last/total,
+// after a dropped connection the upload is resumed from ota_stream_status().offset.
+typedef enum {
+    OTA_TARGET_FIRMWARE,
+    OTA_TARGET_WWW,
+} ota_target_t;
+
+typedef struct {
+    bool active;            // An image is being received
+    ota_target_t target;
+    size_t offset;          // Bytes written and hashed, the next request has to start here
+    size_t total;
+    char sha256[65];        // Hex digest of the last image received in full, empty before
+} ota_stream_status_t;
+
+/**
+ * @brief Create the writer task and its buffers, once before the HTTP server takes requests
+ */
+esp_err_t ota_stream_init(void);
+
+/**
+ * @brief Receive the request body into the image for target
+ *
+ * The first request of an image can send the expected digest as a hex X-OTA-SHA256 header.
+ * It is the only check a www image gets, one sent without it is written unchecked. A firmware
+ * image is also validated by esp_ota_end, which checks its signature when signed app images
+ * are enabled, and set as boot partition.
+ *
+ * There is no spare www partition, a www image is written over the running one as it arrives
+ * and the digest is only known at the end. A www update that fails after its first block
+ * leaves the web app unusable until an image is uploaded again, /recovery is served from the
+ * firmware for that.
+ *
+ * @return ESP_OK when the image is complete and verified
+ *         ESP_ERR_NOT_FINISHED when the body ended before the image did, resume at the offset
+ *         ESP_ERR_INVALID_STATE when Content-Range does not start at the offset, or while
+ *         another request is receiving an image
+ *         ESP_ERR_NO_MEM when ota_stream_init failed
+ *         ESP_ERR_INVALID_SIZE when the image does not fit the partition
+ *         ESP_ERR_INVALID_CRC when the SHA-256 does not match, the update is discarded
+ *         (for www the partition is already overwritten)
+ *         anything else for a flash error, the update is discarded
+ */
+esp_err_t ota_stream_receive(httpd_req_t * req, ota_target_t target);
+
+ota_stream_status_t ota_stream_status(void);
+
+#endif // OTA_STREAM_H
@@ -0,0 +1,401 @@
+#include "static_assets.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_vfs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char * TAG = "static_assets";
+
+#define ASSET_PATH_MAX 48           // SPIFFS object names are at most 32 characters
+#define ASSET_ETAG_SIZE 24
+#define ASSET_CACHE_SIZE (1024 * 1024) // PSRAM kept for cached assets
+#define ASSET_MAX_AGE "max-age=2592000"
+
+typedef struct {
+    char path[ASSET_PATH_MAX];      // Request path, without .gz
+    char etag[ASSET_ETAG_SIZE];     // Quoted, ready for the ETag header
+    size_t size;
+    uint8_t * data;                 // PSRAM copy, NULL while not cached
+    uint32_t last_used;             // LRU clock at the last request
+    uint16_t users;                 // Requests sending from data right now
+    bool stale;                     // Cleared while in use, data is freed by the last user
+} static_asset_t;
+
+typedef struct {
+    size_t count;
+    size_t users;                   // Requests sending from one of its assets
+    bool retired;                   // Replaced or cleared, freed by the last user
+    static_asset_t assets[];
+} asset_manifest_t;
+
+static char asset_base_path[ESP_VFS_PATH_MAX + 1];
+static asset_manifest_t * manifest = NULL;
+static size_t cached_bytes = 0;
+static uint32_t lru_clock = 0;
+static SemaphoreHandle_t assets_lock = NULL;
+
+static bool has_suffix(const char * name, const char * suffix)
+{
+    size_t len = strlen(name);
+    size_t suffix_len = strlen(suffix);
+    return len > suffix_len && strcmp(name + len - suffix_len, suffix) == 0;
+}
+
+static void file_path(char * out, size_t size, const char * path)
+{
+    snprintf(out, size, "%s%s.gz", asset_base_path, path);
+}
+
+static static_asset_t * find_asset(const char * path)
+{
+    for (size_t i = 0; manifest && i < manifest->count; i++) {
+        if (strcmp(manifest->assets[i].path, path) == 0) {
+            return &manifest->assets[i];
+        }
+    }
+    return NULL;
+}
+
+// Read the whole file into buf, false on a short read
+static bool read_file(const char * path, uint8_t * buf, size_t size)
+{
+    char filepath[ESP_VFS_PATH_MAX + ASSET_PATH_MAX + 4];
+    file_path(filepath, sizeof(filepath), path);
+    int fd = open(filepath, O_RDONLY, 0);
+    if (fd == -1) {
+        return false;
+    }
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = read(fd, buf + done, size - done);
+        if (n <= 0) {
+            break;
+        }
+        done += n;
+    }
+    close(fd);
+    return done == size;
+}
+
+// Make room for size bytes by dropping the least recently used assets nobody is sending.
+// Called with assets_lock held.
+static bool evict_for(size_t size)
+{
+    if (size > ASSET_CACHE_SIZE) {
+        return false;
+    }
+    while (cached_bytes + size > ASSET_CACHE_SIZE) {
+        static_asset_t * victim = NULL;
+        for (size_t i = 0; manifest && i < manifest->count; i++) {
+            static_asset_t * asset = &manifest->assets[i];
+            if (asset->data && asset->users == 0 && (!victim || asset->last_used < victim->last_used)) {
+                victim = asset;
+            }
+        }
+        if (!victim) {
+            return false;
+        }
+        ESP_LOGD(TAG, "Evicting %s", victim->path);
+        heap_caps_free(victim->data);
+        victim->data = NULL;
+        cached_bytes -= victim->size;
+    }
+    return true;
+}
+
+// Hash an asset for its ETag, keeping the content in PSRAM when the cache has room
+static bool load_asset(static_asset_t * asset, uint8_t * scratch, size_t scratch_size)
+{
+    uint8_t * data = NULL;
+    if (cached_bytes + asset->size <= ASSET_CACHE_SIZE) {
+        data = heap_caps_malloc(asset->size, MALLOC_CAP_SPIRAM);
+    }
+
+    uint32_t crc = 0;
+    if (data) {
+        if (!read_file(asset->path, data, asset->size)) {
+            heap_caps_free(data);
+            return false;
+        }
+        crc = esp_rom_crc32_le(0, data, asset->size);
+        asset->data = data;
+        cached_bytes += asset->size;
+    } else {
+        char filepath[ESP_VFS_PATH_MAX + ASSET_PATH_MAX + 4];
+        file_path(filepath, sizeof(filepath), asset->path);
+        int fd = open(filepath, O_RDONLY, 0);
+        if (fd == -1) {
+            return false;
+        }
+        ssize_t n;
+        while ((n = read(fd, scratch, scratch_size)) > 0) {
+            crc = esp_rom_crc32_le(crc, scratch, n);
+        }
+        close(fd);
+    }
+
+    snprintf(asset->etag, sizeof(asset->etag), "\"%08lx-%x\"", (unsigned long) crc, (unsigned int) asset->size);
+    return true;
+}
+
+// Forget every asset, called with assets_lock held. While a request is still sending an asset
+// the old manifest is retired instead, the last of those requests frees it.
+static void drop_assets(void)
+{
+    if (manifest == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < manifest->count; i++) {
+        static_asset_t * asset = &manifest->assets[i];
+        if (asset->users > 0) {
+            asset->stale = true;
+        } else if (asset->data) {
+            heap_caps_free(asset->data);
+            asset->data = NULL;
+        }
+    }
+    if (manifest->users > 0) {
+        manifest->retired = true;
+    } else {
+        free(manifest);
+    }
+    manifest = NULL;
+    cached_bytes = 0;
+}
+
+esp_err_t static_assets_init(const char * base_path)
+{
+    if (assets_lock == NULL) {
+        assets_lock = xSemaphoreCreateMutex();
+        if (assets_lock == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    strlcpy(asset_base_path, base_path, sizeof(asset_base_path));
+
+    char dir_path[ESP_VFS_PATH_MAX + 2];
+    snprintf(dir_path, sizeof(dir_path), "%s/", base_path);
+    DIR * dir = opendir(dir_path);
+    if (dir == NULL) {
+        ESP_LOGE(TAG, "Failed to open %s", dir_path);
+        return ESP_FAIL;
+    }
+
+    size_t count = 0;
+    struct dirent * entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (has_suffix(entry->d_name, ".gz")) {
+            count++;
+        }
+    }
+
+    asset_manifest_t * built = calloc(1, sizeof(asset_manifest_t) + count * sizeof(static_asset_t));
+    uint8_t * scratch = malloc(4096);
+    if (built == NULL || scratch == NULL) {
+        free(built);
+        free(scratch);
+        closedir(dir);
+        return ESP_ERR_NO_MEM;
+    }
+
+    xSemaphoreTake(assets_lock, portMAX_DELAY);
+    drop_assets();
+    manifest = built;
+
+    // index.html is what every visit starts with, it goes into the cache first
+    rewinddir(dir);
+    const char * first = "/index.html";
+    for (int pass = 0; pass < 2; pass++) {
+        while ((entry = readdir(dir)) != NULL && manifest->count < count) {
+            size_t name_len = strlen(entry->d_name);
+            if (!has_suffix(entry->d_name, ".gz") || name_len - 3 + 2 > ASSET_PATH_MAX) {
+                continue;
+            }
+            char path[ASSET_PATH_MAX];
+            snprintf(path, sizeof(path), "/%.*s", (int) (name_len - 3), entry->d_name);
+            if ((strcmp(path, first) == 0) != (pass == 0)) {
+                continue;
+            }
+
+            static_asset_t * asset = &manifest->assets[manifest->count];
+            memset(asset, 0, sizeof(*asset));
+            strlcpy(asset->path, path, sizeof(asset->path));
+            char filepath[ESP_VFS_PATH_MAX + ASSET_PATH_MAX + 4];
+            file_path(filepath, sizeof(filepath), path);
+            struct stat st;
+            if (stat(filepath, &st) != 0) {
+                continue;
+            }
+            asset->size = st.st_size;
+            if (load_asset(asset, scratch, 4096)) {
+                manifest->count++;
+            }
+        }
+        rewinddir(dir);
+    }
+    size_t asset_count = manifest->count;
+    xSemaphoreGive(assets_lock);
+
+    free(scratch);
+    closedir(dir);
+    ESP_LOGI(TAG, "%u assets, %u bytes cached in PSRAM", (unsigned) asset_count, (unsigned) cached_bytes);
+    return ESP_OK;
+}
+
+esp_err_t static_assets_reload(void)
+{
+    if (assets_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    char base_path[sizeof(asset_base_path)];
+    strlcpy(base_path, asset_base_path, sizeof(base_path));
+    return static_assets_init(base_path);
+}
+
+void static_assets_clear(void)
+{
+    if (assets_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(assets_lock, portMAX_DELAY);
+    drop_assets();
+    xSemaphoreGive(assets_lock);
+}
+
+// true when If-None-Match lists etag, or is *
+static bool etag_matches(httpd_req_t * req, const char * etag)
+{
+    char value[128];
+    size_t len = httpd_req_get_hdr_value_len(req, "If-None-Match");
+    if (len == 0 || len >= sizeof(value) ||
+        httpd_req_get_hdr_value_str(req, "If-None-Match", value, sizeof(value)) != ESP_OK) {
+        return false;
+    }
+    return strstr(value, etag) != NULL || strcmp(value, "*") == 0;
+}
+
+static esp_err_t stream_file(httpd_req_t * req, const char * path, char * scratch, size_t scratch_size)
+{
+    char filepath[ESP_VFS_PATH_MAX + ASSET_PATH_MAX + 4];
+    file_path(filepath, sizeof(filepath), path);
+    int fd = open(filepath, O_RDONLY, 0);
+    if (fd == -1) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+
+    ssize_t read_bytes;
+    do {
+        /* Read file in chunks into the scratch buffer */
+        read_bytes = read(fd, scratch, scratch_size);
+        if (read_bytes == -1) {
+            ESP_LOGE(TAG, "Failed to read file : %s", filepath);
+        } else if (read_bytes > 0) {
+            /* Send the buffer contents as HTTP response chunk */
+            if (httpd_resp_send_chunk(req, scratch, read_bytes) != ESP_OK) {
+                close(fd);
+                ESP_LOGE(TAG, "File sending failed!");
+                /* Abort sending file */
+                httpd_resp_sendstr_chunk(req, NULL);
+                /* Respond with 500 Internal Server Error */
+                httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to send file");
+                return ESP_OK;
+            }
+        }
+    } while (read_bytes > 0);
+    close(fd);
+    /* Respond with an empty chunk to signal HTTP response completion */
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+esp_err_t static_assets_send(httpd_req_t * req, const char * path, char * scratch, size_t scratch_size)
+{
+    // index.html names the hashed bundles, it has to be revalidated on every visit
+    const char * cache_control = strcmp(path, "/index.html") == 0 ? "no-cache" : ASSET_MAX_AGE;
+
+    if (assets_lock == NULL) {
+        httpd_resp_set_hdr(req, "Cache-Control", cache_control);
+        return stream_file(req, path, scratch, scratch_size);
+    }
+
+    xSemaphoreTake(assets_lock, portMAX_DELAY);
+    static_asset_t * asset = find_asset(path);
+    if (asset == NULL) {
+        bool listed = manifest && manifest->count > 0;
+        xSemaphoreGive(assets_lock);
+        if (listed) {
+            // The manifest covers the whole partition
+            return ESP_ERR_NOT_FOUND;
+        }
+        httpd_resp_set_hdr(req, "Cache-Control", cache_control);
+        return stream_file(req, path, scratch, scratch_size);
+    }
+
+    // Header values are not copied by the server, they have to outlive the response
+    char etag[ASSET_ETAG_SIZE];
+    strlcpy(etag, asset->etag, sizeof(etag));
+    asset->last_used = ++lru_clock;
+
+    if (etag_matches(req, etag)) {
+        xSemaphoreGive(assets_lock);
+        httpd_resp_set_status(req, "304 Not Modified");
+        httpd_resp_set_hdr(req, "ETag", etag);
+        httpd_resp_set_hdr(req, "Cache-Control", cache_control);
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    // Missed the cache, a one time read from the filesystem if there is room for it
+    if (asset->data == NULL && evict_for(asset->size)) {
+        uint8_t * data = heap_caps_malloc(asset->size, MALLOC_CAP_SPIRAM);
+        if (data && read_file(asset->path, data, asset->size)) {
+            asset->data = data;
+            cached_bytes += asset->size;
+        } else {
+            heap_caps_free(data);
+        }
+    }
+
+    uint8_t * data = asset->data;
+    size_t size = asset->size;
+    asset_manifest_t * owner = manifest;
+    if (data) {
+        asset->users++;
+        owner->users++;
+    }
+    xSemaphoreGive(assets_lock);
+
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", cache_control);
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+
+    if (data == NULL) {
+        return stream_file(req, path, scratch, scratch_size);
+    }
+
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    esp_err_t err = httpd_resp_send(req, (const char *) data, size);
+
+    xSemaphoreTake(assets_lock, portMAX_DELAY);
+    asset->users--;
+    owner->users--;
+    if (asset->stale && asset->users == 0) {
+        heap_caps_free(asset->data);
+        asset->data = NULL;
+    }
+    if (owner->retired && owner->users == 0) {
+        free(owner);
+    }
+    xSemaphoreGive(assets_lock);
+    return err;
+}
@@ -0,0 +1,32 @@
+#ifndef STATIC_ASSETS_H
+#define STATIC_ASSETS_H
+
+#include <stddef.h>
+#include "esp_http_server.h"
+
+// The web app is stored gzipped in the www partition, one <path>.gz per asset. At mount a
+// manifest of every asset is built with an ETag from a CRC of its content, and as many
+// assets as fit are copied into a PSRAM cache. Conditional requests are answered with 304,
+// cached assets are sent from PSRAM and evicted least recently used first.
+
+// Build the manifest for the partition mounted at base_path and warm the cache
+esp_err_t static_assets_init(const char * base_path);
+
+// Forget the manifest and drop the cache, call before the partition is rewritten.
+// Requests are streamed from the filesystem afterwards, as before the manifest existed.
+void static_assets_clear(void);
+
+// Build the manifest again for the path given to static_assets_init, once a new image is verified
+esp_err_t static_assets_reload(void);
+
+/**
+ * @brief Send the asset for path (without .gz), the caller sets the content type
+ *
+ * Assets missing from the manifest or the cache are streamed from the filesystem
+ * through scratch.
+ *
+ * @return ESP_ERR_NOT_FOUND if there is no such file, nothing has been sent then
+ */
+esp_err_t static_assets_send(httpd_req_t * req, const char * path, char * scratch, size_t scratch_size);
+
+#endif // STATIC_ASSETS_H
@@ -0,0 +1,563 @@
+#include "ws_api.h"
+#include "http_server.h"
+#include "cJSON.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "system.h"
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char * TAG = "ws_api";
+
+#define WS_MAX_CLIENTS 4
+#define WS_FRAME_SIZE 1024
+#define WS_MAX_RX_SIZE 256
+#define WS_TICK_MS 250
+#define WS_DEFAULT_INTERVAL_MS 1000
+#define WS_MIN_INTERVAL_MS 250
+#define WS_MAX_INTERVAL_MS 60000
+
+#define WS_TOPIC_LOGS 0x01
+#define WS_TOPIC_METRICS 0x02
+
+#define LOG_RING_SIZE (8 * 1024)
+#define MAX_LOG_BUFFER_SIZE 1024  // Define maximum log message size
+
+typedef enum {
+    METRIC_HASHRATE,
+    METRIC_TEMP,
+    METRIC_VR_TEMP,
+    METRIC_POWER,
+    METRIC_VOLTAGE,
+    METRIC_CURRENT,
+    METRIC_FAN_RPM,
+    METRIC_FAN_SPEED,
+    METRIC_FREQUENCY,
+    METRIC_SHARES_ACCEPTED,
+    METRIC_SHARES_REJECTED,
+    METRIC_BEST_SESSION_DIFF,
+    METRIC_STRATUM_DIFF,
+    METRIC_USING_FALLBACK,
+    METRIC_BLOCK_HEIGHT,
+    METRIC_COUNT
+} ws_metric_t;
+
+// Values are kept as integers scaled by 10^decimals, so a change below the
+// printed precision is not a change and does not cost a frame
+static const struct {
+    const char * key;
+    uint8_t decimals;
+} metric_fields[METRIC_COUNT] = {
+    [METRIC_HASHRATE] = {"hashRate", 2},
+    [METRIC_TEMP] = {"temp", 1},
+    [METRIC_VR_TEMP] = {"vrTemp", 1},
+    [METRIC_POWER] = {"power", 2},
+    [METRIC_VOLTAGE] = {"voltage", 0},
+    [METRIC_CURRENT] = {"current", 0},
+    [METRIC_FAN_RPM] = {"fanrpm", 0},
+    [METRIC_FAN_SPEED] = {"fanspeed", 0},
+    [METRIC_FREQUENCY] = {"frequency", 0},
+    [METRIC_SHARES_ACCEPTED] = {"sharesAccepted", 0},
+    [METRIC_SHARES_REJECTED] = {"sharesRejected", 0},
+    [METRIC_BEST_SESSION_DIFF] = {"bestSessionDiff", 0},
+    [METRIC_STRATUM_DIFF] = {"stratumDiff", 0},
+    [METRIC_USING_FALLBACK] = {"isUsingFallbackStratum", 0},
+    [METRIC_BLOCK_HEIGHT] = {"blockHeight", 0},
+};
+
+typedef struct {
+    int64_t value[METRIC_COUNT];
+} ws_metrics_t;
+
+// Position of a reader in the log ring. offset is only valid while seq is still held.
+typedef struct {
+    uint32_t seq;
+    uint32_t offset;
+} log_cursor_t;
+
+typedef struct {
+    int fd;                 // -1 when the slot is free
+    uint8_t topics;
+    uint32_t interval_ms;
+    int64_t last_push_us;
+    bool busy;              // frame is queued on the server task, nothing else is built until it is sent
+    bool synced;            // last holds what the client has, the next push is a delta against it
+    ws_metrics_t last;
+    log_cursor_t log_cursor;
+    uint32_t dropped_lines; // Log lines overwritten before this client read them
+    char frame[WS_FRAME_SIZE];
+    size_t frame_len;
+} ws_client_t;
+
+static GlobalState * GLOBAL_STATE;
+static httpd_handle_t server = NULL;
+static ws_client_t clients[WS_MAX_CLIENTS];
+static SemaphoreHandle_t clients_lock = NULL;
+
+static TaskHandle_t publish_task = NULL;
+
+// Every log line, stored as a 16 bit length and the text, in one fixed ring shared by
+// all clients. Offsets only grow and are taken modulo the size, the oldest lines are
+// dropped to make room. Each client reads through its own cursor.
+static uint8_t log_ring[LOG_RING_SIZE];
+static uint32_t log_head = 0;       // Offset the next line is written at
+static uint32_t log_tail = 0;       // Offset of the oldest line held
+static uint32_t log_head_seq = 0;   // Sequence number of the next line
+static uint32_t log_tail_seq = 0;   // Sequence number of the oldest line held
+static char log_buffer[MAX_LOG_BUFFER_SIZE];  // Pre-allocated buffer for log messages
+static SemaphoreHandle_t log_lock = NULL;     // Guards the ring and log_buffer
+
+static int64_t scale(double value, uint8_t decimals)
+{
+    static const double factors[] = {1, 10, 100, 1000};
+    return (int64_t) llround(value * factors[decimals]);
+}
+
+static void read_metrics(ws_metrics_t * metrics)
+{
+    PowerManagementModule * power = &GLOBAL_STATE->POWER_MANAGEMENT_MODULE;
+    SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
+    int64_t * v = metrics->value;
+
+    v[METRIC_HASHRATE] = scale(module->current_hashrate, metric_fields[METRIC_HASHRATE].decimals);
+    v[METRIC_TEMP] = scale(power->chip_temp_avg, metric_fields[METRIC_TEMP].decimals);
+    v[METRIC_VR_TEMP] = scale(power->vr_temp, metric_fields[METRIC_VR_TEMP].decimals);
+    v[METRIC_POWER] = scale(power->power, metric_fields[METRIC_POWER].decimals);
+    v[METRIC_VOLTAGE] = scale(power->voltage, 0);
+    v[METRIC_CURRENT] = scale(power->current, 0);
+    v[METRIC_FAN_RPM] = power->fan_rpm;
+    v[METRIC_FAN_SPEED] = power->fan_perc;
+    v[METRIC_FREQUENCY] = scale(power->frequency_value, 0);
+    v[METRIC_SHARES_ACCEPTED] = module->shares_accepted;
+    v[METRIC_SHARES_REJECTED] = module->shares_rejected;
+    v[METRIC_BEST_SESSION_DIFF] = module->best_session_nonce_diff;
+    v[METRIC_STRATUM_DIFF] = GLOBAL_STATE->stratum_difficulty;
+    v[METRIC_USING_FALLBACK] = module->is_using_fallback;
+    ChainState chain;
+    SYSTEM_copy_chain_state(GLOBAL_STATE, module->is_using_fallback, &chain);
+    v[METRIC_BLOCK_HEIGHT] = chain.block_height;
+}
+
+static size_t append_metric(char * buf, size_t size, size_t len, bool first, ws_metric_t field, int64_t value)
+{
+    static const int64_t divisors[] = {1, 10, 100, 1000};
+    uint8_t decimals = metric_fields[field].decimals;
+    int n;
+
+    if (decimals == 0) {
+        n = snprintf(buf + len, size - len, "%s\"%s\":%lld", first ? "" : ",", metric_fields[field].key,
+                     (long long) value);
+    } else {
+        int64_t divisor = divisors[decimals];
+        n = snprintf(buf + len, size - len, "%s\"%s\":%s%lld.%0*lld", first ? "" : ",", metric_fields[field].key,
+                     value < 0 ? "-" : "", (long long) (llabs(value) / divisor), decimals,
+                     (long long) (llabs(value) % divisor));
+    }
+    return n > 0 ? len + n : len;
+}
+
+// Fields that changed since the last push, all of them after (re)subscribing. 0 when nothing changed.
+static size_t build_metrics_frame(ws_client_t * client, const ws_metrics_t * now)
+{
+    size_t len = snprintf(client->frame, sizeof(client->frame), "{\"type\":\"metrics\",\"data\":{");
+    bool first = true;
+
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        if (client->synced && client->last.value[i] == now->value[i]) {
+            continue;
+        }
+        len = append_metric(client->frame, sizeof(client->frame), len, first, i, now->value[i]);
+        first = false;
+    }
+    if (first) {
+        return 0;
+    }
+
+    len += snprintf(client->frame + len, sizeof(client->frame) - len, "}}");
+    client->last = *now;
+    client->synced = true;
+    return len;
+}
+
+static esp_err_t send_text(int fd, const char * data, size_t len)
+{
+    httpd_ws_frame_t ws_pkt;
+    memset(&ws_pkt, 0, sizeof(httpd_ws_frame_t));
+    ws_pkt.payload = (uint8_t *) data;
+    ws_pkt.len = len;
+    ws_pkt.type = HTTPD_WS_TYPE_TEXT;
+    return httpd_ws_send_frame_async(server, fd, &ws_pkt);
+}
+
+// Caller holds clients_lock
+static void remove_client(ws_client_t * client)
+{
+    ESP_LOGI(TAG, "Websocket client %d removed", client->fd);
+    client->fd = -1;
+    client->topics = 0;
+}
+
+static void drop_failed_client(int fd)
+{
+    ESP_LOGW(TAG, "Websocket send to %d failed, closing", fd);
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+        if (clients[i].fd == fd) {
+            remove_client(&clients[i]);
+        }
+    }
+    xSemaphoreGive(clients_lock);
+    httpd_sess_trigger_close(server, fd);
+}
+
+// Runs on the server task, which owns every socket write
+static void send_client_frame(void * arg)
+{
+    ws_client_t * client = arg;
+
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
+    int fd = client->fd;
+    xSemaphoreGive(clients_lock);
+
+    if (fd >= 0 && send_text(fd, client->frame, client->frame_len) != ESP_OK) {
+        drop_failed_client(fd);
+    }
+
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
+    client->busy = false;
+    xSemaphoreGive(clients_lock);
+}
+
+static void ring_write(uint32_t offset, const void * data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        log_ring[(offset + i) % LOG_RING_SIZE] = ((const uint8_t *) data)[i];
+    }
+}
+
+static void ring_read(uint32_t offset, void * data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        ((uint8_t *) data)[i] = log_ring[(offset + i) % LOG_RING_SIZE];
+    }
+}
+
+// Caller holds log_lock
+static void log_ring_append(const char * line, uint16_t len)
+{
+    uint32_t need = sizeof(len) + len;
+    while (log_head + need - log_tail > LOG_RING_SIZE) {
+        uint16_t oldest;
+        ring_read(log_tail, &oldest, sizeof(oldest));
+        log_tail += sizeof(oldest) + oldest;
+        log_tail_seq++;
+    }
+    ring_write(log_head, &len, sizeof(len));
+    ring_write(log_head + sizeof(len), line, len);
+    log_head += need;
+    log_head_seq++;
+}
+
+static int log_to_ring(const char * format, va_list args)
+{
+    va_list args_copy;
+    va_copy(args_copy, args);
+
+    // Print to standard output
+    vprintf(format, args);
+
+    xSemaphoreTake(log_lock, portMAX_DELAY);
+
+    // Format the string into the pre-allocated buffer
+    int written = vsnprintf(log_buffer, MAX_LOG_BUFFER_SIZE - 1, format, args_copy);
+    va_end(args_copy);
+
+    if (written > 0) {
+        // Ensure the log message ends with a newline
+        size_t len = strlen(log_buffer);
+        if (log_buffer[len - 1] != '\n') {
+            log_buffer[len++] = '\n';
+            log_buffer[len] = '\0';
+        }
+        log_ring_append(log_buffer, len);
+    }
+
+    xSemaphoreGive(log_lock);
+
+    if (written > 0 && publish_task) {
+        xTaskNotifyGive(publish_task);
+    }
+    return written;
+}
+
+// Copy the lines after the client's cursor that fit into its frame, 0 when it is up to date.
+// Caller holds clients_lock.
+static size_t build_log_frame(ws_client_t * client)
+{
+    size_t len = 0;
+
+    xSemaphoreTake(log_lock, portMAX_DELAY);
+
+    log_cursor_t * cursor = &client->log_cursor;
+    if (cursor->seq < log_tail_seq) {
+        client->dropped_lines += log_tail_seq - cursor->seq;
+        cursor->seq = log_tail_seq;
+        cursor->offset = log_tail;
+        len = snprintf(client->frame, sizeof(client->frame), "[log] %lu lines dropped, client too slow\n",
+                       (unsigned long) client->dropped_lines);
+    }
+
+    while (cursor->seq < log_head_seq) {
+        uint16_t line_len;
+        ring_read(cursor->offset, &line_len, sizeof(line_len));
+        size_t copy = line_len;
+        if (len + copy > sizeof(client->frame)) {
+            if (len > 0) {
+                break;
+            }
+            // Only a line longer than a frame gets here, send what fits
+            copy = sizeof(client->frame);
+        }
+        ring_read(cursor->offset + sizeof(line_len), client->frame + len, copy);
+        len += copy;
+        cursor->offset += sizeof(line_len) + line_len;
+        cursor->seq++;
+    }
+
+    xSemaphoreGive(log_lock);
+    return len;
+}
+
+// Start a client at the oldest line still held, so it gets the backlog first
+static void replay_log_backlog(ws_client_t * client)
+{
+    xSemaphoreTake(log_lock, portMAX_DELAY);
+    client->log_cursor.seq = log_tail_seq;
+    client->log_cursor.offset = log_tail;
+    xSemaphoreGive(log_lock);
+}
+
+// Pushes metric deltas to each subscribed client at its own rate and new log lines as
+// they arrive. A client whose previous frame is still queued is skipped, its next frame
+// then carries every change since the last one it received and its log cursor has not moved.
+static void websocket_publish_task(void * pvParameters)
+{
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(WS_TICK_MS));
+
+        int64_t now_us = esp_timer_get_time();
+        ws_metrics_t now;
+        bool have_metrics = false;
+
+        for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+            ws_client_t * client = &clients[i];
+            size_t len = 0;
+
+            xSemaphoreTake(clients_lock, portMAX_DELAY);
+            if (client->fd >= 0 && (client->topics & WS_TOPIC_METRICS) && !client->busy &&
+                now_us - client->last_push_us >= (int64_t) client->interval_ms * 1000) {
+                if (!have_metrics) {
+                    read_metrics(&now);
+                    have_metrics = true;
+                }
+                len = build_metrics_frame(client, &now);
+                if (len > 0) {
+                    client->last_push_us = now_us;
+                }
+            }
+            // Logs go out when no metrics are due, metrics come at most once per interval
+            if (len == 0 && client->fd >= 0 && (client->topics & WS_TOPIC_LOGS) && !client->busy) {
+                len = build_log_frame(client);
+            }
+            if (len > 0) {
+                client->frame_len = len;
+                client->busy = true;
+            }
+            xSemaphoreGive(clients_lock);
+
+            if (len > 0 && httpd_queue_work(server, send_client_frame, client) != ESP_OK) {
+                xSemaphoreTake(clients_lock, portMAX_DELAY);
+                client->busy = false;
+                client->synced = false;
+                xSemaphoreGive(clients_lock);
+            }
+        }
+    }
+}
+
+static void add_client(int fd)
+{
+    bool added = false;
+
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
+    for (int i = 0; i < WS_MAX_CLIENTS && !added; i++) {
+        ws_client_t * client = &clients[i];
+        // A busy slot still has a frame queued for its old connection
+        if (client->fd < 0 && !client->busy) {
+            client->fd = fd;
+            client->topics = WS_TOPIC_LOGS;
+            client->interval_ms = WS_DEFAULT_INTERVAL_MS;
+            client->last_push_us = 0;
+            client->synced = false;
+            client->dropped_lines = 0;
+            replay_log_backlog(client);
+            added = true;
+        }
+    }
+    xSemaphoreGive(clients_lock);
+
+    if (!added) {
+        ESP_LOGW(TAG, "No free websocket slot, closing %d", fd);
+        httpd_sess_trigger_close(server, fd);
+        return;
+    }
+
+    ESP_LOGI(TAG, "Websocket client %d added", fd);
+}
+
+void ws_api_session_closed(int fd)
+{
+    if (clients_lock == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+        if (clients[i].fd == fd) {
+            remove_client(&clients[i]);
+        }
+    }
+    xSemaphoreGive(clients_lock);
+}
+
+static uint8_t parse_topics(const cJSON * list)
+{
+    uint8_t topics = 0;
+    const cJSON * item;
+    cJSON_ArrayForEach(item, list) {
+        if (!cJSON_IsString(item)) {
+            continue;
+        }
+        if (strcmp(item->valuestring, "logs") == 0) {
+            topics |= WS_TOPIC_LOGS;
+        } else if (strcmp(item->valuestring, "metrics") == 0) {
+            topics |= WS_TOPIC_METRICS;
+        }
+    }
+    return topics;
+}
+
+// {"subscribe":["metrics"],"unsubscribe":["logs"],"interval":500}
+static void handle_client_message(int fd, const char * message)
+{
+    cJSON * root = cJSON_Parse(message);
+    if (!root) {
+        return;
+    }
+
+    uint8_t subscribe = parse_topics(cJSON_GetObjectItem(root, "subscribe"));
+    uint8_t unsubscribe = parse_topics(cJSON_GetObjectItem(root, "unsubscribe"));
+    const cJSON * interval = cJSON_GetObjectItem(root, "interval");
+
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+        ws_client_t * client = &clients[i];
+        if (client->fd != fd) {
+            continue;
+        }
+        if (subscribe & WS_TOPIC_METRICS) {
+            // A new subscriber starts with the full set
+            client->synced = false;
+        }
+        if ((subscribe & WS_TOPIC_LOGS) && !(client->topics & WS_TOPIC_LOGS)) {
+            replay_log_backlog(client);
+        }
+        client->topics = (client->topics | subscribe) & ~unsubscribe;
+        if (cJSON_IsNumber(interval)) {
+            int ms = interval->valueint;
+            client->interval_ms = ms < WS_MIN_INTERVAL_MS ? WS_MIN_INTERVAL_MS : ms > WS_MAX_INTERVAL_MS ? WS_MAX_INTERVAL_MS : ms;
+        }
+    }
+    xSemaphoreGive(clients_lock);
+
+    cJSON_Delete(root);
+}
+
+static esp_err_t ws_handler(httpd_req_t * req)
+{
+    if (req->method == HTTP_GET) {
+        if (is_network_allowed(req) != ESP_OK) {
+            return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+        }
+        ESP_LOGI(TAG, "Handshake done, the new connection was opened");
+        add_client(httpd_req_to_sockfd(req));
+        return ESP_OK;
+    }
+
+    httpd_ws_frame_t ws_pkt;
+    memset(&ws_pkt, 0, sizeof(httpd_ws_frame_t));
+    esp_err_t ret = httpd_ws_recv_frame(req, &ws_pkt, 0);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (ws_pkt.len == 0) {
+        return ESP_OK;
+    }
+    if (ws_pkt.len > WS_MAX_RX_SIZE) {
+        ESP_LOGW(TAG, "Websocket message too large: %u bytes", (unsigned) ws_pkt.len);
+        return ESP_FAIL;
+    }
+
+    char message[WS_MAX_RX_SIZE + 1];
+    ws_pkt.payload = (uint8_t *) message;
+    ret = httpd_ws_recv_frame(req, &ws_pkt, ws_pkt.len);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    message[ws_pkt.len] = '\0';
+
+    if (ws_pkt.type == HTTPD_WS_TYPE_TEXT) {
+        handle_client_message(httpd_req_to_sockfd(req), message);
+    }
+    return ESP_OK;
+}
+
+esp_err_t register_ws_api_endpoints(httpd_handle_t http_server, GlobalState * global_state)
+{
+    server = http_server;
+    GLOBAL_STATE = global_state;
+
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+        clients[i].fd = -1;
+    }
+    clients_lock = xSemaphoreCreateMutex();
+    log_lock = xSemaphoreCreateMutex();
+    if (!clients_lock || !log_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    httpd_uri_t ws = {
+        .uri = "/api/ws",
+        .method = HTTP_GET,
+        .handler = ws_handler,
+        .user_ctx = NULL,
+        .is_websocket = true
+    };
+    esp_err_t err = httpd_register_uri_handler(server, &ws);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    xTaskCreate(&websocket_publish_task, "websocket_publish", 4096, NULL, 2, &publish_task);
+
+    // Capture from here on so a client connecting later still gets the backlog
+    esp_log_set_vprintf(log_to_ring);
+
+    return ESP_OK;
+}
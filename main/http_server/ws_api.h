@@ -0,0 +1,13 @@
+#ifndef WS_API_H
+#define WS_API_H
+
+#include "esp_http_server.h"
+#include "global_state.h"
+
+// Register /api/ws and start the task that pushes to its clients
+esp_err_t register_ws_api_endpoints(httpd_handle_t server, GlobalState * global_state);
+
+// Free the client slot of a closed session, before the server can hand its fd to a new one
+void ws_api_session_closed(int fd);
+
+#endif // WS_API_H
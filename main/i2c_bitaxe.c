@@ -15,7 +15,6 @@
 #define I2C_MASTER_TIMEOUT_MS 1000
 
 //#define I2C_DEFAULT_TIMEOUT ( I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS )
-#define I2C_DEFAULT_TIMEOUT -1  //-1 means wait forever
 
 static i2c_master_bus_handle_t i2c_bus_handle;
 
@@ -111,7 +110,20 @@ esp_err_t i2c_bitaxe_register_read(i2c_master_dev_handle_t dev_handle, uint8_t r
     // return i2c_master_write_read_device(I2C_MASTER_NUM, device_address, &reg_addr, 1, data, len, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS);
     //ESP_LOGI("I2C", "Reading %d bytes from register 0x%02X", len, reg_addr);
 
-    return log_on_error(i2c_master_transmit_receive(dev_handle, &reg_addr, 1, read_buf, len, I2C_DEFAULT_TIMEOUT), dev_handle);
+    return i2c_bitaxe_register_read_timeout(dev_handle, reg_addr, read_buf, len, I2C_DEFAULT_TIMEOUT);
+}
+
+/**
+ * @brief Read a sequence of I2C bytes, giving up after timeout_ms
+ * @param dev_handle The I2C device handle
+ * @param reg_addr The register address to read from
+ * @param read_buf The buffer to store the read data
+ * @param len The number of bytes to read
+ * @param timeout_ms How long to wait for the transaction, -1 waits forever
+ */
+esp_err_t i2c_bitaxe_register_read_timeout(i2c_master_dev_handle_t dev_handle, uint8_t reg_addr, uint8_t * read_buf, size_t len, int timeout_ms)
+{
+    return log_on_error(i2c_master_transmit_receive(dev_handle, &reg_addr, 1, read_buf, len, timeout_ms), dev_handle);
 }
 
 /**
@@ -5,11 +5,17 @@
 
 #define I2C_BUS_SPEED_HZ 100000   /*!< I2C master clock frequency */
 
+#define I2C_DEFAULT_TIMEOUT -1  //-1 means wait forever
+// For the periodic sensor reads, which report a failure instead of aborting. SMBus devices
+// stretch the clock up to 25-35ms, anything longer is a stuck bus.
+#define I2C_TELEMETRY_TIMEOUT_MS 50
+
 esp_err_t i2c_bitaxe_init(void);
 esp_err_t i2c_bitaxe_add_device(uint8_t device_address, i2c_master_dev_handle_t * dev_handle, const char *device_tag);
 esp_err_t i2c_bitaxe_get_master_bus_handle(i2c_master_bus_handle_t * dev_handle);
 
 esp_err_t i2c_bitaxe_register_read(i2c_master_dev_handle_t dev_handle, uint8_t reg_addr, uint8_t * read_buf, size_t len);
+esp_err_t i2c_bitaxe_register_read_timeout(i2c_master_dev_handle_t dev_handle, uint8_t reg_addr, uint8_t * read_buf, size_t len, int timeout_ms);
 esp_err_t i2c_bitaxe_register_write_byte(i2c_master_dev_handle_t dev_handle, uint8_t reg_addr, uint8_t data);
 esp_err_t i2c_bitaxe_register_write_bytes(i2c_master_dev_handle_t dev_handle, uint8_t * data, uint8_t len);
 esp_err_t i2c_bitaxe_register_write_word(i2c_master_dev_handle_t dev_handle, uint8_t reg_addr, uint16_t data);
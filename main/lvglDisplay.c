@@ -77,7 +77,7 @@ Device Status:
 API Data:
     - BTC Price MEMPOOL_STATE.priceUSD
     - BTC Price Timestamp MEMPOOL_STATE.priceTimestamp
-    - Block Height MEMPOOL_STATE.btcBlockHeight
+    - Block Height GLOBAL_STATE->SYSTEM_MODULE.chain_state, from the pool coinbase
     - Network Hashrate MEMPOOL_STATE.networkHashrate
     - Network Difficulty MEMPOOL_STATE.networkDifficulty
     - Network Fee MEMPOOL_STATE.networkFee
@@ -249,7 +249,8 @@ esp_err_t lvglUpdateDisplayNetwork(GlobalState *GLOBAL_STATE)
 
 
     // LVGL_REG_POOL_URL (0x24)
-    const char *currentPoolUrl = module->pool_url;
+    char currentPoolUrl[POOL_URL_SIZE];
+    SYSTEM_copy_pool_url(GLOBAL_STATE, false, currentPoolUrl, sizeof(currentPoolUrl));
     dataLen = strlen(currentPoolUrl);
     if (dataLen + 2 > MAX_BUFFER_SIZE) return ESP_ERR_NO_MEM;
 
@@ -258,10 +259,12 @@ esp_err_t lvglUpdateDisplayNetwork(GlobalState *GLOBAL_STATE)
 
 
     // LVGL_REG_FALLBACK_URL (0x25)
-    dataLen = strlen(module->fallback_pool_url);
+    char fallbackPoolUrl[POOL_URL_SIZE];
+    SYSTEM_copy_pool_url(GLOBAL_STATE, true, fallbackPoolUrl, sizeof(fallbackPoolUrl));
+    dataLen = strlen(fallbackPoolUrl);
     if (dataLen + 2 > MAX_BUFFER_SIZE) return ESP_ERR_NO_MEM;
 
-    ret = sendRegisterData(LVGL_REG_FALLBACK_URL, module->fallback_pool_url, dataLen);
+    ret = sendRegisterData(LVGL_REG_FALLBACK_URL, fallbackPoolUrl, dataLen);
     if (ret != ESP_OK) return ret;
 
 
@@ -336,6 +339,14 @@ esp_err_t lvglUpdateDisplayMining(GlobalState *GLOBAL_STATE)
     ret = sendRegisterData(LVGL_REG_SHARES, shares, sizeof(uint32_t) * 2);
     if (ret != ESP_OK) return ret;
 
+    // LVGL_REG_API_BLOCK_HEIGHT (0x63) comes from the pool's coinbase, not the mempool API
+    ChainState chain;
+    SYSTEM_copy_chain_state(GLOBAL_STATE, module->is_using_fallback, &chain);
+    if (chain.block_height != 0) {
+        ret = sendRegisterData(LVGL_REG_API_BLOCK_HEIGHT, &chain.block_height, sizeof(uint32_t));
+        if (ret != ESP_OK) return ret;
+    }
+
     return ESP_OK;
 }
 
@@ -471,7 +482,9 @@ esp_err_t lvglUpdateDisplayAPI(void)
     lastPriceUpdateTime = currentTime;
 
     esp_err_t ret;
-    MempoolApiState* mempoolState = getMempoolState();
+    MempoolApiState snapshot;
+    getMempoolState(&snapshot);
+    MempoolApiState* mempoolState = &snapshot;
 
     // Only send if we have valid price data
     if (mempoolState->priceValid) {
@@ -494,12 +507,6 @@ esp_err_t lvglUpdateDisplayAPI(void)
         ESP_LOGI("LVGL", "Sent network difficulty: %.2f", mempoolState->networkDifficulty);
     }
 
-    if (mempoolState->blockHeightValid) {
-        ret = sendRegisterData(LVGL_REG_API_BLOCK_HEIGHT, &mempoolState->blockHeight, sizeof(uint32_t));
-        if (ret != ESP_OK) return ret;
-        ESP_LOGI("LVGL", "Sent block height: %lu", mempoolState->blockHeight);
-    }
-
     if (mempoolState->difficultyProgressPercentValid) {
         ret = sendRegisterData(LVGL_REG_API_DIFFICULTY_PROGRESS, &mempoolState->difficultyProgressPercent, sizeof(double));
         if (ret != ESP_OK) return ret;
@@ -12,6 +12,7 @@
 #include "serial.h"
 #include "utils.h"
 #include "driver/uart.h"
+#include "freertos/queue.h"
 #include "esp_system.h"
 
 #include "nvs_config.h"
@@ -28,6 +29,8 @@
 #include "global_state.h"
 #include "theme_api.h"
 #include "esp_ota_ops.h"
+#include "esp_rom_crc.h"
+#include "dataBase.h"
 
 extern GlobalState *GLOBAL_STATE;
 
@@ -36,6 +39,16 @@ extern GlobalState *GLOBAL_STATE;
 #define MAX_BUFFER_SIZE_BAP 1024  //Placeholder Buffer Size
 #define SEND_DELAY_AFTER_RECEIVE_MS 1000  // 1 second delay
 
+#define BAP_MAX_FRAME_DATA 255          // The length field is one byte
+#define BAP_BATCH_MAX_REGS 32
+#define BAP_SHADOW_SIZE 48
+#define BAP_ACK_TIMEOUT_MS 300
+#define BAP_MAX_RETRIES 3
+#define BAP_MAX_FAILED_BATCHES 3        // Unacknowledged batches in a row before going back to v1
+#define BAP_FULL_REFRESH_MS 60000       // Resend everything now and then, the display may have restarted
+#define BAP_RX_FRAME_TIMEOUT_MS 100     // A frame that stops arriving for this long is dropped
+#define BAP_RX_CHUNK_SIZE 128
+
 
 #include "tasks/power_management_task.h"
 
@@ -91,7 +104,7 @@ Device Status:
 API Data:
     - BTC Price MEMPOOL_STATE.priceUSD
     - BTC Price Timestamp MEMPOOL_STATE.priceTimestamp
-    - Block Height MEMPOOL_STATE.btcBlockHeight
+    - Block Height GLOBAL_STATE->SYSTEM_MODULE.chain_state, from the pool coinbase
     - Network Hashrate MEMPOOL_STATE.networkHashrate
     - Network Difficulty MEMPOOL_STATE.networkDifficulty
     - Network Fee MEMPOOL_STATE.networkFee
@@ -131,121 +144,388 @@ static double lastNetworkHashrate = 0.0;
 static double lastNetworkDifficulty = 0.0;
 static uint32_t lastBlockHeight = 0;
 
-// static crc buffer
-static uint8_t crcBufferRX[2];
-static uint8_t crcBufferTX[2];
-
 // Add at the top with other static variables
-static bool is_receiving_data = false;
-static TickType_t last_receive_time = 0;
+static volatile bool is_receiving_data = false;     // A frame from the display is partly received
+static volatile TickType_t last_receive_time = 0;
+
+static QueueHandle_t uartEventsBAP = NULL;
+
+// What the display has for one register. Values are compared by CRC32, so the table
+// stays small no matter how long the strings are.
+typedef struct {
+    uint8_t reg;
+    bool used;
+    bool sent;              // sentCrc is what the display has
+    bool inflight;          // inflightCrc is in the batch waiting for its ACK
+    uint32_t sentCrc;
+    uint32_t inflightCrc;
+} bapShadow_t;
+
+// v2 batch payload: seq, count, then reg, len and value for each register
+typedef struct {
+    uint8_t data[BAP_MAX_FRAME_DATA];
+    size_t len;
+    uint8_t count;
+    uint8_t shadowIndex[BAP_BATCH_MAX_REGS];
+    uint32_t crc[BAP_BATCH_MAX_REGS];
+} bapBatch_t;
+
+static bapShadow_t shadowBAP[BAP_SHADOW_SIZE];
+static bapBatch_t stagedBAP = {.len = 2};   // Filled by the update functions
+static bapBatch_t outstandingBAP;           // Sent, waiting for its ACK
+static uint8_t outstandingFrameBAP[BAP_MAX_FRAME_DATA + 6];
+static size_t outstandingFrameLenBAP = 0;
+static bool awaitingAckBAP = false;
+static TickType_t outstandingSentTimeBAP = 0;
+static uint8_t retriesBAP = 0;
+static uint8_t failedBatchesBAP = 0;
+static uint8_t nextSeqBAP = 0;
+static bool displayV2BAP = false;          // Set once the display announces protocol v2
+static TickType_t lastFullRefreshBAP = 0;
+
+// Handed from the receive task to lvglFlushDisplayBAP, which owns the protocol state
+static volatile bool ackPendingBAP = false;
+static volatile uint8_t ackSeqBAP = 0;
+static volatile int16_t announcedVersionBAP = -1;
+
+typedef enum {
+    BAP_RX_PREAMBLE_FF,
+    BAP_RX_PREAMBLE_AA,
+    BAP_RX_REG,
+    BAP_RX_LEN,
+    BAP_RX_BODY,
+} bapRxState_t;
+
+// Streaming frame parser, body holds reg, len, data and the two CRC bytes
+typedef struct {
+    bapRxState_t state;
+    uint8_t body[BAP_MAX_FRAME_DATA + 4];
+    size_t pos;
+} bapParser_t;
+
+typedef struct bapSetting bapSetting_t;
+typedef void (*bapSettingHandler_t)(GlobalState *GLOBAL_STATE, const bapSetting_t *setting, const uint8_t *data, uint8_t len);
+
+// Register the display writes and what it changes
+struct bapSetting {
+    uint8_t reg;
+    const char *name;
+    bapSettingHandler_t handler;
+    const char *nvsKey;
+    uint16_t min;           // Range for numeric settings
+    uint16_t max;
+    size_t maxLen;          // Longest value for string settings
+};
+
+// CRC-16/CCITT-FALSE, polynomial 0x1021
+static const uint16_t crc16Table[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+    0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+    0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+    0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+    0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+    0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+    0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+    0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+    0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+    0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+    0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+    0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+    0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+    0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+    0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+    0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+    0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+    0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+    0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
+};
 
 
-/// @brief waits for a serial response to Match CRC
-/// @param expectedCRC the expected crc 
-/// @param timeout_ms number of ms to wait before timing out
-/// @return true if CRC matches, false otherwise
-static bool SERIAL_rx_BAP_CRC(uint16_t expectedCRC, uint16_t timeout_ms) {
-    memset(crcBufferRX, 0, 2);
-    int16_t CRCBytesRead = uart_read_bytes(UART_NUM_2, crcBufferRX, 2, timeout_ms / portTICK_PERIOD_MS);
-
-    if (CRCBytesRead != 2) {
-        ESP_LOGE("LVGL", "Failed to read CRC from device");
-        return false;
-    }
-    
-    uint16_t receivedCRC = (crcBufferRX[0] << 8) | crcBufferRX[1];
-    
-    if (receivedCRC == expectedCRC) {
-        return true;
-    }
-    
-    else if (crcBufferRX[0] != expectedCRC) {
-        ESP_LOGE("LVGL", "CRC mismatch: expected 0x%04X, received 0x%04X", expectedCRC, crcBufferRX[0]);
-        return false;
-    }
-    
-    else
-    {
-        ESP_LOGE("LVGL", "Unknown error");
-        return false;
-    }
-}
 /// @brief Calculates the CRC16 of a given data
 /// @param data The data to calculate the CRC16 of
 /// @param length The length of the data
 /// @return The CRC16 of the data
 static uint16_t calculate_crc16(const uint8_t* data, size_t length) {
     uint16_t crc = 0xFFFF;  // Initial value
-    
+
     for (size_t i = 0; i < length; i++) {
-        crc ^= (uint16_t)data[i] << 8;
-        for (int j = 0; j < 8; j++) {
-            if (crc & 0x8000) {
-                crc = (crc << 1) ^ 0x1021;
-            } else {
-                crc = crc << 1;
-            }
-        }
+        crc = (crc << 8) ^ crc16Table[(crc >> 8) ^ data[i]];
     }
-    
+
     return crc;
 }
 
-static esp_err_t sendRegisterDataBAP(uint8_t reg, const void* data, size_t dataLen) 
+// Sending is held off while the display is talking and for a while after
+static bool sendBlockedBAP(void)
 {
-    // Don't send if we're receiving data
     if (is_receiving_data) {
-        ESP_LOGI("LVGL", "Skipping send during data reception");
-        return ESP_OK;
+        return true;
+    }
+    return (xTaskGetTickCount() - last_receive_time) < pdMS_TO_TICKS(SEND_DELAY_AFTER_RECEIVE_MS);
+}
+
+/// @brief Frames a register write and sends it
+/// @return The number of bytes in the frame, 0 if it does not fit
+static size_t writeFrameBAP(uint8_t *frame, size_t size, uint8_t reg, const void* data, size_t dataLen)
+{
+    if (dataLen > BAP_MAX_FRAME_DATA || dataLen + 6 > size) {
+        ESP_LOGE("LVGL", "Buffer overflow prevented: reg 0x%02X, size %d", reg, dataLen);
+        return 0;
     }
 
-    // Check if we're within the delay period after receiving data
-    TickType_t current_time = xTaskGetTickCount();
-    if ((current_time - last_receive_time) < pdMS_TO_TICKS(SEND_DELAY_AFTER_RECEIVE_MS)) {
-        ESP_LOGI("LVGL", "Skipping send during delay period after receive");
+    frame[0] = 0xFF;
+    frame[1] = 0xAA;
+    frame[2] = reg;
+    frame[3] = (uint8_t)dataLen;
+    if (data != NULL && dataLen > 0) {
+        memcpy(&frame[4], data, dataLen);
+    }
+
+    // CRC16 over reg + len + data
+    uint16_t crc = calculate_crc16(&frame[2], dataLen + 2);
+    frame[dataLen + 4] = (crc >> 8) & 0xFF;    // High byte
+    frame[dataLen + 5] = crc & 0xFF;           // Low byte
+
+    ESP_LOGD("LVGL", "Sending reg 0x%02X, len %d, CRC: 0x%04X", reg, dataLen, crc);
+    SERIAL_send_BAP(frame, dataLen + 6, false);
+    return dataLen + 6;
+}
+
+static esp_err_t sendRegisterDataBAP(uint8_t reg, const void* data, size_t dataLen) 
+{
+    // Don't send if we're receiving data or within the delay period after receiving data
+    if (sendBlockedBAP()) {
+        ESP_LOGD("LVGL", "Skipping send of reg 0x%02X while the display is talking", reg);
         return ESP_OK;
     }
 
-    // Check total size including register byte and length byte
-    if (dataLen + 4 > MAX_BUFFER_SIZE_BAP) {
-        ESP_LOGE("LVGL", "Buffer overflow prevented: reg 0x%02X, size %d", reg, dataLen);
+    if (writeFrameBAP(displayBufferBAP, sizeof(displayBufferBAP), reg, data, dataLen) == 0) {
         return ESP_ERR_NO_MEM;
-    }        
-    
-    // Clear only the portion of buffer we'll use
-    //memset(displayBufferBAP, 0, dataLen + 2);
-    
-    // Prepare data
-    memset(displayBufferBAP, 0, MAX_BUFFER_SIZE_BAP);
-    displayBufferBAP[0] = 0xFF;
-    displayBufferBAP[1] = 0xAA;
-    displayBufferBAP[2] = reg;
-    displayBufferBAP[3] = (uint8_t)dataLen; // Explicitly cast size to uint8_t
-    if (data != NULL && dataLen > 0) {
-        memcpy(&displayBufferBAP[4], data, dataLen);
     }
-    
-    // Calculate CRC16 for the entire message (preamble + reg + len + data)
-    uint16_t crc = calculate_crc16(&displayBufferBAP[2], dataLen + 2);  // +4 for preamble (2) + reg (1) + len (1)
-    
-    // Append CRC to the message
-    displayBufferBAP[dataLen + 4] = (crc >> 8) & 0xFF;    // High byte
-    displayBufferBAP[dataLen + 5] = crc & 0xFF;           // Low byte
-    
-    // Send data with CRC
-    ESP_LOGI("LVGL", "Sending reg 0x%02X, len %d, CRC: 0x%04X", reg, dataLen, crc);
-    SERIAL_send_BAP(displayBufferBAP, dataLen + 6, false);
-    // Wait for CRC feedback
+    return ESP_OK;
+}
+
+static bapShadow_t *findShadowBAP(uint8_t reg)
+{
+    for (int i = 0; i < BAP_SHADOW_SIZE; i++) {
+        if (shadowBAP[i].used && shadowBAP[i].reg == reg) {
+            return &shadowBAP[i];
+        }
+    }
+    for (int i = 0; i < BAP_SHADOW_SIZE; i++) {
+        if (!shadowBAP[i].used) {
+            memset(&shadowBAP[i], 0, sizeof(shadowBAP[i]));
+            shadowBAP[i].used = true;
+            shadowBAP[i].reg = reg;
+            return &shadowBAP[i];
+        }
+    }
+    return NULL;
+}
+
+static void resetBatchBAP(bapBatch_t *batch)
+{
+    batch->len = 2;
+    batch->count = 0;
+}
+
+// Make the display get every register again with the next update
+static void invalidateShadowBAP(void)
+{
+    for (int i = 0; i < BAP_SHADOW_SIZE; i++) {
+        shadowBAP[i].sent = false;
+    }
+    lastFullRefreshBAP = xTaskGetTickCount();
+}
+
+static void finishOutstandingBAP(bool acknowledged)
+{
+    for (int i = 0; i < outstandingBAP.count; i++) {
+        bapShadow_t *entry = &shadowBAP[outstandingBAP.shadowIndex[i]];
+        if (acknowledged) {
+            entry->sent = true;
+            entry->sentCrc = outstandingBAP.crc[i];
+        }
+        entry->inflight = false;
+    }
+    awaitingAckBAP = false;
+}
+
+static void sendStagedV1BAP(void)
+{
+    size_t offset = 2;
+    for (int i = 0; i < stagedBAP.count; i++) {
+        uint8_t reg = stagedBAP.data[offset];
+        uint8_t len = stagedBAP.data[offset + 1];
+        writeFrameBAP(displayBufferBAP, sizeof(displayBufferBAP), reg, &stagedBAP.data[offset + 2], len);
+
+        // Nothing is acknowledged in v1, assume it arrived
+        bapShadow_t *entry = &shadowBAP[stagedBAP.shadowIndex[i]];
+        entry->sent = true;
+        entry->sentCrc = stagedBAP.crc[i];
+        offset += 2 + len;
+    }
+    resetBatchBAP(&stagedBAP);
+}
+
+static void sendStagedBatchBAP(void)
+{
+    stagedBAP.data[0] = nextSeqBAP++;
+    stagedBAP.data[1] = stagedBAP.count;
+    outstandingFrameLenBAP = writeFrameBAP(outstandingFrameBAP, sizeof(outstandingFrameBAP), LVGL_REG_BATCH,
+                                           stagedBAP.data, stagedBAP.len);
+
+    outstandingBAP = stagedBAP;
+    for (int i = 0; i < outstandingBAP.count; i++) {
+        bapShadow_t *entry = &shadowBAP[outstandingBAP.shadowIndex[i]];
+        entry->inflight = true;
+        entry->inflightCrc = outstandingBAP.crc[i];
+    }
+    awaitingAckBAP = true;
+    outstandingSentTimeBAP = xTaskGetTickCount();
+    retriesBAP = 0;
+    resetBatchBAP(&stagedBAP);
+}
+
+/// @brief Queues a register for the next flush unless the display already has this value
+static esp_err_t stageRegisterBAP(uint8_t reg, const void* data, size_t dataLen)
+{
+    if (dataLen + 2 > sizeof(stagedBAP.data) - 2) {
+        ESP_LOGE("LVGL", "Register 0x%02X too large for a batch: %d bytes", reg, dataLen);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    bapShadow_t *entry = findShadowBAP(reg);
+    if (entry == NULL) {
+        ESP_LOGE("LVGL", "No shadow slot left for reg 0x%02X", reg);
+        return ESP_ERR_NO_MEM;
+    }
+
+    uint32_t crc = esp_rom_crc32_le(dataLen, data, dataLen);
+    if ((entry->sent && entry->sentCrc == crc) || (entry->inflight && entry->inflightCrc == crc)) {
+        return ESP_OK;
+    }
+    for (int i = 0; i < stagedBAP.count; i++) {
+        if (&shadowBAP[stagedBAP.shadowIndex[i]] == entry && stagedBAP.crc[i] == crc) {
+            return ESP_OK;
+        }
+    }
+
+    if (stagedBAP.len + 2 + dataLen > sizeof(stagedBAP.data) || stagedBAP.count == BAP_BATCH_MAX_REGS) {
+        // A v1 display takes the registers one by one, so make room right away. A v2 batch
+        // waits for its turn and the value is staged again on the next update.
+        if (displayV2BAP || sendBlockedBAP()) {
+            return ESP_OK;
+        }
+        sendStagedV1BAP();
+    }
 
+    stagedBAP.data[stagedBAP.len] = reg;
+    stagedBAP.data[stagedBAP.len + 1] = (uint8_t)dataLen;
+    if (dataLen > 0) {
+        memcpy(&stagedBAP.data[stagedBAP.len + 2], data, dataLen);
+    }
+    stagedBAP.len += 2 + dataLen;
+    stagedBAP.shadowIndex[stagedBAP.count] = entry - shadowBAP;
+    stagedBAP.crc[stagedBAP.count] = crc;
+    stagedBAP.count++;
     return ESP_OK;
 }
 
-esp_err_t lvglDisplay_initBAP(void) 
+static void handleAckBAP(uint8_t seq)
+{
+    if (!awaitingAckBAP || seq != outstandingFrameBAP[4]) {
+        ESP_LOGD("LVGL", "Ignoring ACK for batch %d", seq);
+        return;
+    }
+    finishOutstandingBAP(true);
+    failedBatchesBAP = 0;
+}
+
+static void handleVersionBAP(uint8_t version)
+{
+    ESP_LOGI("LVGL", "Display speaks BAP protocol v%d", version);
+    displayV2BAP = version >= 2;
+    failedBatchesBAP = 0;
+    // Announced when the display starts, it has none of the values yet
+    invalidateShadowBAP();
+}
+
+esp_err_t lvglFlushDisplayBAP(void)
+{
+    TickType_t now = xTaskGetTickCount();
+
+    if (announcedVersionBAP >= 0) {
+        handleVersionBAP(announcedVersionBAP);
+        announcedVersionBAP = -1;
+    }
+    if (ackPendingBAP) {
+        ackPendingBAP = false;
+        handleAckBAP(ackSeqBAP);
+    }
+
+    if (awaitingAckBAP) {
+        if ((now - outstandingSentTimeBAP) < pdMS_TO_TICKS(BAP_ACK_TIMEOUT_MS)) {
+            return ESP_OK;
+        }
+        if (retriesBAP < BAP_MAX_RETRIES) {
+            retriesBAP++;
+            outstandingSentTimeBAP = now;
+            SERIAL_send_BAP(outstandingFrameBAP, outstandingFrameLenBAP, false);
+            return ESP_OK;
+        }
+        // The registers are not marked as sent, so they go out again with the next update
+        ESP_LOGW("LVGL", "Display did not acknowledge batch %d", outstandingFrameBAP[4]);
+        finishOutstandingBAP(false);
+        if (++failedBatchesBAP >= BAP_MAX_FAILED_BATCHES) {
+            ESP_LOGW("LVGL", "Display stopped acknowledging, falling back to protocol v1");
+            displayV2BAP = false;
+            failedBatchesBAP = 0;
+        }
+    }
+
+    if ((now - lastFullRefreshBAP) >= pdMS_TO_TICKS(BAP_FULL_REFRESH_MS)) {
+        invalidateShadowBAP();
+    }
+
+    if (stagedBAP.count == 0 || sendBlockedBAP()) {
+        return ESP_OK;
+    }
+
+    if (displayV2BAP) {
+        sendStagedBatchBAP();
+    } else {
+        sendStagedV1BAP();
+    }
+    return ESP_OK;
+}
+
+static void bapRxTask(void *pvParameters);
+
+esp_err_t lvglDisplay_initBAP(GlobalState *GLOBAL_STATE) 
 {
     lastUpdateTime = xTaskGetTickCount();
 
-    // Test Serial
-    SERIAL_init_BAP();
+    if (SERIAL_init_BAP(&uartEventsBAP) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    if (xTaskCreate(bapRxTask, "bap rx", 4096, GLOBAL_STATE, 3, NULL) != pdPASS) {
+        ESP_LOGE("LVGL", "Failed to start the BAP receive task");
+        return ESP_ERR_NO_MEM;
+    }
     /*
     //TODO: Add initialization handshake to detect if screen is connected
     //SERIAL_send_BAP("Hello", 5, false);
@@ -288,7 +568,7 @@ esp_err_t lvglUpdateDisplayNetworkBAP(GlobalState *GLOBAL_STATE)
     size_t dataLen = strlen(module->ssid);
     if (dataLen + 2 > MAX_BUFFER_SIZE_BAP) return ESP_ERR_NO_MEM;
         
-    ret = sendRegisterDataBAP(LVGL_REG_SSID, module->ssid, dataLen);
+    ret = stageRegisterBAP(LVGL_REG_SSID, module->ssid, dataLen);
     if (ret != ESP_OK) return ret;
 
     // LVGL_REG_IP_ADDR (0x22)
@@ -297,31 +577,34 @@ esp_err_t lvglUpdateDisplayNetworkBAP(GlobalState *GLOBAL_STATE)
     
     dataLen = strlen(ip_address_str);
     if (dataLen + 2 > MAX_BUFFER_SIZE_BAP) return ESP_ERR_NO_MEM;
-    ret = sendRegisterDataBAP(LVGL_REG_IP_ADDR, ip_address_str, dataLen);
+    ret = stageRegisterBAP(LVGL_REG_IP_ADDR, ip_address_str, dataLen);
     if (ret != ESP_OK) return ret;
         
     // LVGL_REG_WIFI_STATUS (0x23)
     dataLen = strlen(module->wifi_status);
     if (dataLen + 2 > MAX_BUFFER_SIZE_BAP) return ESP_ERR_NO_MEM;
 
-    ret = sendRegisterDataBAP(LVGL_REG_WIFI_STATUS, module->wifi_status, dataLen);
+    ret = stageRegisterBAP(LVGL_REG_WIFI_STATUS, module->wifi_status, dataLen);
     if (ret != ESP_OK) return ret;
 
 
     // LVGL_REG_POOL_URL (0x24)
-    const char *currentPoolUrl = module->pool_url;
+    char currentPoolUrl[POOL_URL_SIZE];
+    SYSTEM_copy_pool_url(GLOBAL_STATE, false, currentPoolUrl, sizeof(currentPoolUrl));
     dataLen = strlen(currentPoolUrl);
     if (dataLen + 2 > MAX_BUFFER_SIZE_BAP) return ESP_ERR_NO_MEM;
 
-    ret = sendRegisterDataBAP(LVGL_REG_POOL_URL, currentPoolUrl, dataLen);
+    ret = stageRegisterBAP(LVGL_REG_POOL_URL, currentPoolUrl, dataLen);
     if (ret != ESP_OK) return ret;
 
 
     // LVGL_REG_FALLBACK_URL (0x25)
-    dataLen = strlen(module->fallback_pool_url);
+    char fallbackPoolUrl[POOL_URL_SIZE];
+    SYSTEM_copy_pool_url(GLOBAL_STATE, true, fallbackPoolUrl, sizeof(fallbackPoolUrl));
+    dataLen = strlen(fallbackPoolUrl);
     if (dataLen + 2 > MAX_BUFFER_SIZE_BAP) return ESP_ERR_NO_MEM;
 
-    ret = sendRegisterDataBAP(LVGL_REG_FALLBACK_URL, module->fallback_pool_url, dataLen);
+    ret = stageRegisterBAP(LVGL_REG_FALLBACK_URL, fallbackPoolUrl, dataLen);
     if (ret != ESP_OK) return ret;
 
 
@@ -332,13 +615,12 @@ esp_err_t lvglUpdateDisplayNetworkBAP(GlobalState *GLOBAL_STATE)
         module->fallback_pool_port
     };
     if (sizeof(uint16_t) * 2 + 2 > MAX_BUFFER_SIZE_BAP) return ESP_ERR_NO_MEM;
-    ret = sendRegisterDataBAP(LVGL_REG_POOL_PORTS, ports, sizeof(uint16_t) * 2);
+    ret = stageRegisterBAP(LVGL_REG_POOL_PORTS, ports, sizeof(uint16_t) * 2);
     if (ret != ESP_OK) return ret;
 
     return ESP_OK;
 }
 
-// TODO: Redo Function to send data in one call
 esp_err_t lvglUpdateDisplayMiningBAP(GlobalState *GLOBAL_STATE) 
 {
     static TickType_t lastMiningUpdateTime = 0;
@@ -354,14 +636,7 @@ esp_err_t lvglUpdateDisplayMiningBAP(GlobalState *GLOBAL_STATE)
 
     // LVGL_REG_HASHRATE (0x30)
     float hashrate = module->current_hashrate;
-    ESP_LOGI("LVGL", "Sending hashrate: %.2f", hashrate);
-    ESP_LOGI("LVGL", "Bytes: %02X %02X %02X %02X", 
-        ((uint8_t*)&hashrate)[0],
-        ((uint8_t*)&hashrate)[1],
-        ((uint8_t*)&hashrate)[2],
-        ((uint8_t*)&hashrate)[3]);
-
-    ret = sendRegisterDataBAP(LVGL_REG_HASHRATE, &hashrate, sizeof(float));
+    ret = stageRegisterBAP(LVGL_REG_HASHRATE, &hashrate, sizeof(float));
     if (ret != ESP_OK) return ret;
 
     // LVGL_REG_HIST_HASHRATE (0x31)
@@ -374,19 +649,19 @@ esp_err_t lvglUpdateDisplayMiningBAP(GlobalState *GLOBAL_STATE)
     if (module->current_hashrate > 0) {
         efficiency = power->power / (module->current_hashrate / 1000.0);
     }
-    ret = sendRegisterDataBAP(LVGL_REG_EFFICIENCY, &efficiency, sizeof(float));
+    ret = stageRegisterBAP(LVGL_REG_EFFICIENCY, &efficiency, sizeof(float));
     if (ret != ESP_OK) return ret;
 
     // LVGL_REG_BEST_DIFF (0x33)
     size_t bestDiffLen = strlen(module->best_diff_string);
     if (bestDiffLen + 2 > MAX_BUFFER_SIZE_BAP) return ESP_ERR_NO_MEM;
-    ret = sendRegisterDataBAP(LVGL_REG_BEST_DIFF, module->best_diff_string, bestDiffLen);
+    ret = stageRegisterBAP(LVGL_REG_BEST_DIFF, module->best_diff_string, bestDiffLen);
     if (ret != ESP_OK) return ret;
 
     // LVGL_REG_SESSION_DIFF (0x34)
     size_t sessionDiffLen = strlen(module->best_session_diff_string);
     if (sessionDiffLen + 2 > MAX_BUFFER_SIZE_BAP) return ESP_ERR_NO_MEM;
-    ret = sendRegisterDataBAP(LVGL_REG_SESSION_DIFF, module->best_session_diff_string, sessionDiffLen);
+    ret = stageRegisterBAP(LVGL_REG_SESSION_DIFF, module->best_session_diff_string, sessionDiffLen);
     if (ret != ESP_OK) return ret;
 
     // LVGL_REG_SHARES (0x35)
@@ -394,10 +669,21 @@ esp_err_t lvglUpdateDisplayMiningBAP(GlobalState *GLOBAL_STATE)
         module->shares_accepted,
         module->shares_rejected
     };
-    ret = sendRegisterDataBAP(LVGL_REG_SHARES, shares, sizeof(uint32_t) * 2);
+    ret = stageRegisterBAP(LVGL_REG_SHARES, shares, sizeof(uint32_t) * 2);
     if (ret != ESP_OK) return ret;
 
-    
+    // LVGL_REG_API_NETWORK_DIFFICULTY (0x62) and LVGL_REG_API_BLOCK_HEIGHT (0x63)
+    // come from the pool's mining.notify, so they work without internet access
+    ChainState chain;
+    SYSTEM_copy_chain_state(GLOBAL_STATE, GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback, &chain);
+    if (chain.network_difficulty > 0) {
+        ret = stageRegisterBAP(LVGL_REG_API_NETWORK_DIFFICULTY, &chain.network_difficulty, sizeof(double));
+        if (ret != ESP_OK) return ret;
+    }
+    if (chain.block_height != 0) {
+        ret = stageRegisterBAP(LVGL_REG_API_BLOCK_HEIGHT, &chain.block_height, sizeof(uint32_t));
+        if (ret != ESP_OK) return ret;
+    }
 
     return ESP_OK;
 }
@@ -426,12 +712,12 @@ esp_err_t lvglUpdateDisplayMonitoringBAP(GlobalState *GLOBAL_STATE)
     }
     tempData[GLOBAL_STATE->asic_count] = power->chip_temp_avg;
     
-    ret = sendRegisterDataBAP(LVGL_REG_TEMPS, tempData, tempDataSize);
+    ret = stageRegisterBAP(LVGL_REG_TEMPS, tempData, tempDataSize);
     if (ret != ESP_OK) return ret;
 
     // LVGL_REG_ASIC_FREQ (0x41)
     if (sizeof(float) + 2 > MAX_BUFFER_SIZE_BAP) return ESP_ERR_NO_MEM;
-    ret = sendRegisterDataBAP(LVGL_REG_ASIC_FREQ, &power->frequency_value, sizeof(float)); 
+    ret = stageRegisterBAP(LVGL_REG_ASIC_FREQ, &power->frequency_value, sizeof(float)); 
     if (ret != ESP_OK) return ret;
 
     // LVGL_REG_FAN (0x42)
@@ -441,7 +727,7 @@ esp_err_t lvglUpdateDisplayMonitoringBAP(GlobalState *GLOBAL_STATE)
         (float)power->fan_rpm,   // Fan RPM
         (float)power->fan_perc   // Fan Percentage
     };
-    ret = sendRegisterDataBAP(LVGL_REG_FAN, fanData, sizeof(float) * 2);
+    ret = stageRegisterBAP(LVGL_REG_FAN, fanData, sizeof(float) * 2);
     if (ret != ESP_OK) return ret;
 
     // LVGL_REG_POWER_STATS (0x43)
@@ -451,8 +737,7 @@ esp_err_t lvglUpdateDisplayMonitoringBAP(GlobalState *GLOBAL_STATE)
         power->power,      // Power
         VCORE_get_voltage_mv(GLOBAL_STATE)      // Voltage Domain
     };
-    ret = sendRegisterDataBAP(LVGL_REG_POWER_STATS, powerStats, sizeof(float) * 4);
-    ESP_LOGI("LVGL", "Sending power stats: %.2f %.2f %.2f %.2f", powerStats[0], powerStats[1], powerStats[2], powerStats[3]);
+    ret = stageRegisterBAP(LVGL_REG_POWER_STATS, powerStats, sizeof(float) * 4);
     if (ret != ESP_OK) return ret;
 
     // LVGL_REG_ASIC_INFO (0x44)
@@ -461,18 +746,18 @@ esp_err_t lvglUpdateDisplayMonitoringBAP(GlobalState *GLOBAL_STATE)
         GLOBAL_STATE->asic_count,      // ASIC Count
         //power->vr_temp  // VR Temperature
     };
-    ret = sendRegisterDataBAP(LVGL_REG_ASIC_INFO, asicInfo, sizeof(uint16_t) * 2);
+    ret = stageRegisterBAP(LVGL_REG_ASIC_INFO, asicInfo, sizeof(uint16_t) * 2);
     if (ret != ESP_OK) return ret;
 
     // LVGL_REG_UPTIME (0x45)
     if (sizeof(uint32_t) + 2 > MAX_BUFFER_SIZE_BAP) return ESP_ERR_NO_MEM;
     uint32_t uptimeSeconds = ((esp_timer_get_time() - GLOBAL_STATE->SYSTEM_MODULE.start_time) / 1000000);
-    ret = sendRegisterDataBAP(LVGL_REG_UPTIME, &uptimeSeconds, sizeof(uint32_t));
+    ret = stageRegisterBAP(LVGL_REG_UPTIME, &uptimeSeconds, sizeof(uint32_t));
     if (ret != ESP_OK) return ret;
 
     // LVGL_REG_VREG_TEMP   0x46
     float vreg_temp = power->vr_temp;
-    ret = sendRegisterDataBAP(LVGL_REG_VREG_TEMP, &vreg_temp, sizeof(float));
+    ret = stageRegisterBAP(LVGL_REG_VREG_TEMP, &vreg_temp, sizeof(float));
     if (ret != ESP_OK) return ret;
 
     return ESP_OK;
@@ -495,27 +780,27 @@ esp_err_t lvglUpdateDisplayDeviceStatusBAP(GlobalState *GLOBAL_STATE)
 
     // LVGL_REG_DEVICE_SERIAL 0x70
     static char serialNumber[MAX_SERIAL_LENGTH] = {0};
-    strncpy(serialNumber, nvs_config_get_string(NVS_CONFIG_SERIAL_NUMBER, ""), MAX_SERIAL_LENGTH);
-    ret = sendRegisterDataBAP(LVGL_REG_DEVICE_SERIAL, serialNumber, strlen(serialNumber));
+    nvs_config_copy_string(NVS_CONFIG_SERIAL_NUMBER, "", serialNumber, sizeof(serialNumber));
+    ret = stageRegisterBAP(LVGL_REG_DEVICE_SERIAL, serialNumber, strlen(serialNumber));
     if (ret != ESP_OK) return ret;
 
     // LVGL_REG_BOARD_MODEL 0x71
     static char boardModel[MAX_MODEL_LENGTH] = {0};
     strncpy(boardModel, GLOBAL_STATE->asic_model_str, MAX_MODEL_LENGTH);
-    ret = sendRegisterDataBAP(LVGL_REG_BOARD_MODEL, boardModel, strlen(boardModel));
+    ret = stageRegisterBAP(LVGL_REG_BOARD_MODEL, boardModel, strlen(boardModel));
     if (ret != ESP_OK) return ret;
 
     // LVGL_REG_BOARD_FIRMWARE_VERSION 0x72
     static char firmwareVersion[MAX_FIRMWARE_VERSION_LENGTH] = {0};
     strncpy(firmwareVersion, esp_app_get_description()->version, MAX_FIRMWARE_VERSION_LENGTH);
-    ret = sendRegisterDataBAP(LVGL_REG_BOARD_FIRMWARE_VERSION, firmwareVersion, strlen(firmwareVersion));
+    ret = stageRegisterBAP(LVGL_REG_BOARD_FIRMWARE_VERSION, firmwareVersion, strlen(firmwareVersion));
     if (ret != ESP_OK) return ret;
 
     // LVGL_REG_THEME_CURRENT 0x73
     static char themeCurrent[MAX_THEME_LENGTH] = {0};
     themePreset_t currentTheme = getCurrentThemePreset();
     strncpy(themeCurrent, themePresetToString(currentTheme), MAX_THEME_LENGTH);
-    ret = sendRegisterDataBAP(LVGL_REG_THEME_CURRENT, themeCurrent, strlen(themeCurrent));
+    ret = stageRegisterBAP(LVGL_REG_THEME_CURRENT, themeCurrent, strlen(themeCurrent));
     if (ret != ESP_OK) return ret;
 
     // LVGL_REG_THEMES_AVAILABLE 0x74
@@ -526,10 +811,10 @@ esp_err_t lvglUpdateDisplayDeviceStatusBAP(GlobalState *GLOBAL_STATE)
     // New Flags 0x0E to
 
     if (GLOBAL_STATE->SYSTEM_MODULE.FOUND_BLOCK) {
-        sendRegisterDataBAP(LVGL_FLAG_FOUND_BLOCK, &GLOBAL_STATE->SYSTEM_MODULE.FOUND_BLOCK, sizeof(uint8_t));
+        stageRegisterBAP(LVGL_FLAG_FOUND_BLOCK, &GLOBAL_STATE->SYSTEM_MODULE.FOUND_BLOCK, sizeof(uint8_t));
     }
     if (GLOBAL_STATE->SYSTEM_MODULE.overheat_mode) {
-        sendRegisterDataBAP(LVGL_FLAG_OVERHEAT_MODE, &GLOBAL_STATE->SYSTEM_MODULE.overheat_mode, sizeof(uint8_t));
+        stageRegisterBAP(LVGL_FLAG_OVERHEAT_MODE, &GLOBAL_STATE->SYSTEM_MODULE.overheat_mode, sizeof(uint8_t));
     }
     return ESP_OK;
 }
@@ -546,355 +831,328 @@ esp_err_t lvglUpdateDisplayAPIBAP(void)
     lastPriceUpdateTime = currentTime;
 
     esp_err_t ret;
-    MempoolApiState* mempoolState = getMempoolState();
+    MempoolApiState snapshot;
+    getMempoolState(&snapshot);
+    MempoolApiState* mempoolState = &snapshot;
 
     // Only send if we have valid price data
     if (mempoolState->priceValid) {
         // Send price
-        ret = sendRegisterDataBAP(LVGL_REG_API_BTC_PRICE, &mempoolState->priceUSD, sizeof(uint32_t));
+        ret = stageRegisterBAP(LVGL_REG_API_BTC_PRICE, &mempoolState->priceUSD, sizeof(uint32_t));
         if (ret != ESP_OK) return ret;
-        ESP_LOGI("LVGL", "Sent BTC price: %lu", mempoolState->priceUSD);
+        ESP_LOGD("LVGL", "Staged BTC price: %lu", mempoolState->priceUSD);
 
     }
 
     if (mempoolState->networkHashrateValid) {
-        ret = sendRegisterDataBAP(LVGL_REG_API_NETWORK_HASHRATE, &mempoolState->networkHashrate, sizeof(double));
-        if (ret != ESP_OK) return ret;
-        ESP_LOGI("LVGL", "Sent network hashrate: %.2f", mempoolState->networkHashrate);
-    }
-
-    if (mempoolState->networkDifficultyValid) {
-        ret = sendRegisterDataBAP(LVGL_REG_API_NETWORK_DIFFICULTY, &mempoolState->networkDifficulty, sizeof(double));
+        ret = stageRegisterBAP(LVGL_REG_API_NETWORK_HASHRATE, &mempoolState->networkHashrate, sizeof(double));
         if (ret != ESP_OK) return ret;
-        ESP_LOGI("LVGL", "Sent network difficulty: %.2f", mempoolState->networkDifficulty);
+        ESP_LOGD("LVGL", "Staged network hashrate: %.2f", mempoolState->networkHashrate);
     }
 
-    if (mempoolState->blockHeightValid) {
-        ret = sendRegisterDataBAP(LVGL_REG_API_BLOCK_HEIGHT, &mempoolState->blockHeight, sizeof(uint32_t));
-        if (ret != ESP_OK) return ret;
-        ESP_LOGI("LVGL", "Sent block height: %lu", mempoolState->blockHeight);
-    }
+    // Network difficulty and block height are staged from the pool's notify in lvglUpdateDisplayMiningBAP
 
     if (mempoolState->difficultyProgressPercentValid) {
-        ret = sendRegisterDataBAP(LVGL_REG_API_DIFFICULTY_PROGRESS, &mempoolState->difficultyProgressPercent, sizeof(double));
+        ret = stageRegisterBAP(LVGL_REG_API_DIFFICULTY_PROGRESS, &mempoolState->difficultyProgressPercent, sizeof(double));
         if (ret != ESP_OK) return ret;
-        ESP_LOGI("LVGL", "Sent difficulty progress: %.2f", mempoolState->difficultyProgressPercent);
+        ESP_LOGD("LVGL", "Staged difficulty progress: %.2f", mempoolState->difficultyProgressPercent);
     }
 
     if (mempoolState->difficultyChangePercentValid) {
-        ret = sendRegisterDataBAP(LVGL_REG_API_DIFFICULTY_CHANGE, &mempoolState->difficultyChangePercent, sizeof(double));
+        ret = stageRegisterBAP(LVGL_REG_API_DIFFICULTY_CHANGE, &mempoolState->difficultyChangePercent, sizeof(double));
         if (ret != ESP_OK) return ret;
-        ESP_LOGI("LVGL", "Sent difficulty change: %.2f", mempoolState->difficultyChangePercent);
+        ESP_LOGD("LVGL", "Staged difficulty change: %.2f", mempoolState->difficultyChangePercent);
     }
 
     if (mempoolState->remainingBlocksToDifficultyAdjustmentValid) {
-        ret = sendRegisterDataBAP(LVGL_REG_API_REMAINING_BLOCKS, &mempoolState->remainingBlocksToDifficultyAdjustment, sizeof(uint32_t));
+        ret = stageRegisterBAP(LVGL_REG_API_REMAINING_BLOCKS, &mempoolState->remainingBlocksToDifficultyAdjustment, sizeof(uint32_t));
         if (ret != ESP_OK) return ret;
-        ESP_LOGI("LVGL", "Sent remaining blocks: %lu", mempoolState->remainingBlocksToDifficultyAdjustment);
+        ESP_LOGD("LVGL", "Staged remaining blocks: %lu", mempoolState->remainingBlocksToDifficultyAdjustment);
     }
 
     if (mempoolState->remainingTimeToDifficultyAdjustmentValid) {
-        ret = sendRegisterDataBAP(LVGL_REG_API_REMAINING_TIME, &mempoolState->remainingTimeToDifficultyAdjustment, sizeof(uint32_t));
+        ret = stageRegisterBAP(LVGL_REG_API_REMAINING_TIME, &mempoolState->remainingTimeToDifficultyAdjustment, sizeof(uint32_t));
         if (ret != ESP_OK) return ret;
-        ESP_LOGI("LVGL", "Sent remaining time: %lu", mempoolState->remainingTimeToDifficultyAdjustment);
+        ESP_LOGD("LVGL", "Staged remaining time: %lu", mempoolState->remainingTimeToDifficultyAdjustment);
     }
 
     if (mempoolState->fastestFeeValid) {
-        ret = sendRegisterDataBAP(LVGL_REG_API_FASTEST_FEE, &mempoolState->fastestFee, sizeof(uint32_t));
+        ret = stageRegisterBAP(LVGL_REG_API_FASTEST_FEE, &mempoolState->fastestFee, sizeof(uint32_t));
         if (ret != ESP_OK) return ret;
-        ESP_LOGI("LVGL", "Sent fastest fee: %lu", mempoolState->fastestFee);
+        ESP_LOGD("LVGL", "Staged fastest fee: %lu", mempoolState->fastestFee);
     }
 
     if (mempoolState->halfHourFeeValid) {
-        ret = sendRegisterDataBAP(LVGL_REG_API_HALF_HOUR_FEE, &mempoolState->halfHourFee, sizeof(uint32_t));
+        ret = stageRegisterBAP(LVGL_REG_API_HALF_HOUR_FEE, &mempoolState->halfHourFee, sizeof(uint32_t));
         if (ret != ESP_OK) return ret;
-        ESP_LOGI("LVGL", "Sent half hour fee: %lu", mempoolState->halfHourFee);
+        ESP_LOGD("LVGL", "Staged half hour fee: %lu", mempoolState->halfHourFee);
     }
 
     if (mempoolState->hourFeeValid) {
-        ret = sendRegisterDataBAP(LVGL_REG_API_HOUR_FEE, &mempoolState->hourFee, sizeof(uint32_t));
+        ret = stageRegisterBAP(LVGL_REG_API_HOUR_FEE, &mempoolState->hourFee, sizeof(uint32_t));
         if (ret != ESP_OK) return ret;
-        ESP_LOGI("LVGL", "Sent hour fee: %lu", mempoolState->hourFee);
+        ESP_LOGD("LVGL", "Staged hour fee: %lu", mempoolState->hourFee);
     }
 
     if (mempoolState->economyFeeValid) {
-        ret = sendRegisterDataBAP(LVGL_REG_API_ECONOMY_FEE, &mempoolState->economyFee, sizeof(uint32_t));
+        ret = stageRegisterBAP(LVGL_REG_API_ECONOMY_FEE, &mempoolState->economyFee, sizeof(uint32_t));
         if (ret != ESP_OK) return ret;
-        ESP_LOGI("LVGL", "Sent economy fee: %lu", mempoolState->economyFee);
+        ESP_LOGD("LVGL", "Staged economy fee: %lu", mempoolState->economyFee);
     }
 
     if (mempoolState->minimumFeeValid) {
-        ret = sendRegisterDataBAP(LVGL_REG_API_MINIMUM_FEE, &mempoolState->minimumFee, sizeof(uint32_t));
+        ret = stageRegisterBAP(LVGL_REG_API_MINIMUM_FEE, &mempoolState->minimumFee, sizeof(uint32_t));
         if (ret != ESP_OK) return ret;
-        ESP_LOGI("LVGL", "Sent minimum fee: %lu", mempoolState->minimumFee);
+        ESP_LOGD("LVGL", "Staged minimum fee: %lu", mempoolState->minimumFee);
     }
 
     return ESP_OK;
 }
 #endif
 
-/// @brief waits for a serial response from the device
-/// @param buf buffer to read data into
-/// @param size size of the buffer
-/// @param timeout_ms number of ms to wait before timing out
-/// @return number of bytes read, or -1 on error
-int16_t SERIAL_rx_BAP(GlobalState *GLOBAL_STATE, uint8_t *buf, uint16_t size, uint16_t timeout_ms) {
-    SystemModule *module = &GLOBAL_STATE->SYSTEM_MODULE;
-    memset(buf, 0, size);
-    
-    // Set receiving flag
-    is_receiving_data = true;
-    
-    int16_t bytes_read = uart_read_bytes(UART_NUM_2, buf, size, timeout_ms / portTICK_PERIOD_MS);
+static void setStringBAP(GlobalState *GLOBAL_STATE, const bapSetting_t *setting, const uint8_t *data, uint8_t len)
+{
+    char value[BAP_MAX_FRAME_DATA + 1];
+    size_t valueLen = len < setting->maxLen ? len : setting->maxLen;
+    memcpy(value, data, valueLen);
+    value[valueLen] = '\0';
+    nvs_config_set_string(setting->nvsKey, value);
+}
 
-    if (bytes_read > 0) {
-        // Update last receive time
-        last_receive_time = xTaskGetTickCount();
-        
-        ESP_LOGI("Serial BAP", "rx: ");
-        prettyHex((unsigned char*) buf, bytes_read);
-        ESP_LOGI("Serial BAP", " [%d]\n", bytes_read);
-
-        // Minimum message size: preamble (2) + reg (1) + len (1) + data (1) + CRC (2) = 7 bytes
-        if (bytes_read < 7) {
-            ESP_LOGE("Serial BAP", "Message too short");
-            is_receiving_data = false;  // Clear flag before returning
-            return -1;
+// Big endian, rejected outside min..max
+static void setU16BAP(GlobalState *GLOBAL_STATE, const bapSetting_t *setting, const uint8_t *data, uint8_t len)
+{
+    if (len < 2) {
+        ESP_LOGE("Serial BAP", "%s too short", setting->name);
+        return;
+    }
+    uint16_t value = data[0] * 256 + data[1];
+    if (value < setting->min || value > setting->max) {
+        ESP_LOGE("Serial BAP", "Invalid %s: %d", setting->name, value);
+        return;
+    }
+    ESP_LOGI("Serial BAP", "Setting %s to %d", setting->name, value);
+    nvs_config_set_u16(setting->nvsKey, value);
+}
+
+// Fan speed and auto fan only use the low byte of their two
+static void setLowByteBAP(GlobalState *GLOBAL_STATE, const bapSetting_t *setting, const uint8_t *data, uint8_t len)
+{
+    if (len < 2) {
+        ESP_LOGE("Serial BAP", "%s too short", setting->name);
+        return;
+    }
+    if (data[1] < setting->min || data[1] > setting->max) {
+        ESP_LOGE("Serial BAP", "Invalid %s: %d", setting->name, data[1]);
+        return;
+    }
+    ESP_LOGI("Serial BAP", "Setting %s to %d", setting->name, data[1]);
+    nvs_config_set_u16(setting->nvsKey, data[1]);
+}
+
+static void setFirstByteBAP(GlobalState *GLOBAL_STATE, const bapSetting_t *setting, const uint8_t *data, uint8_t len)
+{
+    if (len < 1) {
+        ESP_LOGE("Serial BAP", "%s too short", setting->name);
+        return;
+    }
+    ESP_LOGI("Serial BAP", "Setting %s to %d", setting->name, data[0]);
+    nvs_config_set_u16(setting->nvsKey, data[0]);
+}
+
+static void setThemeBAP(GlobalState *GLOBAL_STATE, const bapSetting_t *setting, const uint8_t *data, uint8_t len)
+{
+    if (len < 1) {
+        ESP_LOGE("Serial BAP", "%s too short", setting->name);
+        return;
+    }
+    uint16_t theme = data[0];
+    ESP_LOGI("Serial BAP", "Theme: %d", theme);
+    nvs_config_set_u16(NVS_CONFIG_THEME_NAME, theme);
+    initializeTheme(theme);
+}
+
+static void setThemeNameBAP(GlobalState *GLOBAL_STATE, const bapSetting_t *setting, const uint8_t *data, uint8_t len)
+{
+    char themeName[32];
+    size_t nameLen = len < sizeof(themeName) - 1 ? len : sizeof(themeName) - 1;
+    memcpy(themeName, data, nameLen);
+    themeName[nameLen] = '\0';
+    ESP_LOGI("Serial BAP", "Theme: %s", themeName);
+    initializeTheme(themePresetFromString(themeName));
+}
+
+static void applyPresetBAP(GlobalState *GLOBAL_STATE, const bapSetting_t *setting, const uint8_t *data, uint8_t len)
+{
+    char preset[32];
+    size_t presetLen = len < sizeof(preset) - 1 ? len : sizeof(preset) - 1;
+    memcpy(preset, data, presetLen);
+    preset[presetLen] = '\0';
+    ESP_LOGI("Serial BAP", "Preset: %s", preset);
+    if (apply_preset(GLOBAL_STATE->device_model, preset)) {
+        ESP_LOGI("Serial BAP", "Preset applied successfully");
+    } else {
+        ESP_LOGE("Serial BAP", "Failed to apply preset");
+    }
+}
+
+static void restartBAP(GlobalState *GLOBAL_STATE, const bapSetting_t *setting, const uint8_t *data, uint8_t len)
+{
+    // The CRC reply has already gone out
+    vTaskDelay(pdMS_TO_TICKS(2000));
+    dataBase_flush_logs(2000);
+    esp_restart();
+}
+
+static const bapSetting_t bapSettings[] = {
+    {LVGL_REG_SETTINGS_HOSTNAME, "hostname", setStringBAP, NVS_CONFIG_HOSTNAME, .maxLen = 63},
+    {LVGL_REG_SETTINGS_WIFI_SSID, "wifi ssid", setStringBAP, NVS_CONFIG_WIFI_SSID, .maxLen = 63},
+    {LVGL_REG_SETTINGS_WIFI_PASSWORD, "wifi password", setStringBAP, NVS_CONFIG_WIFI_PASS, .maxLen = 63},
+    {LVGL_REG_SETTINGS_STRATUM_URL_MAIN, "stratum url main", setStringBAP, NVS_CONFIG_STRATUM_URL, .maxLen = 127},
+    {LVGL_REG_SETTINGS_STRATUM_PORT_MAIN, "stratum port main", setU16BAP, NVS_CONFIG_STRATUM_PORT, 0, UINT16_MAX},
+    {LVGL_REG_SETTINGS_STRATUM_USER_MAIN, "stratum user main", setStringBAP, NVS_CONFIG_STRATUM_USER, .maxLen = 63},
+    {LVGL_REG_SETTINGS_STRATUM_PASSWORD_MAIN, "stratum password main", setStringBAP, NVS_CONFIG_STRATUM_PASS, .maxLen = 63},
+    {LVGL_REG_SETTINGS_STRATUM_URL_FALLBACK, "stratum url fallback", setStringBAP, NVS_CONFIG_FALLBACK_STRATUM_URL, .maxLen = 127},
+    {LVGL_REG_SETTINGS_STRATUM_PORT_FALLBACK, "stratum port fallback", setU16BAP, NVS_CONFIG_FALLBACK_STRATUM_PORT, 0, UINT16_MAX},
+    {LVGL_REG_SETTINGS_STRATUM_USER_FALLBACK, "stratum user fallback", setStringBAP, NVS_CONFIG_FALLBACK_STRATUM_USER, .maxLen = 63},
+    {LVGL_REG_SETTINGS_STRATUM_PASSWORD_FALLBACK, "stratum password fallback", setStringBAP, NVS_CONFIG_FALLBACK_STRATUM_PASS, .maxLen = 63},
+    {LVGL_REG_SETTINGS_ASIC_VOLTAGE, "asic voltage", setU16BAP, NVS_CONFIG_ASIC_VOLTAGE, 800, 1500},
+    {LVGL_REG_SETTINGS_ASIC_FREQ, "asic frequency", setU16BAP, NVS_CONFIG_ASIC_FREQ, 200, 1000},
+    {LVGL_REG_SETTINGS_FAN_SPEED, "fan speed", setLowByteBAP, NVS_CONFIG_FAN_SPEED, 0, 100},
+    {LVGL_REG_SETTINGS_AUTO_FAN_SPEED, "auto fan speed", setLowByteBAP, NVS_CONFIG_AUTO_FAN_SPEED, 0, 1},
+    {LVGL_REG_SPECIAL_THEME, "theme", setThemeBAP},
+    {LVGL_REG_SPECIAL_PRESET, "preset", applyPresetBAP},
+    {LVGL_REG_SPECIAL_RESTART, "restart", restartBAP},
+    {LVGL_FLAG_OVERHEAT_MODE, "overheat mode", setFirstByteBAP, NVS_CONFIG_OVERHEAT_MODE},
+    {LVGL_REG_THEME_CURRENT, "current theme", setThemeNameBAP},
+};
+
+static void dispatchFrameBAP(GlobalState *GLOBAL_STATE, uint8_t reg, const uint8_t *data, uint8_t len, uint16_t crc)
+{
+    // Protocol frames carry no user input, they get no CRC reply and do not hold off sending
+    if (reg == LVGL_REG_ACK || reg == LVGL_REG_PROTOCOL_VERSION) {
+        if (len < 1) {
+            return;
         }
+        if (reg == LVGL_REG_ACK) {
+            ackSeqBAP = data[0];
+            ackPendingBAP = true;
+        } else {
+            announcedVersionBAP = data[0];
+        }
+        return;
+    }
 
-        if (buf[0] == 0xFF && buf[1] == 0xAA) {
-            uint8_t reg = buf[2];
-            uint8_t data_len = buf[3];
-            
-            // Verify total message length
-            if (bytes_read != data_len + 6) { // preamble + reg + len + data + CRC
-                ESP_LOGE("Serial BAP", "Invalid message length");
-                is_receiving_data = false;  // Clear flag before returning
-                return -1;
-            }
-            
-            // Calculate CRC16 of received message (excluding CRC bytes)
-            uint16_t calculated_crc = calculate_crc16(&buf[2], bytes_read - 4);  // Start after preamble, exclude CRC bytes
-            crcBufferTX[0] = (calculated_crc >> 8) & 0xFF;
-            crcBufferTX[1] = calculated_crc & 0xFF;
-
-            
-            
-            if (calculated_crc != ((buf[bytes_read - 2] << 8) | (buf[bytes_read - 1]))) {
-                ESP_LOGE("Serial BAP", "CRC mismatch: received 0x%04X, calculated 0x%04X", 
-                         (buf[bytes_read - 2] << 8) | (buf[bytes_read - 1]), calculated_crc);
-                SERIAL_send_BAP(crcBufferTX, 2, false);
-                is_receiving_data = false;  // Clear flag before returning
-                return -1;
-            }
-            
-            // Process the message based on register
-            if (data_len == bytes_read - 6) {
-                switch (buf[2]) {
-                    case LVGL_REG_SETTINGS_HOSTNAME:
-                    {
-                        ESP_LOGI("Serial BAP", "Received hostname");
-                        char hostname[64] = {0};  // Create temporary buffer
-                        strncpy(hostname, (const char *)(buf + 4), data_len);
-                        hostname[data_len] = '\0';  // Ensure null termination
-                        ESP_LOGI("Serial BAP", "Hostname: %s", hostname);
-                        nvs_config_set_string(NVS_CONFIG_HOSTNAME, hostname);
-                        break;
-                    }
-                case LVGL_REG_SETTINGS_WIFI_SSID:
-                    {
-                        ESP_LOGI("Serial BAP", "Received wifi ssid");
-                        char ssid[64] = {0};  // Create temporary buffer
-                        strncpy(ssid, (const char *)(buf + 4), data_len);
-                        ssid[data_len] = '\0';  // Ensure null termination
-                        ESP_LOGI("Serial BAP", "SSID: %s", ssid);
-                        nvs_config_set_string(NVS_CONFIG_WIFI_SSID, ssid);
-                        break;
-                    }
-                case LVGL_REG_SETTINGS_WIFI_PASSWORD:
-                    {
-                        ESP_LOGI("Serial BAP", "Received wifi password");
-                        char password[64] = {0};  // Create temporary buffer
-                        strncpy(password, (const char *)(buf + 4), data_len);
-                        password[data_len] = '\0';  // Ensure null termination
-                        ESP_LOGI("Serial BAP", "Password: %s", password);
-                        nvs_config_set_string(NVS_CONFIG_WIFI_PASS, password);
-                        break;
-                    }
-                case LVGL_REG_SETTINGS_STRATUM_URL_MAIN:
-                    {
-                        ESP_LOGI("Serial BAP", "Received stratum url main");
-                        char url[128] = {0};  // Create temporary buffer
-                        strncpy(url, (const char *)(buf + 4), data_len);
-                        url[data_len] = '\0';  // Ensure null termination
-                        ESP_LOGI("Serial BAP", "URL: %s", url);
-                        nvs_config_set_string(NVS_CONFIG_STRATUM_URL, url);
-                        break;
-                    }
-                case LVGL_REG_SETTINGS_STRATUM_PORT_MAIN:
-                    ESP_LOGI("Serial BAP", "Received stratum port main");
-                    ESP_LOGI("Serial BAP", "Port: %d", buf[4] * 256 + buf[5]);
-                    nvs_config_set_u16(NVS_CONFIG_STRATUM_PORT, buf[4] * 256 + buf[5]);
+    last_receive_time = xTaskGetTickCount();
+
+    uint8_t crcReply[2] = {(crc >> 8) & 0xFF, crc & 0xFF};
+    SERIAL_send_BAP(crcReply, 2, false);
+
+    for (size_t i = 0; i < sizeof(bapSettings) / sizeof(bapSettings[0]); i++) {
+        if (bapSettings[i].reg == reg) {
+            ESP_LOGI("Serial BAP", "Received %s", bapSettings[i].name);
+            bapSettings[i].handler(GLOBAL_STATE, &bapSettings[i], data, len);
+            return;
+        }
+    }
+    ESP_LOGI("Serial BAP", "Received unknown register 0x%02X", reg);
+}
+
+/// @brief Feeds received bytes through the frame parser, frames may be split or share a read
+static void parseBytesBAP(GlobalState *GLOBAL_STATE, bapParser_t *parser, const uint8_t *bytes, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        uint8_t byte = bytes[i];
+        switch (parser->state) {
+            case BAP_RX_PREAMBLE_FF:
+                if (byte == 0xFF) {
+                    parser->state = BAP_RX_PREAMBLE_AA;
+                }
+                break;
+            case BAP_RX_PREAMBLE_AA:
+                if (byte == 0xAA) {
+                    parser->pos = 0;
+                    parser->state = BAP_RX_REG;
+                    is_receiving_data = true;
+                } else if (byte != 0xFF) {
+                    parser->state = BAP_RX_PREAMBLE_FF;
+                }
+                break;
+            case BAP_RX_REG:
+                parser->body[parser->pos++] = byte;
+                parser->state = BAP_RX_LEN;
+                break;
+            case BAP_RX_LEN:
+                parser->body[parser->pos++] = byte;
+                parser->state = BAP_RX_BODY;
+                break;
+            case BAP_RX_BODY: {
+                parser->body[parser->pos++] = byte;
+                uint8_t len = parser->body[1];
+                if (parser->pos < (size_t)len + 4) {
                     break;
-                case LVGL_REG_SETTINGS_STRATUM_USER_MAIN:
-                    {
-                        ESP_LOGI("Serial BAP", "Received stratum user main");
-                        char user[64] = {0};  // Create temporary buffer
-                        strncpy(user, (const char *)(buf + 4), data_len);
-                        user[data_len] = '\0';  // Ensure null termination
-                        ESP_LOGI("Serial BAP", "User: %s", user);
-                        nvs_config_set_string(NVS_CONFIG_STRATUM_USER, user);
-                        break;
-                    }
-                case LVGL_REG_SETTINGS_STRATUM_PASSWORD_MAIN:
-                    {
-                        ESP_LOGI("Serial BAP", "Received stratum password main");
-                        char password[64] = {0};  // Create temporary buffer
-                        strncpy(password, (const char *)(buf + 4), data_len);
-                        password[data_len] = '\0';  // Ensure null termination
-                        ESP_LOGI("Serial BAP", "Password: %s", password);
-                        nvs_config_set_string(NVS_CONFIG_STRATUM_PASS, password);
-                        break;
-                    }
-                case LVGL_REG_SETTINGS_STRATUM_URL_FALLBACK:
-                    {
-                        ESP_LOGI("Serial BAP", "Received stratum url fallback");
-                        char url[128] = {0};  // Create temporary buffer
-                        strncpy(url, (const char *)(buf + 4), data_len);
-                        url[data_len] = '\0';  // Ensure null termination
-                        ESP_LOGI("Serial BAP", "URL: %s", url);
-                        nvs_config_set_string(NVS_CONFIG_FALLBACK_STRATUM_URL, url);
-                        break;
-                    }
-                case LVGL_REG_SETTINGS_STRATUM_PORT_FALLBACK:
-                    ESP_LOGI("Serial BAP", "Received stratum port fallback");
-                    ESP_LOGI("Serial BAP", "Port: %d", buf[4] * 256 + buf[5]);
-                    nvs_config_set_u16(NVS_CONFIG_FALLBACK_STRATUM_PORT, buf[4] * 256 + buf[5]);
+                }
+                uint16_t calculated = calculate_crc16(parser->body, len + 2);
+                uint16_t received = (parser->body[len + 2] << 8) | parser->body[len + 3];
+                parser->state = BAP_RX_PREAMBLE_FF;
+                is_receiving_data = false;
+                if (calculated != received) {
+                    ESP_LOGE("Serial BAP", "CRC mismatch: received 0x%04X, calculated 0x%04X", received, calculated);
+                    uint8_t crcReply[2] = {(calculated >> 8) & 0xFF, calculated & 0xFF};
+                    SERIAL_send_BAP(crcReply, 2, false);
                     break;
-                case LVGL_REG_SETTINGS_STRATUM_USER_FALLBACK:
-                    {
-                        ESP_LOGI("Serial BAP", "Received stratum user fallback");
-                        char user[64] = {0};  // Create temporary buffer
-                        strncpy(user, (const char *)(buf + 4), data_len);
-                        user[data_len] = '\0';  // Ensure null termination
-                        ESP_LOGI("Serial BAP", "User: %s", user);
-                        nvs_config_set_string(NVS_CONFIG_FALLBACK_STRATUM_USER, user);
-                        break;
-                    }
-                case LVGL_REG_SETTINGS_STRATUM_PASSWORD_FALLBACK:
-                    {
-                        ESP_LOGI("Serial BAP", "Received stratum password fallback");
-                        char password[64] = {0};  // Create temporary buffer
-                        strncpy(password, (const char *)(buf + 4), data_len);
-                        password[data_len] = '\0';  // Ensure null termination
-                        ESP_LOGI("Serial BAP", "Password: %s", password);
-                        nvs_config_set_string(NVS_CONFIG_FALLBACK_STRATUM_PASS, password);
+                }
+                dispatchFrameBAP(GLOBAL_STATE, parser->body[0], &parser->body[2], len, calculated);
+                break;
+            }
+        }
+    }
+}
+
+/// @brief Receives from the display as the UART driver reports data, nothing polls
+static void bapRxTask(void *pvParameters)
+{
+    GlobalState *GLOBAL_STATE = (GlobalState *) pvParameters;
+    bapParser_t parser = {.state = BAP_RX_PREAMBLE_FF};
+    uint8_t chunk[BAP_RX_CHUNK_SIZE];
+    uart_event_t event;
+
+    while (1) {
+        // Only a frame that is partly received needs a timeout
+        TickType_t wait = is_receiving_data ? pdMS_TO_TICKS(BAP_RX_FRAME_TIMEOUT_MS) : portMAX_DELAY;
+        if (xQueueReceive(uartEventsBAP, &event, wait) != pdTRUE) {
+            ESP_LOGW("Serial BAP", "Dropping incomplete frame");
+            parser.state = BAP_RX_PREAMBLE_FF;
+            is_receiving_data = false;
+            continue;
+        }
+
+        switch (event.type) {
+            case UART_DATA: {
+                size_t pending = event.size;
+                while (pending > 0) {
+                    int bytesRead = uart_read_bytes(UART_NUM_2, chunk, pending < sizeof(chunk) ? pending : sizeof(chunk), 0);
+                    if (bytesRead <= 0) {
                         break;
                     }
-                case LVGL_REG_SETTINGS_ASIC_VOLTAGE:
-                    ESP_LOGI("Serial BAP", "Received asic voltage");
-                    ESP_LOGI("Serial BAP", "Voltage: %d", buf[4] * 256 + buf[5]);
-                    uint16_t voltage = buf[4] * 256 + buf[5];
-                    if (voltage <= 1500 && voltage >= 800) {
-                        nvs_config_set_u16(NVS_CONFIG_ASIC_VOLTAGE, voltage);
-                        ESP_LOGI("Serial BAP", "Setting ASIC voltage to %d", voltage);
-                    }
-                    else 
-                    {
-                        ESP_LOGE("Serial BAP", "Invalid voltage: %d", voltage);
-                    }
-                    break;
-                case LVGL_REG_SETTINGS_ASIC_FREQ:
-                    ESP_LOGI("Serial BAP", "Received asic frequency");
-                    ESP_LOGI("Serial BAP", "Frequency: %d", buf[4] * 256 + buf[5]);
-                    uint16_t frequency = buf[4] * 256 + buf[5];
-                    if (frequency <= 1000 && frequency >= 200) {
-                        nvs_config_set_u16(NVS_CONFIG_ASIC_FREQ, frequency);
-                        ESP_LOGI("Serial BAP", "Setting ASIC frequency to %d", frequency);
-                    }
-                    else 
-                    {
-                        ESP_LOGE("Serial BAP", "Invalid frequency: %d", frequency);
-                    }
-                    break;
-                case LVGL_REG_SETTINGS_FAN_SPEED:
-                    ESP_LOGI("Serial BAP", "Received fan speed");
-                    ESP_LOGI("Serial BAP", "Speed: %d", buf[5]);    
-                    uint16_t fan_speed = buf[5];
-                    if (fan_speed <= 100 && fan_speed >= 0) {
-                        nvs_config_set_u16(NVS_CONFIG_FAN_SPEED, fan_speed);
-                        ESP_LOGI("Serial BAP", "Setting fan speed to %d", fan_speed);
-                    }
-                    break;
-                case LVGL_REG_SETTINGS_AUTO_FAN_SPEED:
-                    ESP_LOGI("Serial BAP", "Received auto fan enable flag");
-                    ESP_LOGI("Serial BAP", "RAW HEX: %02X", buf[5]);
-                    uint16_t auto_fan_enabled = 0x0000 + buf[5];  // Convert to bool (0 or 1)
-                    ESP_LOGI("Serial BAP", "Auto fan enabled: %d", auto_fan_enabled);
-                    nvs_config_set_u16(NVS_CONFIG_AUTO_FAN_SPEED, auto_fan_enabled ? 1 : 0);
-                    break;
-                case LVGL_REG_SPECIAL_THEME:
-                    ESP_LOGI("Serial BAP", "Received theme");
-                    ESP_LOGI("Serial BAP", "RAW HEX: %02X", buf[4]);
-                    uint16_t theme = 0x0000 + buf[4];
-                    ESP_LOGI("Serial BAP", "Theme: %d", theme);
-                    nvs_config_set_u16(NVS_CONFIG_THEME_NAME, theme);
-                    initializeTheme(theme);
-                    break;
-                case LVGL_REG_SPECIAL_PRESET:
-                    ESP_LOGI("Serial BAP", "Received preset");
-                    ESP_LOGI("Serial BAP", "RAW HEX: %02X", buf[4]);
-                    char preset[32] = {0};  // Initialize buffer for preset string
-                    strncpy(preset, (const char *)(buf + 4), data_len);  // Copy the string data
-                    preset[data_len] = '\0';  // Ensure null termination
-                    ESP_LOGI("Serial BAP", "Preset: %s", preset);
-                    if (apply_preset(GLOBAL_STATE->device_model, preset)) {
-                        ESP_LOGI("Serial BAP", "Preset applied successfully");
-                    } else {
-                        ESP_LOGE("Serial BAP", "Failed to apply preset");
-                    }
-                    break;
-                case LVGL_REG_SPECIAL_RESTART:
-                    ESP_LOGI("Serial BAP", "Received restart command");
-                    // send crc before restart
-                    SERIAL_send_BAP(crcBufferTX, 2, false);
-                    vTaskDelay(pdMS_TO_TICKS(2000));
-                    esp_restart();
-                    break;
-                case LVGL_FLAG_OVERHEAT_MODE:
-                    ESP_LOGI("Serial BAP", "Received overheat mode flag");
-                    ESP_LOGI("Serial BAP", "RAW HEX: %02X", buf[4]);
-                    uint16_t flag_overheat_mode = 0x0000 + buf[4];
-                    ESP_LOGI("Serial BAP", "Overheat mode: %d", flag_overheat_mode);
-                    nvs_config_set_u16(NVS_CONFIG_OVERHEAT_MODE, flag_overheat_mode);
-                    break;
-                // current theme
-                case LVGL_REG_THEME_CURRENT:
-                    ESP_LOGI("Serial BAP", "Received current theme");
-                    char themeName[32] = {0};  // Create temporary buffer
-                    strncpy(themeName, (const char *)(buf + 4), data_len);
-                    themeName[data_len] = '\0';  // Ensure null termination
-                    ESP_LOGI("Serial BAP", "Theme: %s", themeName);
-                    theme = themePresetFromString(themeName);
-                    initializeTheme(theme);
-                    break;
-                default:
-                        ESP_LOGI("Serial BAP", "Received unknown register");
-                        ESP_LOGI("Serial BAP", "RAW HEX: %02X", buf[2]);
-                        break;
+                    ESP_LOG_BUFFER_HEXDUMP("Serial BAP", chunk, bytesRead, ESP_LOG_DEBUG);
+                    parseBytesBAP(GLOBAL_STATE, &parser, chunk, bytesRead);
+                    pending -= bytesRead;
                 }
-                SERIAL_send_BAP(crcBufferTX, 2, false);
-            }
-            else {
-                ESP_LOGI("Serial BAP", "Received invalid length");           
-                ESP_LOGI("Serial BAP", "Expected: %d, Received: %d", buf[3], bytes_read - 4);
+                break;
             }
+            case UART_FIFO_OVF:
+            case UART_BUFFER_FULL:
+                ESP_LOGW("Serial BAP", "Receive overflow, discarding input");
+                uart_flush_input(UART_NUM_2);
+                xQueueReset(uartEventsBAP);
+                parser.state = BAP_RX_PREAMBLE_FF;
+                is_receiving_data = false;
+                break;
+            default:
+                break;
         }
     }
-    
-    // Clear receiving flag
-    is_receiving_data = false;
-    return bytes_read;
 }
 
 esp_err_t lvglStartupLoopBAP(GlobalState *GLOBAL_STATE) 
@@ -951,20 +1209,14 @@ esp_err_t lvglSendThemeBAP(char themeName[32]) {
 // send preset to BAP
 esp_err_t lvglSendPresetBAP() {
     char preset[32] = {0};
-    const char* preset_str = nvs_config_get_string(NVS_CONFIG_AUTOTUNE_PRESET, "");
-    ESP_LOGI("LVGL", "Getting preset from NVS: %s", preset_str);
-    
-    strncpy(preset, preset_str, sizeof(preset) - 1);
-    preset[sizeof(preset) - 1] = '\0';  // Ensure null termination
-    
-    size_t preset_len = strlen(preset);
+    size_t preset_len = nvs_config_copy_string(NVS_CONFIG_AUTOTUNE_PRESET, "", preset, sizeof(preset));
+    ESP_LOGI("LVGL", "Getting preset from NVS: %s", preset);
+
     ESP_LOGI("LVGL", "Sending preset length: %d", preset_len);
     ESP_LOGI("LVGL", "Sending preset: %s", preset);
 
     vTaskDelay(pdMS_TO_TICKS(1000));
 
-    // clear receiving flag due to bug TODO: Why is this happening when the same sendRegisterDataBAP is used for other registers with no issues?
-    is_receiving_data = false;
     esp_err_t ret = sendRegisterDataBAP(LVGL_REG_SPECIAL_PRESET, preset, preset_len);
     if (ret != ESP_OK) {
         ESP_LOGE("LVGL", "Failed to send preset");
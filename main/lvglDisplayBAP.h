@@ -99,6 +99,17 @@
 #define LVGL_REG_SPECIAL_PRESET 0xF1
 #define LVGL_REG_SPECIAL_RESTART 0xFE
 
+// Protocol v2 registers (0xB0 - 0xBF)
+// A display that understands v2 writes LVGL_REG_PROTOCOL_VERSION with one byte, 2, when it
+// starts. From then on registers are sent as LVGL_REG_BATCH frames:
+//   [seq][count] followed by count x [reg][len][data]
+// and the display answers each batch with LVGL_REG_ACK [seq] once it has applied it. Only
+// registers whose value changed are sent. Until the display announces v2, the same changed
+// registers go out as one v1 frame each.
+#define LVGL_REG_BATCH 0xB0
+#define LVGL_REG_ACK 0xB1
+#define LVGL_REG_PROTOCOL_VERSION 0xB2
+
 // Flags (0xE0 - 0xEF)
 #define LVGL_FLAG_STARTUP_DONE 0xE0
 #define LVGL_FLAG_OVERHEAT_MODE 0xE1
@@ -106,7 +117,7 @@
 
 
 
-esp_err_t lvglDisplay_initBAP(void);
+esp_err_t lvglDisplay_initBAP(GlobalState *GLOBAL_STATE);
 esp_err_t lvglStartupLoopBAP(GlobalState *GLOBAL_STATE);
 esp_err_t lvglOverheatLoopBAP(GlobalState *GLOBAL_STATE);
 
@@ -115,11 +126,11 @@ esp_err_t lvglUpdateDisplayMiningBAP(GlobalState *GLOBAL_STATE);
 esp_err_t lvglUpdateDisplayMonitoringBAP(GlobalState *GLOBAL_STATE);
 esp_err_t lvglUpdateDisplayDeviceStatusBAP(GlobalState *GLOBAL_STATE);
 esp_err_t lvglUpdateDisplayAPIBAP(void);
+// Send what the update functions staged, and retransmit a batch the display did not acknowledge
+esp_err_t lvglFlushDisplayBAP(void);
 esp_err_t lvglGetSettingsBAP(void);
 
 esp_err_t lvglSendPresetBAP();
 esp_err_t lvglSendThemeBAP(char themeName[32]);
 
-int16_t SERIAL_rx_BAP(GlobalState *GLOBAL_STATE, uint8_t *buf, uint16_t size, uint16_t timeout_ms);
-
 #endif
\ No newline at end of file
@@ -23,6 +23,11 @@
 #include "theme_api.h"
 #include "dataBase.h"
 #include "power_management_task.h"
+#include "telemetry_task.h"
+#include "sensor_task.h"
+#include "mempoolAPI.h"
+#include "fleet_ota_task.h"
+#include "fleet_status_task.h"
 
 static GlobalState GLOBAL_STATE = {
     .extranonce_str = NULL, 
@@ -93,10 +98,14 @@ void app_main(void)
    
     
     xTaskCreate(SYSTEM_task, "SYSTEM_task", 4096, (void *) &GLOBAL_STATE, 3, NULL);
+    xTaskCreate(SENSOR_task, "sensors", 4096, (void *) &GLOBAL_STATE, 10, NULL);
     xTaskCreate(POWER_MANAGEMENT_task, "power management", 8192, (void *) &GLOBAL_STATE, 10, NULL);
 
     //start the API for AxeOS
     start_rest_server((void *) &GLOBAL_STATE);
+
+    // Telemetry restores its history from the data partition, so start it after the database is mounted
+    xTaskCreate(TELEMETRY_task, "telemetry", 4096, (void *) &GLOBAL_STATE, 2, NULL);
     
     EventBits_t result_bits = wifi_connect();
 
@@ -138,6 +147,17 @@ void app_main(void)
     GLOBAL_STATE.SYSTEM_MODULE.startup_done = true;
     GLOBAL_STATE.new_stratum_version_rolling_msg = false;
 
+#if USE_MEMPOOL_API == 1
+    xTaskCreate(mempool_api_task, "mempool api", 8192, NULL, 2, NULL);
+#endif
+
+    if (nvs_config_get_u16(NVS_CONFIG_FLEET_OTA, 0)) {
+        xTaskCreate(FLEET_OTA_task, "fleet ota", 6144, (void *) &GLOBAL_STATE, 2, NULL);
+    }
+    if (nvs_config_get_u16(NVS_CONFIG_FLEET_STATUS, 0)) {
+        xTaskCreate(FLEET_STATUS_task, "fleet status", 4096, (void *) &GLOBAL_STATE, 2, NULL);
+    }
+
 
     if (GLOBAL_STATE.SYSTEM_MODULE.overheat_mode) {
         ESP_LOGI(TAG, "Device is in overheat mode. Resetting to balanced preset and clearing overheat mode flag.");
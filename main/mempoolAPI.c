@@ -1,4 +1,3 @@
-
 #include "mempoolAPI.h"
 #include <string.h>
 #include <stdlib.h>
@@ -7,1042 +6,382 @@
 #include "esp_timer.h"
 #include "esp_http_client.h"
 #include "esp_err.h"
+#include "esp_random.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "nvs_flash.h"
-#include "lwip/err.h"
-#include "lwip/sys.h"
-#include "cJSON.h"
+#include "freertos/semphr.h"
 #include "esp_crt_bundle.h"
 
 #if USE_MEMPOOL_API == 1
 
-#define MAX_RESPONSE_SIZE 8192  // 8KB max response size
-
-static char *responseBuffer = NULL;
-static size_t responseLength = 0;
-
-// At the top with other global variables
-MempoolApiState MEMPOOL_STATE = {
-    .priceTimestamp = 0,
-    .priceUSD = 0,
-    .priceValid = false,
-    .blockHeight = 0,
-    .blockHeightValid = false,
-    .networkHashrate = 0.0,
-    .networkHashrateValid = false,
-    .networkDifficulty = 0.0,
-    .networkDifficultyValid = false,
-    .difficultyProgressPercent = 0.0,
-    .difficultyProgressPercentValid = false,
-    .difficultyChangePercent = 0.0,
-    .difficultyChangePercentValid = false,
-    .remainingBlocksToDifficultyAdjustment = 0,
-    .remainingBlocksToDifficultyAdjustmentValid = false,
-    .remainingTimeToDifficultyAdjustment = 0,
-    .remainingTimeToDifficultyAdjustmentValid = false,
-    .fastestFee = 0,
-    .fastestFeeValid = false,
-    .halfHourFee = 0,
-    .halfHourFeeValid = false,
-    .hourFee = 0,
-    .hourFeeValid = false,
-    .economyFee = 0,
-    .economyFeeValid = false,
-    .minimumFee = 0,
-    .minimumFeeValid = false,
-};
-
-// Add getter function implementation
-MempoolApiState* getMempoolState(void) {
-    return &MEMPOOL_STATE;
+static const char *TAG = "HTTP API";
+
+#define MEMPOOL_HOST_URL "https://mempool.space"
+
+// Failed endpoints retry after 30 s, doubling up to 30 minutes. Every delay gets
+// +-10% jitter so the endpoints drift apart instead of firing in the same second.
+#define RETRY_BASE_S 30
+#define RETRY_MAX_S 1800
+#define JITTER_PERCENT 10
+
+// Longest key and number the parser keeps, anything longer is cut off
+#define PARSER_KEY_SIZE 32
+#define PARSER_VALUE_SIZE 32
+
+typedef void (*mempoolApplyFn)(MempoolApiState *state, const char *key, double value);
+
+typedef struct {
+    const char *path;
+    uint32_t periodS;
+    mempoolApplyFn apply;
+    int64_t nextDue;
+    uint8_t failures;
+} mempoolEndpoint_t;
+
+/*
+ * Pulls "key": number pairs out of the top level of a JSON object (or a bare
+ * number, reported with an empty key) one chunk at a time, so the multi-KB
+ * hashrate history is skipped without ever being buffered.
+ */
+typedef struct {
+    uint8_t depth;
+    bool inString;
+    bool escape;
+    bool readingKey;
+    bool expectValue;
+    char key[PARSER_KEY_SIZE];
+    uint8_t keyLen;
+    char value[PARSER_VALUE_SIZE];
+    uint8_t valueLen;
+    mempoolApplyFn apply;
+    MempoolApiState *state;
+} mempoolParser_t;
+
+static MempoolApiState MEMPOOL_STATE;
+static SemaphoreHandle_t stateLock;
+
+// Only the fetcher task writes here, it is published to MEMPOOL_STATE after a complete response
+static MempoolApiState pendingState;
+static mempoolParser_t parser;
+
+void getMempoolState(MempoolApiState *snapshot)
+{
+    if (stateLock == NULL) {
+        memset(snapshot, 0, sizeof(*snapshot));
+        return;
+    }
+    xSemaphoreTake(stateLock, portMAX_DELAY);
+    *snapshot = MEMPOOL_STATE;
+    xSemaphoreGive(stateLock);
 }
 
-static esp_err_t priceEventHandler(esp_http_client_event_t *evt) 
-
 /* Expected JSON format
 {
   time: 1703252411,
   USD: 43753,
   EUR: 40545,
-  GBP: 37528,
-  CAD: 58123,
-  CHF: 37438,
-  AUD: 64499,
-  JPY: 6218915
+  ...
 }
 */
+static void applyPrice(MempoolApiState *state, const char *key, double value)
 {
-    switch (evt->event_id) {
-        case HTTP_EVENT_ERROR:
-            ESP_LOGE("HTTP API", "HTTP_EVENT_ERROR");
-            break;
-        case HTTP_EVENT_ON_CONNECTED:
-            if (responseBuffer != NULL) 
-            {
-                free(responseBuffer);
-                responseBuffer = NULL;
-                responseLength = 0;
-            }
-            break;
-        case HTTP_EVENT_HEADERS_SENT:
-            break;
-        case HTTP_EVENT_ON_HEADER:
-            break;
-        case HTTP_EVENT_REDIRECT:
-            break;
-        case HTTP_EVENT_ON_DATA:
-            ESP_LOGI("HTTP API", "Receiving price data chunk: %d bytes", evt->data_len);
-
-            if (responseBuffer == NULL) 
-            {
-                responseBuffer = malloc(MAX_RESPONSE_SIZE);
-                if (responseBuffer == NULL) 
-                {
-                    ESP_LOGE("HTTP API", "Initial memory allocation failed!");
-                    responseLength = 0;
-                    return ESP_ERR_NO_MEM;
-                }
-                // Clear the buffer
-                memset(responseBuffer, 0, MAX_RESPONSE_SIZE);
-                responseLength = 0;  // Reset length when allocating new buffer
-            }
-            
-            if (responseLength + evt->data_len > MAX_RESPONSE_SIZE) {
-                ESP_LOGE("HTTP API", "Response too large, maximum size is %d bytes", MAX_RESPONSE_SIZE);
-                if (responseBuffer != NULL) {
-                    free(responseBuffer);
-                    responseBuffer = NULL;
-                }
-                responseLength = 0;
-                return ESP_ERR_NO_MEM;
-            }
-
-            if (responseBuffer == NULL) {
-                responseBuffer = malloc(MAX_RESPONSE_SIZE);
-                if (responseBuffer == NULL) {
-                    ESP_LOGE("HTTP API", "Initial memory allocation failed!");
-                    responseLength = 0;
-                    return ESP_ERR_NO_MEM;
-                }
-            }
-
-            memcpy(responseBuffer + responseLength, evt->data, evt->data_len);
-            responseLength += evt->data_len;
-            responseBuffer[responseLength] = '\0';
-            break;
-
-        case HTTP_EVENT_ON_FINISH:
-            if (responseBuffer != NULL) {
-                cJSON *json = cJSON_Parse(responseBuffer);
-                if (json != NULL) {
-                    cJSON *priceUSD = cJSON_GetObjectItem(json, "USD");
-                    if (priceUSD != NULL && cJSON_IsNumber(priceUSD)) {
-                        MEMPOOL_STATE.priceUSD = priceUSD->valueint;
-                        MEMPOOL_STATE.priceValid = true;
-                        ESP_LOGI("HTTP API", "Price USD: %d", priceUSD->valueint);
-                    }
-                    cJSON_Delete(json);
-                }
-                free(responseBuffer);
-                responseBuffer = NULL;
-                responseLength = 0;
-            }
-            break;
-            
-        case HTTP_EVENT_DISCONNECTED:
-            if (responseBuffer != NULL) {
-                free(responseBuffer);
-                responseBuffer = NULL;
-                responseLength = 0;
-            }
-            break;
+    if (strcmp(key, "time") == 0) {
+        state->priceTimestamp = (uint32_t)value;
+    } else if (strcmp(key, "USD") == 0) {
+        state->priceUSD = (uint32_t)value;
+        state->priceValid = true;
     }
-    return ESP_OK;
 }
 
-static esp_err_t blockHeightEventHandler(esp_http_client_event_t *evt) 
-
 /* Expected JSON format
 {
-  736249
-}*/
-    {
-    switch (evt->event_id) {
-        case HTTP_EVENT_ERROR:
-            ESP_LOGE("HTTP API", "HTTP_EVENT_ERROR");
-            break;
-        case HTTP_EVENT_ON_CONNECTED:
-            if (responseBuffer != NULL) 
-            {
-                free(responseBuffer);
-                responseBuffer = NULL;
-                responseLength = 0;
-            }
-            break;
-        case HTTP_EVENT_HEADERS_SENT:
-            break;
-        case HTTP_EVENT_ON_HEADER:
-            break;
-        case HTTP_EVENT_REDIRECT:
-            break;
-        case HTTP_EVENT_ON_DATA:
-        if (responseBuffer == NULL) 
-            {
-                responseBuffer = malloc(MAX_RESPONSE_SIZE);
-                if (responseBuffer == NULL) 
-                {
-                    ESP_LOGE("HTTP API", "Initial memory allocation failed!");
-                    responseLength = 0;
-                    return ESP_ERR_NO_MEM;
-                }
-                // Clear the buffer
-                memset(responseBuffer, 0, MAX_RESPONSE_SIZE);
-                responseLength = 0;  // Reset length when allocating new buffer
-            }
-
-            ESP_LOGI("HTTP API", "Receiving price data chunk: %d bytes", evt->data_len);
-            
-            if (responseLength + evt->data_len > MAX_RESPONSE_SIZE) {
-                ESP_LOGE("HTTP API", "Response too large, maximum size is %d bytes", MAX_RESPONSE_SIZE);
-                if (responseBuffer != NULL) {
-                    free(responseBuffer);
-                    responseBuffer = NULL;
-                }
-                responseLength = 0;
-                return ESP_ERR_NO_MEM;
-            }
-
-            if (responseBuffer == NULL) {
-                responseBuffer = malloc(MAX_RESPONSE_SIZE);
-                if (responseBuffer == NULL) {
-                    ESP_LOGE("HTTP API", "Initial memory allocation failed!");
-                    responseLength = 0;
-                    return ESP_ERR_NO_MEM;
-                }
-            }
-
-            memcpy(responseBuffer + responseLength, evt->data, evt->data_len);
-            responseLength += evt->data_len;
-            responseBuffer[responseLength] = '\0';
-            break;
-
-        case HTTP_EVENT_ON_FINISH:
-            if (responseBuffer != NULL) {
-                char *endptr;
-                uint32_t blockHeight = (uint32_t)strtoul(responseBuffer, &endptr, 10);
-                if (endptr != responseBuffer && *endptr == '\0') {
-                    MEMPOOL_STATE.blockHeight = blockHeight;
-                    MEMPOOL_STATE.blockHeightValid = true;
-                    ESP_LOGI("HTTP API", "Block height: %lu", blockHeight);
-                } else {
-                    ESP_LOGE("HTTP API", "Failed to parse block height");
-                }
-                free(responseBuffer);
-                responseBuffer = NULL;
-                responseLength = 0;
-            }
-            break;
-            
-        case HTTP_EVENT_DISCONNECTED:
-            if (responseBuffer != NULL) {
-                free(responseBuffer);
-                responseBuffer = NULL;
-                responseLength = 0;
-            }
-            break;
+  hashrates: [...],
+  difficulty: [...],
+  currentHashrate: 4.6e20,
+  currentDifficulty: 6.7e13
+}
+*/
+static void applyNetworkHashrate(MempoolApiState *state, const char *key, double value)
+{
+    if (strcmp(key, "currentHashrate") == 0) {
+        state->networkHashrate = value;
+        state->networkHashrateValid = true;
+    } else if (strcmp(key, "currentDifficulty") == 0) {
+        state->networkDifficulty = value;
+        state->networkDifficultyValid = true;
     }
-    return ESP_OK;
 }
 
-static esp_err_t networkHashrateEventHandler(esp_http_client_event_t *evt)
-
-/* Expected JSON format{
-  "hashrates": [
-    {
-      "timestamp": 1652486400,
-      "avgHashrate": 236499762108771800000
-    },
-    {
-      "timestamp": 1652572800,
-      "avgHashrate": 217473276787331300000
-    },
-    {
-      "timestamp": 1652659200,
-      "avgHashrate": 189877203506913000000
-    }
-  ],
-  "difficulty": [
-    {
-      "timestamp": 1652468330,
-      "difficulty": 31251101365711.12,
-      "height": 736249
+/* Expected JSON format
+{
+  progressPercent: 44.3,
+  difficultyChange: 2.1,
+  remainingBlocks: 1122,
+  remainingTime: 667830000,
+  ...
+}
+*/
+static void applyDifficultyAdjustment(MempoolApiState *state, const char *key, double value)
+{
+    if (strcmp(key, "progressPercent") == 0) {
+        state->difficultyProgressPercent = value;
+        state->difficultyProgressPercentValid = true;
+    } else if (strcmp(key, "difficultyChange") == 0) {
+        state->difficultyChangePercent = value;
+        state->difficultyChangePercentValid = true;
+    } else if (strcmp(key, "remainingBlocks") == 0) {
+        state->remainingBlocksToDifficultyAdjustment = (uint32_t)value;
+        state->remainingBlocksToDifficultyAdjustmentValid = true;
+    } else if (strcmp(key, "remainingTime") == 0) {
+        state->remainingTimeToDifficultyAdjustment = (uint32_t)value;
+        state->remainingTimeToDifficultyAdjustmentValid = true;
     }
-  ],
-  "currentHashrate": 252033247355212300000,
-  "currentDifficulty": 31251101365711.12
-}*/
-
+}
 
+/* Expected JSON format
 {
-    switch (evt->event_id) 
-    {
-        case HTTP_EVENT_ERROR:
-            ESP_LOGE("HTTP API", "HTTP_EVENT_ERROR");
-            break;
-        case HTTP_EVENT_ON_CONNECTED:
-            if (responseBuffer != NULL) 
-            {
-                free(responseBuffer);
-                responseBuffer = NULL;
-                responseLength = 0;
-            }
-            break;
-        case HTTP_EVENT_HEADERS_SENT:
-            break;
-        case HTTP_EVENT_ON_HEADER:
-            break;
-        case HTTP_EVENT_REDIRECT:
-            break;
-        case HTTP_EVENT_ON_DATA:
-            ESP_LOGI("HTTP API", "Receiving price data chunk: %d bytes", evt->data_len);
-            
-            if (responseBuffer == NULL) 
-            {
-                responseBuffer = malloc(MAX_RESPONSE_SIZE);
-                if (responseBuffer == NULL) 
-                {
-                    ESP_LOGE("HTTP API", "Initial memory allocation failed!");
-                    responseLength = 0;
-                    return ESP_ERR_NO_MEM;
-                }
-                // Clear the buffer
-                memset(responseBuffer, 0, MAX_RESPONSE_SIZE);
-                responseLength = 0;  // Reset length when allocating new buffer
-            }
+  fastestFee: 12,
+  halfHourFee: 10,
+  hourFee: 8,
+  economyFee: 4,
+  minimumFee: 2
+}
+*/
+static void applyRecommendedFee(MempoolApiState *state, const char *key, double value)
+{
+    if (strcmp(key, "fastestFee") == 0) {
+        state->fastestFee = (uint32_t)value;
+        state->fastestFeeValid = true;
+    } else if (strcmp(key, "halfHourFee") == 0) {
+        state->halfHourFee = (uint32_t)value;
+        state->halfHourFeeValid = true;
+    } else if (strcmp(key, "hourFee") == 0) {
+        state->hourFee = (uint32_t)value;
+        state->hourFeeValid = true;
+    } else if (strcmp(key, "economyFee") == 0) {
+        state->economyFee = (uint32_t)value;
+        state->economyFeeValid = true;
+    } else if (strcmp(key, "minimumFee") == 0) {
+        state->minimumFee = (uint32_t)value;
+        state->minimumFeeValid = true;
+    }
+}
 
-            if (responseLength + evt->data_len > MAX_RESPONSE_SIZE) {
-                ESP_LOGE("HTTP API", "Response too large, maximum size is %d bytes", MAX_RESPONSE_SIZE);
-                if (responseBuffer != NULL) {
-                    free(responseBuffer);
-                    responseBuffer = NULL;
-                }
-                responseLength = 0;
-                return ESP_ERR_NO_MEM;
-            }
+static mempoolEndpoint_t endpoints[] = {
+    { "/api/v1/prices", 300, applyPrice },
+    { "/api/v1/mining/hashrate/3d", 600, applyNetworkHashrate },
+    { "/api/v1/difficulty-adjustment", 300, applyDifficultyAdjustment },
+    { "/api/v1/fees/recommended", 120, applyRecommendedFee },
+};
 
-            if (responseBuffer == NULL) {
-                responseBuffer = malloc(MAX_RESPONSE_SIZE);
-                if (responseBuffer == NULL) {
-                    ESP_LOGE("HTTP API", "Initial memory allocation failed!");
-                    responseLength = 0;
-                    return ESP_ERR_NO_MEM;
-                }
-            }
+#define ENDPOINT_COUNT (sizeof(endpoints) / sizeof(endpoints[0]))
 
-            memcpy(responseBuffer + responseLength, evt->data, evt->data_len);
-            responseLength += evt->data_len;
-            responseBuffer[responseLength] = '\0';
-            break;
-            
-        case HTTP_EVENT_ON_FINISH:
-            if (responseBuffer != NULL) 
-            {
-                ESP_LOGI("HTTP API", "Parsing network hashrate data, buffer length: %d", responseLength);
-                if (responseLength > 0) {
-                    ESP_LOGI("HTTP API", "Response: %s", responseBuffer);
-                } else {
-                    ESP_LOGW("HTTP API", "Empty response buffer");
-                }
-                
-                cJSON *json = cJSON_Parse(responseBuffer);
-                if (json == NULL) {
-                    ESP_LOGE("HTTP API", "JSON parsing failed: %s", cJSON_GetErrorPtr());
-                } else {
-                    // Get current hashrate (in EH/s)
-                    cJSON *currentHashrate = cJSON_GetObjectItem(json, "currentHashrate");
-                    if (currentHashrate != NULL && cJSON_IsNumber(currentHashrate)) 
-                    {
-                        MEMPOOL_STATE.networkHashrate = currentHashrate->valuedouble;
-                        MEMPOOL_STATE.networkHashrateValid = true;
-                        ESP_LOGI("HTTP API", "Network hashrate: %.2f EH/s", MEMPOOL_STATE.networkHashrate / 1e18);
-                    }
+static void parserReset(mempoolParser_t *p, mempoolApplyFn apply, MempoolApiState *state)
+{
+    memset(p, 0, sizeof(*p));
+    p->apply = apply;
+    p->state = state;
+}
 
-                    // Get current difficulty
-                    cJSON *currentDifficulty = cJSON_GetObjectItem(json, "currentDifficulty");
-                    if (currentDifficulty != NULL && cJSON_IsNumber(currentDifficulty)) 
-                    {
-                        MEMPOOL_STATE.networkDifficulty = currentDifficulty->valuedouble;
-                        MEMPOOL_STATE.networkDifficultyValid = true;
-                        ESP_LOGI("HTTP API", "Network difficulty: %.2f", MEMPOOL_STATE.networkDifficulty);
-                    }
-                    
-                    cJSON_Delete(json);
-                }
-                free(responseBuffer);
-                responseBuffer = NULL;
-                responseLength = 0;
-            }
-            break;
-            
-        case HTTP_EVENT_DISCONNECTED:
-            if (responseBuffer != NULL) {
-                free(responseBuffer);
-                responseBuffer = NULL;
-                responseLength = 0;
-            }
-            break;
+static void parserFlushValue(mempoolParser_t *p)
+{
+    if (p->valueLen == 0) {
+        return;
     }
-    return ESP_OK;
-}
+    p->value[p->valueLen] = '\0';
+    p->valueLen = 0;
 
-static esp_err_t networkDifficultyAdjustementEventHandler(esp_http_client_event_t *evt)
+    char *end;
+    double value = strtod(p->value, &end);
+    if (end != p->value && *end == '\0') {
+        p->apply(p->state, p->depth == 0 ? "" : p->key, value);
+    }
+}
 
-/* Expected JSON format
+static void parserFeed(mempoolParser_t *p, const char *data, int len)
 {
-  progressPercent: 44.397234501112074,
-  difficultyChange: 98.45932018381687,
-  estimatedRetargetDate: 1627762478,
-  remainingBlocks: 1121,
-  remainingTime: 665977,
-  previousRetarget: -4.807005268478962,
-  nextRetargetHeight: 741888,
-  timeAvg: 302328,
-  adjustedTimeAvg: 302328,
-  timeOffset: 0
-}*/
-{
-        switch (evt->event_id) 
-    {
-        case HTTP_EVENT_ERROR:
-            ESP_LOGE("HTTP API", "HTTP_EVENT_ERROR");
-            break;
-        case HTTP_EVENT_ON_CONNECTED:
-            if (responseBuffer != NULL) 
-            {
-                free(responseBuffer);
-                responseBuffer = NULL;
-                responseLength = 0;
-            }
-            break;
-        case HTTP_EVENT_HEADERS_SENT:
-            break;
-        case HTTP_EVENT_ON_HEADER:
-            break;
-        case HTTP_EVENT_REDIRECT:
-            break;
-        case HTTP_EVENT_ON_DATA:
-            ESP_LOGI("HTTP API", "Receiving price data chunk: %d bytes", evt->data_len);
-            
-            if (responseBuffer == NULL) 
-            {
-                responseBuffer = malloc(MAX_RESPONSE_SIZE);
-                if (responseBuffer == NULL) 
-                {
-                    ESP_LOGE("HTTP API", "Initial memory allocation failed!");
-                    responseLength = 0;
-                    return ESP_ERR_NO_MEM;
+    for (int i = 0; i < len; i++) {
+        char c = data[i];
+
+        if (p->inString) {
+            if (p->escape) {
+                p->escape = false;
+            } else if (c == '\\') {
+                p->escape = true;
+            } else if (c == '"') {
+                p->inString = false;
+                if (p->readingKey) {
+                    p->key[p->keyLen] = '\0';
+                    p->readingKey = false;
                 }
-                // Clear the buffer
-                memset(responseBuffer, 0, MAX_RESPONSE_SIZE);
-                responseLength = 0;  // Reset length when allocating new buffer
+            } else if (p->readingKey && p->keyLen < PARSER_KEY_SIZE - 1) {
+                p->key[p->keyLen++] = c;
             }
+            continue;
+        }
 
-            if (responseLength + evt->data_len > MAX_RESPONSE_SIZE) {
-                ESP_LOGE("HTTP API", "Response too large, maximum size is %d bytes", MAX_RESPONSE_SIZE);
-                if (responseBuffer != NULL) {
-                    free(responseBuffer);
-                    responseBuffer = NULL;
+        switch (c) {
+            case '"':
+                p->inString = true;
+                if (p->depth == 1 && !p->expectValue) {
+                    p->readingKey = true;
+                    p->keyLen = 0;
                 }
-                responseLength = 0;
-                return ESP_ERR_NO_MEM;
-            }
-
-            if (responseBuffer == NULL) {
-                responseBuffer = malloc(MAX_RESPONSE_SIZE);
-                if (responseBuffer == NULL) {
-                    ESP_LOGE("HTTP API", "Initial memory allocation failed!");
-                    responseLength = 0;
-                    return ESP_ERR_NO_MEM;
+                break;
+            case '{':
+            case '[':
+                p->depth++;
+                break;
+            case '}':
+            case ']':
+                if (p->depth == 1) {
+                    parserFlushValue(p);
                 }
-            }
-
-            memcpy(responseBuffer + responseLength, evt->data, evt->data_len);
-            responseLength += evt->data_len;
-            responseBuffer[responseLength] = '\0';
-            break;
-            
-        case HTTP_EVENT_ON_FINISH:
-            if (responseBuffer != NULL) 
-            {
-                ESP_LOGI("HTTP API", "Parsing difficulty adjustment data, buffer length: %d", responseLength);
-                if (responseLength > 0) {
-                    ESP_LOGI("HTTP API", "Response: %s", responseBuffer);
-                } else {
-                    ESP_LOGW("HTTP API", "Empty response buffer");
+                if (p->depth > 0) {
+                    p->depth--;
                 }
-                // Parse JSON
-                cJSON *json = cJSON_Parse(responseBuffer);
-                if (json == NULL) {
-                    ESP_LOGE("HTTP API", "JSON parsing failed: %s", cJSON_GetErrorPtr());
-                } else {
-                    // Get difficulty progress percent This is the percentage of the way to the next difficulty adjustment 
-                    cJSON *progressPercent = cJSON_GetObjectItem(json, "progressPercent");
-                    if (progressPercent != NULL && cJSON_IsNumber(progressPercent)) 
-                    {
-                        MEMPOOL_STATE.difficultyProgressPercent = progressPercent->valuedouble;
-                        MEMPOOL_STATE.difficultyProgressPercentValid = true;
-                        ESP_LOGI("HTTP API", "Difficulty progress: %.2f", MEMPOOL_STATE.difficultyProgressPercent);
-                    }
-                    else
-                    {
-                        MEMPOOL_STATE.difficultyProgressPercentValid = false;
-                        ESP_LOGI("HTTP API", "Difficulty progress not found");
-                    }
-
-                    // Get difficulty change percent This is the expected change in difficulty over the next adjustment
-                    cJSON *difficultyChangePercent = cJSON_GetObjectItem(json, "difficultyChange");
-                    if (difficultyChangePercent != NULL && cJSON_IsNumber(difficultyChangePercent)) 
-                    {
-                        MEMPOOL_STATE.difficultyChangePercent = difficultyChangePercent->valuedouble;
-                        MEMPOOL_STATE.difficultyChangePercentValid = true;
-                        ESP_LOGI("HTTP API", "Difficulty change: %.2f", MEMPOOL_STATE.difficultyChangePercent);
-                    }
-                    else
-                    {
-                        MEMPOOL_STATE.difficultyChangePercentValid = false;
-                        ESP_LOGI("HTTP API", "Difficulty change not found");
-                    }
-
-                    // Get remaining blocks to difficulty adjustment
-                    cJSON *remainingBlocks = cJSON_GetObjectItem(json, "remainingBlocks");
-                    if (remainingBlocks != NULL && cJSON_IsNumber(remainingBlocks)) 
-                    {
-                        MEMPOOL_STATE.remainingBlocksToDifficultyAdjustment = remainingBlocks->valueint;
-                        MEMPOOL_STATE.remainingBlocksToDifficultyAdjustmentValid = true;
-                        ESP_LOGI("HTTP API", "Remaining blocks to difficulty adjustment: %lu", MEMPOOL_STATE.remainingBlocksToDifficultyAdjustment);
-                    }
-                    else
-                    {
-                        MEMPOOL_STATE.remainingBlocksToDifficultyAdjustmentValid = false;
-                        ESP_LOGI("HTTP API", "Remaining blocks to difficulty adjustment not found");
-                    }
-                    
-                    // Get remaining time to difficulty adjustment
-                    cJSON *remainingTime = cJSON_GetObjectItem(json, "remainingTime");
-                    if (remainingTime != NULL && cJSON_IsNumber(remainingTime)) 
-                    {
-                        MEMPOOL_STATE.remainingTimeToDifficultyAdjustment = remainingTime->valueint;
-                        MEMPOOL_STATE.remainingTimeToDifficultyAdjustmentValid = true;
-                        ESP_LOGI("HTTP API", "Remaining time to difficulty adjustment: %lu", MEMPOOL_STATE.remainingTimeToDifficultyAdjustment);
-                    }
-                    else
-                    {
-                        MEMPOOL_STATE.remainingTimeToDifficultyAdjustmentValid = false;
-                        ESP_LOGI("HTTP API", "Remaining time to difficulty adjustment not found");
-                    }
-                    
-                    cJSON_Delete(json);
+                break;
+            case ':':
+                if (p->depth == 1) {
+                    p->expectValue = true;
+                    p->valueLen = 0;
                 }
-                free(responseBuffer);
-                responseBuffer = NULL;
-                responseLength = 0;
-            }
-            break;
-            
-        case HTTP_EVENT_DISCONNECTED:
-            if (responseBuffer != NULL) {
-                free(responseBuffer);
-                responseBuffer = NULL;
-                responseLength = 0;
-            }
-            break;
+                break;
+            case ',':
+                if (p->depth == 1) {
+                    parserFlushValue(p);
+                    p->expectValue = false;
+                }
+                break;
+            default:
+                // Numbers only, true/false/null fail strtod and are dropped
+                if ((p->depth == 0 || (p->depth == 1 && p->expectValue)) && c > ' ' &&
+                    p->valueLen < PARSER_VALUE_SIZE - 1) {
+                    p->value[p->valueLen++] = c;
+                }
+                break;
+        }
     }
-    return ESP_OK;
 }
 
-
-static esp_err_t networkRecommendedFeeEventHandler(esp_http_client_event_t *evt)
-
-/* Expected JSON format
+static esp_err_t mempoolEventHandler(esp_http_client_event_t *evt)
 {
-  fastestFee: 1,
-  halfHourFee: 1,
-  hourFee: 1,
-  economyFee: 1,
-  minimumFee: 1
-}
-*/
-{
-        switch (evt->event_id) 
-    {
+    switch (evt->event_id) {
         case HTTP_EVENT_ERROR:
-            ESP_LOGE("HTTP API", "HTTP_EVENT_ERROR");
-            break;
-        case HTTP_EVENT_ON_CONNECTED:
-            if (responseBuffer != NULL) 
-            {
-                free(responseBuffer);
-                responseBuffer = NULL;
-                responseLength = 0;
-            }
-            break;
-        case HTTP_EVENT_HEADERS_SENT:
-            break;
-        case HTTP_EVENT_ON_HEADER:
-            break;
-        case HTTP_EVENT_REDIRECT:
+            ESP_LOGE(TAG, "HTTP_EVENT_ERROR");
             break;
         case HTTP_EVENT_ON_DATA:
-            ESP_LOGI("HTTP API", "Receiving price data chunk: %d bytes", evt->data_len);
-            
-            if (responseBuffer == NULL) 
-            {
-                responseBuffer = malloc(MAX_RESPONSE_SIZE);
-                if (responseBuffer == NULL) 
-                {
-                    ESP_LOGE("HTTP API", "Initial memory allocation failed!");
-                    responseLength = 0;
-                    return ESP_ERR_NO_MEM;
-                }
-                // Clear the buffer
-                memset(responseBuffer, 0, MAX_RESPONSE_SIZE);
-                responseLength = 0;  // Reset length when allocating new buffer
-            }
-
-            if (responseLength + evt->data_len > MAX_RESPONSE_SIZE) {
-                ESP_LOGE("HTTP API", "Response too large, maximum size is %d bytes", MAX_RESPONSE_SIZE);
-                if (responseBuffer != NULL) {
-                    free(responseBuffer);
-                    responseBuffer = NULL;
-                }
-                responseLength = 0;
-                return ESP_ERR_NO_MEM;
-            }
-
-            if (responseBuffer == NULL) {
-                responseBuffer = malloc(MAX_RESPONSE_SIZE);
-                if (responseBuffer == NULL) {
-                    ESP_LOGE("HTTP API", "Initial memory allocation failed!");
-                    responseLength = 0;
-                    return ESP_ERR_NO_MEM;
-                }
-            }
-
-            memcpy(responseBuffer + responseLength, evt->data, evt->data_len);
-            responseLength += evt->data_len;
-            responseBuffer[responseLength] = '\0';
+            parserFeed(&parser, evt->data, evt->data_len);
             break;
-            
-        case HTTP_EVENT_ON_FINISH:
-            if (responseBuffer != NULL) 
-            {
-                ESP_LOGI("HTTP API", "Parsing difficulty adjustment data, buffer length: %d", responseLength);
-                if (responseLength > 0) {
-                    ESP_LOGI("HTTP API", "Response: %s", responseBuffer);
-                } else {
-                    ESP_LOGW("HTTP API", "Empty response buffer");
-                }
-                // Parse JSON
-                cJSON *json = cJSON_Parse(responseBuffer);
-                if (json == NULL) {
-                    ESP_LOGE("HTTP API", "JSON parsing failed: %s", cJSON_GetErrorPtr());
-                } else {
-                    // Get fastest fee
-                    cJSON *fastestFee = cJSON_GetObjectItem(json, "fastestFee");
-                    if (fastestFee != NULL && cJSON_IsNumber(fastestFee)) 
-                    {
-                        MEMPOOL_STATE.fastestFee = fastestFee->valueint;
-                        MEMPOOL_STATE.fastestFeeValid = true;
-                        ESP_LOGI("HTTP API", "Fastest fee: %lu", MEMPOOL_STATE.fastestFee);
-                    }
-                    else
-                    {
-                        MEMPOOL_STATE.fastestFeeValid = false;
-                        ESP_LOGI("HTTP API", "Fastest fee not found");
-                    }
-
-                    // Get half hour fee
-                    cJSON *halfHourFee = cJSON_GetObjectItem(json, "halfHourFee");
-                    if (halfHourFee != NULL && cJSON_IsNumber(halfHourFee)) 
-                    {
-                        MEMPOOL_STATE.halfHourFee = halfHourFee->valueint;
-                        MEMPOOL_STATE.halfHourFeeValid = true;
-                        ESP_LOGI("HTTP API", "Half hour fee: %lu", MEMPOOL_STATE.halfHourFee);
-                    }
-                    else
-                    {
-                        MEMPOOL_STATE.halfHourFeeValid = false;
-                        ESP_LOGI("HTTP API", "Half hour fee not found");
-                    }
-
-                    // Get hour fee
-                    cJSON *hourFee = cJSON_GetObjectItem(json, "hourFee");
-                    if (hourFee != NULL && cJSON_IsNumber(hourFee)) 
-                    {
-                        MEMPOOL_STATE.hourFee = hourFee->valueint;
-                        MEMPOOL_STATE.hourFeeValid = true;
-                        ESP_LOGI("HTTP API", "Hour fee: %lu", MEMPOOL_STATE.hourFee);
-                    }
-                    else
-                    {
-                        MEMPOOL_STATE.hourFeeValid = false;
-                        ESP_LOGI("HTTP API", "Hour fee not found");
-                    }
-                    
-                    // Get economy fee
-                    cJSON *economyFee = cJSON_GetObjectItem(json, "economyFee");
-                    if (economyFee != NULL && cJSON_IsNumber(economyFee)) 
-                    {
-                        MEMPOOL_STATE.economyFee = economyFee->valueint;
-                        MEMPOOL_STATE.economyFeeValid = true;
-                        ESP_LOGI("HTTP API", "Economy fee: %lu", MEMPOOL_STATE.economyFee);
-                    }
-                    else
-                    {
-                        MEMPOOL_STATE.economyFeeValid = false;
-                        ESP_LOGI("HTTP API", "Economy fee not found");
-                    }
-                    
-                    // Get minimum fee
-                    cJSON *minimumFee = cJSON_GetObjectItem(json, "minimumFee");
-                    if (minimumFee != NULL && cJSON_IsNumber(minimumFee)) 
-                    {
-                        MEMPOOL_STATE.minimumFee = minimumFee->valueint;
-                        MEMPOOL_STATE.minimumFeeValid = true;
-                        ESP_LOGI("HTTP API", "Minimum fee: %lu", MEMPOOL_STATE.minimumFee);
-                    }
-                    cJSON_Delete(json);
-                }
-                free(responseBuffer);
-                responseBuffer = NULL;
-                responseLength = 0;
-            }
-            break;
-            
-        case HTTP_EVENT_DISCONNECTED:
-            if (responseBuffer != NULL) {
-                free(responseBuffer);
-                responseBuffer = NULL;
-                responseLength = 0;
-            }
+        default:
             break;
     }
     return ESP_OK;
 }
 
-// Update the mempool_api_price function
-esp_err_t mempool_api_price(void) {
-    static int64_t lastUpdate = 0;  
-    int64_t currentTime = esp_timer_get_time();
-    
-    // Check if it's time to send the request. Limit the number of requests here
-    if (((currentTime - lastUpdate)/1000000) > 300 || lastUpdate == 0)
-    {
-        lastUpdate = currentTime;
-        // Set up the HTTP client configuration using esp cert bndles
-        //Using Coingecko API key for testing
-        // TODO: move this to own server for production to limit the number of requests
-        esp_http_client_config_t config = {
-            .url = "https://mempool.space/api/v1/prices",
-            .event_handler = priceEventHandler,  // Use specific handler
-            .transport_type = HTTP_TRANSPORT_OVER_SSL,
-            .crt_bundle_attach = esp_crt_bundle_attach,
-        };
-
-        // Initialize client
-        esp_http_client_handle_t client = esp_http_client_init(&config);
-        if (client == NULL) 
-        {
-            ESP_LOGE("HTTP API", "Failed to initialize HTTP client");
-            return ESP_FAIL;
-        }
-
-        /* // Set headers with error checking Not needed for this API
-        esp_err_t err;
-        if ((err = esp_http_client_set_header(client, "accept", "application/json")) != ESP_OK) 
-        {
-            ESP_LOGE("HTTP API", "Failed to set accept header: %s", esp_err_to_name(err));
-            esp_http_client_cleanup(client);
-            return err;
-        }
-
-        if ((err = esp_http_client_set_header(client, "x-cg-demo-api-key", "CG-iUyVPGbu2nECCwVo8yXXUf57")) != ESP_OK) 
-        {
-            ESP_LOGE("HTTP API", "Failed to set API key header: %s", esp_err_to_name(err));
-            esp_http_client_cleanup(client);
-            return err;
-        }*/
+static int64_t jitteredDelayUs(uint32_t seconds)
+{
+    int64_t delayUs = (int64_t)seconds * 1000000;
+    int64_t spread = delayUs * JITTER_PERCENT / 100;
+    return delayUs - spread + (int64_t)(esp_random() % (uint32_t)(2 * spread + 1));
+}
 
-        // Perform request 
-        esp_err_t err;
-        err = esp_http_client_perform(client);
-        
-        if (err == ESP_OK) 
-        {
-            ESP_LOGI("HTTP API", "HTTP GET Status = %d", esp_http_client_get_status_code(client));
-        } 
-        else 
-        {
-            ESP_LOGE("HTTP API", "HTTP GET request failed: %s", esp_err_to_name(err));
-        }
-        
-        esp_http_client_cleanup(client);
+static esp_err_t fetchEndpoint(esp_http_client_handle_t client, mempoolEndpoint_t *endpoint)
+{
+    char url[96];
+    snprintf(url, sizeof(url), MEMPOOL_HOST_URL "%s", endpoint->path);
+    esp_http_client_set_url(client, url);
+
+    // The parser writes into a copy, a failed or half read response never reaches the display
+    xSemaphoreTake(stateLock, portMAX_DELAY);
+    pendingState = MEMPOOL_STATE;
+    xSemaphoreGive(stateLock);
+    parserReset(&parser, endpoint->apply, &pendingState);
+
+    esp_err_t err = esp_http_client_perform(client);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "GET %s failed: %s", endpoint->path, esp_err_to_name(err));
+        // Drop the session, the next request opens a new one
+        esp_http_client_close(client);
         return err;
     }
-    
-    return ESP_OK;
-}
 
-// Update the mempool_api_block_tip_height function
-esp_err_t mempool_api_block_tip_height(void) {
-    static int64_t lastUpdate = 0;  
-    int64_t currentTime = esp_timer_get_time();
-    
-    // Check if it's time to send the request. Limit the number of requests here
-    if (((currentTime - lastUpdate)/1000000) > 300 || lastUpdate == 0)
-    {
-        lastUpdate = currentTime;
-        // Set up the HTTP client configuration using esp cert bndles
-        //Using Coingecko API key for testing
-        // TODO: move this to own server for production to limit the number of requests
-        esp_http_client_config_t config = {
-            .url = "https://mempool.space/api/blocks/tip/height",
-            .event_handler = blockHeightEventHandler,  // Use specific handler
-            .transport_type = HTTP_TRANSPORT_OVER_SSL,
-            .crt_bundle_attach = esp_crt_bundle_attach,
-        };
-
-        // Initialize client
-        esp_http_client_handle_t client = esp_http_client_init(&config);
-        if (client == NULL) 
-        {
-            ESP_LOGE("HTTP API", "Failed to initialize HTTP client");
-            return ESP_FAIL;
-        }
+    int status = esp_http_client_get_status_code(client);
+    if (status != 200) {
+        ESP_LOGE(TAG, "GET %s returned HTTP %d", endpoint->path, status);
+        return ESP_FAIL;
+    }
 
-        /* // Set headers with error checking Not needed for this API
-        esp_err_t err;
-        if ((err = esp_http_client_set_header(client, "accept", "application/json")) != ESP_OK) 
-        {
-            ESP_LOGE("HTTP API", "Failed to set accept header: %s", esp_err_to_name(err));
-            esp_http_client_cleanup(client);
-            return err;
-        }
+    // A bare number has nothing after it to end it
+    parserFlushValue(&parser);
 
-        if ((err = esp_http_client_set_header(client, "x-cg-demo-api-key", "CG-iUyVPGbu2nECCwVo8yXXUf57")) != ESP_OK) 
-        {
-            ESP_LOGE("HTTP API", "Failed to set API key header: %s", esp_err_to_name(err));
-            esp_http_client_cleanup(client);
-            return err;
-        }*/
+    xSemaphoreTake(stateLock, portMAX_DELAY);
+    MEMPOOL_STATE = pendingState;
+    xSemaphoreGive(stateLock);
 
-        // Perform request 
-        esp_err_t err;
-        err = esp_http_client_perform(client);
-        
-        if (err == ESP_OK) 
-        {
-            ESP_LOGI("HTTP API", "HTTP GET Status = %d", esp_http_client_get_status_code(client));
-        } 
-        else 
-        {
-            ESP_LOGE("HTTP API", "HTTP GET request failed: %s", esp_err_to_name(err));
-        }
-        
-        esp_http_client_cleanup(client);
-        return err;
-    }
-    
+    ESP_LOGD(TAG, "GET %s ok", endpoint->path);
     return ESP_OK;
 }
 
-esp_err_t mempool_api_network_hashrate(void)
+void mempool_api_task(void *pvParameters)
 {
-    static int64_t lastUpdate = 0;  
-    int64_t currentTime = esp_timer_get_time();
-    
-    // Check if it's time to send the request. Limit the number of requests here
-    if (((currentTime - lastUpdate)/1000000) > 300 || lastUpdate == 0)
-    {
-        lastUpdate = currentTime;
-        // Set up the HTTP client configuration using esp cert bndles
-        //Using Coingecko API key for testing
-        // TODO: move this to own server for production to limit the number of requests
-        esp_http_client_config_t config = {
-            .url = "https://mempool.space/api/v1/mining/hashrate/3d",
-            .event_handler = networkHashrateEventHandler,  // Use specific handler
-            .transport_type = HTTP_TRANSPORT_OVER_SSL,
-            .crt_bundle_attach = esp_crt_bundle_attach,
-        };
-
-        // Initialize client
-        esp_http_client_handle_t client = esp_http_client_init(&config);
-        if (client == NULL) 
-        {
-            ESP_LOGE("HTTP API", "Failed to initialize HTTP client");
-            return ESP_FAIL;
-        }
-
-        /* // Set headers with error checking Not needed for this API
-        esp_err_t err;
-        if ((err = esp_http_client_set_header(client, "accept", "application/json")) != ESP_OK) 
-        {
-            ESP_LOGE("HTTP API", "Failed to set accept header: %s", esp_err_to_name(err));
-            esp_http_client_cleanup(client);
-            return err;
-        }
-
-        if ((err = esp_http_client_set_header(client, "x-cg-demo-api-key", "CG-iUyVPGbu2nECCwVo8yXXUf57")) != ESP_OK) 
-        {
-            ESP_LOGE("HTTP API", "Failed to set API key header: %s", esp_err_to_name(err));
-            esp_http_client_cleanup(client);
-            return err;
-        }*/
-
-        // Perform request 
-        esp_err_t err;
-        err = esp_http_client_perform(client);
-        
-        if (err == ESP_OK) 
-        {
-            ESP_LOGI("HTTP API", "HTTP GET Status = %d", esp_http_client_get_status_code(client));
-        } 
-        else 
-        {
-            ESP_LOGE("HTTP API", "HTTP GET request failed: %s", esp_err_to_name(err));
-        }
-        
-        esp_http_client_cleanup(client);
-        return err;
+    stateLock = xSemaphoreCreateMutex();
+    if (stateLock == NULL) {
+        ESP_LOGE(TAG, "Failed to create state lock");
+        vTaskDelete(NULL);
+        return;
     }
-    
-    return ESP_OK;
-}
-
-esp_err_t mempool_api_network_difficulty_adjustement(void) {
-        static int64_t lastUpdate = 0;  
-    int64_t currentTime = esp_timer_get_time();
-    
-    // Check if it's time to send the request. Limit the number of requests here
-    if (((currentTime - lastUpdate)/1000000) > 300 || lastUpdate == 0)
-    {
-        lastUpdate = currentTime;
-        // Set up the HTTP client configuration using esp cert bndles
-        //Using Coingecko API key for testing
-        // TODO: move this to own server for production to limit the number of requests
-        esp_http_client_config_t config = {
-            .url = "https://mempool.space/api/v1/difficulty-adjustment",
-            .event_handler = networkDifficultyAdjustementEventHandler,  // Use specific handler
-            .transport_type = HTTP_TRANSPORT_OVER_SSL,
-            .crt_bundle_attach = esp_crt_bundle_attach,
-        };
 
-        // Initialize client
-        esp_http_client_handle_t client = esp_http_client_init(&config);
-        if (client == NULL) 
-        {
-            ESP_LOGE("HTTP API", "Failed to initialize HTTP client");
-            return ESP_FAIL;
-        }
-
-        /* // Set headers with error checking Not needed for this API
-        esp_err_t err;
-        if ((err = esp_http_client_set_header(client, "accept", "application/json")) != ESP_OK) 
-        {
-            ESP_LOGE("HTTP API", "Failed to set accept header: %s", esp_err_to_name(err));
-            esp_http_client_cleanup(client);
-            return err;
-        }
-
-        if ((err = esp_http_client_set_header(client, "x-cg-demo-api-key", "CG-iUyVPGbu2nECCwVo8yXXUf57")) != ESP_OK) 
-        {
-            ESP_LOGE("HTTP API", "Failed to set API key header: %s", esp_err_to_name(err));
-            esp_http_client_cleanup(client);
-            return err;
-        }*/
-
-        // Perform request 
-        esp_err_t err;
-        err = esp_http_client_perform(client);
-        
-        if (err == ESP_OK) 
-        {
-            ESP_LOGI("HTTP API", "HTTP GET Status = %d", esp_http_client_get_status_code(client));
-        } 
-        else 
-        {
-            ESP_LOGE("HTTP API", "HTTP GET request failed: %s", esp_err_to_name(err));
-        }
-        
-        esp_http_client_cleanup(client);
-        return err;
+    esp_http_client_config_t config = {
+        .url = MEMPOOL_HOST_URL,
+        .event_handler = mempoolEventHandler,
+        .transport_type = HTTP_TRANSPORT_OVER_SSL,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+        .keep_alive_enable = true,
+        .timeout_ms = 10000,
+    };
+
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (client == NULL) {
+        ESP_LOGE(TAG, "Failed to initialize HTTP client");
+        vTaskDelete(NULL);
+        return;
     }
-    
-    return ESP_OK;
-    return ESP_OK;
-}
 
-esp_err_t mempool_api_network_recommended_fee(void) {
-        static int64_t lastUpdate = 0;  
-    int64_t currentTime = esp_timer_get_time();
-    
-    // Check if it's time to send the request. Limit the number of requests here
-    if (((currentTime - lastUpdate)/1000000) > 300 || lastUpdate == 0)
-    {
-        lastUpdate = currentTime;
-        // Set up the HTTP client configuration using esp cert bndles
-        //Using Coingecko API key for testing
-        // TODO: move this to own server for production to limit the number of requests
-        esp_http_client_config_t config = {
-            .url = "https://mempool.space/api/v1/fees/recommended",
-            .event_handler = networkRecommendedFeeEventHandler,  // Use specific handler
-            .transport_type = HTTP_TRANSPORT_OVER_SSL,
-            .crt_bundle_attach = esp_crt_bundle_attach,
-        };
+    // Spread the first round over a few seconds instead of five requests back to back
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < ENDPOINT_COUNT; i++) {
+        endpoints[i].nextDue = now + jitteredDelayUs(i * 2 + 1);
+    }
 
-        // Initialize client
-        esp_http_client_handle_t client = esp_http_client_init(&config);
-        if (client == NULL) 
-        {
-            ESP_LOGE("HTTP API", "Failed to initialize HTTP client");
-            return ESP_FAIL;
+    while (1) {
+        mempoolEndpoint_t *next = &endpoints[0];
+        for (int i = 1; i < ENDPOINT_COUNT; i++) {
+            if (endpoints[i].nextDue < next->nextDue) {
+                next = &endpoints[i];
+            }
         }
 
-        /* // Set headers with error checking Not needed for this API
-        esp_err_t err;
-        if ((err = esp_http_client_set_header(client, "accept", "application/json")) != ESP_OK) 
-        {
-            ESP_LOGE("HTTP API", "Failed to set accept header: %s", esp_err_to_name(err));
-            esp_http_client_cleanup(client);
-            return err;
+        now = esp_timer_get_time();
+        if (next->nextDue > now) {
+            vTaskDelay(pdMS_TO_TICKS((next->nextDue - now) / 1000) + 1);
+            continue;
         }
 
-        if ((err = esp_http_client_set_header(client, "x-cg-demo-api-key", "CG-iUyVPGbu2nECCwVo8yXXUf57")) != ESP_OK) 
-        {
-            ESP_LOGE("HTTP API", "Failed to set API key header: %s", esp_err_to_name(err));
-            esp_http_client_cleanup(client);
-            return err;
-        }*/
-
-        // Perform request 
-        esp_err_t err;
-        err = esp_http_client_perform(client);
-        
-        if (err == ESP_OK) 
-        {
-            ESP_LOGI("HTTP API", "HTTP GET Status = %d", esp_http_client_get_status_code(client));
-        } 
-        else 
-        {
-            ESP_LOGE("HTTP API", "HTTP GET request failed: %s", esp_err_to_name(err));
+        if (fetchEndpoint(client, next) == ESP_OK) {
+            next->failures = 0;
+            next->nextDue = esp_timer_get_time() + jitteredDelayUs(next->periodS);
+        } else {
+            uint32_t retryS = RETRY_BASE_S << (next->failures < 6 ? next->failures : 6);
+            if (retryS > RETRY_MAX_S) {
+                retryS = RETRY_MAX_S;
+            }
+            if (next->failures < UINT8_MAX) {
+                next->failures++;
+            }
+            next->nextDue = esp_timer_get_time() + jitteredDelayUs(retryS);
         }
-        
-        esp_http_client_cleanup(client);
-        return err;
     }
-    
-    return ESP_OK;
-    return ESP_OK;
 }
-#endif
\ No newline at end of file
+
+#endif
@@ -27,8 +27,6 @@ typedef struct {
     bool networkHashrateValid;
     double networkDifficulty;
     bool networkDifficultyValid;
-    uint32_t blockHeight;
-    bool blockHeightValid;
     double difficultyProgressPercent;
     bool difficultyProgressPercentValid;
     double difficultyChangePercent;
@@ -49,16 +47,13 @@ typedef struct {
     bool minimumFeeValid;
 } MempoolApiState;
 
-extern MempoolApiState MEMPOOL_STATE;  // Declare the global variable
+// Polls every mempool.space endpoint on its own schedule over one keep-alive TLS session.
+// Start it once the network is up, nothing else talks to mempool.space.
+void mempool_api_task(void *pvParameters);
 
-esp_err_t mempool_api_price(void);
-esp_err_t mempool_api_network_hashrate(void);
-esp_err_t mempool_api_network_difficulty_adjustement(void);
-esp_err_t mempool_api_block_tip_height(void);
-esp_err_t mempool_api_network_recommended_fee(void);
-
-MempoolApiState* getMempoolState(void);  // Add getter function
+// Copy the latest state, each endpoint's fields are published together
+void getMempoolState(MempoolApiState *snapshot);
 
 #endif
 
-#endif
\ No newline at end of file
+#endif
@@ -1,13 +1,357 @@
 #include "nvs_config.h"
 #include "esp_log.h"
+#include "esp_system.h"
 #include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 
 #define NVS_CONFIG_NAMESPACE "main"
+#define MAX_CONFIG_ENTRIES 64
+#define MAX_CONFIG_SUBSCRIBERS 8
 
 static const char * TAG = "nvs_config";
 
-char * nvs_config_get_string(const char * key, const char * default_value)
+// Every setting of the namespace is kept in RAM after nvs_config_init, reads never
+// touch flash and writes go to NVS first and then to the cache
+typedef struct {
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    nvs_type_t type;
+    bool dirty;     // Changed by a deferred write and not yet on flash
+    bool pending;   // Set in NVS by a running flush, stays dirty until the commit succeeds
+    union {
+        uint16_t u16;
+        uint64_t u64;
+        char * str;
+    } value;
+} config_entry_t;
+
+typedef struct {
+    nvs_config_change_fn fn;
+    void * ctx;
+} config_subscriber_t;
+
+static config_entry_t entries[MAX_CONFIG_ENTRIES];
+static int entry_count = 0;
+static bool cache_loaded = false;
+static bool cache_complete = true;  // Cleared if a key did not fit, misses then go to flash
+static SemaphoreHandle_t cache_lock = NULL;
+// Held for every NVS write so a flush can never put an older value over a newer one
+static SemaphoreHandle_t write_lock = NULL;
+static TaskHandle_t flush_task = NULL;
+
+static config_subscriber_t subscribers[MAX_CONFIG_SUBSCRIBERS];
+static int subscriber_count = 0;
+
+// Bumped on every write so readers can cache what they derive from the settings
+static volatile uint32_t config_generation = 1;
+
+static config_entry_t * find_entry(const char * key)
+{
+    for (int i = 0; i < entry_count; i++) {
+        if (strcmp(entries[i].key, key) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+// Entry for key with the given type, created or converted as needed, NULL when the cache is full
+static config_entry_t * store_entry(const char * key, nvs_type_t type)
+{
+    config_entry_t * entry = find_entry(key);
+    if (!entry) {
+        if (entry_count == MAX_CONFIG_ENTRIES) {
+            ESP_LOGE(TAG, "Config cache full, %s is not cached", key);
+            cache_complete = false;
+            return NULL;
+        }
+        entry = &entries[entry_count++];
+        strncpy(entry->key, key, sizeof(entry->key) - 1);
+        entry->key[sizeof(entry->key) - 1] = '\0';
+        entry->type = type;
+        entry->dirty = false;
+        entry->pending = false;
+        memset(&entry->value, 0, sizeof(entry->value));
+    } else if (entry->type != type) {
+        // NVS replaces a key written with another type, so does the cache
+        if (entry->type == NVS_TYPE_STR) {
+            free(entry->value.str);
+        }
+        entry->type = type;
+        entry->dirty = false;
+        entry->pending = false;
+        memset(&entry->value, 0, sizeof(entry->value));
+    }
+    return entry;
+}
+
+static void notify_change(const char * key)
+{
+    config_subscriber_t current[MAX_CONFIG_SUBSCRIBERS];
+    int count;
+
+    config_generation++;
+    if (!cache_lock) {
+        return;
+    }
+
+    xSemaphoreTake(cache_lock, portMAX_DELAY);
+    count = subscriber_count;
+    memcpy(current, subscribers, sizeof(subscribers[0]) * count);
+    xSemaphoreGive(cache_lock);
+
+    for (int i = 0; i < count; i++) {
+        current[i].fn(key, current[i].ctx);
+    }
+}
+
+static void load_entry(nvs_handle handle, const nvs_entry_info_t * info)
+{
+    esp_err_t err = ESP_ERR_NOT_SUPPORTED;
+    config_entry_t * entry;
+
+    switch (info->type) {
+        case NVS_TYPE_U16: {
+            uint16_t value;
+            err = nvs_get_u16(handle, info->key, &value);
+            if (err == ESP_OK && (entry = store_entry(info->key, NVS_TYPE_U16))) {
+                entry->value.u16 = value;
+            }
+            break;
+        }
+        case NVS_TYPE_U64: {
+            uint64_t value;
+            err = nvs_get_u64(handle, info->key, &value);
+            if (err == ESP_OK && (entry = store_entry(info->key, NVS_TYPE_U64))) {
+                entry->value.u64 = value;
+            }
+            break;
+        }
+        case NVS_TYPE_STR: {
+            size_t size = 0;
+            err = nvs_get_str(handle, info->key, NULL, &size);
+            if (err != ESP_OK) {
+                break;
+            }
+            char * value = malloc(size);
+            if (!value) {
+                err = ESP_ERR_NO_MEM;
+                break;
+            }
+            err = nvs_get_str(handle, info->key, value, &size);
+            if (err == ESP_OK && (entry = store_entry(info->key, NVS_TYPE_STR))) {
+                entry->value.str = value;
+            } else {
+                free(value);
+            }
+            break;
+        }
+        default:
+            // Nothing in this namespace is written as any other type
+            break;
+    }
+
+    if (err != ESP_OK && err != ESP_ERR_NOT_SUPPORTED) {
+        ESP_LOGW(TAG, "Could not cache nvs key: %s (%s)", info->key, esp_err_to_name(err));
+    }
+}
+
+static void lock_writes(void)
+{
+    if (write_lock) {
+        xSemaphoreTake(write_lock, portMAX_DELAY);
+    }
+}
+
+static void unlock_writes(void)
+{
+    if (write_lock) {
+        xSemaphoreGive(write_lock);
+    }
+}
+
+static void load_cache(void)
+{
+    nvs_handle handle;
+    esp_err_t err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READONLY, &handle);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        // Nothing was ever saved, every setting is at its default
+        return;
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Could not open nvs, settings are read from flash");
+        cache_complete = false;
+        return;
+    }
+
+    nvs_iterator_t it = NULL;
+    err = nvs_entry_find(NVS_DEFAULT_PART_NAME, NVS_CONFIG_NAMESPACE, NVS_TYPE_ANY, &it);
+    while (err == ESP_OK) {
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+        load_entry(handle, &info);
+        err = nvs_entry_next(&it);
+    }
+    nvs_release_iterator(it);
+    nvs_close(handle);
+}
+
+// Deferred writes are held for CONFIG_NVS_FLUSH_INTERVAL seconds after the first
+// one, so a run of autotune steps or new best difficulties costs one flash write
+static void flush_task_fn(void * pvParameters)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_NVS_FLUSH_INTERVAL * 1000));
+        nvs_config_flush();
+    }
+}
+
+// Runs from esp_restart, whatever triggered it
+static void flush_on_shutdown(void)
+{
+    nvs_config_flush();
+}
+
+esp_err_t nvs_config_init(void)
+{
+    if (cache_loaded) {
+        return ESP_OK;
+    }
+
+    cache_lock = xSemaphoreCreateMutex();
+    write_lock = xSemaphoreCreateMutex();
+    if (!cache_lock || !write_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    load_cache();
+    cache_loaded = true;
+    ESP_LOGI(TAG, "Cached %d settings", entry_count);
+
+    // Without the task deferred writes go straight to flash
+    if (xTaskCreate(flush_task_fn, "nvs flush", 3072, NULL, 1, &flush_task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start nvs flush task, writing settings immediately");
+        flush_task = NULL;
+    }
+    esp_register_shutdown_handler(flush_on_shutdown);
+
+    return ESP_OK;
+}
+
+esp_err_t nvs_config_flush(void)
+{
+    if (!cache_loaded) {
+        return ESP_OK;
+    }
+
+    lock_writes();
+
+    nvs_handle handle;
+    esp_err_t err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        unlock_writes();
+        ESP_LOGW(TAG, "Could not open nvs");
+        return err;
+    }
+
+    int written = 0;
+    int next = 0;
+    while (1) {
+        // Take one dirty value at a time so readers never wait on flash, entries
+        // are only ever appended so the index stays valid without the lock
+        char key[NVS_KEY_NAME_MAX_SIZE];
+        nvs_type_t type = NVS_TYPE_ANY;
+        uint64_t value = 0;
+        int i;
+
+        xSemaphoreTake(cache_lock, portMAX_DELAY);
+        for (i = next; i < entry_count; i++) {
+            if (entries[i].dirty) {
+                strcpy(key, entries[i].key);
+                type = entries[i].type;
+                value = type == NVS_TYPE_U16 ? entries[i].value.u16 : entries[i].value.u64;
+                break;
+            }
+        }
+        xSemaphoreGive(cache_lock);
+        next = i + 1;
+
+        if (type == NVS_TYPE_ANY) {
+            break;
+        }
+
+        esp_err_t set_err = type == NVS_TYPE_U16 ? nvs_set_u16(handle, key, (uint16_t) value)
+                                                 : nvs_set_u64(handle, key, value);
+        if (set_err != ESP_OK) {
+            // Still dirty, the next flush tries again
+            ESP_LOGW(TAG, "Could not write nvs key: %s, value: %llu", key, value);
+            err = set_err;
+            continue;
+        }
+        written++;
+
+        // A deferred write since the copy above leaves the entry dirty for the next flush
+        xSemaphoreTake(cache_lock, portMAX_DELAY);
+        uint64_t current = type == NVS_TYPE_U16 ? entries[i].value.u16 : entries[i].value.u64;
+        if (entries[i].dirty && entries[i].type == type && current == value) {
+            entries[i].pending = true;
+        }
+        xSemaphoreGive(cache_lock);
+    }
+
+    if (written) {
+        esp_err_t commit_err = nvs_commit(handle);
+        if (commit_err != ESP_OK) {
+            ESP_LOGW(TAG, "Could not commit deferred settings");
+            err = commit_err;
+        } else {
+            ESP_LOGI(TAG, "Wrote %d deferred settings", written);
+        }
+
+        xSemaphoreTake(cache_lock, portMAX_DELAY);
+        for (int i = 0; i < entry_count; i++) {
+            if (entries[i].pending) {
+                entries[i].dirty = commit_err != ESP_OK;
+                entries[i].pending = false;
+            }
+        }
+        xSemaphoreGive(cache_lock);
+    }
+    nvs_close(handle);
+    unlock_writes();
+    return err;
+}
+
+esp_err_t nvs_config_subscribe(nvs_config_change_fn fn, void * ctx)
+{
+    if (!cache_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(cache_lock, portMAX_DELAY);
+    if (subscriber_count < MAX_CONFIG_SUBSCRIBERS) {
+        subscribers[subscriber_count].fn = fn;
+        subscribers[subscriber_count].ctx = ctx;
+        subscriber_count++;
+    } else {
+        err = ESP_ERR_NO_MEM;
+    }
+    xSemaphoreGive(cache_lock);
+    return err;
+}
+
+uint32_t nvs_config_get_generation(void)
+{
+    return config_generation;
+}
+
+static char * read_string(const char * key, const char * default_value)
 {
     nvs_handle handle;
     esp_err_t err;
@@ -37,13 +381,53 @@ char * nvs_config_get_string(const char * key, const char * default_value)
     return out;
 }
 
+char * nvs_config_get_string(const char * key, const char * default_value)
+{
+    if (!cache_loaded) {
+        return read_string(key, default_value);
+    }
+
+    xSemaphoreTake(cache_lock, portMAX_DELAY);
+    config_entry_t * entry = find_entry(key);
+    if (!entry && !cache_complete) {
+        xSemaphoreGive(cache_lock);
+        return read_string(key, default_value);
+    }
+    char * out = strdup(entry && entry->type == NVS_TYPE_STR ? entry->value.str : default_value);
+    xSemaphoreGive(cache_lock);
+    return out;
+}
+
+size_t nvs_config_copy_string(const char * key, const char * default_value, char * buf, size_t size)
+{
+    if (cache_loaded) {
+        xSemaphoreTake(cache_lock, portMAX_DELAY);
+        config_entry_t * entry = find_entry(key);
+        if (entry || cache_complete) {
+            strncpy(buf, entry && entry->type == NVS_TYPE_STR ? entry->value.str : default_value, size - 1);
+            xSemaphoreGive(cache_lock);
+            buf[size - 1] = '\0';
+            return strlen(buf);
+        }
+        xSemaphoreGive(cache_lock);
+    }
+
+    char * value = read_string(key, default_value);
+    strncpy(buf, value, size - 1);
+    buf[size - 1] = '\0';
+    free(value);
+    return strlen(buf);
+}
+
 void nvs_config_set_string(const char * key, const char * value)
 {
 
     nvs_handle handle;
     esp_err_t err;
+    lock_writes();
     err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READWRITE, &handle);
     if (err != ESP_OK) {
+        unlock_writes();
         ESP_LOGW(TAG, "Could not open nvs");
         return;
     }
@@ -54,10 +438,38 @@ void nvs_config_set_string(const char * key, const char * value)
     }
 
     nvs_close(handle);
+
+    if (err == ESP_OK && cache_loaded) {
+        char * copy = strdup(value);
+        xSemaphoreTake(cache_lock, portMAX_DELAY);
+        config_entry_t * entry = store_entry(key, NVS_TYPE_STR);
+        if (entry && copy) {
+            free(entry->value.str);
+            entry->value.str = copy;
+        } else {
+            free(copy);
+        }
+        xSemaphoreGive(cache_lock);
+    }
+    unlock_writes();
+    notify_change(key);
 }
 
 uint16_t nvs_config_get_u16(const char * key, const uint16_t default_value)
 {
+    if (cache_loaded) {
+        uint16_t out = default_value;
+        xSemaphoreTake(cache_lock, portMAX_DELAY);
+        config_entry_t * entry = find_entry(key);
+        if (entry && entry->type == NVS_TYPE_U16) {
+            out = entry->value.u16;
+        }
+        xSemaphoreGive(cache_lock);
+        if (entry || cache_complete) {
+            return out;
+        }
+    }
+
     nvs_handle handle;
     esp_err_t err;
     err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READONLY, &handle);
@@ -80,8 +492,10 @@ void nvs_config_set_u16(const char * key, const uint16_t value)
 
     nvs_handle handle;
     esp_err_t err;
+    lock_writes();
     err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READWRITE, &handle);
     if (err != ESP_OK) {
+        unlock_writes();
         ESP_LOGW(TAG, "Could not open nvs");
         return;
     }
@@ -92,10 +506,35 @@ void nvs_config_set_u16(const char * key, const uint16_t value)
     }
 
     nvs_close(handle);
+
+    if (err == ESP_OK && cache_loaded) {
+        xSemaphoreTake(cache_lock, portMAX_DELAY);
+        config_entry_t * entry = store_entry(key, NVS_TYPE_U16);
+        if (entry) {
+            entry->value.u16 = value;
+            entry->dirty = false;
+        }
+        xSemaphoreGive(cache_lock);
+    }
+    unlock_writes();
+    notify_change(key);
 }
 
 uint64_t nvs_config_get_u64(const char * key, const uint64_t default_value)
 {
+    if (cache_loaded) {
+        uint64_t out = default_value;
+        xSemaphoreTake(cache_lock, portMAX_DELAY);
+        config_entry_t * entry = find_entry(key);
+        if (entry && entry->type == NVS_TYPE_U64) {
+            out = entry->value.u64;
+        }
+        xSemaphoreGive(cache_lock);
+        if (entry || cache_complete) {
+            return out;
+        }
+    }
+
     nvs_handle handle;
     esp_err_t err;
     err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READONLY, &handle);
@@ -120,8 +559,10 @@ void nvs_config_set_u64(const char * key, const uint64_t value)
 
     nvs_handle handle;
     esp_err_t err;
+    lock_writes();
     err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READWRITE, &handle);
     if (err != ESP_OK) {
+        unlock_writes();
         ESP_LOGW(TAG, "Could not open nvs");
         return;
     }
@@ -131,4 +572,213 @@ void nvs_config_set_u64(const char * key, const uint64_t value)
         ESP_LOGW(TAG, "Could not write nvs key: %s, value: %llu", key, value);
     }
     nvs_close(handle);
+
+    if (err == ESP_OK && cache_loaded) {
+        xSemaphoreTake(cache_lock, portMAX_DELAY);
+        config_entry_t * entry = store_entry(key, NVS_TYPE_U64);
+        if (entry) {
+            entry->value.u64 = value;
+            entry->dirty = false;
+        }
+        xSemaphoreGive(cache_lock);
+    }
+    unlock_writes();
+    notify_change(key);
+}
+
+static void set_deferred(const char * key, nvs_type_t type, uint64_t value)
+{
+    xSemaphoreTake(cache_lock, portMAX_DELAY);
+    config_entry_t * entry = find_entry(key);
+    if (entry && entry->type == type &&
+        (type == NVS_TYPE_U16 ? entry->value.u16 : entry->value.u64) == value) {
+        // Already the cached value, on flash or about to be
+        xSemaphoreGive(cache_lock);
+        return;
+    }
+
+    entry = store_entry(key, type);
+    if (!entry) {
+        xSemaphoreGive(cache_lock);
+        if (type == NVS_TYPE_U16) {
+            nvs_config_set_u16(key, (uint16_t) value);
+        } else {
+            nvs_config_set_u64(key, value);
+        }
+        return;
+    }
+
+    if (type == NVS_TYPE_U16) {
+        entry->value.u16 = (uint16_t) value;
+    } else {
+        entry->value.u64 = value;
+    }
+    entry->dirty = true;
+    entry->pending = false;
+    xSemaphoreGive(cache_lock);
+
+    notify_change(key);
+    xTaskNotifyGive(flush_task);
+}
+
+void nvs_config_set_u16_deferred(const char * key, const uint16_t value)
+{
+    if (!flush_task) {
+        nvs_config_set_u16(key, value);
+        return;
+    }
+    set_deferred(key, NVS_TYPE_U16, value);
+}
+
+void nvs_config_set_u64_deferred(const char * key, const uint64_t value)
+{
+    if (!flush_task) {
+        nvs_config_set_u64(key, value);
+        return;
+    }
+    set_deferred(key, NVS_TYPE_U64, value);
+}
+
+// Value a key had before a batch, put back if the batch fails
+typedef struct {
+    bool existed;
+    uint64_t u64;
+    char * str;
+} saved_value_t;
+
+static esp_err_t write_value(nvs_handle handle, const char * key, nvs_type_t type, uint64_t u64, const char * str)
+{
+    switch (type) {
+        case NVS_TYPE_U16:
+            return nvs_set_u16(handle, key, (uint16_t) u64);
+        case NVS_TYPE_U64:
+            return nvs_set_u64(handle, key, u64);
+        case NVS_TYPE_STR:
+            return nvs_set_str(handle, key, str);
+        default:
+            return ESP_ERR_INVALID_ARG;
+    }
+}
+
+static void save_value(nvs_handle handle, const nvs_config_value_t * value, saved_value_t * saved)
+{
+    switch (value->type) {
+        case NVS_TYPE_U16: {
+            uint16_t u16;
+            saved->existed = nvs_get_u16(handle, value->key, &u16) == ESP_OK;
+            saved->u64 = u16;
+            break;
+        }
+        case NVS_TYPE_U64:
+            saved->existed = nvs_get_u64(handle, value->key, &saved->u64) == ESP_OK;
+            break;
+        case NVS_TYPE_STR: {
+            size_t size = 0;
+            if (nvs_get_str(handle, value->key, NULL, &size) != ESP_OK || !(saved->str = malloc(size))) {
+                break;
+            }
+            saved->existed = nvs_get_str(handle, value->key, saved->str, &size) == ESP_OK;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+esp_err_t nvs_config_set_batch(const nvs_config_value_t * values, size_t count)
+{
+    if (count == 0) {
+        return ESP_OK;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (values[i].type != NVS_TYPE_U16 && values[i].type != NVS_TYPE_U64 &&
+            (values[i].type != NVS_TYPE_STR || values[i].str == NULL)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    saved_value_t * saved = calloc(count, sizeof(saved_value_t));
+    if (!saved) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    lock_writes();
+
+    nvs_handle handle;
+    esp_err_t err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        unlock_writes();
+        free(saved);
+        ESP_LOGW(TAG, "Could not open nvs");
+        return err;
+    }
+
+    size_t written = 0;
+    for (; written < count; written++) {
+        const nvs_config_value_t * value = &values[written];
+        save_value(handle, value, &saved[written]);
+        err = write_value(handle, value->key, value->type, value->u64, value->str);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Could not write nvs key: %s (%s)", value->key, esp_err_to_name(err));
+            break;
+        }
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+
+    if (err != ESP_OK) {
+        // The failed key may be half written too, it is restored with the others
+        size_t failed = written < count ? written + 1 : count;
+        for (size_t i = 0; i < failed; i++) {
+            const nvs_config_value_t * value = &values[i];
+            esp_err_t restore_err = saved[i].existed
+                ? write_value(handle, value->key, value->type, saved[i].u64, saved[i].str)
+                : nvs_erase_key(handle, value->key);
+            if (restore_err != ESP_OK && restore_err != ESP_ERR_NVS_NOT_FOUND) {
+                ESP_LOGE(TAG, "Could not restore nvs key: %s", value->key);
+            }
+        }
+        nvs_commit(handle);
+    }
+    nvs_close(handle);
+
+    if (err == ESP_OK && cache_loaded) {
+        for (size_t i = 0; i < count; i++) {
+            const nvs_config_value_t * value = &values[i];
+            char * copy = value->type == NVS_TYPE_STR ? strdup(value->str) : NULL;
+            xSemaphoreTake(cache_lock, portMAX_DELAY);
+            config_entry_t * entry = store_entry(value->key, value->type);
+            if (entry && value->type == NVS_TYPE_STR && copy) {
+                free(entry->value.str);
+                entry->value.str = copy;
+                copy = NULL;
+            } else if (entry && value->type == NVS_TYPE_U16) {
+                entry->value.u16 = (uint16_t) value->u64;
+            } else if (entry && value->type == NVS_TYPE_U64) {
+                entry->value.u64 = value->u64;
+            }
+            if (entry) {
+                entry->dirty = false;
+            }
+            xSemaphoreGive(cache_lock);
+            free(copy);
+        }
+    }
+    unlock_writes();
+
+    for (size_t i = 0; i < count; i++) {
+        free(saved[i].str);
+    }
+    free(saved);
+
+    if (err != ESP_OK) {
+        return err;
+    }
+    ESP_LOGI(TAG, "Wrote %u settings", (unsigned) count);
+    for (size_t i = 0; i < count; i++) {
+        notify_change(values[i].key);
+    }
+    return ESP_OK;
 }
@@ -1,7 +1,10 @@
 #ifndef MAIN_NVS_CONFIG_H
 #define MAIN_NVS_CONFIG_H
 
+#include <stddef.h>
 #include <stdint.h>
+#include "esp_err.h"
+#include "nvs.h"
 
 // Max length 15
 
@@ -38,6 +41,14 @@
 #define NVS_CONFIG_AUTOTUNE_FLAG "autotune"
 #define NVS_CONFIG_AUTOTUNE_PRESET "preset"
 
+// Power budget in watts, 0 = no cap
+#define NVS_CONFIG_POWER_CAP "powercap"
+
+// Serve and pull firmware updates to and from peers on the LAN, read at boot
+#define NVS_CONFIG_FLEET_OTA "fleetota"
+// Announce status to the fleet multicast group and answer fleet queries, off unless set, read at boot
+#define NVS_CONFIG_FLEET_STATUS "fleetstatus"
+
 // Warranty Checks
 #define NVS_CONFIG_SERIAL_NUMBER "serialnumber"
 #define NVS_CONFIG_BUILD_DATE "builddate"
@@ -53,11 +64,47 @@
 
 
 
+/**
+ * @brief Called after a setting was written, from the writing task. Keep it short,
+ * e.g. set a flag or notify a task, and read the new value from there.
+ */
+typedef void (*nvs_config_change_fn)(const char * key, void * ctx);
+
+// Load every setting into RAM, call once after nvs_flash_init. Reads before that go to flash.
+esp_err_t nvs_config_init(void);
+esp_err_t nvs_config_subscribe(nvs_config_change_fn fn, void * ctx);
+
+// Returns a copy the caller frees
 char * nvs_config_get_string(const char * key, const char * default_value);
+// Same without allocating, truncated to size - 1 characters
+size_t nvs_config_copy_string(const char * key, const char * default_value, char * buf, size_t size);
 void nvs_config_set_string(const char * key, const char * default_value);
 uint16_t nvs_config_get_u16(const char * key, const uint16_t default_value);
 void nvs_config_set_u16(const char * key, const uint16_t value);
 uint64_t nvs_config_get_u64(const char * key, const uint64_t default_value);
 void nvs_config_set_u64(const char * key, const uint64_t value);
 
+// One setting of a batch, type is NVS_TYPE_U16, NVS_TYPE_U64 or NVS_TYPE_STR
+typedef struct {
+    const char * key;
+    nvs_type_t type;
+    uint64_t u64;
+    const char * str;
+} nvs_config_value_t;
+
+// Write every value through one handle with one commit. If a write fails the keys
+// already written get their old values back and the error is returned, so either the
+// whole batch is saved or none of it. Subscribers are called per key afterwards.
+esp_err_t nvs_config_set_batch(const nvs_config_value_t * values, size_t count);
+
+// For values that change often. The cache and subscribers see the new value at once,
+// flash is written by a background task CONFIG_NVS_FLUSH_INTERVAL seconds after the
+// first unsaved change, by nvs_config_flush, or when the system restarts.
+void nvs_config_set_u16_deferred(const char * key, const uint16_t value);
+void nvs_config_set_u64_deferred(const char * key, const uint64_t value);
+// Write every deferred value now
+esp_err_t nvs_config_flush(void);
+// Changes whenever any setting is written
+uint32_t nvs_config_get_generation(void);
+
 #endif // MAIN_NVS_CONFIG_H
@@ -19,6 +19,9 @@ esp_err_t NVSDevice_init(void) {
         ESP_ERROR_CHECK(nvs_flash_erase());
         err = nvs_flash_init();
     }
+    if (err == ESP_OK) {
+        err = nvs_config_init();
+    }
     return err;
 }
 
@@ -0,0 +1,118 @@
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "power_cap.h"
+
+// Aim this far under the budget so sensor noise doesn't push readings over it
+#define POWERCAP_HEADROOM 0.03
+// Only raise the cap once power is this far under the target
+#define POWERCAP_RELEASE_MARGIN 0.04
+#define POWERCAP_RAISE_STEP 0.03    // Largest raise per step, fraction of the running frequency
+#define POWERCAP_SETTLE_US (6 * 1000000LL)
+#define POWERCAP_POWER_ALPHA 0.5    // Low-pass factor for measured power
+
+static const char * TAG = "power_cap";
+
+void POWERCAP_init(PowerCapController * ctrl)
+{
+    ctrl->cap = 0;
+    ctrl->filtered_power = -1;
+    ctrl->freq_cap = 0;
+    ctrl->last_change_time = 0;
+}
+
+void POWERCAP_set_cap(PowerCapController * ctrl, uint16_t watts)
+{
+    if (watts == ctrl->cap) {
+        return;
+    }
+
+    if (watts) {
+        ESP_LOGI(TAG, "Power cap set to %uW", watts);
+    } else {
+        ESP_LOGI(TAG, "Power cap disabled");
+        ctrl->freq_cap = 0;
+    }
+    ctrl->cap = watts;
+    // Let a raised budget take effect right away, a lowered one is handled by the overshoot cut anyway
+    ctrl->last_change_time = 0;
+}
+
+// After a frequency change the old readings no longer describe the device
+static void set_freq_cap(PowerCapController * ctrl, uint16_t freq_cap)
+{
+    ctrl->freq_cap = freq_cap;
+    ctrl->filtered_power = -1;
+    ctrl->last_change_time = esp_timer_get_time();
+}
+
+uint16_t POWERCAP_limit_frequency(PowerCapController * ctrl, float power, uint16_t running_freq,
+                                  uint16_t requested_freq, uint16_t min_freq)
+{
+    if (!ctrl->cap || power <= 0 || running_freq == 0) {
+        return ctrl->cap && ctrl->freq_cap && ctrl->freq_cap < requested_freq ? ctrl->freq_cap : requested_freq;
+    }
+
+    if (ctrl->filtered_power < 0) {
+        ctrl->filtered_power = power;
+    } else {
+        ctrl->filtered_power += POWERCAP_POWER_ALPHA * (power - ctrl->filtered_power);
+    }
+
+    float target = ctrl->cap * (1.0 - POWERCAP_HEADROOM);
+    int64_t now = esp_timer_get_time();
+
+    // Use the raw reading for the cut so a step in load is acted on immediately
+    if (power > ctrl->cap) {
+        // Only the dynamic part of the power scales with frequency, so with static power this can
+        // still land over the target. The next reading is then over the cap again and cuts further.
+        uint16_t new_cap = (uint16_t)(running_freq * target / power);
+        if (new_cap < min_freq) {
+            new_cap = min_freq;
+        }
+        if (new_cap < running_freq) {
+            ESP_LOGW(TAG, "Power %.1fW over %uW cap, frequency cap %uMHz -> %uMHz",
+                     power, ctrl->cap, running_freq, new_cap);
+            set_freq_cap(ctrl, new_cap);
+        }
+    } else if (ctrl->freq_cap && ctrl->filtered_power < target * (1.0 - POWERCAP_RELEASE_MARGIN) &&
+               (now - ctrl->last_change_time) >= POWERCAP_SETTLE_US) {
+        float ratio = target / ctrl->filtered_power;
+        if (ratio > 1.0 + POWERCAP_RAISE_STEP) {
+            ratio = 1.0 + POWERCAP_RAISE_STEP;
+        }
+        uint16_t new_cap = (uint16_t)(ctrl->freq_cap * ratio);
+        if (new_cap >= requested_freq) {
+            ESP_LOGI(TAG, "Power cap released at %.1fW", ctrl->filtered_power);
+            set_freq_cap(ctrl, 0);
+        } else if (new_cap > ctrl->freq_cap) {
+            ESP_LOGI(TAG, "Raising frequency cap %uMHz -> %uMHz at %.1fW", ctrl->freq_cap, new_cap, ctrl->filtered_power);
+            set_freq_cap(ctrl, new_cap);
+        }
+    }
+
+    if (ctrl->freq_cap && ctrl->freq_cap < requested_freq) {
+        return ctrl->freq_cap;
+    }
+    return requested_freq;
+}
+
+uint16_t POWERCAP_limit_voltage(const PowerCapController * ctrl, uint16_t requested_voltage,
+                                uint16_t requested_freq, uint16_t min_voltage)
+{
+    if (!POWERCAP_is_limiting(ctrl, requested_freq)) {
+        return requested_voltage;
+    }
+
+    // Presets drop ~9% voltage for ~18% frequency
+    float scale = 0.5 + 0.5 * ((float) ctrl->freq_cap / requested_freq);
+    uint16_t voltage = (uint16_t)(requested_voltage * scale);
+    if (voltage < min_voltage) {
+        voltage = min_voltage < requested_voltage ? min_voltage : requested_voltage;
+    }
+    return voltage;
+}
+
+bool POWERCAP_is_limiting(const PowerCapController * ctrl, uint16_t requested_freq)
+{
+    return ctrl->cap && ctrl->freq_cap && ctrl->freq_cap < requested_freq;
+}
@@ -0,0 +1,50 @@
+#ifndef POWER_CAP_H_
+#define POWER_CAP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct
+{
+    uint16_t cap;             // Power budget in W (0 = disabled)
+    float filtered_power;     // Low-passed measured power in W, < 0 until the next sample
+    uint16_t freq_cap;        // Current power frequency cap in MHz (0 = uncapped)
+    int64_t last_change_time; // esp_timer time of the last cap change
+} PowerCapController;
+
+void POWERCAP_init(PowerCapController * ctrl);
+
+/**
+ * @brief Change the power budget, 0 disables the cap.
+ */
+void POWERCAP_set_cap(PowerCapController * ctrl, uint16_t watts);
+
+/**
+ * @brief Frequency that keeps measured power at or below the budget.
+ *
+ * Over budget the cap is cut in proportion to the overshoot on every reading
+ * that is still over, static power can take more than one cut to get under.
+ * Under budget it is raised in small steps once the previous change has
+ * settled, approaching the budget from below.
+ *
+ * @param power Measured power in W
+ * @param running_freq Frequency the power was measured at in MHz
+ * @return Frequency to run in MHz, never above requested_freq
+ */
+uint16_t POWERCAP_limit_frequency(PowerCapController * ctrl, float power, uint16_t running_freq,
+                                  uint16_t requested_freq, uint16_t min_freq);
+
+/**
+ * @brief Core voltage to go with the capped frequency.
+ *
+ * Scales the requested voltage down with the frequency cap along the same curve
+ * the device presets follow (about half the relative frequency reduction).
+ *
+ * @return Voltage in mV, never above requested_voltage
+ */
+uint16_t POWERCAP_limit_voltage(const PowerCapController * ctrl, uint16_t requested_voltage,
+                                uint16_t requested_freq, uint16_t min_voltage);
+
+bool POWERCAP_is_limiting(const PowerCapController * ctrl, uint16_t requested_freq);
+
+#endif /* POWER_CAP_H_ */
@@ -6,6 +6,7 @@
 #include "esp_lvgl_port.h"
 #include "global_state.h"
 #include "screen.h"
+#include "system.h"
 
 // static const char * TAG = "screen";
 
@@ -170,7 +171,9 @@ static lv_obj_t * create_scr_urls(SystemModule * module) {
     mining_url_scr_urls_label = lv_label_create(scr);
     lv_obj_set_width(mining_url_scr_urls_label, LV_HOR_RES);
     lv_label_set_long_mode(mining_url_scr_urls_label, LV_LABEL_LONG_SCROLL_CIRCULAR);
-    lv_label_set_text(mining_url_scr_urls_label, module->is_using_fallback ? module->fallback_pool_url : module->pool_url);
+    char pool_url[POOL_URL_SIZE];
+    SYSTEM_copy_pool_url(GLOBAL_STATE, module->is_using_fallback, pool_url, sizeof(pool_url));
+    lv_label_set_text(mining_url_scr_urls_label, pool_url);
 
     lv_obj_t *label3 = lv_label_create(scr);
     lv_label_set_text(label3, "Bitaxe IP:");
@@ -285,7 +288,8 @@ static void screen_update_cb(lv_timer_t * timer)
 
     PowerManagementModule * power_management = &GLOBAL_STATE->POWER_MANAGEMENT_MODULE;
 
-    char *pool_url = module->is_using_fallback ? module->fallback_pool_url : module->pool_url;
+    char pool_url[POOL_URL_SIZE];
+    SYSTEM_copy_pool_url(GLOBAL_STATE, module->is_using_fallback, pool_url, sizeof(pool_url));
     if (strcmp(lv_label_get_text(mining_url_scr_urls_label), pool_url) != 0) {
         lv_label_set_text(mining_url_scr_urls_label, pool_url);
     }
@@ -2,6 +2,7 @@
 #include <math.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <pthread.h>
 #include <string.h>
 #include <sys/time.h>
 
@@ -42,6 +43,12 @@
 
 static const char * TAG = "SystemModule";
 
+// chain_state is written by the stratum task and read by the API and display tasks
+static portMUX_TYPE chain_state_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Display updates run on their own intervals, this only paces the loop
+#define SYSTEM_LOOP_MS 50
+
 static void _suffix_string(uint64_t, char *, size_t, int);
 
 esp_netif_t * netif;
@@ -53,6 +60,34 @@ static esp_err_t ensure_overheat_mode_config();
 static void _check_for_best_diff(GlobalState * GLOBAL_STATE, double diff, uint8_t job_id);
 static void _suffix_string(uint64_t val, char * buf, size_t bufsiz, int sigdigits);
 
+void SYSTEM_load_pool_settings(GlobalState * GLOBAL_STATE)
+{
+    SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
+    char pool_url[POOL_URL_SIZE];
+    char fallback_pool_url[POOL_URL_SIZE];
+
+    nvs_config_copy_string(NVS_CONFIG_STRATUM_URL, CONFIG_STRATUM_URL, pool_url, sizeof(pool_url));
+    nvs_config_copy_string(NVS_CONFIG_FALLBACK_STRATUM_URL, CONFIG_FALLBACK_STRATUM_URL, fallback_pool_url, sizeof(fallback_pool_url));
+
+    pthread_mutex_lock(&module->pool_lock);
+    strcpy(module->pool_url, pool_url);
+    strcpy(module->fallback_pool_url, fallback_pool_url);
+    module->pool_port = nvs_config_get_u16(NVS_CONFIG_STRATUM_PORT, CONFIG_STRATUM_PORT);
+    module->fallback_pool_port = nvs_config_get_u16(NVS_CONFIG_FALLBACK_STRATUM_PORT, CONFIG_FALLBACK_STRATUM_PORT);
+    module->is_using_fallback = false;
+    pthread_mutex_unlock(&module->pool_lock);
+}
+
+void SYSTEM_copy_pool_url(GlobalState * GLOBAL_STATE, bool fallback, char * buf, size_t size)
+{
+    SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
+
+    pthread_mutex_lock(&module->pool_lock);
+    strncpy(buf, fallback ? module->fallback_pool_url : module->pool_url, size - 1);
+    pthread_mutex_unlock(&module->pool_lock);
+    buf[size - 1] = '\0';
+}
+
 void SYSTEM_init_system(GlobalState * GLOBAL_STATE)
 {
     SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
@@ -64,6 +99,12 @@ void SYSTEM_init_system(GlobalState * GLOBAL_STATE)
     module->screen_page = 0;
     module->shares_accepted = 0;
     module->shares_rejected = 0;
+    memset(module->shares_rejected_by_reason, 0, sizeof(module->shares_rejected_by_reason));
+    module->nonces_found = 0;
+    module->invalid_job_nonces = 0;
+    memset(module->notify_latency_buckets, 0, sizeof(module->notify_latency_buckets));
+    module->notify_latency_sum_us = 0;
+    module->notify_latency_count = 0;
     module->best_nonce_diff = nvs_config_get_u64(NVS_CONFIG_BEST_DIFF, 0);
     module->best_session_nonce_diff = 0;
     module->start_time = esp_timer_get_time();
@@ -71,16 +112,9 @@ void SYSTEM_init_system(GlobalState * GLOBAL_STATE)
     module->FOUND_BLOCK = false;
     module->startup_done = false;
     
-    // set the pool url
-    module->pool_url = nvs_config_get_string(NVS_CONFIG_STRATUM_URL, CONFIG_STRATUM_URL);
-    module->fallback_pool_url = nvs_config_get_string(NVS_CONFIG_FALLBACK_STRATUM_URL, CONFIG_FALLBACK_STRATUM_URL);
-
-    //set the pool port
-    module->pool_port = nvs_config_get_u16(NVS_CONFIG_STRATUM_PORT, CONFIG_STRATUM_PORT);
-    module->fallback_pool_port = nvs_config_get_u16(NVS_CONFIG_FALLBACK_STRATUM_PORT, CONFIG_FALLBACK_STRATUM_PORT);
-
-    // set fallback to false.
-    module->is_using_fallback = false;
+    // set the pool urls and ports, fallback to false
+    pthread_mutex_init(&module->pool_lock, NULL);
+    SYSTEM_load_pool_settings(GLOBAL_STATE);
 
     // Initialize overheat_mode
     module->overheat_mode = nvs_config_get_u16(NVS_CONFIG_OVERHEAT_MODE, 0);
@@ -152,7 +186,7 @@ void SYSTEM_init_peripherals(GlobalState * GLOBAL_STATE) {
             }
             #if LVGL_MODE_BAP == 1
             // Initialize LVGL display
-            if (lvglDisplay_initBAP() != ESP_OK) {
+            if (lvglDisplay_initBAP(GLOBAL_STATE) != ESP_OK) {
                 ESP_LOGI(TAG, "LVGL display init failed!");
             } else {
                 ESP_LOGI(TAG, "LVGL display init success!");
@@ -185,7 +219,6 @@ void SYSTEM_task(void * pvParameters)
 {
     GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
     SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
-    static uint8_t displayBufferBAP[1024];
     
     //_init_system(GLOBAL_STATE);
 
@@ -194,25 +227,21 @@ void SYSTEM_task(void * pvParameters)
 
     // show the connection screen
     while (!module->startup_done) {
-        // Check for BAP messages
+        // BAP messages are handled by their own receive task
         #if LVGL_MODE_BAP == 1
-        SERIAL_rx_BAP(GLOBAL_STATE, displayBufferBAP, sizeof(displayBufferBAP), 50);
         lvglStartupLoopBAP(GLOBAL_STATE);
         #elif LVGL_MODE_I2C == 1
         // TODO: Implement I2C startup loop
         #endif
+        vTaskDelay(pdMS_TO_TICKS(SYSTEM_LOOP_MS));
     }
     int current_screen = 0;
     TickType_t last_update_time = xTaskGetTickCount();
     
     while (1) {
-        // Check for overheat mode
-        #if LVGL_MODE_BAP == 1
-            SERIAL_rx_BAP(GLOBAL_STATE, displayBufferBAP, sizeof(displayBufferBAP), 15);
-        #elif LVGL_MODE_I2C == 1
-            // TODO: 
-        #endif
+        vTaskDelay(pdMS_TO_TICKS(SYSTEM_LOOP_MS));
 
+        // Check for overheat mode
         if (module->overheat_mode == 1) {
             
             gpio_set_level(GPIO_NUM_1, 0);
@@ -240,11 +269,6 @@ void SYSTEM_task(void * pvParameters)
         #endif
         
         #if USE_MEMPOOL_API == 1
-        mempool_api_price();
-        mempool_api_block_tip_height();
-        mempool_api_network_hashrate();
-        mempool_api_network_difficulty_adjustement();
-        mempool_api_network_recommended_fee();
         #if LVGL_MODE_BAP == 1
             lvglUpdateDisplayAPIBAP();
         #elif LVGL_MODE_I2C == 1
@@ -252,6 +276,10 @@ void SYSTEM_task(void * pvParameters)
         #endif
         #endif
 
+        #if LVGL_MODE_BAP == 1
+            lvglFlushDisplayBAP();
+        #endif
+
         #if LVGL_MODE_I2C == 1
             lvglGetSettings();
         #endif
@@ -267,11 +295,53 @@ void SYSTEM_notify_accepted_share(GlobalState * GLOBAL_STATE)
     module->shares_accepted++;
 }
 
-void SYSTEM_notify_rejected_share(GlobalState * GLOBAL_STATE)
+void SYSTEM_notify_rejected_share(GlobalState * GLOBAL_STATE, const char * reason)
 {
     SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
 
     module->shares_rejected++;
+
+    if (reason == NULL || reason[0] == '\0') {
+        reason = "unknown";
+    }
+    // Pools use a handful of reasons, the first ones seen get a slot each and the rest share the last
+    RejectedShares * slot = &module->shares_rejected_by_reason[REJECT_REASON_COUNT - 1];
+    for (int i = 0; i < REJECT_REASON_COUNT - 1; i++) {
+        RejectedShares * candidate = &module->shares_rejected_by_reason[i];
+        if (candidate->reason[0] == '\0') {
+            strncpy(candidate->reason, reason, REJECT_REASON_SIZE - 1);
+        }
+        if (strncmp(candidate->reason, reason, REJECT_REASON_SIZE - 1) == 0) {
+            slot = candidate;
+            break;
+        }
+    }
+    if (slot->reason[0] == '\0') {
+        strcpy(slot->reason, "other");
+    }
+    slot->count++;
+}
+
+const uint32_t SYSTEM_notify_latency_bounds_us[NOTIFY_LATENCY_BUCKETS - 1] = {
+    1000, 5000, 10000, 25000, 50000, 100000, 250000,
+};
+
+void SYSTEM_notify_job_latency(GlobalState * GLOBAL_STATE, int64_t latency_us)
+{
+    SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
+
+    int bucket = 0;
+    while (bucket < NOTIFY_LATENCY_BUCKETS - 1 && latency_us > SYSTEM_notify_latency_bounds_us[bucket]) {
+        bucket++;
+    }
+    module->notify_latency_buckets[bucket]++;
+    module->notify_latency_sum_us += latency_us;
+    module->notify_latency_count++;
+}
+
+void SYSTEM_notify_invalid_nonce(GlobalState * GLOBAL_STATE)
+{
+    GLOBAL_STATE->SYSTEM_MODULE.invalid_job_nonces++;
 }
 
 void SYSTEM_notify_mining_started(GlobalState * GLOBAL_STATE)
@@ -297,10 +367,50 @@ void SYSTEM_notify_new_ntime(GlobalState * GLOBAL_STATE, uint32_t ntime)
     settimeofday(&tv, NULL);
 }
 
+bool SYSTEM_notify_chain_state(GlobalState * GLOBAL_STATE, const mining_notify * notify)
+{
+    ChainState * chain = &GLOBAL_STATE->SYSTEM_MODULE.chain_state[GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback ? 1 : 0];
+    double network_difficulty = calculate_network_difficulty(notify->target);
+    uint32_t height = coinbase_block_height(notify->coinbase_1);
+    int64_t now = esp_timer_get_time();
+    bool new_block = false;
+
+    portENTER_CRITICAL(&chain_state_mux);
+    chain->network_difficulty = network_difficulty;
+    if (height != 0) {
+        chain->block_height = height;
+    }
+    if (strncmp(chain->prev_block_hash, notify->prev_block_hash, sizeof(chain->prev_block_hash) - 1) != 0) {
+        if (chain->block_change_us != 0) {
+            chain->block_changes++;
+        }
+        strncpy(chain->prev_block_hash, notify->prev_block_hash, sizeof(chain->prev_block_hash) - 1);
+        chain->block_ntime = notify->ntime;
+        chain->block_change_us = now;
+        new_block = true;
+    }
+    height = chain->block_height;
+    portEXIT_CRITICAL(&chain_state_mux);
+
+    if (new_block) {
+        ESP_LOGI(TAG, "New block %lu, network diff %.0f", height, network_difficulty);
+    }
+    return new_block;
+}
+
+void SYSTEM_copy_chain_state(GlobalState * GLOBAL_STATE, bool fallback, ChainState * chain)
+{
+    portENTER_CRITICAL(&chain_state_mux);
+    *chain = GLOBAL_STATE->SYSTEM_MODULE.chain_state[fallback ? 1 : 0];
+    portEXIT_CRITICAL(&chain_state_mux);
+}
+
 void SYSTEM_notify_found_nonce(GlobalState * GLOBAL_STATE, double found_diff, uint8_t job_id)
 {
     SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
 
+    module->nonces_found++;
+
     // Calculate the time difference in seconds with sub-second precision
     // hashrate = (nonce_difficulty * 2^32) / time_to_find
 
@@ -340,18 +450,6 @@ void SYSTEM_notify_found_nonce(GlobalState * GLOBAL_STATE, double found_diff, ui
     _check_for_best_diff(GLOBAL_STATE, found_diff, job_id);
 }
 
-static double _calculate_network_difficulty(uint32_t nBits)
-{
-    uint32_t mantissa = nBits & 0x007fffff;  // Extract the mantissa from nBits
-    uint8_t exponent = (nBits >> 24) & 0xff; // Extract the exponent from nBits
-
-    double target = (double) mantissa * pow(256, (exponent - 3)); // Calculate the target value
-
-    double difficulty = (pow(2, 208) * 65535) / target; // Calculate the difficulty
-
-    return difficulty;
-}
-
 static void _check_for_best_diff(GlobalState * GLOBAL_STATE, double diff, uint8_t job_id)
 {
     SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
@@ -366,12 +464,12 @@ static void _check_for_best_diff(GlobalState * GLOBAL_STATE, double diff, uint8_
     }
     module->best_nonce_diff = (uint64_t) diff;
 
-    nvs_config_set_u64(NVS_CONFIG_BEST_DIFF, module->best_nonce_diff);
+    nvs_config_set_u64_deferred(NVS_CONFIG_BEST_DIFF, module->best_nonce_diff);
 
     // make the best_nonce_diff into a string
     _suffix_string((uint64_t) diff, module->best_diff_string, DIFF_STRING_SIZE, 0);
 
-    double network_diff = _calculate_network_difficulty(GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->target);
+    double network_diff = calculate_network_difficulty(GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->target);
     if (diff > network_diff) {
         module->FOUND_BLOCK = true;
         ESP_LOGI(TAG, "FOUND BLOCK!!!!!!!!!!!!!!!!!!!!!! %f > %f", diff, network_diff);
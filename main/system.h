@@ -10,10 +10,24 @@ void SYSTEM_init_system(GlobalState * GLOBAL_STATE);
 void SYSTEM_init_peripherals(GlobalState * GLOBAL_STATE);
 void SYSTEM_task(void * pvParameters);
 
+// Read the pool urls and ports from NVS, only the stratum task calls it after init
+void SYSTEM_load_pool_settings(GlobalState * GLOBAL_STATE);
+// Copy of the primary or the fallback pool url, for tasks other than the stratum task
+void SYSTEM_copy_pool_url(GlobalState * GLOBAL_STATE, bool fallback, char * buf, size_t size);
+
+// Upper bound of each notify latency bucket except the last, which is unbounded
+extern const uint32_t SYSTEM_notify_latency_bounds_us[NOTIFY_LATENCY_BUCKETS - 1];
+
 void SYSTEM_notify_accepted_share(GlobalState * GLOBAL_STATE);
-void SYSTEM_notify_rejected_share(GlobalState * GLOBAL_STATE);
+void SYSTEM_notify_rejected_share(GlobalState * GLOBAL_STATE, const char * reason);
 void SYSTEM_notify_found_nonce(GlobalState * GLOBAL_STATE, double found_diff, uint8_t job_id);
+void SYSTEM_notify_invalid_nonce(GlobalState * GLOBAL_STATE);
+void SYSTEM_notify_job_latency(GlobalState * GLOBAL_STATE, int64_t latency_us);
 void SYSTEM_notify_mining_started(GlobalState * GLOBAL_STATE);
 void SYSTEM_notify_new_ntime(GlobalState * GLOBAL_STATE, uint32_t ntime);
+// Track height and difficulty from a notify, true when it is the first notify for a new block
+bool SYSTEM_notify_chain_state(GlobalState * GLOBAL_STATE, const mining_notify * notify);
+// Consistent copy of the chain state of the primary or fallback pool
+void SYSTEM_copy_chain_state(GlobalState * GLOBAL_STATE, bool fallback, ChainState * chain);
 
 #endif /* SYSTEM_H_ */
@@ -11,10 +11,17 @@
 
 static const char *TAG = "asic_result";
 
+#define MAX_STRATUM_USER_SIZE 128
+
 void ASIC_result_task(void *pvParameters)
 {
     GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
 
+    // Worker names for share submission, copied again only when a setting changes
+    char stratum_user[MAX_STRATUM_USER_SIZE];
+    char fallback_stratum_user[MAX_STRATUM_USER_SIZE];
+    uint32_t config_generation = 0;
+
     while (1)
     {
         task_result *asic_result = (*GLOBAL_STATE->ASIC_functions.receive_result_fn)(GLOBAL_STATE);
@@ -29,6 +36,7 @@ void ASIC_result_task(void *pvParameters)
         if (GLOBAL_STATE->valid_jobs[job_id] == 0)
         {
             ESP_LOGI(TAG, "Invalid job nonce found, 0x%02X", job_id);
+            SYSTEM_notify_invalid_nonce(GLOBAL_STATE);
             continue;
         }
 
@@ -43,7 +51,12 @@ void ASIC_result_task(void *pvParameters)
 
         if (nonce_diff > GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->pool_diff)
         {
-            char * user = GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback ? nvs_config_get_string(NVS_CONFIG_FALLBACK_STRATUM_USER, FALLBACK_STRATUM_USER) : nvs_config_get_string(NVS_CONFIG_STRATUM_USER, STRATUM_USER);
+            if (config_generation != nvs_config_get_generation()) {
+                config_generation = nvs_config_get_generation();
+                nvs_config_copy_string(NVS_CONFIG_STRATUM_USER, STRATUM_USER, stratum_user, sizeof(stratum_user));
+                nvs_config_copy_string(NVS_CONFIG_FALLBACK_STRATUM_USER, FALLBACK_STRATUM_USER, fallback_stratum_user, sizeof(fallback_stratum_user));
+            }
+            const char * user = GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback ? fallback_stratum_user : stratum_user;
             int ret = STRATUM_V1_submit_share(
                 GLOBAL_STATE->sock,
                 user,
@@ -52,7 +65,6 @@ void ASIC_result_task(void *pvParameters)
                 GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->ntime,
                 asic_result->nonce,
                 asic_result->rolled_version ^ GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->version);
-            free(user);
 
             if (ret < 0) {
                 ESP_LOGI(TAG, "Unable to write share to socket. Closing connection. Ret: %d (errno %d: %s)", ret, errno, strerror(errno));
@@ -2,6 +2,8 @@
 #include "global_state.h"
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_timer.h"
+#include "system.h"
 #include "mining.h"
 #include <limits.h>
 #include "string.h"
@@ -42,6 +44,9 @@ void create_jobs_task(void *pvParameters)
             if (should_generate_more_work(GLOBAL_STATE))
             {
                 generate_work(GLOBAL_STATE, mining_notification, extranonce_2);
+                if (extranonce_2 == 0) {
+                    SYSTEM_notify_job_latency(GLOBAL_STATE, esp_timer_get_time() - mining_notification->received_us);
+                }
 
                 // Increase extranonce_2 for the next job.
                 extranonce_2++;
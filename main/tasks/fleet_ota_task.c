@@ -0,0 +1,539 @@
+#include "fleet_ota_task.h"
+#include "dataBase.h"
+#include "esp_app_desc.h"
+#include "esp_http_client.h"
+#include "esp_image_format.h"
+#include "esp_log.h"
+#include "esp_netif_ip_addr.h"
+#include "esp_ota_ops.h"
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "global_state.h"
+#include "mdns.h"
+#include "nvs_config.h"
+#include "static_assets.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char * TAG = "fleet_ota";
+
+#define FLEET_OTA_SERVICE "_acsminer"
+#define FLEET_OTA_PROTO "_tcp"
+#define FLEET_OTA_PORT 80
+#define FLEET_OTA_FIRST_BROWSE_S 120
+#define FLEET_OTA_BROWSE_INTERVAL_S 900     // Jittered, so a fleet does not pull from one miner at once
+#define FLEET_OTA_JITTER_PERCENT 25
+#define FLEET_OTA_QUERY_TIMEOUT_MS 3000
+#define FLEET_OTA_MAX_PEERS 32
+#define FLEET_OTA_HTTP_TIMEOUT_MS 10000
+#define FLEET_OTA_SECTOR_SIZE 4096
+#define FLEET_OTA_WWW_ATTEMPTS 3            // A www pull that already erased something is retried right away
+#define FLEET_OTA_WWW_RETRY_DELAY_MS 5000
+#define FLEET_OTA_BROKEN_WWW_BROWSE_S 60    // Browse again this soon while the www partition is left half written
+
+static FleetOtaServed served[2];
+static portMUX_TYPE served_mux = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t serve_lock = NULL;     // Serializes manifest rebuilds, NULL while fleet OTA is off
+
+typedef struct {
+    char ip[16];
+    uint16_t port;
+    char version[FLEET_OTA_VERSION_LEN];
+} fleet_peer_t;
+
+// Pulling one image from a peer, the context of both fleet_ota_pull callbacks
+typedef struct {
+    esp_http_client_handle_t client;
+    const fleet_peer_t * peer;
+    fleet_ota_image_t image;
+    const esp_partition_t * partition;
+    esp_ota_handle_t ota_handle;        // Firmware only
+    bool www_written;                   // The www partition was erased, the web app is broken until a pull completes
+} fleet_transfer_t;
+
+static const char * image_name(fleet_ota_image_t image)
+{
+    return image == FLEET_OTA_IMAGE_FIRMWARE ? "firmware" : "www";
+}
+
+const FleetOtaServed * FLEET_OTA_acquire(fleet_ota_image_t image)
+{
+    FleetOtaServed * entry = NULL;
+    if (image > FLEET_OTA_IMAGE_WWW) {
+        return NULL;
+    }
+    taskENTER_CRITICAL(&served_mux);
+    if (served[image].ready) {
+        served[image].users++;
+        entry = &served[image];
+    }
+    taskEXIT_CRITICAL(&served_mux);
+    return entry;
+}
+
+void FLEET_OTA_release(fleet_ota_image_t image)
+{
+    taskENTER_CRITICAL(&served_mux);
+    served[image].users--;
+    taskEXIT_CRITICAL(&served_mux);
+}
+
+void FLEET_OTA_stop_serving(fleet_ota_image_t image)
+{
+    taskENTER_CRITICAL(&served_mux);
+    served[image].ready = false;
+    taskEXIT_CRITICAL(&served_mux);
+}
+
+// Stop serving and free the manifest once the last request answering from it is done
+static void drop_served(fleet_ota_image_t image)
+{
+    FleetOtaServed * entry = &served[image];
+    FLEET_OTA_stop_serving(image);
+    while (1) {
+        taskENTER_CRITICAL(&served_mux);
+        uint32_t users = entry->users;
+        taskEXIT_CRITICAL(&served_mux);
+        if (users == 0) {
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    if (entry->encoded != NULL) {
+        free(entry->encoded);
+        entry->encoded = NULL;
+        fleet_ota_manifest_free(&entry->manifest);
+    }
+}
+
+static esp_err_t partition_read(void * ctx, size_t offset, void * buf, size_t len)
+{
+    return esp_partition_read((const esp_partition_t *) ctx, offset, buf, len);
+}
+
+// Called with serve_lock held
+static esp_err_t serve_image(fleet_ota_image_t image, const esp_partition_t * partition, size_t size, uint8_t * scratch)
+{
+    FleetOtaServed * entry = &served[image];
+    drop_served(image);
+    esp_err_t err = fleet_ota_manifest_build(&entry->manifest, image, esp_app_get_description()->version, size,
+                                             FLEET_OTA_CHUNK_SIZE, partition_read, (void *) partition, scratch);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    entry->encoded_len = fleet_ota_manifest_encoded_size(&entry->manifest);
+    entry->encoded = malloc(entry->encoded_len);
+    if (entry->encoded == NULL) {
+        fleet_ota_manifest_free(&entry->manifest);
+        return ESP_ERR_NO_MEM;
+    }
+    fleet_ota_manifest_encode(&entry->manifest, entry->encoded, entry->encoded_len);
+    entry->partition = partition;
+    taskENTER_CRITICAL(&served_mux);
+    entry->ready = true;
+    taskEXIT_CRITICAL(&served_mux);
+
+    ESP_LOGI(TAG, "Serving %s image, %" PRIu32 " bytes in %" PRIu32 " chunks", image_name(image), entry->manifest.size,
+             entry->manifest.chunk_count);
+    return ESP_OK;
+}
+
+// The running firmware is served as far as its image reaches
+static esp_err_t serve_firmware(uint8_t * scratch)
+{
+    const esp_partition_t * running = esp_ota_get_running_partition();
+    esp_partition_pos_t pos = {
+        .offset = running->address,
+        .size = running->size,
+    };
+    esp_image_metadata_t metadata;
+    esp_err_t err = esp_image_get_metadata(&pos, &metadata);
+    if (err == ESP_OK) {
+        err = serve_image(FLEET_OTA_IMAGE_FIRMWARE, running, metadata.image_len, scratch);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Not serving the firmware: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+// The www partition as a whole
+static esp_err_t serve_www(uint8_t * scratch)
+{
+    // Without a data partition the logs are written under /www/data, the manifest would go stale
+    // with the next log line
+    if (esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, "data") == NULL) {
+        ESP_LOGW(TAG, "Not serving the www partition, it holds the logs on this partition layout");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    const esp_partition_t * www = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, "www");
+    esp_err_t err = www ? serve_image(FLEET_OTA_IMAGE_WWW, www, www->size, scratch) : ESP_ERR_NOT_FOUND;
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Not serving the www partition: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+esp_err_t FLEET_OTA_start_serving(fleet_ota_image_t image)
+{
+    SemaphoreHandle_t lock = __atomic_load_n(&serve_lock, __ATOMIC_ACQUIRE);
+    if (lock == NULL || image > FLEET_OTA_IMAGE_WWW) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    uint8_t * scratch = malloc(FLEET_OTA_CHUNK_SIZE);
+    if (scratch == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    esp_err_t err = image == FLEET_OTA_IMAGE_FIRMWARE ? serve_firmware(scratch) : serve_www(scratch);
+    xSemaphoreGive(lock);
+    free(scratch);
+    return err;
+}
+
+static esp_err_t advertise(GlobalState * GLOBAL_STATE)
+{
+    char hostname[64];
+    nvs_config_copy_string(NVS_CONFIG_HOSTNAME, CONFIG_LWIP_LOCAL_HOSTNAME, hostname, sizeof(hostname));
+
+    esp_err_t err = mdns_init();
+    if (err == ESP_OK) {
+        err = mdns_hostname_set(hostname);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    mdns_txt_item_t txt[] = {
+        {"version", esp_app_get_description()->version},
+        {"model", GLOBAL_STATE->device_model_str},
+    };
+    return mdns_service_add(NULL, FLEET_OTA_SERVICE, FLEET_OTA_PROTO, FLEET_OTA_PORT, txt, sizeof(txt) / sizeof(txt[0]));
+}
+
+static const char * txt_value(const mdns_result_t * result, const char * key)
+{
+    for (size_t i = 0; i < result->txt_count; i++) {
+        if (strcmp(result->txt[i].key, key) == 0) {
+            return result->txt[i].value;
+        }
+    }
+    return NULL;
+}
+
+// A random one of the peers with the newest version, so the load spreads as the update does
+static bool find_newer_peer(GlobalState * GLOBAL_STATE, fleet_peer_t * peer)
+{
+    mdns_result_t * results = NULL;
+    if (mdns_query_ptr(FLEET_OTA_SERVICE, FLEET_OTA_PROTO, FLEET_OTA_QUERY_TIMEOUT_MS, FLEET_OTA_MAX_PEERS, &results) != ESP_OK) {
+        return false;
+    }
+
+    int candidates = 0;
+    strlcpy(peer->version, esp_app_get_description()->version, sizeof(peer->version));
+
+    for (mdns_result_t * result = results; result != NULL; result = result->next) {
+        const char * version = txt_value(result, "version");
+        const char * model = txt_value(result, "model");
+        if (version == NULL || model == NULL || strcmp(model, GLOBAL_STATE->device_model_str) != 0) {
+            continue;
+        }
+
+        int order = fleet_ota_version_compare(version, peer->version);
+        if (order < 0 || (order == 0 && candidates == 0)) {
+            continue;
+        }
+
+        for (mdns_ip_addr_t * addr = result->addr; addr != NULL; addr = addr->next) {
+            if (addr->addr.type != ESP_IPADDR_TYPE_V4) {
+                continue;
+            }
+            candidates = order > 0 ? 1 : candidates + 1;
+            // Reservoir sampling over the peers sharing the newest version
+            if (esp_random() % candidates == 0) {
+                snprintf(peer->ip, sizeof(peer->ip), IPSTR, IP2STR(&addr->addr.u_addr.ip4));
+                peer->port = result->port;
+                strlcpy(peer->version, version, sizeof(peer->version));
+            }
+            break;
+        }
+    }
+
+    mdns_query_results_free(results);
+    return candidates > 0;
+}
+
+// GET a response of at most size bytes into buf, the connection is kept for the next request
+static esp_err_t http_get(esp_http_client_handle_t client, const char * url, uint8_t * buf, size_t size, size_t * received)
+{
+    esp_http_client_set_url(client, url);
+    esp_err_t err = esp_http_client_open(client, 0);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    int64_t content_length = esp_http_client_fetch_headers(client);
+    int status = esp_http_client_get_status_code(client);
+    if (content_length < 0 && !esp_http_client_is_chunked_response(client)) {
+        esp_http_client_close(client);
+        return ESP_FAIL;
+    }
+    if (status != 200 || content_length > (int64_t) size) {
+        esp_http_client_close(client);
+        return status == 404 ? ESP_ERR_NOT_FOUND : status != 200 ? ESP_FAIL : ESP_ERR_INVALID_SIZE;
+    }
+
+    size_t len = 0;
+    while (len < size) {
+        int read = esp_http_client_read(client, (char *) buf + len, size - len);
+        if (read <= 0) {
+            break;
+        }
+        len += read;
+    }
+    if (!esp_http_client_is_complete_data_received(client)) {
+        esp_http_client_close(client);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    *received = len;
+    return ESP_OK;
+}
+
+static esp_err_t fetch_chunk(void * ctx, uint32_t index, uint8_t * buf, size_t len)
+{
+    fleet_transfer_t * transfer = ctx;
+    char url[96];
+    snprintf(url, sizeof(url), "http://%s:%u/api/fleet/chunk?image=%s&index=%" PRIu32, transfer->peer->ip,
+             transfer->peer->port, image_name(transfer->image), index);
+
+    size_t received;
+    esp_err_t err = http_get(transfer->client, url, buf, len, &received);
+    if (err == ESP_OK && received != len) {
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Chunk %" PRIu32 " of %s: %s", index, image_name(transfer->image), esp_err_to_name(err));
+    }
+    return err;
+}
+
+static esp_err_t fetch_manifest(fleet_transfer_t * transfer, fleet_ota_manifest_t * manifest, uint8_t * buf)
+{
+    char url[96];
+    snprintf(url, sizeof(url), "http://%s:%u/api/fleet/manifest?image=%s", transfer->peer->ip, transfer->peer->port,
+             image_name(transfer->image));
+
+    size_t received;
+    esp_err_t err = http_get(transfer->client, url, buf, FLEET_OTA_MANIFEST_MAX_SIZE, &received);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = fleet_ota_manifest_decode(manifest, buf, received);
+    if (err == ESP_OK && manifest->image != transfer->image) {
+        fleet_ota_manifest_free(manifest);
+        err = ESP_ERR_INVALID_RESPONSE;
+    }
+    return err;
+}
+
+static esp_err_t write_firmware(void * ctx, size_t offset, const uint8_t * data, size_t len)
+{
+    fleet_transfer_t * transfer = ctx;
+    return esp_ota_write(transfer->ota_handle, data, len);
+}
+
+// Chunks are sector aligned, each one erases the sectors it covers
+static esp_err_t write_www(void * ctx, size_t offset, const uint8_t * data, size_t len)
+{
+    fleet_transfer_t * transfer = ctx;
+    size_t erase_len = (len + FLEET_OTA_SECTOR_SIZE - 1) & ~(FLEET_OTA_SECTOR_SIZE - 1);
+    transfer->www_written = true;
+    esp_err_t err = esp_partition_erase_range(transfer->partition, offset, erase_len);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return esp_partition_write(transfer->partition, offset, data, len);
+}
+
+
+static esp_err_t pull_image(fleet_transfer_t * transfer, uint8_t * buf)
+{
+    fleet_ota_manifest_t manifest;
+    esp_err_t err = fetch_manifest(transfer, &manifest, buf);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    fleet_ota_pull_io_t io = {
+        .fetch = fetch_chunk,
+        .ctx = transfer,
+    };
+    if (transfer->image == FLEET_OTA_IMAGE_FIRMWARE) {
+        transfer->partition = esp_ota_get_next_update_partition(NULL);
+        if (transfer->partition == NULL || manifest.size > transfer->partition->size) {
+            err = ESP_ERR_INVALID_SIZE;
+        } else {
+            err = esp_ota_begin(transfer->partition, OTA_WITH_SEQUENTIAL_WRITES, &transfer->ota_handle);
+        }
+        io.write = write_firmware;
+    } else {
+        const FleetOtaServed * own = FLEET_OTA_acquire(FLEET_OTA_IMAGE_WWW);
+        bool up_to_date = own != NULL && memcmp(own->manifest.image_sha, manifest.image_sha, sizeof(manifest.image_sha)) == 0;
+        if (own != NULL) {
+            FLEET_OTA_release(FLEET_OTA_IMAGE_WWW);
+        }
+        if (up_to_date) {
+            ESP_LOGI(TAG, "The www partition is already up to date");
+            fleet_ota_manifest_free(&manifest);
+            return ESP_OK;
+        }
+        // A SPIFFS image always fills its partition
+        transfer->partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, "www");
+        if (transfer->partition == NULL || manifest.size != transfer->partition->size) {
+            err = ESP_ERR_INVALID_SIZE;
+        } else {
+            FLEET_OTA_stop_serving(FLEET_OTA_IMAGE_WWW);
+            static_assets_clear();
+        }
+        io.write = write_www;
+    }
+
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Pulling %s %s from %s, %" PRIu32 " bytes", image_name(transfer->image), manifest.version,
+                 transfer->peer->ip, manifest.size);
+        err = fleet_ota_pull(&manifest, &io, buf);
+        if (transfer->image == FLEET_OTA_IMAGE_FIRMWARE) {
+            // Checks the image, and its signature when signed app images are enabled
+            if (err == ESP_OK) {
+                err = esp_ota_end(transfer->ota_handle);
+            } else {
+                esp_ota_abort(transfer->ota_handle);
+            }
+        } else if (err == ESP_OK) {
+            if (static_assets_reload() != ESP_OK) {
+                ESP_LOGW(TAG, "Failed to rebuild the web app manifest, serving straight from the filesystem");
+            }
+            FLEET_OTA_start_serving(FLEET_OTA_IMAGE_WWW);
+        }
+    }
+    fleet_ota_manifest_free(&manifest);
+    return err;
+}
+
+// Firmware first, it only goes live once the www partition matches it as well. Returns true
+// when the www partition was left half written.
+static bool update_from_peer(const fleet_peer_t * peer, uint8_t * buf)
+{
+    char url[48];
+    snprintf(url, sizeof(url), "http://%s:%u/", peer->ip, peer->port);
+    esp_http_client_config_t config = {
+        .url = url,
+        .keep_alive_enable = true,
+        .timeout_ms = FLEET_OTA_HTTP_TIMEOUT_MS,
+    };
+    fleet_transfer_t transfer = {
+        .client = esp_http_client_init(&config),
+        .peer = peer,
+        .image = FLEET_OTA_IMAGE_FIRMWARE,
+    };
+    if (transfer.client == NULL) {
+        ESP_LOGE(TAG, "Failed to initialize HTTP client");
+        return false;
+    }
+
+    esp_err_t err = pull_image(&transfer, buf);
+    const esp_partition_t * firmware = transfer.partition;
+    if (err == ESP_OK) {
+        transfer.image = FLEET_OTA_IMAGE_WWW;
+        for (int attempt = 1; ; attempt++) {
+            err = pull_image(&transfer, buf);
+            if (err == ESP_OK || !transfer.www_written || attempt == FLEET_OTA_WWW_ATTEMPTS) {
+                break;
+            }
+            ESP_LOGW(TAG, "www pull %d of %d failed with the partition erased: %s", attempt, FLEET_OTA_WWW_ATTEMPTS,
+                     esp_err_to_name(err));
+            vTaskDelay(pdMS_TO_TICKS(FLEET_OTA_WWW_RETRY_DELAY_MS));
+        }
+    }
+    esp_http_client_cleanup(transfer.client);
+    if (err == ESP_OK) {
+        err = esp_ota_set_boot_partition(firmware);
+    }
+
+    char data[128];
+    snprintf(data, sizeof(data), "{\"peer\":\"%s\",\"version\":\"%s\",\"image\":\"%s\",\"error\":\"%s\"}", peer->ip,
+             peer->version, image_name(transfer.image), esp_err_to_name(err));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Update from %s failed on the %s image: %s", peer->ip, image_name(transfer.image), esp_err_to_name(err));
+        dataBase_log_event("system", "error", "Fleet OTA update from peer failed", data);
+        return transfer.image == FLEET_OTA_IMAGE_WWW && transfer.www_written;
+    }
+
+    ESP_LOGI(TAG, "Updated to %s from %s, restarting", peer->version, peer->ip);
+    dataBase_log_event("system", "info", "Fleet OTA update pulled from peer", data);
+    dataBase_flush_logs(2000);
+    esp_restart();
+    return false;
+}
+
+static uint32_t jittered_ms(uint32_t seconds)
+{
+    uint32_t ms = seconds * 1000;
+    uint32_t spread = ms / 100 * FLEET_OTA_JITTER_PERCENT;
+    return ms - spread + esp_random() % (2 * spread + 1);
+}
+
+void FLEET_OTA_task(void * pvParameters)
+{
+    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
+
+    // Holds a whole manifest, which is larger than a chunk
+    uint8_t * buf = malloc(FLEET_OTA_MANIFEST_MAX_SIZE);
+    if (buf == NULL) {
+        ESP_LOGE(TAG, "No memory for the transfer buffer");
+        vTaskDelete(NULL);
+        return;
+    }
+
+    SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+    if (lock != NULL) {
+        xSemaphoreTake(lock, portMAX_DELAY);
+        serve_firmware(buf);
+        serve_www(buf);
+        xSemaphoreGive(lock);
+        __atomic_store_n(&serve_lock, lock, __ATOMIC_RELEASE);
+    } else {
+        ESP_LOGE(TAG, "No memory to serve images, pulling only");
+    }
+
+    esp_err_t err = advertise(GLOBAL_STATE);
+    if (err != ESP_OK) {
+        // Peers that know the address can still pull, but nothing is discovered
+        ESP_LOGE(TAG, "mDNS failed: %s", esp_err_to_name(err));
+        free(buf);
+        vTaskDelete(NULL);
+        return;
+    }
+
+    uint32_t delay_ms = jittered_ms(FLEET_OTA_FIRST_BROWSE_S);
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(delay_ms));
+        delay_ms = jittered_ms(FLEET_OTA_BROWSE_INTERVAL_S);
+
+        fleet_peer_t peer;
+        if (find_newer_peer(GLOBAL_STATE, &peer)) {
+            ESP_LOGI(TAG, "Peer %s runs %s", peer.ip, peer.version);
+            if (update_from_peer(&peer, buf)) {
+                // The web app stays broken until a pull completes, /recovery still works meanwhile
+                delay_ms = jittered_ms(FLEET_OTA_BROKEN_WWW_BROWSE_S);
+            }
+        }
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef FLEET_OTA_TASK_H_
+#define FLEET_OTA_TASK_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_partition.h"
+#include "fleet_ota.h"
+
+// With fleet OTA enabled a miner advertises itself over mDNS and serves its running firmware
+// and its www partition to peers. It also browses for peers of the same device model running
+// a newer version, pulls both images from one of them and restarts into the new firmware.
+// An update pushed to one miner then spreads over the LAN.
+
+typedef struct {
+    bool ready;
+    uint32_t users;                 // Requests still answering from this manifest
+    fleet_ota_manifest_t manifest;
+    uint8_t * encoded;              // The manifest as served
+    size_t encoded_len;
+    const esp_partition_t * partition;
+} FleetOtaServed;
+
+void FLEET_OTA_task(void * pvParameters);
+
+// The image served to peers, NULL while fleet OTA is off or the image is not available.
+// Held for one request, hand it back with FLEET_OTA_release.
+const FleetOtaServed * FLEET_OTA_acquire(fleet_ota_image_t image);
+void FLEET_OTA_release(fleet_ota_image_t image);
+
+// Stop serving an image whose partition was rewritten
+void FLEET_OTA_stop_serving(fleet_ota_image_t image);
+
+// Rebuild the manifest of a rewritten image and serve it again, blocks while the partition is
+// hashed. ESP_ERR_INVALID_STATE while fleet OTA is off.
+esp_err_t FLEET_OTA_start_serving(fleet_ota_image_t image);
+
+#endif /* FLEET_OTA_TASK_H_ */
@@ -0,0 +1,240 @@
+#include "fleet_status_task.h"
+#include "esp_app_desc.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "global_state.h"
+#include "lwip/inet.h"
+#include "lwip/sockets.h"
+#include "nvs_config.h"
+#include "system.h"
+#include <string.h>
+
+static const char * TAG = "fleet_status";
+
+#define FLEET_STATUS_MAX_PEERS 512          // In PSRAM
+#define FLEET_STATUS_MAX_PEERS_INTERNAL 64  // Without PSRAM
+#define FLEET_STATUS_JITTER_MS 1000
+#define FLEET_STATUS_REPLY_SPREAD_MS 500    // A fleet answering a query does not answer at once
+#define FLEET_STATUS_RETRY_MS 5000
+
+static fleet_status_table_t table;
+static SemaphoreHandle_t table_lock = NULL;
+
+static void build_digest(GlobalState * GLOBAL_STATE, const uint8_t * mac, fleet_status_digest_t * digest)
+{
+    SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
+    bool fallback = module->is_using_fallback;
+
+    memset(digest, 0, sizeof(*digest));
+    memcpy(digest->mac, mac, sizeof(digest->mac));
+    inet_pton(AF_INET, module->ip_addr_str, digest->ip);
+    digest->hashrate = module->current_hashrate;
+    digest->chip_temp = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.chip_temp_avg;
+    digest->power = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.power;
+    digest->uptime_s = (esp_timer_get_time() - module->start_time) / 1000000;
+    digest->shares_accepted = module->shares_accepted;
+    digest->shares_rejected = module->shares_rejected;
+    digest->pool_port = fallback ? module->fallback_pool_port : module->pool_port;
+    digest->flags = (fallback ? FLEET_STATUS_FLAG_FALLBACK : 0) | (module->overheat_mode ? FLEET_STATUS_FLAG_OVERHEAT : 0);
+    nvs_config_copy_string(NVS_CONFIG_HOSTNAME, CONFIG_LWIP_LOCAL_HOSTNAME, digest->hostname, sizeof(digest->hostname));
+    strncpy(digest->model, GLOBAL_STATE->device_model_str, sizeof(digest->model) - 1);
+    strncpy(digest->version, esp_app_get_description()->version, sizeof(digest->version) - 1);
+    SYSTEM_copy_pool_url(GLOBAL_STATE, fallback, digest->pool, sizeof(digest->pool));
+}
+
+static int open_socket(void)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
+        return -1;
+    }
+
+    int reuse = 1;
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(FLEET_STATUS_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    struct ip_mreq mreq = {
+        .imr_interface.s_addr = htonl(INADDR_ANY),
+    };
+    inet_aton(FLEET_STATUS_GROUP, &mreq.imr_multiaddr);
+    // Announces stay on the LAN. Multicast loopback stays on so instances on one host hear
+    // each other, a miner skips its own announces by their mac.
+    uint8_t ttl = 1;
+
+    if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+        bind(sock, (struct sockaddr *) &addr, sizeof(addr)) != 0 ||
+        setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) != 0 ||
+        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) != 0) {
+        ESP_LOGE(TAG, "Unable to join %s:%d: errno %d", FLEET_STATUS_GROUP, FLEET_STATUS_PORT, errno);
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+static bool send_digest(GlobalState * GLOBAL_STATE, int sock, const uint8_t * mac, uint32_t seq,
+                        const struct sockaddr_in * to)
+{
+    fleet_status_digest_t digest;
+    uint8_t packet[FLEET_STATUS_MAX_PACKET_SIZE];
+
+    build_digest(GLOBAL_STATE, mac, &digest);
+    if (seq == 0) {
+        xSemaphoreTake(table_lock, portMAX_DELAY);
+        fleet_status_table_update(&table, &digest, esp_timer_get_time() / 1000);
+        xSemaphoreGive(table_lock);
+    }
+
+    size_t len = fleet_status_encode_announce(&digest, seq, packet, sizeof(packet));
+    if (sendto(sock, packet, len, 0, (const struct sockaddr *) to, sizeof(*to)) < 0) {
+        ESP_LOGW(TAG, "Failed to send status: errno %d", errno);
+        return false;
+    }
+    return true;
+}
+
+void FLEET_STATUS_for_each(fleet_status_peer_fn fn, void * ctx)
+{
+    if (table_lock == NULL) {
+        return;
+    }
+
+    for (size_t i = 0;; i++) {
+        fleet_status_peer_t peer;
+        xSemaphoreTake(table_lock, portMAX_DELAY);
+        bool found = i < table.count;
+        if (found) {
+            peer = table.peers[i];
+        }
+        xSemaphoreGive(table_lock);
+
+        if (!found || !fn(&peer, ctx)) {
+            return;
+        }
+    }
+}
+
+bool FLEET_STATUS_summarize(fleet_status_summary_t * summary)
+{
+    if (table_lock == NULL) {
+        return false;
+    }
+    xSemaphoreTake(table_lock, portMAX_DELAY);
+    fleet_status_table_summarize(&table, summary);
+    xSemaphoreGive(table_lock);
+    return true;
+}
+
+void FLEET_STATUS_task(void * pvParameters)
+{
+    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
+
+    size_t capacity = FLEET_STATUS_MAX_PEERS;
+    fleet_status_peer_t * peers = heap_caps_malloc(capacity * sizeof(fleet_status_peer_t), MALLOC_CAP_SPIRAM);
+    if (peers == NULL) {
+        capacity = FLEET_STATUS_MAX_PEERS_INTERNAL;
+        peers = malloc(capacity * sizeof(fleet_status_peer_t));
+    }
+    SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+    if (peers == NULL || lock == NULL) {
+        ESP_LOGE(TAG, "No memory for the fleet table");
+        free(peers);
+        vTaskDelete(NULL);
+        return;
+    }
+    fleet_status_table_init(&table, peers, capacity);
+    table_lock = lock;
+
+    uint8_t mac[6];
+    esp_wifi_get_mac(WIFI_IF_STA, mac);
+
+    struct sockaddr_in group = {
+        .sin_family = AF_INET,
+        .sin_port = htons(FLEET_STATUS_PORT),
+    };
+    inet_aton(FLEET_STATUS_GROUP, &group.sin_addr);
+
+    // A pending answer to a query
+    struct sockaddr_in reply_to;
+    uint32_t reply_seq = 0;
+    int64_t reply_at_ms = -1;
+
+    int sock = -1;
+    // Miners powered on together do not announce together
+    int64_t next_announce_ms = esp_timer_get_time() / 1000 + esp_random() % FLEET_STATUS_ANNOUNCE_INTERVAL_MS;
+    ESP_LOGI(TAG, "Fleet status on %s:%d, room for %u miners", FLEET_STATUS_GROUP, FLEET_STATUS_PORT, (unsigned) capacity);
+
+    while (1) {
+        if (sock < 0) {
+            sock = open_socket();
+            if (sock < 0) {
+                vTaskDelay(pdMS_TO_TICKS(FLEET_STATUS_RETRY_MS));
+                continue;
+            }
+        }
+
+        int64_t now_ms = esp_timer_get_time() / 1000;
+        if (now_ms >= next_announce_ms) {
+            next_announce_ms = now_ms + FLEET_STATUS_ANNOUNCE_INTERVAL_MS - FLEET_STATUS_JITTER_MS +
+                               esp_random() % (2 * FLEET_STATUS_JITTER_MS + 1);
+            xSemaphoreTake(table_lock, portMAX_DELAY);
+            fleet_status_table_expire(&table, now_ms);
+            xSemaphoreGive(table_lock);
+
+            if (!send_digest(GLOBAL_STATE, sock, mac, 0, &group)) {
+                // The membership is gone with the interface, join again
+                close(sock);
+                sock = -1;
+                continue;
+            }
+        }
+        if (reply_at_ms >= 0 && now_ms >= reply_at_ms) {
+            reply_at_ms = -1;
+            send_digest(GLOBAL_STATE, sock, mac, reply_seq, &reply_to);
+        }
+
+        int64_t wait_ms = next_announce_ms - now_ms;
+        if (reply_at_ms >= 0 && reply_at_ms - now_ms < wait_ms) {
+            wait_ms = reply_at_ms - now_ms;
+        }
+        struct timeval timeout = {
+            .tv_sec = wait_ms / 1000,
+            .tv_usec = (wait_ms % 1000) * 1000,
+        };
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(sock, &readable);
+        if (select(sock + 1, &readable, NULL, NULL, &timeout) <= 0) {
+            continue;
+        }
+
+        uint8_t packet[FLEET_STATUS_MAX_PACKET_SIZE];
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        int len = recvfrom(sock, packet, sizeof(packet), 0, (struct sockaddr *) &from, &from_len);
+        fleet_status_message_t msg;
+        if (len <= 0 || fleet_status_decode(&msg, packet, len) != ESP_OK) {
+            continue;
+        }
+
+        if (msg.type == FLEET_STATUS_QUERY) {
+            // A newer query replaces one not answered yet
+            reply_to = from;
+            reply_seq = msg.seq;
+            reply_at_ms = esp_timer_get_time() / 1000 + esp_random() % FLEET_STATUS_REPLY_SPREAD_MS;
+        } else if (memcmp(msg.digest.mac, mac, sizeof(mac)) != 0) {
+            xSemaphoreTake(table_lock, portMAX_DELAY);
+            fleet_status_table_update(&table, &msg.digest, esp_timer_get_time() / 1000);
+            xSemaphoreGive(table_lock);
+        }
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef FLEET_STATUS_TASK_H_
+#define FLEET_STATUS_TASK_H_
+
+#include <stdbool.h>
+#include "fleet_status.h"
+
+// With fleet status enabled a miner sends its status digest to the fleet multicast group,
+// answers fleet queries and keeps a table of every miner it hears on the group, itself
+// included. One miner can then report on the whole fleet without polling each one.
+
+void FLEET_STATUS_task(void * pvParameters);
+
+// Return false to stop
+typedef bool (*fleet_status_peer_fn)(const fleet_status_peer_t * peer, void * ctx);
+
+// Calls fn for every miner known, with a copy, so fn may take its time. A miner that
+// joins or expires meanwhile may be left out.
+void FLEET_STATUS_for_each(fleet_status_peer_fn fn, void * ctx);
+
+// false while fleet status is off
+bool FLEET_STATUS_summarize(fleet_status_summary_t * summary);
+
+#endif /* FLEET_STATUS_TASK_H_ */
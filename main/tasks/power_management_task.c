@@ -20,6 +20,9 @@
 #include "common.h"
 #include "system.h"
 #include "esp_system.h"
+#include "thermal_control.h"
+#include "power_cap.h"
+#include "sensor_task.h"
 #define GPIO_ASIC_ENABLE CONFIG_GPIO_ASIC_ENABLE
 #define GPIO_ASIC_RESET  CONFIG_GPIO_ASIC_RESET
 #define GPIO_PLUG_SENSE  CONFIG_GPIO_PLUG_SENSE
@@ -36,9 +39,6 @@
 #define TPS546_THROTTLE_TEMP 105.0
 #define TPS546_MAX_TEMP 145.0
 
-#define SUPRA_POWER_OFFSET 5
-#define GAMMA_POWER_OFFSET 5
-
 static const char * TAG = "power_management";
 
 
@@ -165,6 +165,11 @@ static void autotuneOffset(GlobalState * GLOBAL_STATE)
     uint8_t currentFanSpeed = (uint8_t)(power->fan_perc);               // Fan Speed in percentage
     float currentHashrate = system->current_hashrate;                   // Hashrate in GH/s
     int16_t currentPower = (int16_t)power->power;                       // Power in watts
+    // An operator power cap tightens the autotune power limit
+    uint16_t maxPower = autotune->maxPower;
+    if (power->power_cap && power->power_cap < maxPower) {
+        maxPower = power->power_cap;
+    }
 
     // Early return if temperature is invalid or hashrate is 0
     if (currentAsicTemp == 255) {
@@ -195,7 +200,7 @@ static void autotuneOffset(GlobalState * GLOBAL_STATE)
     ESP_LOGI(autotuneTAG, "  Fan Speed: %u %%", currentFanSpeed);
     ESP_LOGI(autotuneTAG, "  Hashrate: %.2f GH/s", currentHashrate);
     ESP_LOGI(autotuneTAG, "  Power: %d W", currentPower);
-    ESP_LOGI(autotuneTAG, "  Max Power: %d W", GLOBAL_STATE->AUTOTUNE_MODULE.maxPower);
+    ESP_LOGI(autotuneTAG, "  Max Power: %d W", maxPower);
     ESP_LOGI(autotuneTAG, "  Max Domain Voltage: %u mV", GLOBAL_STATE->AUTOTUNE_MODULE.maxDomainVoltage);
     ESP_LOGI(autotuneTAG, "  Max Frequency: %u MHz", GLOBAL_STATE->AUTOTUNE_MODULE.maxFrequency);
     ESP_LOGI(autotuneTAG, "  Min Domain Voltage: %u mV", GLOBAL_STATE->AUTOTUNE_MODULE.minDomainVoltage);
@@ -305,7 +310,7 @@ static void autotuneOffset(GlobalState * GLOBAL_STATE)
             snprintf(data, sizeof(data), "{\"voltage\":%u, \"frequency\":%u, \"temperature\":%u, \"hashrate\":%.2f, \"targetHashrate\":%.2f, }", 
             newVoltage, currentFrequency, currentAsicTemp, currentHashrate, targetHashrate);
             dataBase_log_event("power", "info", "Autotune - Hashrate below target, increasing voltage", data);
-            nvs_config_set_u16(NVS_CONFIG_ASIC_VOLTAGE, newVoltage);
+            nvs_config_set_u16_deferred(NVS_CONFIG_ASIC_VOLTAGE, newVoltage);
             return;
         } else {
             ESP_LOGI(TAG, "Autotune - Hashrate above target, no adjustments needed");
@@ -321,28 +326,28 @@ static void autotuneOffset(GlobalState * GLOBAL_STATE)
         static uint16_t newFrequency = 0;
         static uint16_t newVoltage = 0;
         // Increase frequency by 2%
-        if (currentFrequency < GLOBAL_STATE->AUTOTUNE_MODULE.maxFrequency && GLOBAL_STATE->AUTOTUNE_MODULE.maxPower > currentPower) {
+        if (currentFrequency < GLOBAL_STATE->AUTOTUNE_MODULE.maxFrequency && maxPower > currentPower) {
            newFrequency = currentFrequency * 1.02;
         }
         else {
             ESP_LOGI(TAG, "freq or power limit reached, no adjustments possible");
             ESP_LOGI(TAG, "Autotune - Frequency: %u MHz, Power: %d W, Max Frequency: %u MHz, Max Power: %d W", 
-                     currentFrequency, currentPower, GLOBAL_STATE->AUTOTUNE_MODULE.maxFrequency, GLOBAL_STATE->AUTOTUNE_MODULE.maxPower);
+                     currentFrequency, currentPower, GLOBAL_STATE->AUTOTUNE_MODULE.maxFrequency, maxPower);
             char data[128];
             snprintf(data, sizeof(data), "{\"frequency\":%u,\"power\":%d,\"maxFrequency\":%u,\"maxPower\":%d}", 
-                     currentFrequency, currentPower, GLOBAL_STATE->AUTOTUNE_MODULE.maxFrequency, GLOBAL_STATE->AUTOTUNE_MODULE.maxPower);
+                     currentFrequency, currentPower, GLOBAL_STATE->AUTOTUNE_MODULE.maxFrequency, maxPower);
             dataBase_log_event("power", "warn", "Autotune - Frequency or power limit reached, no adjustments possible", data);
 
             return;
         }
         // Increase voltage by 0.2%
-        if (targetDomainVoltage < GLOBAL_STATE->AUTOTUNE_MODULE.maxDomainVoltage && GLOBAL_STATE->AUTOTUNE_MODULE.maxPower > currentPower) {
+        if (targetDomainVoltage < GLOBAL_STATE->AUTOTUNE_MODULE.maxDomainVoltage && maxPower > currentPower) {
             newVoltage = targetDomainVoltage * 1.002;
         }
         else {
             ESP_LOGI(TAG, "voltage or power limit reached, no adjustments possible");
             ESP_LOGI(TAG, "Autotune - Voltage: %u mV, Power: %d W, Max Voltage: %u mV, Max Power: %d W", 
-                     targetDomainVoltage, currentPower, GLOBAL_STATE->AUTOTUNE_MODULE.maxDomainVoltage, GLOBAL_STATE->AUTOTUNE_MODULE.maxPower);
+                     targetDomainVoltage, currentPower, GLOBAL_STATE->AUTOTUNE_MODULE.maxDomainVoltage, maxPower);
             return;
         }
         
@@ -354,8 +359,8 @@ static void autotuneOffset(GlobalState * GLOBAL_STATE)
         newFrequency, newVoltage, currentAsicTemp, currentHashrate, targetHashrate);
         dataBase_log_event("power", "info", "Autotune - Temperature under target, increasing frequency and voltage", data);
         
-        nvs_config_set_u16(NVS_CONFIG_ASIC_FREQ, newFrequency);
-        nvs_config_set_u16(NVS_CONFIG_ASIC_VOLTAGE, newVoltage);
+        nvs_config_set_u16_deferred(NVS_CONFIG_ASIC_FREQ, newFrequency);
+        nvs_config_set_u16_deferred(NVS_CONFIG_ASIC_VOLTAGE, newVoltage);
         return;
     }
     // If temperature is over target
@@ -393,13 +398,13 @@ static void autotuneOffset(GlobalState * GLOBAL_STATE)
         if (frequencyChanged) {
             ESP_LOGI(TAG, "Autotune - Temperature over target, decreasing frequency from %u MHz to %u MHz", 
                      currentFrequency, newFrequency);
-            nvs_config_set_u16(NVS_CONFIG_ASIC_FREQ, newFrequency);
+            nvs_config_set_u16_deferred(NVS_CONFIG_ASIC_FREQ, newFrequency);
         }
         
         if (voltageChanged) {
             ESP_LOGI(TAG, "Autotune - Decreasing voltage from %u mV to %u mV", targetDomainVoltage, newVoltage);
             char data[128];
-            nvs_config_set_u16(NVS_CONFIG_ASIC_VOLTAGE, newVoltage);
+            nvs_config_set_u16_deferred(NVS_CONFIG_ASIC_VOLTAGE, newVoltage);
         }
         
         char data[128];
@@ -421,32 +426,34 @@ static void autotuneOffset(GlobalState * GLOBAL_STATE)
 //     return value;
 // }
 
-// Set the fan speed between 20% min and 100% max based on chip temperature as input.
-// The fan speed increases from 20% to 100% proportionally to the temperature increase from 50 and THROTTLE_TEMP
-static double automatic_fan_speed(float chip_temp, GlobalState * GLOBAL_STATE)
+static TaskHandle_t power_task_handle = NULL;
+
+// Run the loop right away when a setting it applies changes, not on the next poll
+static void on_config_change(const char * key, void * ctx)
 {
-    double result = 0.0;
-    double min_temp = 45.0;
-    double min_fan_speed = 35.0;
-
-    if (chip_temp < min_temp) {
-        result = min_fan_speed;
-    } else if (chip_temp >= THROTTLE_TEMP) {
-        result = 100;
-    } else {
-        double temp_range = THROTTLE_TEMP - min_temp;
-        double fan_range = 100 - min_fan_speed;
-        result = ((chip_temp - min_temp) / temp_range) * fan_range + min_fan_speed;
+    // Autotune writes voltage and frequency from this task, the loop already has those
+    if (xTaskGetCurrentTaskHandle() == power_task_handle) {
+        return;
+    }
+
+    if (strcmp(key, NVS_CONFIG_ASIC_VOLTAGE) == 0 || strcmp(key, NVS_CONFIG_ASIC_FREQ) == 0 ||
+        strcmp(key, NVS_CONFIG_POWER_CAP) == 0 || strcmp(key, NVS_CONFIG_AUTO_FAN_SPEED) == 0 ||
+        strcmp(key, NVS_CONFIG_FAN_SPEED) == 0 || strcmp(key, NVS_CONFIG_OVERHEAT_MODE) == 0) {
+        xTaskNotifyGive(power_task_handle);
     }
+}
+
+// Set the fan speed from the closed-loop thermal controller (PID on chip temp + power feed-forward)
+static double automatic_fan_speed(ThermalController * thermal, float dt_s, GlobalState * GLOBAL_STATE)
+{
+    double result = THERMAL_update_fan(thermal, GLOBAL_STATE->POWER_MANAGEMENT_MODULE.power, dt_s);
 
     switch (GLOBAL_STATE->device_model) {
         case DEVICE_MAX:
         case DEVICE_ULTRA:
         case DEVICE_SUPRA:
         case DEVICE_GAMMA:
-            float perc = (float) result / 100;
-            GLOBAL_STATE->POWER_MANAGEMENT_MODULE.fan_perc = perc;
-            EMC2101_set_fan_speed( perc );
+            EMC2101_set_fan_speed((float) result / 100);
             break;
         default:
     }
@@ -593,6 +600,7 @@ static void handle_overheat_recovery(GlobalState * GLOBAL_STATE, const char* dev
     nvs_config_set_u16(NVS_CONFIG_OVERHEAT_MODE, 0);
     // Log recovery event
     dataBase_log_event("power", "info", "Overheat recovery completed - restarting system", "{}");
+    dataBase_flush_logs(2000);
     
     // Restart the ESP32
     esp_restart();
@@ -642,49 +650,49 @@ void POWER_MANAGEMENT_task(void * pvParameters)
         default:
     }
 
+    ThermalController thermal;
+    THERMAL_init(&thermal, THERMAL_SETPOINT_TEMP, THROTTLE_TEMP, GLOBAL_STATE->AUTOTUNE_MODULE.maxPower);
+
+    PowerCapController power_cap;
+    POWERCAP_init(&power_cap);
+
+    power_task_handle = xTaskGetCurrentTaskHandle();
+    nvs_config_subscribe(on_config_change, NULL);
+
     vTaskDelay(500 / portTICK_PERIOD_MS);
     uint16_t last_core_voltage = 0.0;
     uint16_t last_asic_frequency = power_management->frequency_value;
+    int64_t last_loop_time = esp_timer_get_time();
+    bool thermal_throttled = false;
+    bool power_capped = false;
+    bool readings_missing = false;
     
     while (1) {
-
-        switch (GLOBAL_STATE->device_model) {
-            case DEVICE_MAX:
-            case DEVICE_ULTRA:
-            case DEVICE_SUPRA:
-				if (GLOBAL_STATE->board_version >= 402 && GLOBAL_STATE->board_version <= 499) {
-                    power_management->voltage = TPS546_get_vin() * 1000;
-                    power_management->current = TPS546_get_iout() * 1000;
-                    // calculate regulator power (in milliwatts)
-                    power_management->power = (TPS546_get_vout() * power_management->current) / 1000;
-                    // The power reading from the TPS546 is only it's output power. So the rest of the Bitaxe power is not accounted for.
-                    power_management->power += SUPRA_POWER_OFFSET; // Add offset for the rest of the Bitaxe power. TODO: this better.
-				} else {
-                    if (INA260_installed() == true) {
-                        power_management->voltage = INA260_read_voltage();
-                        power_management->current = INA260_read_current();
-                        power_management->power = INA260_read_power() / 1000;
-                    }
-				}
-            
-                break;
-            case DEVICE_GAMMA:
-                    power_management->voltage = TPS546_get_vin() * 1000;
-                    power_management->current = TPS546_get_iout() * 1000;
-                    // calculate regulator power (in milliwatts)
-                    power_management->power = (TPS546_get_vout() * power_management->current) / 1000;
-                    // The power reading from the TPS546 is only it's output power. So the rest of the Bitaxe power is not accounted for.
-                    power_management->power += GAMMA_POWER_OFFSET; // Add offset for the rest of the Bitaxe power. TODO: this better.
-                break;
-            default:
+        int64_t loop_time = esp_timer_get_time();
+        float dt_s = (loop_time - last_loop_time) / 1000000.0;
+        last_loop_time = loop_time;
+
+        // Sensor reads happen on the sensor task with bounded I2C timeouts, we only consume its snapshot
+        SensorSnapshot sensors;
+        bool sensors_fresh = SENSOR_get_snapshot(&sensors) && SENSOR_snapshot_is_fresh(&sensors);
+
+        if (sensors.valid & SENSOR_VALID_POWER) {
+            power_management->voltage = sensors.voltage;
+            power_management->current = sensors.current;
+            power_management->power = sensors.power;
+        }
+        if (sensors.valid & SENSOR_VALID_FAN) {
+            power_management->fan_rpm = sensors.fan_rpm;
+        }
+        if (sensors.valid & SENSOR_VALID_CHIP_TEMP) {
+            power_management->chip_temp_avg = sensors.chip_temp;
+        }
+        if (sensors.valid & SENSOR_VALID_VR_TEMP) {
+            power_management->vr_temp = sensors.vr_temp;
         }
-
-        power_management->fan_rpm = EMC2101_get_fan_speed();
 
         switch (GLOBAL_STATE->device_model) {
             case DEVICE_MAX:
-                power_management->chip_temp_avg = GLOBAL_STATE->ASIC_initalized ? EMC2101_get_external_temp() : -1;
-
                 if ((power_management->chip_temp_avg > THROTTLE_TEMP) &&
                     (power_management->frequency_value > 50 || power_management->voltage > 1000)) {
                     
@@ -711,15 +719,6 @@ void POWER_MANAGEMENT_task(void * pvParameters)
                 break;
             case DEVICE_ULTRA:
             case DEVICE_SUPRA:
-                
-                if (GLOBAL_STATE->board_version >= 402 && GLOBAL_STATE->board_version <= 499) {
-                    power_management->chip_temp_avg = GLOBAL_STATE->ASIC_initalized ? EMC2101_get_external_temp() : -1;
-                    power_management->vr_temp = (float)TPS546_get_temperature();
-                } else {
-                    power_management->chip_temp_avg = EMC2101_get_internal_temp() + 5;
-                    power_management->vr_temp = 0.0;
-                }
-
                 // EMC2101 will give bad readings if the ASIC is turned off
                 if(power_management->voltage < TPS546_INIT_VOUT_MIN){
                     break;
@@ -753,9 +752,6 @@ void POWER_MANAGEMENT_task(void * pvParameters)
 
                 break;
             case DEVICE_GAMMA:
-                power_management->chip_temp_avg = GLOBAL_STATE->ASIC_initalized ? EMC2101_get_external_temp() : -1;
-                power_management->vr_temp = (float)TPS546_get_temperature();
-
                 // EMC2101 will give bad readings if the ASIC is turned off
                 if(power_management->voltage < TPS546_INIT_VOUT_MIN){
                     break;
@@ -791,9 +787,29 @@ void POWER_MANAGEMENT_task(void * pvParameters)
         }
 
 
-        if (nvs_config_get_u16(NVS_CONFIG_AUTO_FAN_SPEED, 1) == 1) {
+        THERMAL_observe(&thermal, power_management->chip_temp_avg, power_management->fan_perc, power_management->fan_rpm, dt_s);
 
-            power_management->fan_perc = (float)automatic_fan_speed(power_management->chip_temp_avg, GLOBAL_STATE);
+        // Without current temperature readings the fan control is flying blind, fall back to full airflow
+        bool missing = !sensors_fresh || !(sensors.valid & SENSOR_VALID_CHIP_TEMP);
+        if (missing != readings_missing) {
+            if (missing) {
+                ESP_LOGW(TAG, "Temperature readings unavailable (%s), forcing fan to 100%%",
+                         sensors_fresh ? "sensor error" : "stale snapshot");
+            } else {
+                ESP_LOGI(TAG, "Temperature readings are back, resuming fan control");
+            }
+            readings_missing = missing;
+        }
+
+        bool auto_fan = nvs_config_get_u16(NVS_CONFIG_AUTO_FAN_SPEED, 1) == 1;
+        if (readings_missing) {
+            if (power_management->fan_perc != 100) {
+                EMC2101_set_fan_speed(1);
+                power_management->fan_perc = 100;
+            }
+        } else if (auto_fan) {
+
+            power_management->fan_perc = (float)automatic_fan_speed(&thermal, dt_s, GLOBAL_STATE);
 
         } else {
             switch (GLOBAL_STATE->device_model) {
@@ -821,10 +837,23 @@ void POWER_MANAGEMENT_task(void * pvParameters)
         }
 
         // New voltage and frequency adjustment code
-        uint16_t core_voltage = nvs_config_get_u16(NVS_CONFIG_ASIC_VOLTAGE, CONFIG_ASIC_VOLTAGE);
-        uint16_t asic_frequency = nvs_config_get_u16(NVS_CONFIG_ASIC_FREQ, CONFIG_ASIC_FREQUENCY);
-
-        if (core_voltage != last_core_voltage) {
+        uint16_t requested_voltage = nvs_config_get_u16(NVS_CONFIG_ASIC_VOLTAGE, CONFIG_ASIC_VOLTAGE);
+        uint16_t requested_frequency = nvs_config_get_u16(NVS_CONFIG_ASIC_FREQ, CONFIG_ASIC_FREQUENCY);
+        // Thermal and power caps sit on top of the configured frequency so NVS keeps the user's setting
+        uint16_t thermal_frequency = THERMAL_limit_frequency(&thermal, requested_frequency,
+                                                             GLOBAL_STATE->AUTOTUNE_MODULE.minFrequency, auto_fan);
+        POWERCAP_set_cap(&power_cap, nvs_config_get_u16(NVS_CONFIG_POWER_CAP, 0));
+        uint16_t capped_frequency = POWERCAP_limit_frequency(&power_cap, power_management->power,
+                                                             (uint16_t) power_management->frequency_value, requested_frequency,
+                                                             GLOBAL_STATE->AUTOTUNE_MODULE.minFrequency);
+        uint16_t asic_frequency = thermal_frequency < capped_frequency ? thermal_frequency : capped_frequency;
+        uint16_t core_voltage = POWERCAP_limit_voltage(&power_cap, requested_voltage, requested_frequency,
+                                                       GLOBAL_STATE->AUTOTUNE_MODULE.minDomainVoltage);
+        power_management->power_cap = power_cap.cap;
+        power_management->power_capped = POWERCAP_is_limiting(&power_cap, requested_frequency);
+
+        // Raise the voltage before the frequency and lower it after, so the ASIC never runs undervolted
+        if (core_voltage > last_core_voltage) {
             ESP_LOGI(TAG, "setting new vcore voltage to %umV", core_voltage);
             VCORE_set_voltage((double) core_voltage / 1000.0, GLOBAL_STATE);
             last_core_voltage = core_voltage;
@@ -832,6 +861,19 @@ void POWER_MANAGEMENT_task(void * pvParameters)
 
         if (asic_frequency != last_asic_frequency) {
             ESP_LOGI(TAG, "New ASIC frequency requested: %uMHz (current: %uMHz)", asic_frequency, last_asic_frequency);
+            if (capped_frequency < thermal_frequency || (power_capped && asic_frequency == capped_frequency)) {
+                char cap_data[128];
+                snprintf(cap_data, sizeof(cap_data),
+                         "{\"power\":%.1f,\"powerCap\":%u,\"frequency\":%u,\"requestedFrequency\":%u,\"voltage\":%u}",
+                         power_management->power, power_cap.cap, asic_frequency, requested_frequency, core_voltage);
+                dataBase_log_event("power", "warn", "Power cap adjusted ASIC frequency", cap_data);
+            } else if (asic_frequency != requested_frequency || thermal_throttled) {
+                char throttle_data[128];
+                snprintf(throttle_data, sizeof(throttle_data),
+                         "{\"chipTemp\":%.1f,\"frequency\":%u,\"requestedFrequency\":%u,\"fanSpeed\":%u}",
+                         power_management->chip_temp_avg, asic_frequency, requested_frequency, power_management->fan_perc);
+                dataBase_log_event("power", "warn", "Thermal throttle adjusted ASIC frequency", throttle_data);
+            }
             if (do_frequency_transition((float)asic_frequency)) {
                 power_management->frequency_value = (float)asic_frequency;
                 ESP_LOGI(TAG, "Successfully transitioned to new ASIC frequency: %uMHz", asic_frequency);
@@ -840,6 +882,15 @@ void POWER_MANAGEMENT_task(void * pvParameters)
             }
             last_asic_frequency = asic_frequency;
         }
+        // Track the limits every loop, a cap can clear without the frequency changing
+        thermal_throttled = thermal_frequency != requested_frequency;
+        power_capped = capped_frequency != requested_frequency;
+
+        if (core_voltage < last_core_voltage) {
+            ESP_LOGI(TAG, "setting new vcore voltage to %umV", core_voltage);
+            VCORE_set_voltage((double) core_voltage / 1000.0, GLOBAL_STATE);
+            last_core_voltage = core_voltage;
+        }
 
         // Check for changing of overheat mode
         SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
@@ -849,7 +900,10 @@ void POWER_MANAGEMENT_task(void * pvParameters)
             module->overheat_mode = new_overheat_mode;
             ESP_LOGI(TAG, "Overheat mode updated to: %d", module->overheat_mode);
         }
-        autotuneOffset(GLOBAL_STATE);
-        vTaskDelay(POLL_RATE / portTICK_PERIOD_MS);
+        // Let the thermal and power caps settle before autotune writes new targets based on the capped frequency
+        if (!thermal_throttled && !power_capped) {
+            autotuneOffset(GLOBAL_STATE);
+        }
+        ulTaskNotifyTake(pdTRUE, POLL_RATE / portTICK_PERIOD_MS);
     }
 }
@@ -17,6 +17,8 @@ typedef struct
     float frequency_value;
     float power;
     float current;
+    uint16_t power_cap;       // Power budget in W (0 = disabled)
+    bool power_capped;        // Frequency currently held below the setting by the power cap
     bool HAS_POWER_EN;
     bool HAS_PLUG_SENSE;
 } PowerManagementModule;
@@ -0,0 +1,203 @@
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "global_state.h"
+#include "EMC2101.h"
+#include "INA260.h"
+#include "TPS546.h"
+#include "sensor_task.h"
+
+#define SUPRA_POWER_OFFSET 5
+#define GAMMA_POWER_OFFSET 5
+
+// After this many failed cycles in a row a device is skipped for SENSOR_BACKOFF_MS
+// so one wedged device can't eat the whole cycle in timeouts
+#define SENSOR_MAX_FAILURES 3
+#define SENSOR_BACKOFF_MS 5000
+
+static const char * TAG = "sensor_task";
+
+typedef esp_err_t (*sensor_read_fn)(GlobalState * GLOBAL_STATE, SensorSnapshot * snapshot);
+
+typedef struct
+{
+    const char * name;
+    sensor_read_fn read;
+    uint32_t valid_bits;
+    uint8_t failures;
+    int64_t retry_after_us;
+} SensorDevice;
+
+static SensorSnapshot published;
+static uint32_t publish_count = 0;
+static portMUX_TYPE snapshot_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static bool uses_tps546(GlobalState * GLOBAL_STATE)
+{
+    switch (GLOBAL_STATE->device_model) {
+        case DEVICE_MAX:
+        case DEVICE_ULTRA:
+        case DEVICE_SUPRA:
+            return GLOBAL_STATE->board_version >= 402 && GLOBAL_STATE->board_version <= 499;
+        case DEVICE_GAMMA:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static esp_err_t read_tps546(GlobalState * GLOBAL_STATE, SensorSnapshot * snapshot)
+{
+    TPS546_Telemetry telemetry;
+    esp_err_t err = TPS546_read_telemetry(&telemetry);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    snapshot->voltage = telemetry.vin * 1000;
+    snapshot->current = telemetry.iout * 1000;
+    // calculate regulator power (in milliwatts)
+    snapshot->power = (telemetry.vout * snapshot->current) / 1000;
+    // The power reading from the TPS546 is only it's output power. So the rest of the Bitaxe power is not accounted for.
+    // Add offset for the rest of the Bitaxe power. TODO: this better.
+    snapshot->power += GLOBAL_STATE->device_model == DEVICE_GAMMA ? GAMMA_POWER_OFFSET : SUPRA_POWER_OFFSET;
+    snapshot->vr_temp = telemetry.temperature;
+    return ESP_OK;
+}
+
+static esp_err_t read_ina260(GlobalState * GLOBAL_STATE, SensorSnapshot * snapshot)
+{
+    float current, voltage, power;
+    esp_err_t err = INA260_read_all(&current, &voltage, &power);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    snapshot->voltage = voltage;
+    snapshot->current = current;
+    snapshot->power = power / 1000;
+    snapshot->vr_temp = 0.0;
+    return ESP_OK;
+}
+
+static esp_err_t read_emc2101(GlobalState * GLOBAL_STATE, SensorSnapshot * snapshot)
+{
+    uint16_t rpm;
+    esp_err_t err = EMC2101_read_fan_speed(&rpm);
+    if (err != ESP_OK) {
+        return err;
+    }
+    snapshot->fan_rpm = rpm;
+
+    bool external_diode = GLOBAL_STATE->device_model == DEVICE_MAX || GLOBAL_STATE->device_model == DEVICE_GAMMA ||
+                          uses_tps546(GLOBAL_STATE);
+    if (external_diode) {
+        // The external diode reads garbage until the ASIC is running
+        if (!GLOBAL_STATE->ASIC_initalized) {
+            snapshot->chip_temp = -1;
+            return ESP_OK;
+        }
+        float temp;
+        err = EMC2101_read_external_temp(&temp);
+        if (err == ESP_OK) {
+            snapshot->chip_temp = temp;
+        }
+        return err;
+    }
+
+    uint8_t temp;
+    err = EMC2101_read_internal_temp(&temp);
+    if (err == ESP_OK) {
+        snapshot->chip_temp = temp + 5;
+    }
+    return err;
+}
+
+static void publish(const SensorSnapshot * snapshot)
+{
+    taskENTER_CRITICAL(&snapshot_mux);
+    published = *snapshot;
+    published.sequence = ++publish_count;
+    published.timestamp_us = esp_timer_get_time();
+    taskEXIT_CRITICAL(&snapshot_mux);
+}
+
+bool SENSOR_get_snapshot(SensorSnapshot * snapshot)
+{
+    taskENTER_CRITICAL(&snapshot_mux);
+    *snapshot = published;
+    taskEXIT_CRITICAL(&snapshot_mux);
+    return snapshot->sequence != 0;
+}
+
+bool SENSOR_snapshot_is_fresh(const SensorSnapshot * snapshot)
+{
+    return snapshot->sequence != 0 && (esp_timer_get_time() - snapshot->timestamp_us) < SENSOR_STALE_MS * 1000LL;
+}
+
+void SENSOR_task(void * pvParameters)
+{
+    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
+
+    SensorDevice devices[2];
+    size_t device_count = 0;
+
+    // One batch per physical device, in the order the power task used to read them
+    if (uses_tps546(GLOBAL_STATE)) {
+        devices[device_count++] = (SensorDevice) {
+            .name = "TPS546", .read = read_tps546, .valid_bits = SENSOR_VALID_POWER | SENSOR_VALID_VR_TEMP
+        };
+    } else if (GLOBAL_STATE->device_model != DEVICE_UNKNOWN && INA260_installed()) {
+        devices[device_count++] = (SensorDevice) {
+            .name = "INA260", .read = read_ina260, .valid_bits = SENSOR_VALID_POWER | SENSOR_VALID_VR_TEMP
+        };
+    }
+    if (GLOBAL_STATE->device_model != DEVICE_UNKNOWN) {
+        devices[device_count++] = (SensorDevice) {
+            .name = "EMC2101", .read = read_emc2101, .valid_bits = SENSOR_VALID_FAN | SENSOR_VALID_CHIP_TEMP
+        };
+    }
+
+    ESP_LOGI(TAG, "Polling %u devices every %dms", (unsigned) device_count, SENSOR_POLL_RATE_MS);
+
+    SensorSnapshot snapshot = {
+        .chip_temp = -1,
+    };
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (1) {
+        int64_t now = esp_timer_get_time();
+
+        for (size_t i = 0; i < device_count; i++) {
+            SensorDevice * device = &devices[i];
+
+            if (device->retry_after_us > now) {
+                snapshot.valid &= ~device->valid_bits;
+                continue;
+            }
+
+            if (device->read(GLOBAL_STATE, &snapshot) == ESP_OK) {
+                if (device->failures >= SENSOR_MAX_FAILURES) {
+                    ESP_LOGI(TAG, "%s responding again", device->name);
+                }
+                device->failures = 0;
+                snapshot.valid |= device->valid_bits;
+            } else {
+                snapshot.valid &= ~device->valid_bits;
+                if (device->failures < UINT8_MAX) {
+                    device->failures++;
+                }
+                if (device->failures >= SENSOR_MAX_FAILURES) {
+                    ESP_LOGW(TAG, "%s failed %d times, backing off %dms", device->name, device->failures, SENSOR_BACKOFF_MS);
+                    device->retry_after_us = now + SENSOR_BACKOFF_MS * 1000LL;
+                }
+            }
+        }
+
+        publish(&snapshot);
+
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(SENSOR_POLL_RATE_MS));
+    }
+}
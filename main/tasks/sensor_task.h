@@ -0,0 +1,44 @@
+#ifndef SENSOR_TASK_H_
+#define SENSOR_TASK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SENSOR_POLL_RATE_MS 500
+// A snapshot older than this means the sensor task itself is not making progress
+#define SENSOR_STALE_MS 3000
+
+// Bits in SensorSnapshot.valid for readings that succeeded in the latest cycle
+#define SENSOR_VALID_POWER     (1 << 0)
+#define SENSOR_VALID_FAN       (1 << 1)
+#define SENSOR_VALID_CHIP_TEMP (1 << 2)
+#define SENSOR_VALID_VR_TEMP   (1 << 3)
+
+typedef struct
+{
+    float voltage;        // Input voltage in mV
+    float current;        // Current in mA
+    float power;          // Power in W
+    float chip_temp;      // ASIC temperature in °C, -1 while the ASIC is not initialized
+    float vr_temp;        // Voltage regulator temperature in °C
+    uint16_t fan_rpm;
+    uint32_t valid;       // SENSOR_VALID_* bits, fields without their bit hold the last good value
+    uint32_t sequence;    // Incremented on every publish
+    int64_t timestamp_us; // esp_timer time of the publish
+} SensorSnapshot;
+
+void SENSOR_task(void * pvParameters);
+
+/**
+ * @brief Copy the latest published sensor snapshot.
+ *
+ * @return false if nothing has been published yet
+ */
+bool SENSOR_get_snapshot(SensorSnapshot * snapshot);
+
+/**
+ * @brief True if the snapshot was published within SENSOR_STALE_MS.
+ */
+bool SENSOR_snapshot_is_fresh(const SensorSnapshot * snapshot);
+
+#endif /* SENSOR_TASK_H_ */
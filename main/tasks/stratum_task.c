@@ -5,12 +5,16 @@
 #include "system.h"
 #include "global_state.h"
 #include "lwip/dns.h"
+#include "lwip/sockets.h"
 #include <lwip/tcpip.h>
 #include "nvs_config.h"
 #include "stratum_task.h"
 #include "work_queue.h"
+#include "dataBase.h"
 #include "esp_wifi.h"
+#include "esp_timer.h"
 #include <esp_sntp.h>
+#include <string.h>
 #include <time.h>
 
 #define PORT CONFIG_STRATUM_PORT
@@ -25,14 +29,18 @@
 
 #define MAX_RETRY_ATTEMPTS 3
 #define MAX_CRITICAL_RETRY_ATTEMPTS 5
+// How often an idle connection checks for changed pool settings and the heartbeat
+#define POOL_SETTINGS_POLL_MS 1000
 
 static const char * TAG = "stratum_task";
 
 static StratumApiV1Message stratum_api_v1_message = {};
 static SystemTaskModule SYSTEM_TASK_MODULE = {.stratum_difficulty = 8192};
 
-static const char * primary_stratum_url;
-static uint16_t primary_stratum_port;
+// Set when a pool setting was written, the task reconnects with the new settings
+static volatile bool pool_settings_changed = false;
+// Set by the heartbeat when the primary pool answers again while on the fallback
+static volatile bool primary_reachable = false;
 
 bool is_wifi_connected() {
     wifi_ap_record_t ap_info;
@@ -70,10 +78,41 @@ void stratum_close_connection(GlobalState * GLOBAL_STATE)
     vTaskDelay(1000 / portTICK_PERIOD_MS);
 }
 
+static bool is_pool_setting(const char * key)
+{
+    return strcmp(key, NVS_CONFIG_STRATUM_URL) == 0 || strcmp(key, NVS_CONFIG_STRATUM_PORT) == 0 ||
+           strcmp(key, NVS_CONFIG_STRATUM_USER) == 0 || strcmp(key, NVS_CONFIG_STRATUM_PASS) == 0 ||
+           strcmp(key, NVS_CONFIG_FALLBACK_STRATUM_URL) == 0 || strcmp(key, NVS_CONFIG_FALLBACK_STRATUM_PORT) == 0 ||
+           strcmp(key, NVS_CONFIG_FALLBACK_STRATUM_USER) == 0 || strcmp(key, NVS_CONFIG_FALLBACK_STRATUM_PASS) == 0;
+}
+
+// Runs on the writing task, the stratum task drops its own connection when it sees the flag
+static void on_config_change(const char * key, void * ctx)
+{
+    if (is_pool_setting(key)) {
+        pool_settings_changed = true;
+    }
+}
+
+// True when sock has data within timeout_ms
+static bool socket_readable(int sock, int timeout_ms)
+{
+    struct timeval timeout = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000,
+    };
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(sock, &readable);
+    return select(sock + 1, &readable, NULL, NULL, &timeout) != 0;
+}
+
 void stratum_primary_heartbeat(void * pvParameters)
 {
     GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
+    char primary_stratum_url[POOL_URL_SIZE];
 
+    SYSTEM_copy_pool_url(GLOBAL_STATE, false, primary_stratum_url, sizeof(primary_stratum_url));
     ESP_LOGI(TAG, "Starting heartbeat thread for primary endpoint: %s", primary_stratum_url);
     vTaskDelay(10000 / portTICK_PERIOD_MS);
 
@@ -88,6 +127,8 @@ void stratum_primary_heartbeat(void * pvParameters)
         }
 
         char host_ip[INET_ADDRSTRLEN];
+        SYSTEM_copy_pool_url(GLOBAL_STATE, false, primary_stratum_url, sizeof(primary_stratum_url));
+        uint16_t primary_stratum_port = GLOBAL_STATE->SYSTEM_MODULE.pool_port;
         ESP_LOGD(TAG, "Running Heartbeat on: %s!", primary_stratum_url);
 
         if (!is_wifi_connected()) {
@@ -130,8 +171,7 @@ void stratum_primary_heartbeat(void * pvParameters)
 
         if (GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback) {
             ESP_LOGI(TAG, "Heartbeat successful and in fallback mode. Switching back to primary.");
-            GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback = false;
-            stratum_close_connection(GLOBAL_STATE);
+            primary_reachable = true;
             vTaskDelay(60000 / portTICK_PERIOD_MS);
             continue;
         }
@@ -143,8 +183,7 @@ void stratum_task(void * pvParameters)
 {
     GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
 
-    primary_stratum_url = GLOBAL_STATE->SYSTEM_MODULE.pool_url;
-    primary_stratum_port = GLOBAL_STATE->SYSTEM_MODULE.pool_port;
+    // The only writer of the pool settings, so it reads them without pool_lock
     char * stratum_url = GLOBAL_STATE->SYSTEM_MODULE.pool_url;
     uint16_t port = GLOBAL_STATE->SYSTEM_MODULE.pool_port;
 
@@ -159,6 +198,7 @@ void stratum_task(void * pvParameters)
     timeout.tv_usec = 0;
 
     xTaskCreate(stratum_primary_heartbeat, "stratum primary heartbeat", 4096, pvParameters, 1, NULL);
+    nvs_config_subscribe(on_config_change, NULL);
 
     ESP_LOGI(TAG, "Trying to get IP for URL: %s", stratum_url);
     while (1) {
@@ -169,9 +209,17 @@ void stratum_task(void * pvParameters)
             continue;
         }
 
+        if (pool_settings_changed) {
+            pool_settings_changed = false;
+            SYSTEM_load_pool_settings(GLOBAL_STATE);
+            ESP_LOGI(TAG, "Pool settings changed, connecting to %s:%d", GLOBAL_STATE->SYSTEM_MODULE.pool_url,
+                     GLOBAL_STATE->SYSTEM_MODULE.pool_port);
+            retry_attempts = 0;
+        }
+
         if (retry_attempts >= MAX_RETRY_ATTEMPTS)
         {
-            if (GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_url == NULL || GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_url[0] == '\0') {
+            if (GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_url[0] == '\0') {
                 ESP_LOGI(TAG, "Unable to switch to fallback. No url configured. (retries: %d)...", retry_attempts);
                 GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback = false;
                 retry_attempts = 0;
@@ -206,6 +254,7 @@ void stratum_task(void * pvParameters)
             ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
             if (++retry_critical_attempts > MAX_CRITICAL_RETRY_ATTEMPTS) {
                 ESP_LOGE(TAG, "Max retry attempts reached, restarting...");
+                dataBase_flush_logs(2000);
                 esp_restart();
             }
             vTaskDelay(5000 / portTICK_PERIOD_MS);
@@ -254,6 +303,23 @@ void stratum_task(void * pvParameters)
         STRATUM_V1_suggest_difficulty(GLOBAL_STATE->sock, STRATUM_DIFFICULTY);
 
         while (1) {
+            if (pool_settings_changed) {
+                ESP_LOGI(TAG, "Pool settings changed, reconnecting...");
+                stratum_close_connection(GLOBAL_STATE);
+                break;
+            }
+            if (primary_reachable) {
+                primary_reachable = false;
+                if (GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback) {
+                    GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback = false;
+                    stratum_close_connection(GLOBAL_STATE);
+                    break;
+                }
+            }
+            if (!STRATUM_V1_line_buffered() && !socket_readable(GLOBAL_STATE->sock, POOL_SETTINGS_POLL_MS)) {
+                continue;
+            }
+
             char * line = STRATUM_V1_receive_jsonrpc_line(GLOBAL_STATE->sock);
             if (!line) {
                 ESP_LOGE(TAG, "Failed to receive JSON-RPC line, reconnecting...");
@@ -265,8 +331,11 @@ void stratum_task(void * pvParameters)
             free(line);
 
             if (stratum_api_v1_message.method == MINING_NOTIFY) {
+                stratum_api_v1_message.mining_notification->received_us = esp_timer_get_time();
                 SYSTEM_notify_new_ntime(GLOBAL_STATE, stratum_api_v1_message.mining_notification->ntime);
-                if (stratum_api_v1_message.should_abandon_work &&
+                // Work for the old block is worthless even when the pool does not set clean_jobs
+                bool new_block = SYSTEM_notify_chain_state(GLOBAL_STATE, stratum_api_v1_message.mining_notification);
+                if ((stratum_api_v1_message.should_abandon_work || new_block) &&
                     (GLOBAL_STATE->stratum_queue.count > 0 || GLOBAL_STATE->ASIC_jobs_queue.count > 0)) {
                     cleanQueue(GLOBAL_STATE);
                 }
@@ -300,7 +369,7 @@ void stratum_task(void * pvParameters)
                     SYSTEM_notify_accepted_share(GLOBAL_STATE);
                 } else {
                     ESP_LOGW(TAG, "message result rejected: %s", stratum_api_v1_message.error_str ? stratum_api_v1_message.error_str : "unknown");
-                    SYSTEM_notify_rejected_share(GLOBAL_STATE);
+                    SYSTEM_notify_rejected_share(GLOBAL_STATE, stratum_api_v1_message.error_str);
                 }
             } else if (stratum_api_v1_message.method == STRATUM_RESULT_SETUP) {
                 if (stratum_api_v1_message.response_success) {
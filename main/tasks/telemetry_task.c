@@ -0,0 +1,361 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "global_state.h"
+#include "dataBase.h"
+#include "telemetry_task.h"
+#include "sensor_task.h"
+
+#define TELEMETRY_SAMPLE_RATE_MS 1000
+
+// Ring depths: 5 minutes of 1 s, 3 hours of 1 min, 7 days of 1 h
+#define TELEMETRY_1S_DEPTH 300
+#define TELEMETRY_1M_DEPTH 180
+#define TELEMETRY_1H_DEPTH 168
+
+#define TELEMETRY_FILE "telemetry.bin"
+#define TELEMETRY_TMP_FILE "telemetry.tmp"
+#define TELEMETRY_PERSIST_INTERVAL_S (10 * 60)
+
+static const char * TAG = "telemetry";
+
+typedef struct
+{
+    TelemetrySample * samples;
+    uint32_t depth;
+    uint32_t total;        // Samples ever written, the next sequence number
+    uint32_t interval_s;
+} TelemetryRing;
+
+// Running sums for averaging finer samples into the next resolution
+typedef struct
+{
+    int64_t voltage;
+    int64_t current;
+    int64_t power;
+    int64_t chip_temp;
+    int64_t vr_temp;
+    int64_t fan_rpm;
+    int64_t hashrate;
+    uint32_t count;
+} TelemetryAccumulator;
+
+static TelemetrySample samples_1s[TELEMETRY_1S_DEPTH];
+static TelemetrySample samples_1m[TELEMETRY_1M_DEPTH];
+static TelemetrySample samples_1h[TELEMETRY_1H_DEPTH];
+
+static TelemetryRing rings[TELEMETRY_RES_COUNT] = {
+    [TELEMETRY_RES_1S] = { .samples = samples_1s, .depth = TELEMETRY_1S_DEPTH, .interval_s = 1 },
+    [TELEMETRY_RES_1M] = { .samples = samples_1m, .depth = TELEMETRY_1M_DEPTH, .interval_s = 60 },
+    [TELEMETRY_RES_1H] = { .samples = samples_1h, .depth = TELEMETRY_1H_DEPTH, .interval_s = 3600 },
+};
+
+static SemaphoreHandle_t telemetry_lock = NULL;
+
+static uint32_t ring_count(const TelemetryRing * ring)
+{
+    return ring->total < ring->depth ? ring->total : ring->depth;
+}
+
+static void ring_push(TelemetryRing * ring, const TelemetrySample * sample)
+{
+    ring->samples[ring->total % ring->depth] = *sample;
+    ring->total++;
+}
+
+static void accumulator_add(TelemetryAccumulator * acc, const TelemetrySample * sample)
+{
+    acc->voltage += sample->voltage;
+    acc->current += sample->current;
+    acc->power += sample->power;
+    acc->chip_temp += sample->chip_temp;
+    acc->vr_temp += sample->vr_temp;
+    acc->fan_rpm += sample->fan_rpm;
+    acc->hashrate += sample->hashrate;
+    acc->count++;
+}
+
+static void accumulator_average(TelemetryAccumulator * acc, uint32_t timestamp, TelemetrySample * out)
+{
+    uint32_t n = acc->count ? acc->count : 1;
+    out->timestamp = timestamp;
+    out->voltage = acc->voltage / n;
+    out->current = acc->current / n;
+    out->power = acc->power / n;
+    out->chip_temp = acc->chip_temp / n;
+    out->vr_temp = acc->vr_temp / n;
+    out->fan_rpm = acc->fan_rpm / n;
+    out->hashrate = acc->hashrate / n;
+    memset(acc, 0, sizeof(*acc));
+}
+
+static uint16_t clamp_u16(float value)
+{
+    if (value <= 0) {
+        return 0;
+    }
+    return value >= UINT16_MAX ? UINT16_MAX : (uint16_t) value;
+}
+
+static int16_t clamp_i16(float value)
+{
+    if (value <= INT16_MIN) {
+        return INT16_MIN;
+    }
+    return value >= INT16_MAX ? INT16_MAX : (int16_t) value;
+}
+
+static void take_sample(GlobalState * GLOBAL_STATE, TelemetrySample * sample)
+{
+    PowerManagementModule * power = &GLOBAL_STATE->POWER_MANAGEMENT_MODULE;
+
+    // Prefer the sensor snapshot, it updates faster than the power management loop
+    SensorSnapshot sensors;
+    if (SENSOR_get_snapshot(&sensors) && SENSOR_snapshot_is_fresh(&sensors)) {
+        if (!(sensors.valid & SENSOR_VALID_POWER)) {
+            sensors.voltage = power->voltage;
+            sensors.current = power->current;
+            sensors.power = power->power;
+        }
+    } else {
+        sensors.voltage = power->voltage;
+        sensors.current = power->current;
+        sensors.power = power->power;
+        sensors.chip_temp = power->chip_temp_avg;
+        sensors.vr_temp = power->vr_temp;
+        sensors.fan_rpm = power->fan_rpm;
+    }
+
+    sample->timestamp = (uint32_t) time(NULL);
+    sample->voltage = clamp_u16(sensors.voltage);
+    sample->current = clamp_u16(sensors.current);
+    sample->power = clamp_u16(sensors.power * 100);
+    sample->chip_temp = clamp_i16(sensors.chip_temp * 10);
+    sample->vr_temp = clamp_i16(sensors.vr_temp * 10);
+    sample->fan_rpm = sensors.fan_rpm;
+    double hashrate = GLOBAL_STATE->SYSTEM_MODULE.current_hashrate * 100;
+    sample->hashrate = hashrate > 0 ? (uint32_t) hashrate : 0;
+}
+
+// Write the coarse rings oldest first so the file layout doesn't depend on ring position
+static void write_ring(FILE * file, const TelemetryRing * ring)
+{
+    uint32_t count = ring_count(ring);
+    TelemetryHeader header = {
+        .magic = TELEMETRY_MAGIC,
+        .version = TELEMETRY_VERSION,
+        .sample_size = sizeof(TelemetrySample),
+        .interval_s = ring->interval_s,
+        .count = count,
+    };
+    fwrite(&header, sizeof(header), 1, file);
+    for (uint32_t seq = ring->total - count; seq < ring->total; seq++) {
+        fwrite(&ring->samples[seq % ring->depth], sizeof(TelemetrySample), 1, file);
+    }
+}
+
+static bool read_ring(FILE * file, TelemetryRing * ring)
+{
+    TelemetryHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != TELEMETRY_MAGIC ||
+        header.version != TELEMETRY_VERSION || header.sample_size != sizeof(TelemetrySample) ||
+        header.interval_s != ring->interval_s) {
+        return false;
+    }
+
+    uint32_t count = header.count;
+    if (count > ring->depth) {
+        // Drop the oldest entries that no longer fit
+        fseek(file, (count - ring->depth) * sizeof(TelemetrySample), SEEK_CUR);
+        count = ring->depth;
+    }
+
+    ring->total = 0;
+    TelemetrySample sample;
+    for (uint32_t i = 0; i < count; i++) {
+        if (fread(&sample, sizeof(sample), 1, file) != 1) {
+            return false;
+        }
+        ring_push(ring, &sample);
+    }
+    return true;
+}
+
+static void telemetry_persist(void)
+{
+    char path[64];
+    char tmp_path[64];
+    if (dataBase_get_logs_path(TELEMETRY_FILE, path, sizeof(path)) != ESP_OK ||
+        dataBase_get_logs_path(TELEMETRY_TMP_FILE, tmp_path, sizeof(tmp_path)) != ESP_OK) {
+        return;
+    }
+
+    FILE * file = fopen(tmp_path, "wb");
+    if (!file) {
+        ESP_LOGW(TAG, "Failed to open %s for writing", tmp_path);
+        return;
+    }
+
+    xSemaphoreTake(telemetry_lock, portMAX_DELAY);
+    write_ring(file, &rings[TELEMETRY_RES_1M]);
+    write_ring(file, &rings[TELEMETRY_RES_1H]);
+    xSemaphoreGive(telemetry_lock);
+
+    if (fclose(file) != 0) {
+        ESP_LOGW(TAG, "Failed to write %s", tmp_path);
+        remove(tmp_path);
+        return;
+    }
+
+    // SPIFFS rename does not replace an existing file
+    remove(path);
+    if (rename(tmp_path, path) != 0) {
+        ESP_LOGW(TAG, "Failed to replace %s", path);
+    }
+}
+
+static void telemetry_restore(void)
+{
+    char path[64];
+    if (dataBase_get_logs_path(TELEMETRY_FILE, path, sizeof(path)) != ESP_OK) {
+        return;
+    }
+
+    FILE * file = fopen(path, "rb");
+    if (!file) {
+        return;
+    }
+
+    if (read_ring(file, &rings[TELEMETRY_RES_1M]) && read_ring(file, &rings[TELEMETRY_RES_1H])) {
+        ESP_LOGI(TAG, "Restored %lu minute and %lu hour samples",
+                 ring_count(&rings[TELEMETRY_RES_1M]), ring_count(&rings[TELEMETRY_RES_1H]));
+    } else {
+        ESP_LOGW(TAG, "Discarding unreadable telemetry file");
+        rings[TELEMETRY_RES_1M].total = 0;
+        rings[TELEMETRY_RES_1H].total = 0;
+    }
+    fclose(file);
+}
+
+uint32_t TELEMETRY_interval_s(TelemetryResolution res)
+{
+    return rings[res].interval_s;
+}
+
+void TELEMETRY_window(TelemetryResolution res, uint32_t * oldest, uint32_t * count)
+{
+    *oldest = 0;
+    *count = 0;
+    if (telemetry_lock == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(telemetry_lock, portMAX_DELAY);
+    *count = ring_count(&rings[res]);
+    *oldest = rings[res].total - *count;
+    xSemaphoreGive(telemetry_lock);
+}
+
+TelemetrySample * TELEMETRY_snapshot(TelemetryResolution res, uint32_t * count)
+{
+    *count = 0;
+    if (telemetry_lock == NULL) {
+        return NULL;
+    }
+
+    TelemetryRing * ring = &rings[res];
+    // Sized for a full ring so the allocation stays outside the lock
+    TelemetrySample * samples = malloc(ring->depth * sizeof(TelemetrySample));
+    if (samples == NULL) {
+        return NULL;
+    }
+
+    xSemaphoreTake(telemetry_lock, portMAX_DELAY);
+    uint32_t held = ring_count(ring);
+    for (uint32_t i = 0; i < held; i++) {
+        samples[i] = ring->samples[(ring->total - held + i) % ring->depth];
+    }
+    xSemaphoreGive(telemetry_lock);
+
+    if (held == 0) {
+        free(samples);
+        return NULL;
+    }
+    *count = held;
+    return samples;
+}
+
+size_t TELEMETRY_read(TelemetryResolution res, uint32_t * seq, TelemetrySample * out, size_t max)
+{
+    if (telemetry_lock == NULL) {
+        return 0;
+    }
+
+    TelemetryRing * ring = &rings[res];
+    size_t copied = 0;
+
+    xSemaphoreTake(telemetry_lock, portMAX_DELAY);
+    uint32_t oldest = ring->total - ring_count(ring);
+    if (*seq < oldest) {
+        *seq = oldest;
+    }
+    while (copied < max && *seq < ring->total) {
+        out[copied++] = ring->samples[*seq % ring->depth];
+        (*seq)++;
+    }
+    xSemaphoreGive(telemetry_lock);
+
+    return copied;
+}
+
+void TELEMETRY_task(void * pvParameters)
+{
+    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
+
+    telemetry_lock = xSemaphoreCreateMutex();
+    telemetry_restore();
+
+    TelemetryAccumulator minute_acc = {0};
+    TelemetryAccumulator hour_acc = {0};
+    uint32_t seconds = 0;
+    TickType_t last_wake = xTaskGetTickCount();
+
+    ESP_LOGI(TAG, "Sampling every %dms", TELEMETRY_SAMPLE_RATE_MS);
+
+    while (1) {
+        TelemetrySample sample;
+        take_sample(GLOBAL_STATE, &sample);
+        accumulator_add(&minute_acc, &sample);
+        seconds++;
+
+        xSemaphoreTake(telemetry_lock, portMAX_DELAY);
+        ring_push(&rings[TELEMETRY_RES_1S], &sample);
+
+        if (seconds % 60 == 0) {
+            TelemetrySample minute;
+            accumulator_average(&minute_acc, sample.timestamp, &minute);
+            ring_push(&rings[TELEMETRY_RES_1M], &minute);
+            accumulator_add(&hour_acc, &minute);
+
+            if (seconds % 3600 == 0) {
+                TelemetrySample hour;
+                accumulator_average(&hour_acc, sample.timestamp, &hour);
+                ring_push(&rings[TELEMETRY_RES_1H], &hour);
+            }
+        }
+        xSemaphoreGive(telemetry_lock);
+
+        // Flash wear: only the coarse series are persisted, and not more often than every 10 minutes
+        if (seconds % TELEMETRY_PERSIST_INTERVAL_S == 0) {
+            telemetry_persist();
+        }
+
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(TELEMETRY_SAMPLE_RATE_MS));
+    }
+}
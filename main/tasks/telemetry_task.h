@@ -0,0 +1,69 @@
+#ifndef TELEMETRY_TASK_H_
+#define TELEMETRY_TASK_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TELEMETRY_MAGIC 0x314D4C54 // "TLM1"
+#define TELEMETRY_VERSION 1
+
+typedef enum
+{
+    TELEMETRY_RES_1S = 0,
+    TELEMETRY_RES_1M,
+    TELEMETRY_RES_1H,
+    TELEMETRY_RES_COUNT,
+} TelemetryResolution;
+
+// One fixed-point sample, averaged over the resolution window
+typedef struct __attribute__((packed))
+{
+    uint32_t timestamp;   // Unix time (or seconds since boot before the clock is synced)
+    uint16_t voltage;     // Input voltage in mV
+    uint16_t current;     // Current in mA
+    uint16_t power;       // Power in 10 mW
+    int16_t chip_temp;    // ASIC temperature in 0.1 °C
+    int16_t vr_temp;      // Voltage regulator temperature in 0.1 °C
+    uint16_t fan_rpm;     // Fan speed in RPM
+    uint32_t hashrate;    // Hashrate in 10 MH/s (0.01 GH/s)
+} TelemetrySample;
+
+// Header of the binary download, followed by `count` samples oldest first
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t sample_size;
+    uint32_t interval_s;
+    uint32_t count;
+} TelemetryHeader;
+
+void TELEMETRY_task(void * pvParameters);
+
+uint32_t TELEMETRY_interval_s(TelemetryResolution res);
+
+// Sequence number of the oldest sample still held for this resolution and the number
+// of samples held, read together under the lock
+void TELEMETRY_window(TelemetryResolution res, uint32_t * oldest, uint32_t * count);
+
+/**
+ * @brief Copy every sample held for this resolution, oldest first, under one lock
+ *
+ * The copy cannot be overwritten while it is sent, so its count is exact.
+ *
+ * @return malloc'd samples for the caller to free, NULL when empty or out of memory
+ */
+TelemetrySample * TELEMETRY_snapshot(TelemetryResolution res, uint32_t * count);
+
+/**
+ * @brief Copy samples oldest first starting at *seq.
+ *
+ * *seq is moved forward past the copied samples (and up to the oldest held
+ * sample if it has already been overwritten), so it can be passed back in to
+ * read the next block.
+ *
+ * @return Number of samples copied
+ */
+size_t TELEMETRY_read(TelemetryResolution res, uint32_t * seq, TelemetrySample * out, size_t max);
+
+#endif /* TELEMETRY_TASK_H_ */
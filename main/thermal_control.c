@@ -0,0 +1,200 @@
+#include <math.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "thermal_control.h"
+
+// PID gains, output is fan duty in %
+#define THERMAL_KP 4.0              // % per °C of error
+#define THERMAL_KI 0.05             // % per °C·s of accumulated error
+#define THERMAL_KD 20.0             // % per °C/s of temperature slope
+#define THERMAL_INTEGRAL_LIMIT 40.0
+
+// Feed-forward: fan duty expected at a given fraction of the power budget
+#define THERMAL_FAN_MIN 35.0
+#define THERMAL_FAN_MAX 100.0
+#define THERMAL_FF_SPAN 40.0
+
+#define THERMAL_SLOPE_ALPHA 0.3     // Low-pass factor for the temperature slope
+#define THERMAL_PREDICT_HORIZON_S 20.0
+
+// A fan commanded above this duty that reports 0 RPM is treated as stalled
+#define THERMAL_STALL_DUTY 50.0
+#define THERMAL_STALL_COUNT 3
+
+// Fan RPM response
+#define THERMAL_RPM_ALPHA 0.2       // Low-pass factor for the fan RPM
+#define THERMAL_SETTLE_COUNT 3      // Updates at the same duty before the RPM counts as settled
+#define THERMAL_RESPONSE_MIN 0.5    // Feed-forward is raised at most 2x for a weak fan
+
+// Frequency throttling
+#define THERMAL_FREQ_STEP 0.05      // 5% of the current cap per step
+#define THERMAL_RELEASE_HYST 5.0    // Degrees below the soft limit before raising the cap again
+#define THERMAL_STEP_INTERVAL_US (10 * 1000000LL)
+
+static const char * TAG = "thermal_control";
+
+void THERMAL_init(ThermalController * ctrl, float setpoint, float throttle_temp, float max_power)
+{
+    ctrl->setpoint = setpoint;
+    ctrl->throttle_temp = throttle_temp;
+    ctrl->integral = 0.0;
+    ctrl->last_temp = 0.0;
+    ctrl->slope = 0.0;
+    ctrl->last_fan_perc = THERMAL_FAN_MAX;
+    ctrl->fan_stall_count = 0;
+    ctrl->fan_settled = 0;
+    ctrl->fan_rpm = 0.0;
+    memset(ctrl->rpm_ref, 0, sizeof(ctrl->rpm_ref));
+    ctrl->fan_response = 1.0;
+    ctrl->max_power = max_power > 0 ? max_power : 1.0;
+    ctrl->freq_cap = 0;
+    ctrl->last_step_time = 0;
+    ctrl->initialized = false;
+    ctrl->valid = false;
+}
+
+static float _clamp(float value, float lower, float upper)
+{
+    if (value < lower) {
+        return lower;
+    }
+    if (value > upper) {
+        return upper;
+    }
+    return value;
+}
+
+void THERMAL_observe(ThermalController * ctrl, float chip_temp, float fan_perc, uint16_t fan_rpm, float dt_s)
+{
+    // Sensor not ready (ASIC off or not initialized), don't disturb the loop state
+    if (chip_temp <= 0 || isnan(chip_temp) || dt_s <= 0) {
+        ctrl->valid = false;
+        return;
+    }
+
+    if (!ctrl->initialized) {
+        ctrl->last_temp = chip_temp;
+        ctrl->slope = 0.0;
+        ctrl->initialized = true;
+    }
+
+    float raw_slope = (chip_temp - ctrl->last_temp) / dt_s;
+    ctrl->slope += THERMAL_SLOPE_ALPHA * (raw_slope - ctrl->slope);
+    ctrl->last_temp = chip_temp;
+    ctrl->valid = true;
+
+    // Fan response: commanded high but not turning means airflow we are counting on isn't there
+    if (fan_perc >= THERMAL_STALL_DUTY && fan_rpm == 0) {
+        if (ctrl->fan_stall_count < UINT8_MAX) {
+            ctrl->fan_stall_count++;
+        }
+        if (ctrl->fan_stall_count == THERMAL_STALL_COUNT) {
+            ESP_LOGW(TAG, "Fan not responding at %.0f%% duty", fan_perc);
+        }
+    } else {
+        ctrl->fan_stall_count = 0;
+    }
+
+    // Compare the settled RPM with the best this fan has done in the same duty band, a new
+    // duty needs a few updates to spin up or down before it says anything about the fan
+    if (fabsf(fan_perc - ctrl->last_fan_perc) >= 1.0) {
+        ctrl->fan_settled = 0;
+    } else if (ctrl->fan_settled < THERMAL_SETTLE_COUNT) {
+        ctrl->fan_settled++;
+    }
+    if (ctrl->fan_settled < THERMAL_SETTLE_COUNT) {
+        ctrl->fan_rpm = fan_rpm;
+    } else if (fan_rpm > 0) {
+        ctrl->fan_rpm += THERMAL_RPM_ALPHA * (fan_rpm - ctrl->fan_rpm);
+        int band = (int) _clamp(fan_perc / 10.0, 0, THERMAL_RPM_BANDS - 1);
+        if (ctrl->fan_rpm > ctrl->rpm_ref[band]) {
+            ctrl->rpm_ref[band] = (uint16_t) ctrl->fan_rpm;
+        }
+        ctrl->fan_response = _clamp(ctrl->fan_rpm / ctrl->rpm_ref[band], THERMAL_RESPONSE_MIN, 1.0);
+    }
+    ctrl->last_fan_perc = fan_perc;
+}
+
+float THERMAL_update_fan(ThermalController * ctrl, float power, float dt_s)
+{
+    if (!ctrl->valid) {
+        return THERMAL_FAN_MIN;
+    }
+
+    float chip_temp = ctrl->last_temp;
+    float error = chip_temp - ctrl->setpoint;
+    // Duty a healthy fan needs at this power, raised by how far the fan falls short of its best RPM
+    float feed_forward = (THERMAL_FAN_MIN + _clamp(power / ctrl->max_power, 0.0, 1.0) * THERMAL_FF_SPAN) / ctrl->fan_response;
+    float proportional = THERMAL_KP * error;
+    // Derivative on measurement so setpoint changes don't kick the fan
+    float derivative = THERMAL_KD * ctrl->slope;
+
+    float output = feed_forward + proportional + ctrl->integral + derivative;
+
+    // Anti-windup: only integrate when the output isn't already pinned in the direction of the error
+    bool saturated_high = output >= THERMAL_FAN_MAX && error > 0;
+    bool saturated_low = output <= THERMAL_FAN_MIN && error < 0;
+    if (!saturated_high && !saturated_low) {
+        ctrl->integral = _clamp(ctrl->integral + THERMAL_KI * error * dt_s, -THERMAL_INTEGRAL_LIMIT, THERMAL_INTEGRAL_LIMIT);
+    }
+
+    // Anything near the soft limit gets full airflow regardless of the loop
+    if (chip_temp >= ctrl->throttle_temp - THERMAL_SOFT_MARGIN) {
+        output = THERMAL_FAN_MAX;
+    }
+
+    output = _clamp(output, THERMAL_FAN_MIN, THERMAL_FAN_MAX);
+
+    ESP_LOGD(TAG, "temp %.1fC slope %.3fC/s ff %.1f (fan response %.2f) p %.1f i %.1f d %.1f -> fan %.1f%%",
+             chip_temp, ctrl->slope, feed_forward, ctrl->fan_response, proportional, ctrl->integral, derivative, output);
+
+    return output;
+}
+
+uint16_t THERMAL_limit_frequency(ThermalController * ctrl, uint16_t requested_freq, uint16_t min_freq, bool fan_adjustable)
+{
+    if (!ctrl->valid) {
+        return ctrl->freq_cap && ctrl->freq_cap < requested_freq ? ctrl->freq_cap : requested_freq;
+    }
+
+    float soft_limit = ctrl->throttle_temp - THERMAL_SOFT_MARGIN;
+    float predicted = ctrl->last_temp + ctrl->slope * THERMAL_PREDICT_HORIZON_S;
+    bool fan_headroom = fan_adjustable && ctrl->last_fan_perc < THERMAL_FAN_MAX - 1 &&
+                        ctrl->fan_stall_count < THERMAL_STALL_COUNT;
+
+    int64_t now = esp_timer_get_time();
+    bool can_step = (now - ctrl->last_step_time) >= THERMAL_STEP_INTERVAL_US;
+
+    uint16_t cap = ctrl->freq_cap ? ctrl->freq_cap : requested_freq;
+
+    if ((predicted >= soft_limit && !fan_headroom) || ctrl->last_temp >= soft_limit) {
+        if (can_step && cap > min_freq) {
+            uint16_t new_cap = (uint16_t)(cap * (1.0 - THERMAL_FREQ_STEP));
+            if (new_cap < min_freq) {
+                new_cap = min_freq;
+            }
+            ESP_LOGW(TAG, "Throttling: %.1fC (predicted %.1fC), frequency cap %uMHz -> %uMHz",
+                     ctrl->last_temp, predicted, cap, new_cap);
+            ctrl->freq_cap = new_cap;
+            ctrl->last_step_time = now;
+        }
+    } else if (ctrl->freq_cap && ctrl->last_temp < soft_limit - THERMAL_RELEASE_HYST && ctrl->slope <= 0) {
+        if (can_step) {
+            uint16_t new_cap = (uint16_t)(ctrl->freq_cap * (1.0 + THERMAL_FREQ_STEP));
+            if (new_cap >= requested_freq) {
+                ESP_LOGI(TAG, "Throttle released at %.1fC", ctrl->last_temp);
+                ctrl->freq_cap = 0;
+            } else {
+                ESP_LOGI(TAG, "Raising frequency cap %uMHz -> %uMHz", ctrl->freq_cap, new_cap);
+                ctrl->freq_cap = new_cap;
+            }
+            ctrl->last_step_time = now;
+        }
+    }
+
+    if (ctrl->freq_cap && ctrl->freq_cap < requested_freq) {
+        return ctrl->freq_cap;
+    }
+    return requested_freq;
+}
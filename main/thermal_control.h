@@ -0,0 +1,70 @@
+#ifndef THERMAL_CONTROL_H_
+#define THERMAL_CONTROL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Chip temperature the fan loop regulates to (matches the autotune target)
+#define THERMAL_SETPOINT_TEMP 60.0
+
+// Frequency throttling starts this many degrees below THROTTLE_TEMP
+#define THERMAL_SOFT_MARGIN 5.0
+
+// Fan RPM is tracked per 10% duty band, 0-9% .. 100%
+#define THERMAL_RPM_BANDS 11
+
+typedef struct
+{
+    float setpoint;           // Target chip temperature in °C
+    float throttle_temp;      // Hard overheat limit in °C
+    float integral;           // PID integral term (in fan %)
+    float last_temp;          // Filtered temperature from the previous update
+    float slope;              // Filtered temperature slope in °C/s
+    float last_fan_perc;      // Fan duty in % at the last observation
+    uint8_t fan_stall_count;  // Consecutive updates with fan commanded high but not spinning
+    uint8_t fan_settled;      // Consecutive updates at the same fan duty
+    float fan_rpm;            // Filtered fan RPM
+    uint16_t rpm_ref[THERMAL_RPM_BANDS]; // Highest settled RPM seen per duty band
+    float fan_response;       // Settled RPM over the band's reference, 1 = fan as good as it has been
+    float max_power;          // Device power budget used to scale the feed-forward
+    uint16_t freq_cap;        // Current thermal frequency cap in MHz (0 = uncapped)
+    int64_t last_step_time;   // esp_timer time of the last cap change
+    bool initialized;
+    bool valid;               // Last observation had a usable chip temperature
+} ThermalController;
+
+void THERMAL_init(ThermalController * ctrl, float setpoint, float throttle_temp, float max_power);
+
+/**
+ * @brief Feed one sample into the controller.
+ *
+ * Tracks the filtered temperature slope, whether the fan is actually turning at
+ * the commanded duty, and how its settled RPM compares with the best it has
+ * done at that duty. Call every cycle, in auto or manual fan mode.
+ */
+void THERMAL_observe(ThermalController * ctrl, float chip_temp, float fan_perc, uint16_t fan_rpm, float dt_s);
+
+/**
+ * @brief Compute the fan duty for this cycle.
+ *
+ * PID on chip temperature plus a feed-forward term from measured power so the
+ * fan responds to load changes before the die heats up. The feed-forward is
+ * scaled up when the fan turns slower than it used to at the same duty
+ * (dust, wear, a blocked intake), so it still asks for the airflow it expects.
+ *
+ * @return Fan duty in percent (min fan % .. 100)
+ */
+float THERMAL_update_fan(ThermalController * ctrl, float power, float dt_s);
+
+/**
+ * @brief Coordinated frequency throttling.
+ *
+ * Once the fan has no headroom left (saturated, stalled or under manual control)
+ * and the predicted temperature approaches the hard limit, step the frequency
+ * down; step it back up once the chips are cool.
+ *
+ * @return Frequency to run in MHz, never above requested_freq
+ */
+uint16_t THERMAL_limit_frequency(ThermalController * ctrl, uint16_t requested_freq, uint16_t min_freq, bool fan_adjustable);
+
+#endif /* THERMAL_CONTROL_H_ */